@@ -0,0 +1,393 @@
+
+// VAN bus load analyzer: per IDEN value, the packet and byte rates, the duplicate and CRC error ratios and the
+// inter-arrival jitter, plus an estimate of the overall bus utilisation
+//
+// The figures are kept in a compact, fixed-size table, that is filled in order of first appearance of each IDEN.
+// A summary is shown on the "system" screen (see BusStatsToJson); the full table is served as JSON on "/bus" (see
+// ServeBusStats in WebServer.ino).
+//
+// Note: packets that are dropped by the VanBusRx library before they reach the main loop (see VanRxPolicy.ino) are
+// not seen here, so under high load the bus utilisation is underestimated.
+
+// Defined in Metrics.ino
+extern const char gaugeStr[];
+extern const char counterStr[];
+int ScalarMetric(char* buf, const int n, PGM_P name, PGM_P type, PGM_P help, uint32_t value);
+
+// Defined in PacketToJson.ino
+extern const char emptyStr[];
+extern const char commaStr[];
+
+// When set, the bus load summary is sent to the client. Set by the client with the "bus_stats_on_client:YES"
+// websocket message.
+bool busStatsOnClient = false;
+
+// Length of a VAN packet on the bus, in time slots (TS). In Enhanced Manchester code, each 4 bits take 5 TS.
+// - Start of frame: 10 TS
+// - IDEN, COM and FCS (CRC): 12 + 4 + 16 bits = 40 TS
+// - Data: 8 bits = 10 TS per byte
+// - End of data, acknowledge, end of frame and inter-frame spacing: 2 + 2 + 5 + 8 = 17 TS
+#define VAN_PACKET_TIME_SLOTS(dataLen) (67 + 10 * (dataLen))
+
+// Inter-arrival times longer than this are not taken into account for the jitter (e.g. after the bus was silent)
+#define BUS_STATS_MAX_INTERVAL_MS (10000)
+
+// Open-addressed with linear probing; the size must be a power of 2 and well above the number of IDEN values seen
+// on the bus
+#define BUS_STATS_TABLE_SIZE (64)
+
+// Number of IDEN values shown on the "system" screen
+#define BUS_STATS_N_BUSIEST (4)
+
+struct BusIdenStats_t
+{
+    uint16_t iden;
+    int8_t printSelection;  // -1 = as per "packets" diagnostic selection (see Log.ino), 0 = muted, 1 = printed
+    uint16_t lastCrc;  // To detect duplicates
+    uint32_t nPackets;  // 0 = empty slot
+    uint32_t nBytes;
+    uint32_t nDuplicates;
+    uint32_t nCrcErrors;
+    unsigned long lastMillis;
+    uint32_t meanInterval_x16;  // Moving average of the inter-arrival time, in 1/16 milliseconds
+    uint32_t jitter_x16;  // Moving average of the deviation from the above, in 1/16 milliseconds
+
+    // Current measurement window
+    uint16_t windowPackets;
+    uint16_t windowBytes;
+
+    // Last completed measurement window
+    uint16_t packetsPerSec_x10;
+    uint16_t bytesPerSec;
+}; // struct BusIdenStats_t
+
+BusIdenStats_t busIdenStats[BUS_STATS_TABLE_SIZE];
+
+// Packets that did not fit in the table
+uint32_t nBusStatsUntracked = 0;
+
+// Time stamp of the most recent packet; used to detect bus silence (see LoopSettings in Settings.ino)
+unsigned long busLastPacketAt = 0;
+
+uint32_t busWindowTimeSlots = 0;
+unsigned long busWindowStartedAt = 0;
+uint16_t busLoad_x10 = 0;  // Percentage of time the bus was occupied, times 10
+uint16_t busPacketsPerSec = 0;
+
+inline int BusStatsHash(uint16_t iden)
+{
+    return (iden ^ iden >> 6) & (BUS_STATS_TABLE_SIZE - 1);
+} // BusStatsHash
+
+// Find the entry for the specified IDEN value. If not found, optionally creates a new entry. Returns nullptr if not
+// found (and not created).
+BusIdenStats_t* FindBusIdenStats(uint16_t iden, bool create = false)
+{
+    int slot = BusStatsHash(iden);
+    for (int i = 0; i < BUS_STATS_TABLE_SIZE; i++)
+    {
+        BusIdenStats_t& stats = busIdenStats[slot];
+        if (stats.nPackets == 0)
+        {
+            if (! create) return nullptr;
+
+            stats.iden = iden;
+            stats.printSelection = -1;
+            return &stats;
+        } // if
+
+        if (stats.iden == iden) return &stats;
+
+        slot = (slot + 1) & (BUS_STATS_TABLE_SIZE - 1);
+    } // for
+
+    return nullptr;
+} // FindBusIdenStats
+
+// Account a received VAN bus packet
+void RecordBusPacket(const VanPacket_t& pkt)
+{
+    int dataLen = pkt.DataLen();
+    if (dataLen < 0 || dataLen > VAN_MAX_DATA_BYTES) dataLen = 0;
+
+    busWindowTimeSlots += VAN_PACKET_TIME_SLOTS(dataLen);
+    busLastPacketAt = pkt.Millis();
+
+    BusIdenStats_t* stats = FindBusIdenStats(pkt.Iden(), true);
+    if (stats == nullptr)
+    {
+        nBusStatsUntracked++;
+        return;
+    } // if
+
+    unsigned long now = pkt.Millis();
+    uint16_t crc = pkt.Crc();
+
+    if (stats->nPackets > 0)
+    {
+        if (crc == stats->lastCrc) stats->nDuplicates++;
+
+        uint32_t interval = now - stats->lastMillis;  // Arithmetic has safe roll-over
+        if (stats->meanInterval_x16 == 0)
+        {
+            // First measured interval: start the averages from here
+            stats->meanInterval_x16 = interval * 16;
+        }
+        else if (interval <= BUS_STATS_MAX_INTERVAL_MS)
+        {
+            // Exponential moving averages with a weight of 1/8 for the new sample
+            int32_t deviation = (int32_t)(interval * 16) - (int32_t)stats->meanInterval_x16;
+            stats->meanInterval_x16 += deviation / 8;
+            stats->jitter_x16 += ((int32_t)abs(deviation) - (int32_t)stats->jitter_x16) / 8;
+        } // if
+    } // if
+
+    stats->nPackets++;
+    stats->nBytes += dataLen;
+    stats->lastCrc = crc;
+    stats->lastMillis = now;
+
+    if (stats->windowPackets < UINT16_MAX) stats->windowPackets++;
+    if (stats->windowBytes <= UINT16_MAX - dataLen) stats->windowBytes += dataLen;
+} // RecordBusPacket
+
+// Account a packet that was received with a CRC error that could not be repaired
+void CountBusCrcError(uint16_t iden)
+{
+    BusIdenStats_t* stats = FindBusIdenStats(iden);
+    if (stats != nullptr) stats->nCrcErrors++;
+} // CountBusCrcError
+
+// Returns the number of packets that were due to arrive between 'from' and 'to' (inclusive, in milliseconds),
+// going by the mean inter-arrival time of each IDEN value. Used to estimate the packets lost while the receiver was
+// disabled.
+uint32_t BusPacketsExpectedBetween(unsigned long from, unsigned long to)
+{
+    uint32_t expected = 0;
+
+    for (int slot = 0; slot < BUS_STATS_TABLE_SIZE; slot++)
+    {
+        const BusIdenStats_t& stats = busIdenStats[slot];
+        uint32_t interval = stats.meanInterval_x16 / 16;
+        if (stats.nPackets == 0 || interval == 0) continue;
+
+        // IDEN value not seen recently: not expected either
+        uint32_t sinceLast = from - stats.lastMillis;  // Arithmetic has safe roll-over
+        if (sinceLast > BUS_STATS_MAX_INTERVAL_MS) continue;
+
+        // Arrivals at lastMillis + k * interval (k >= 1) that fall within [from, to]
+        uint32_t first = (sinceLast + interval - 1) / interval;
+        if (first == 0) first = 1;
+        uint32_t last = (to - stats.lastMillis) / interval;
+        if (last >= first) expected += last - first + 1;
+    } // for
+
+    return expected;
+} // BusPacketsExpectedBetween
+
+// Close the current measurement window, and calculate the rates over it
+void RollBusStatsWindow()
+{
+    unsigned long now = millis();
+    unsigned long windowMs = now - busWindowStartedAt;  // Arithmetic has safe roll-over
+    if (windowMs == 0) return;
+    busWindowStartedAt = now;
+
+    uint32_t windowPackets = 0;
+
+    for (int slot = 0; slot < BUS_STATS_TABLE_SIZE; slot++)
+    {
+        BusIdenStats_t& stats = busIdenStats[slot];
+        if (stats.nPackets == 0) continue;
+
+        windowPackets += stats.windowPackets;
+        stats.packetsPerSec_x10 = stats.windowPackets * 10000UL / windowMs;
+        stats.bytesPerSec = stats.windowBytes * 1000UL / windowMs;
+        stats.windowPackets = 0;
+        stats.windowBytes = 0;
+    } // for
+
+    busPacketsPerSec = windowPackets * 1000UL / windowMs;
+    busLoad_x10 = (uint64_t)busWindowTimeSlots * 1000 * 1000 / VAN_BUS_TIME_SLOTS_PER_SEC / windowMs;
+    busWindowTimeSlots = 0;
+} // RollBusStatsWindow
+
+// Returns the run-time selection for printing packets with the specified IDEN value on the serial port: -1 if none
+// (use the "packets" diagnostic selection), 0 if muted, 1 if printed
+int BusStatsPrintSelection(uint16_t iden)
+{
+    BusIdenStats_t* stats = FindBusIdenStats(iden);
+    return stats == nullptr ? -1 : stats->printSelection;
+} // BusStatsPrintSelection
+
+// Set the run-time selection for printing packets with the specified IDEN value on the serial port (see
+// BusStatsPrintSelection). Returns false if the IDEN value was not yet seen on the bus.
+bool SetBusStatsPrintSelection(uint16_t iden, int selection)
+{
+    BusIdenStats_t* stats = FindBusIdenStats(iden);
+    if (stats == nullptr) return false;
+
+    stats->printSelection = selection;
+    return true;
+} // SetBusStatsPrintSelection
+
+// Returns the percentage (times 10) of 'part' in 'total'
+inline unsigned int Ratio_x10(uint32_t part, uint32_t total)
+{
+    return total == 0 ? 0 : (uint64_t)part * 1000 / total;
+} // Ratio_x10
+
+// Report the bus load and the busiest IDEN values, for the "system" screen
+const char* BusStatsToJson(char* buf, const int n)
+{
+    if (! busStatsOnClient) return "";
+
+    const static char jsonFormatter[] PROGMEM =
+    "{\n"
+        "\"event\": \"display\",\n"
+        "\"data\":\n"
+        "{\n"
+            "\"bus_stats\": \"Bus load: %u.%u %%, %u pkt/s; busiest:";
+
+    int at = snprintf_P(buf, n, jsonFormatter, busLoad_x10 / 10, busLoad_x10 % 10, busPacketsPerSec);
+
+    // Show the busiest IDEN values, in descending order of bus time
+    uint32_t prevLoad = UINT32_MAX;
+    int prevSlot = -1;
+    for (int i = 0; i < BUS_STATS_N_BUSIEST; i++)
+    {
+        int busiest = -1;
+        uint32_t busiestLoad = 0;
+        for (int slot = 0; slot < BUS_STATS_TABLE_SIZE; slot++)
+        {
+            const BusIdenStats_t& stats = busIdenStats[slot];
+            if (stats.nPackets == 0) continue;
+
+            // Load in time slots per second
+            uint32_t load = stats.packetsPerSec_x10 * VAN_PACKET_TIME_SLOTS(0) / 10 + stats.bytesPerSec * 10;
+
+            // Skip the ones already shown
+            if (load > prevLoad || (load == prevLoad && slot <= prevSlot)) continue;
+
+            if (busiest < 0 || load > busiestLoad)
+            {
+                busiest = slot;
+                busiestLoad = load;
+            } // if
+        } // for
+
+        if (busiest < 0 || busiestLoad == 0) break;
+
+        const BusIdenStats_t& stats = busIdenStats[busiest];
+        at += at >= n ? 0 :
+            snprintf_P(buf + at, n - at, PSTR("%s %03X %u.%u/s %u B/s dup %u %% crc %u.%u %% jitter %" PRIu32 " ms"),
+                i == 0 ? emptyStr : PSTR(";"),
+                stats.iden,
+                stats.packetsPerSec_x10 / 10,
+                stats.packetsPerSec_x10 % 10,
+                stats.bytesPerSec,
+                Ratio_x10(stats.nDuplicates, stats.nPackets) / 10,
+                Ratio_x10(stats.nCrcErrors, stats.nPackets) / 10,
+                Ratio_x10(stats.nCrcErrors, stats.nPackets) % 10,
+                stats.jitter_x16 / 16
+            );
+
+        prevLoad = busiestLoad;
+        prevSlot = busiest;
+    } // for
+
+    at += at >= n ? 0 : snprintf_P(buf + at, n - at, PSTR("\"\n}\n}\n"));
+
+    // JSON buffer overflow?
+    if (at >= n) return "";
+
+    return buf;
+} // BusStatsToJson
+
+// Write the next piece of the bus load analysis in JSON format, for export over HTTP. 'slot' must start at -1 and
+// is advanced to the piece after that; 'nListed' must start at 0. Returns the number of characters written, or 0
+// when done.
+int BusStatsJsonText(int& slot, int& nListed, char* buf, const int n)
+{
+    if (slot < 0)
+    {
+        const static char jsonFormatter[] PROGMEM =
+        "{\n"
+            "\"bus_load_percent\": %u.%u,\n"
+            "\"packets_per_sec\": %u,\n"
+            "\"untracked_packets\": %" PRIu32 ",\n"
+            "\"idens\":\n"
+            "[";
+
+        slot = 0;
+        return snprintf_P(buf, n, jsonFormatter,
+            busLoad_x10 / 10,
+            busLoad_x10 % 10,
+            busPacketsPerSec,
+            nBusStatsUntracked
+        );
+    } // if
+
+    while (slot < BUS_STATS_TABLE_SIZE)
+    {
+        const BusIdenStats_t& stats = busIdenStats[slot++];
+        if (stats.nPackets == 0) continue;
+
+        const static char jsonFormatter[] PROGMEM =
+            "%s\n"
+            "{\n"
+                "\"iden\": \"%03X\",\n"
+                "\"packets\": %" PRIu32 ",\n"
+                "\"bytes\": %" PRIu32 ",\n"
+                "\"packets_per_sec\": %u.%u,\n"
+                "\"bytes_per_sec\": %u,\n"
+                "\"duplicate_percent\": %u.%u,\n"
+                "\"crc_error_percent\": %u.%u,\n"
+                "\"interval_msec\": %" PRIu32 ",\n"
+                "\"jitter_msec\": %" PRIu32 ",\n"
+                "\"print\": %s\n"
+            "}";
+
+        return snprintf_P(buf, n, jsonFormatter,
+            nListed++ == 0 ? emptyStr : commaStr,
+            stats.iden,
+            stats.nPackets,
+            stats.nBytes,
+            stats.packetsPerSec_x10 / 10,
+            stats.packetsPerSec_x10 % 10,
+            stats.bytesPerSec,
+            Ratio_x10(stats.nDuplicates, stats.nPackets) / 10,
+            Ratio_x10(stats.nDuplicates, stats.nPackets) % 10,
+            Ratio_x10(stats.nCrcErrors, stats.nPackets) / 10,
+            Ratio_x10(stats.nCrcErrors, stats.nPackets) % 10,
+            stats.meanInterval_x16 / 16,
+            stats.jitter_x16 / 16,
+            stats.printSelection < 0 ? PSTR("\"auto\"") : stats.printSelection ? PSTR("true") : PSTR("false")
+        );
+    } // while
+
+    if (slot == BUS_STATS_TABLE_SIZE)
+    {
+        slot++;
+        return snprintf_P(buf, n, PSTR("\n]\n}\n"));
+    } // if
+
+    return 0;
+} // BusStatsJsonText
+
+// Report the bus load for "/metrics"
+int BusStatsMetricsText(int item, char* buf, const int n)
+{
+    switch (item)
+    {
+        case 0:
+            return ScalarMetric(buf, n, PSTR("van_bus_load_permille"), gaugeStr,
+                PSTR("Estimated VAN bus utilisation over the last measurement window."), busLoad_x10);
+        case 1:
+            return ScalarMetric(buf, n, PSTR("van_bus_untracked_packets_total"), counterStr,
+                PSTR("VAN bus packets of IDEN values that did not fit in the bus load analyzer table."),
+                nBusStatsUntracked);
+        default:
+            return 0;
+    } // switch
+} // BusStatsMetricsText
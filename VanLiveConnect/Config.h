@@ -134,6 +134,11 @@
   #define LIGHT_SLEEP_WAKE_PIN_ALT D0  // Matches pin GPIO_NUM_22 on LilyGO TTGO T7 Mini32 board
 #endif // ARDUINO_ARCH_ESP32
 
+// Budget, in milliseconds, for the time from waking up until ready to serve clients (Wi-Fi, web server and
+// WebSockets up). The time of each phase of the wake sequence is reported in "/metrics" (see WakeTrace.ino); a
+// warning is logged when the budget is exceeded.
+#define WAKE_READY_BUDGET_MS (1000)
+
 // -----
 // Web server
 
@@ -318,6 +323,10 @@
 
 #endif // IR_TSOP312XX
 
+// Number of received IR frames that can be queued for decoding (must be a power of 2). A held button sends a frame
+// every ~ 110 milliseconds.
+#define IR_FRAME_QUEUE_SIZE (4)
+
 #ifdef ON_DESK_MFD_ESP_MAC
 
   // Used only by test setup on desk
@@ -343,9 +352,168 @@
 
 #endif // ON_DESK_MFD_ESP_MAC
 
+// -----
+// WebSocket
+
+// For a client that can handle it, updates are collected for at most this number of milliseconds, and then sent
+// together in one WebSocket frame. This saves TCP segments, and JSON parsing in the browser.
+#define WEBSOCKET_BATCH_WINDOW_MS (10)
+
+// Maximum size of a WebSocket frame with collected updates; roughly one TCP segment
+#define WEBSOCKET_BATCH_MAX_BYTES (1400)
+
+// A client sends its options (e.g. "units_on_client:YES") one by one, right after connecting. These are applied
+// only after no option has changed for this number of milliseconds, so that all data is re-sent once, not once
+// per option.
+#define WEBSOCKET_CLIENT_OPTIONS_SETTLE_MS (100)
+
+// If defined, undecoded VAN bus packets are streamed, with their reception time, on a separate binary WebSocket
+// ("/raw"), for external analysers (see RawWebSocket.ino). The subscriber can set an IDEN allow or deny list.
+//#define RAW_VAN_WEBSOCKET
+
+// Raw packets are collected for at most this number of milliseconds, and then sent together in one binary
+// WebSocket message of at most this number of bytes. When the subscriber cannot keep up, messages are dropped.
+#define RAW_VAN_WEBSOCKET_BATCH_WINDOW_MS (100)
+#define RAW_VAN_WEBSOCKET_BATCH_MAX_BYTES (1024)
+
+// Maximum number of IDENs in the allow or deny list of the subscriber
+#define RAW_VAN_WEBSOCKET_MAX_FILTER_IDENS (16)
+
+// -----
+// VAN bus receive drop policy
+
+// When the VAN bus RX queue fills up, packets are dropped in tiers, at these fill percentages:
+// - diagnostic and unknown IDENs,
+// - high-rate telemetry (e.g. engine, wheel speed, odometer),
+// - state changes.
+// Critical packets (see IsVeryImportantPacket) are never dropped.
+#define VAN_DROP_DIAGNOSTIC_AT_PERCENTAGE (50)
+#define VAN_DROP_TELEMETRY_AT_PERCENTAGE (65)
+#define VAN_DROP_STATE_AT_PERCENTAGE (80)
+
+// While the RX queue is above the lowest of these percentages, each IDEN value may pass at most this number of
+// packets per second, with bursts of at most VAN_IDEN_TOKEN_BURST packets
+#define VAN_IDEN_TOKENS_PER_SEC (20)
+#define VAN_IDEN_TOKEN_BURST (8)
+
+// If defined, high-rate IDEN values (e.g. wheel speed, odometer) are decimated before parsing: packets that carry no
+// relevant change are skipped, unless a minimum interval has passed (see 'vanDecimations' in VanRxPolicy.ino).
+// Leave undefined to parse every packet, e.g. in combination with PRINT_RAW_PACKET_DATA.
+//#define VAN_RX_DECIMATION
+
+// Speed of the VAN bus, in time slots (TS) per second, used to estimate the bus load (see BusStats.ino). The
+// "comfort" VAN bus runs at 125 kTS/s.
+#define VAN_BUS_TIME_SLOTS_PER_SEC (125000UL)
+
+// -----
+// VAN bus trace recorder
+
+// Define to be able to record all received VAN bus packets in binary format, in a rotating set of files in the
+// LittleFS flash file system (see VanTrace.ino). Recording is started and stopped by tapping the trace status on
+// the "system" screen; the files can be downloaded via "/trace", and replayed via "/replay" (see VanTraceReplay.ino).
+//#define VAN_TRACE_RECORDER
+
+// Size of the RAM buffer in which packets are collected before being written to flash
+#define VAN_TRACE_BUFFER_SIZE (4096)
+
+// The buffer is written to flash only after the VAN bus has been idle for this number of milliseconds
+#define VAN_TRACE_FLUSH_IDLE_MS (10)
+
+// Maximum size and number of trace files; when all files are full, the oldest is overwritten
+#define VAN_TRACE_FILE_SIZE (64 * 1024UL)
+#define VAN_TRACE_N_FILES (4)
+
+#if defined VAN_TRACE_RECORDER && ! defined SERVE_FROM_LITTLEFS
+  #error "#define VAN_TRACE_RECORDER requires #define SERVE_FROM_LITTLEFS"
+#endif
+
+// -----
+// VAN bus receive task (ESP32 only)
+
+// Define to receive and parse VAN bus packets in a separate task, pinned to the other core than the main loop (which
+// handles Wi-Fi, web server and WebSockets), so that a slow WebSocket send no longer delays the parsing. The JSON
+// produced is handed over to the main loop through a lock-free ring buffer (see VanRxTask.ino). Compare
+// "van_rx_queue_overruns_total" in "/metrics" with and without.
+// Experimental: the duplicate detection state of the packet parsers is handed over to the task, but the settings
+// written by the parsers, the bus statistics and the latency histograms are still shared between the task and the
+// main loop without a lock, so an occasional count or setting may be off.
+// The trace recorder and replay (see above) assume that everything runs in the main loop; they cannot be combined
+// with this.
+//#define VAN_RX_PARSE_TASK
+
+// Size (in bytes, must be a power of 2) of the ring buffer to the main loop. When it is full, frames are dropped.
+#define VAN_RX_TASK_RING_SIZE (16 * 1024)
+
+// Stack size (in bytes) and priority of the task; the main loop task runs at priority 1
+#define VAN_RX_TASK_STACK_SIZE (16 * 1024)
+#define VAN_RX_TASK_PRIORITY (2)
+
+// The host build (see extras/Host) runs the task as a thread
+#if defined VAN_RX_PARSE_TASK && ! defined ARDUINO_ARCH_ESP32 && ! defined HOST_BUILD
+  #error "#define VAN_RX_PARSE_TASK requires the ESP32"
+#endif
+
+#if defined VAN_RX_PARSE_TASK && defined VAN_TRACE_RECORDER
+  #error "#define VAN_RX_PARSE_TASK cannot be combined with #define VAN_TRACE_RECORDER"
+#endif
+
+// -----
+// Settings
+
+// Number of flash sectors used for the settings journal (see Settings.ino), ending at the sector of the emulated
+// EEPROM (ESP8266 only; ignored on the ESP32). With 2 sectors, a full journal is compacted into the other sector
+// before it is erased, so a power loss at any moment leaves a complete copy of the settings.
+//
+// Flash layout requirement: the sector just below the EEPROM sector must be free, i.e. not part of the flash file
+// system. That is the case with the "4MB (FS:1MB OTA:~1019KB)" layout (see README.md): the file system ends at
+// 0x3FA000, the EEPROM sector starts at 0x3FB000. With a layout that has no free sector there, the sketch logs an
+// error at startup and falls back to 1 sector, which is erased and rewritten in place when it is full; a power loss
+// at that moment loses the settings.
+#define SETTINGS_JOURNAL_N_SECTORS (2)
+
+// Changed settings are written to flash once the VAN bus has been silent for this number of milliseconds. Appending
+// a record takes well under a millisecond; compacting the journal (erasing a sector) takes tens of milliseconds, so
+// it waits for a longer silence, or until just before going to sleep.
+#define SETTINGS_COMMIT_AFTER_BUS_SILENCE_MS (50)
+#define SETTINGS_COMPACT_AFTER_BUS_SILENCE_MS (2000)
+
+// -----
+// Memory
+
+// Per subsystem, the free heap and the largest free block (in bytes) that must remain after admitting its work.
+// The largest free block matters most: AsyncTCP fails when it cannot allocate its buffers in one piece.
+#define MEMORY_WEB_SERVING_MIN_FREE_HEAP (8 * 1024)
+#define MEMORY_WEB_SERVING_MIN_FREE_BLOCK (4 * 1024)
+#define MEMORY_JSON_QUEUE_MIN_FREE_HEAP (15 * 1024)
+#define MEMORY_JSON_QUEUE_MIN_FREE_BLOCK (6 * 1024)
+#define MEMORY_WEBSOCKET_CLEANUP_MIN_FREE_HEAP (2 * 1024)
+#define MEMORY_WEBSOCKET_CLEANUP_MIN_FREE_BLOCK (1 * 1024)
+
+// Maximum number of bytes in the queue of JSON packets that are stored for (re-)sending
+#define MEMORY_JSON_QUEUE_MAX_BYTES (8 * 1024)
+
+// -----
+// Logging
+
+// Log text is collected in a ring buffer of this size (a power of 2), and written to the serial port only when the
+// VAN bus receive queue is empty (see Log.ino)
+#define LOG_BUFFER_SIZE (2048)
+
+// Lowest priority of log text that is kept: LOG_LEVEL_ERROR, LOG_LEVEL_WARNING, LOG_LEVEL_INFO or LOG_LEVEL_DEBUG
+#define LOG_LEVEL (LOG_LEVEL_INFO)
+
+// If defined, the log text is also sent on a WebSocket ("/log"), for debugging without a USB cable
+//#define LOG_WEBSOCKET
+
 // -----
 // Debugging
 
+// The DEBUG_... and PRINT_... defines below only set the diagnostic output that is switched on at startup. Each
+// category can be switched on or off at run time, without re-flashing, e.g.:
+// - "/diag?websocket=2&raw_packet_data=1&packets=head_unit" (see ServeDiagnostics in WebServer.ino)
+// - WebSocket message "diag:websocket=0" (see ProcessWebSocketClientMessage in WebSocket.ino)
+// Diagnostic output that is switched off costs one branch.
+
 // If defined, prevents the ESP board from going to sleep as long as no VAN bus packets were received
 // (which often happens in the test setup).
 //#define TEST_SETUP_KEEP_AWAKE
@@ -357,6 +525,12 @@
 //#define DEBUG_WEBSOCKET 1  // Set to 2 for more output, 3 for even more
 //#define DEBUG_ORIGINAL_MFD
 
+// Define to measure the time (in CPU cycles) spent in each stage of the main loop. The average and maximum
+// are shown on the "system" screen. A stage taking LOOP_STAGE_STALL_MS milliseconds or more is reported on the
+// serial port as a stall.
+//#define MEASURE_LOOP_STAGES
+#define LOOP_STAGE_STALL_MS (100)
+
 // When set to 1, sends small test packets (~ 55 bytes). When set to 2, sends large test packets (~ 2.5 KByte).
 //#define WIFI_STRESS_TEST 1
 
@@ -372,6 +546,8 @@
 //   $HOME/Arduino/libraries/PrintEx/src/lib/TypeTraits.h (Linux)
 //
 // Edit that file: replace "struct select" by "struct select_P".
+// Also prints the VAN bus receiver statistics on the serial port every 15 seconds (run-time category
+// "van_rx_stats"; the "system" screen output can only be selected at compile time).
 //#define SHOW_VAN_RX_STATS
 
 // Prints each packet on serial port, highlighting the bytes that differ from the previous
@@ -381,17 +557,13 @@
 // Define to see JSON buffers printed on the serial port
 //#define PRINT_JSON_BUFFERS_ON_SERIAL
 
-#if defined PRINT_RAW_PACKET_DATA || defined PRINT_JSON_BUFFERS_ON_SERIAL
-
-  // Which type of VAN-bus packets will be printed on the serial port?
-
-  #define SELECTED_PACKETS VAN_PACKETS_ALL_VAN_PKTS
-  //#define SELECTED_PACKETS VAN_PACKETS_COM2000_ETC_PKTS
-  //#define SELECTED_PACKETS VAN_PACKETS_HEAD_UNIT_PKTS
-  //#define SELECTED_PACKETS VAN_PACKETS_SAT_NAV_PKTS
-  //#define SELECTED_PACKETS VAN_PACKETS_NO_VAN_PKTS
-
-#endif // defined PRINT_RAW_PACKET_DATA || defined PRINT_JSON_BUFFERS_ON_SERIAL
+// Which type of VAN-bus packets will be printed on the serial port (at startup; "packets=..." at run time)? Can be
+// overridden at run time per IDEN value; see ServeBusStats in WebServer.ino.
+#define SELECTED_PACKETS VAN_PACKETS_ALL_VAN_PKTS
+//#define SELECTED_PACKETS VAN_PACKETS_COM2000_ETC_PKTS
+//#define SELECTED_PACKETS VAN_PACKETS_HEAD_UNIT_PKTS
+//#define SELECTED_PACKETS VAN_PACKETS_SAT_NAV_PKTS
+//#define SELECTED_PACKETS VAN_PACKETS_NO_VAN_PKTS
 
 //#define PRINT_VAN_CRC_ERROR_PACKETS_ON_SERIAL
 
@@ -101,7 +101,7 @@ const char* TimeStamp()
 
 void PrintTimeStamp()
 {
-    Serial.printf("%s", TimeStamp());
+    AsyncLog.printf("%s", TimeStamp());
 } // PrintTimeStamp
 
 #else
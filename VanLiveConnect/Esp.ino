@@ -6,10 +6,8 @@
   #include "lwip/init.h"
 #endif // ARDUINO_ARCH_ESP32
 
-#ifdef PRINT_JSON_BUFFERS_ON_SERIAL
 // Defined in PacketToJson.ino
 void PrintJsonText(const char* jsonBuffer);
-#endif // PRINT_JSON_BUFFERS_ON_SERIAL
 
 // Defined in VanLiveConnect.ino
 extern String md5Checksum;
@@ -257,10 +255,11 @@ const char* EspSystemDataToJson(char* buf, const int n)
     // JSON buffer overflow?
     if (at >= n) return "";
 
-  #ifdef PRINT_JSON_BUFFERS_ON_SERIAL
-    Serial.printf_P(PSTR("%sESP system data as JSON object:\n"), TimeStamp());
-    PrintJsonText(buf);
-  #endif // PRINT_JSON_BUFFERS_ON_SERIAL
+    if (IsDiagEnabled(DIAG_JSON_BUFFERS))
+    {
+        AsyncLog.printf_P(PSTR("%sESP system data as JSON object:\n"), TimeStamp());
+        PrintJsonText(buf);
+    } // if
 
     return buf;
 } // EspSystemDataToJson
@@ -283,10 +282,31 @@ const char* EspRuntimeDataToJson(char* buf, const int n)
     // JSON buffer overflow?
     if (at >= n) return "";
 
-  #ifdef PRINT_JSON_BUFFERS_ON_SERIAL
-    Serial.printf_P(PSTR("%sESP runtime data as JSON object:\n"), TimeStamp());
-    PrintJsonText(buf);
-  #endif  // PRINT_JSON_BUFFERS_ON_SERIAL
+    if (IsDiagEnabled(DIAG_JSON_BUFFERS))
+    {
+        AsyncLog.printf_P(PSTR("%sESP runtime data as JSON object:\n"), TimeStamp());
+        PrintJsonText(buf);
+    } // if
 
     return buf;
 } // EspRuntimeDataToJson
+
+// Lowest amount of free heap seen since boot
+uint32_t lowestFreeHeap = UINT32_MAX;
+
+// Called once per main loop iteration
+void SampleFreeHeap()
+{
+    uint32_t freeHeap = system_get_free_heap_size();
+    if (freeHeap < lowestFreeHeap) lowestFreeHeap = freeHeap;
+} // SampleFreeHeap
+
+// Size of the largest block that can be allocated from the heap
+uint32_t MaxFreeBlockSize()
+{
+  #ifdef ARDUINO_ARCH_ESP32
+    return ESP.getMaxAllocHeap();
+  #else
+    return ESP.getMaxFreeBlockSize();
+  #endif // ARDUINO_ARCH_ESP32
+} // MaxFreeBlockSize
@@ -9,15 +9,12 @@
 // - GPIO handling cleanup: no longer monopolizing resources
 // - Safer handling of ISR-written data
 // - Removed all decoding stuff except decoding as hash
+// - Received frames are queued, so that a button press is not lost while the main loop is busy (see irPinChangeIsr)
+// - Integer-only decoding
 //
 
 #include "Config.h"
 
-// Receiver states
-#define STATE_IDLE 2
-#define STATE_MARK 3
-#define STATE_STOP 5
-
 #define IR_ERR 0
 #define IR_DECODED 1
 
@@ -25,15 +22,20 @@
 #define USECPERTICK 50  // microseconds per clock interrupt tick
 #define RAWBUF 100 // Length of raw duration buffer
 
-// Information for the interrupt handler
+// A frame ends when no pulse is seen for this long
+#define TIMEOUT_USECS (10000)
+
+#if (IR_FRAME_QUEUE_SIZE & (IR_FRAME_QUEUE_SIZE - 1)) != 0
+  #error "IR_FRAME_QUEUE_SIZE must be a power of 2"
+#endif
+
+// One IR frame, as received by the interrupt handler
 typedef struct
 {
-    uint8_t recvpin;  // pin for IR data from detector
-    uint8_t rcvstate;  // state machine
-    unsigned long millis_;
-    unsigned int rawbuf[RAWBUF];  // raw data
-    uint8_t rawlen;  // counter of entries in rawbuf
-} TIrParams;
+    unsigned long millis_;  // Time of the first pulse
+    uint16_t rawbuf[RAWBUF];  // Raw intervals in 50 usec ticks
+    uint8_t rawlen;  // Number of entries in rawbuf
+} TIrFrame;
 
 // Defined in WebSocket.ino
 extern int irButtonFasterRepeat;
@@ -45,6 +47,10 @@ extern const char noStr[];
 extern bool economyMode;
 void PrintJsonText(const char* jsonBuffer);
 
+// Defined in Metrics.ino
+extern const char counterStr[];
+int ScalarMetric(char* buf, const int n, PGM_P name, PGM_P type, PGM_P help, uint32_t value);
+
 // Defined in OriginalMfd.ino
 PGM_P TripComputerStr();
 PGM_P LargeScreenStr();
@@ -62,82 +68,101 @@ class IRrecv
     int decode(TIrPacket* results);
     void enableIRIn();
     void disableIRIn();
-    void resume();
 
   private:
-    long decodeHash(TIrPacket* results);  // Called by decode
+    uint8_t recvpin;  // pin for IR data from detector
+
+    long decodeHash(const volatile TIrFrame* frame, TIrPacket* results);  // Called by decode
     int compare(unsigned int oldval, unsigned int newval);
 }; // class IRrecv
 
+// Ring of received IR frames. Only the interrupt handler writes 'irFrameHead' and the frame it is filling; only
+// the main loop writes 'irFrameTail'. The frames from 'irFrameTail' up to 'irFrameHead' are complete. No
+// interrupts are disabled anywhere.
+volatile TIrFrame irFrames[IR_FRAME_QUEUE_SIZE];
+volatile uint8_t irFrameHead = 0;
+volatile uint8_t irFrameTail = 0;
+
+// True if the interrupt handler has started filling the frame in 'irFrames[irFrameHead]'. A frame is complete
+// when the next pulse comes in after TIMEOUT_USECS or more, or when no pulse comes in at all for that long. In the
+// latter case, the main loop decodes the frame before the interrupt handler has moved on (see IRrecv::decode).
+volatile bool irFrameFilling = false;
+
+// True if the queue was full at the start of the frame now coming in; that frame is dropped
+volatile bool irFrameDiscarding = false;
+
 volatile unsigned long lastIrPulse = 0;
 
-volatile TIrParams irparams;
+// The frame decoded by the main loop before the interrupt handler moved on from it; -1 if none
+int irFrameTakenEarly = -1;
+
+// Counters, reported in "/metrics"
+uint32_t nIrFramesReceived = 0;
+volatile uint32_t nIrFramesDropped = 0;
 
 void IRAM_ATTR irPinChangeIsr()
 {
-    if (irparams.rcvstate == STATE_STOP) return;
-
     unsigned long now = micros();
+    unsigned long interval = now - lastIrPulse;  // Arithmetic has safe roll-over
+    lastIrPulse = now;
 
-    if (irparams.rcvstate == STATE_IDLE)
+    if (interval > TIMEOUT_USECS || ! irFrameFilling)
     {
-        irparams.millis_ = millis();
-        irparams.rcvstate = STATE_MARK;
-        irparams.rawbuf[irparams.rawlen] = 20;
-        irparams.rawlen = irparams.rawlen + 1;
-    }
-    else
-    {
-        unsigned long ticks = (now - lastIrPulse) / USECPERTICK + 1;  // Arithmetic has safe roll-over
-
-        // Timeout after
-        #define TIMEOUT_USECS (10000)
-        #define TIMEOUT_TICKS (TIMEOUT_USECS / USECPERTICK)
-
-        if (ticks > TIMEOUT_TICKS)
-        {
-            irparams.rcvstate = STATE_STOP;
-        }
-        else if (irparams.rawlen < RAWBUF)
+        // A new frame starts
+        if (irFrameFilling)
         {
-            irparams.rawbuf[irparams.rawlen] = ticks;
-            irparams.rawlen = irparams.rawlen + 1;
+            uint8_t next = (irFrameHead + 1) & (IR_FRAME_QUEUE_SIZE - 1);
+            if (next == irFrameTail)
+            {
+                // Queue is full: keep the frame just completed, drop the new one
+                nIrFramesDropped = nIrFramesDropped + 1;
+                irFrameDiscarding = true;
+                return;
+            } // if
+
+            irFrameHead = next;  // Hand the completed frame to the main loop
         } // if
-    }
-    lastIrPulse = now;
+
+        volatile TIrFrame& frame = irFrames[irFrameHead];
+        frame.millis_ = millis();
+        frame.rawbuf[0] = 20;
+        frame.rawlen = 1;
+        irFrameFilling = true;
+        irFrameDiscarding = false;
+        return;
+    } // if
+
+    if (irFrameDiscarding) return;
+
+    volatile TIrFrame& frame = irFrames[irFrameHead];
+    if (frame.rawlen < RAWBUF)
+    {
+        frame.rawbuf[frame.rawlen] = interval / USECPERTICK + 1;
+        frame.rawlen = frame.rawlen + 1;
+    } // if
 } // irPinChangeIsr
 
-IRrecv::IRrecv(int recvpin)
+IRrecv::IRrecv(int _recvpin) : recvpin(_recvpin)
 {
-    irparams.recvpin = recvpin;
 } // IRrecv::IRrecv
 
 // Initialization
 void IRrecv::enableIRIn()
 {
-    // Initialize state machine variables
-    noInterrupts();
-    irparams.rcvstate = STATE_IDLE;
-    irparams.rawlen = 0;
-    interrupts();
-
-    pinMode(irparams.recvpin, INPUT_PULLUP);
-    attachInterrupt(digitalPinToInterrupt(irparams.recvpin), irPinChangeIsr, CHANGE);
+    // Start with an empty queue; the interrupt handler is not attached
+    irFrameHead = irFrameTail = 0;
+    irFrameFilling = irFrameDiscarding = false;
+    irFrameTakenEarly = -1;
+
+    pinMode(recvpin, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(recvpin), irPinChangeIsr, CHANGE);
 } // IRrecv::enableIRIn
 
 void IRrecv::disableIRIn()
 {
-    detachInterrupt(irparams.recvpin);
+    detachInterrupt(recvpin);
 } // IRrecv::disableIRIn
 
-void IRrecv::resume()
-{
-    noInterrupts();
-    irparams.rcvstate = STATE_IDLE;
-    irparams.rawlen = 0;
-    interrupts();
-} // IRrecv::resume
-
 // IR controller button hash codes
 enum IrButton_t
 {
@@ -166,35 +191,47 @@ PGM_P IrButtonStr(unsigned long data)
         emptyStr;
 } // IrButtonStr
 
-// Decodes the received IR message.
+// Decodes the next received IR frame, if any.
 // Returns 0 if no data ready, 1 if data ready.
 // Results of decoding are stored in results.
 int IRrecv::decode(TIrPacket* results)
 {
-    noInterrupts();
-    results->rawbuf = irparams.rawbuf;
-    results->rawlen = irparams.rawlen;
-    if (irparams.rawlen && irparams.rcvstate != STATE_STOP)
+    uint8_t head = irFrameHead;
+    uint8_t tail = irFrameTail;
+
+    if (tail != head && tail == irFrameTakenEarly)
     {
-        unsigned long now = micros();
-        unsigned long then = lastIrPulse;
-        unsigned long ticks = (now - then) / USECPERTICK + 1;  // Arithmetic has safe roll-over
-        if (ticks > TIMEOUT_TICKS) irparams.rcvstate = STATE_STOP;
+        // Already decoded, before the interrupt handler moved on from it
+        tail = (tail + 1) & (IR_FRAME_QUEUE_SIZE - 1);
+        irFrameTail = tail;
+        irFrameTakenEarly = -1;
     } // if
-    interrupts();
-
-    if (irparams.rcvstate != STATE_STOP) return IR_ERR;
 
-    if (decodeHash(results))
+    bool early = false;
+    if (tail == head)
     {
-        results->millis_ = irparams.millis_;
-        results->buttonStr = IrButtonStr(results->value);
-        if (strlen_P(results->buttonStr) > 0) return IR_DECODED;
+        // No complete frame queued. Has the frame being filled timed out? Read 'micros()' before 'lastIrPulse': a
+        // pulse coming in after that lands in the next frame.
+        if (! irFrameFilling || tail == irFrameTakenEarly) return IR_ERR;
+        unsigned long now = micros();
+        if ((long)(now - lastIrPulse) <= TIMEOUT_USECS) return IR_ERR;
+        early = true;
     } // if
 
-    // Throw away and start over
-    resume();
-    return IR_ERR;
+    const volatile TIrFrame* frame = irFrames + tail;
+    nIrFramesReceived++;
+
+    bool decoded = decodeHash(frame, results);
+    results->millis_ = frame->millis_;
+
+    // Hand the frame back to the interrupt handler
+    if (early) irFrameTakenEarly = tail;
+    else irFrameTail = (tail + 1) & (IR_FRAME_QUEUE_SIZE - 1);
+
+    if (! decoded) return IR_ERR;
+
+    results->buttonStr = IrButtonStr(results->value);
+    return strlen_P(results->buttonStr) > 0 ? IR_DECODED : IR_ERR;
 } // IRrecv::decode
 
 // Use FNV hash algorithm: http://isthe.com/chongo/tech/comp/fnv/#FNV-param
@@ -204,15 +241,16 @@ int IRrecv::decode(TIrPacket* results)
 // Converts the raw code values into a 32-bit hash code.
 // Hopefully this code is unique for each button.
 // This isn't a "real" decoding, just an arbitrary value.
-long IRrecv::decodeHash(TIrPacket* results)
+long IRrecv::decodeHash(const volatile TIrFrame* frame, TIrPacket* results)
 {
     // Require at least 6 samples to prevent triggering on noise
-    if (results->rawlen < 6) return IR_ERR;
+    int rawlen = frame->rawlen;
+    if (rawlen < 6) return IR_ERR;
 
-    long hash = FNV_BASIS_32;
-    for (int i = 1; i+2 < results->rawlen; i++)
+    uint32_t hash = FNV_BASIS_32;
+    for (int i = 1; i+2 < rawlen; i++)
     {
-        int value =  compare(results->rawbuf[i], results->rawbuf[i+2]);
+        int value =  compare(frame->rawbuf[i], frame->rawbuf[i+2]);
 
         // Add value into the hash
         hash = (hash * FNV_PRIME_32) ^ value;
@@ -225,11 +263,11 @@ long IRrecv::decodeHash(TIrPacket* results)
 
 // Compare two tick values, returning 0 if newval is shorter,
 // 1 if newval is equal, and 2 if newval is longer.
-// Use a tolerance of 20%
+// Use a tolerance of 20%. Integer arithmetic, giving exactly the same results as "newval < oldval * .8".
 int IRrecv::compare(unsigned int oldval, unsigned int newval)
 {
-    if (newval < oldval * .8) return 0;
-    else if (oldval < newval * .8) return 2;
+    if (newval * 5 < oldval * 4) return 0;
+    else if (oldval * 5 < newval * 4) return 2;
     return 1;
 } // IRrecv::compare
 
@@ -291,10 +329,11 @@ const char* ParseIrPacketToJson(const TIrPacket& pkt)
     // JSON buffer overflow?
     if (at >= IR_JSON_BUFFER_SIZE) return "";
 
-  #ifdef PRINT_JSON_BUFFERS_ON_SERIAL
-    Serial.print(F("IR remote control packet parsed to JSON object:\n"));
-    PrintJsonText(jsonBuffer);
-  #endif // PRINT_JSON_BUFFERS_ON_SERIAL
+    if (IsDiagEnabled(DIAG_JSON_BUFFERS))
+    {
+        AsyncLog.print(F("IR remote control packet parsed to JSON object:\n"));
+        PrintJsonText(jsonBuffer);
+    } // if
 
     return jsonBuffer;
 } // ParseIrPacketToJson
@@ -394,8 +433,6 @@ bool IrReceive(TIrPacket& irPacket)
 {
     if (! irrecv->decode(&irPacket)) return false;
 
-    irrecv->resume(); // Receive the next value
-
     // Code that detects "button held" condition
     //
     // The IR controller normally fires ~ 20 times per second.
@@ -430,24 +467,23 @@ bool IrReceive(TIrPacket& irPacket)
     lastValue = irPacket.value;
     lastUpdate = now;
 
-  #ifdef DEBUG_IR_RECV
-    Serial.printf_P
-    (
-        PSTR("%s[irRecv] val = 0x%lX (%s), intv = %lu, held = %s"),
-        TimeStamp(),
-        irPacket.value,
-        irPacket.buttonStr,
-        interval,
-        irPacket.held ? yesStr : noStr
-    );
-  #endif // DEBUG_IR_RECV
+    if (IsDiagEnabled(DIAG_IR_RECV))
+    {
+        AsyncLog.printf_P
+        (
+            PSTR("%s[irRecv] val = 0x%lX (%s), intv = %lu, held = %s"),
+            TimeStamp(),
+            irPacket.value,
+            irPacket.buttonStr,
+            interval,
+            irPacket.held ? yesStr : noStr
+        );
+    } // if
 
     // "MENU_BUTTON" and "MODE_BUTTON" are never "held"; they fire only once.
     if (irPacket.held && (irPacket.value == IB_MENU || irPacket.value == IB_MODE))
     {
-      #ifdef DEBUG_IR_RECV
-        Serial.print("\n");
-      #endif // DEBUG_IR_RECV
+        if (IsDiagEnabled(DIAG_IR_RECV)) AsyncLog.print("\n");
         return false;
     } // if
 
@@ -484,33 +520,25 @@ bool IrReceive(TIrPacket& irPacket)
 
         nFirings = 1;
 
-      #ifdef DEBUG_IR_RECV
-        Serial.printf_P(PSTR(" --> FIRING (%u)\n"), nFirings);
-      #endif // DEBUG_IR_RECV
+        if (IsDiagEnabled(DIAG_IR_RECV)) AsyncLog.printf_P(PSTR(" --> FIRING (%u)\n"), nFirings);
 
         return true;
     } // if
 
     // irPacket.held == true
 
-  #ifdef DEBUG_IR_RECV
-    Serial.printf_P(PSTR(", countDown = %d"), countDown);
-  #endif // DEBUG_IR_RECV
+    if (IsDiagEnabled(DIAG_IR_RECV)) AsyncLog.printf_P(PSTR(", countDown = %d"), countDown);
 
     // 50 = -1; 74 = -1; 75 = -2; 100 = -2; 124 = -2; 125 = -3; 150 = -3; 175 = -4; 200 = -4; ...
     countDown -= (interval + IR_BUTTON_HELD_INTV_MS / 2) / IR_BUTTON_HELD_INTV_MS;
 
-  #ifdef DEBUG_IR_RECV
-    Serial.printf_P(PSTR("-->%d"), countDown);
-  #endif // DEBUG_IR_RECV
+    if (IsDiagEnabled(DIAG_IR_RECV)) AsyncLog.printf_P(PSTR("-->%d"), countDown);
 
     if (irButtonRepeatState == IBHS_DELAYING)
     {
         if (countDown > 0)
         {
-          #ifdef DEBUG_IR_RECV
-            Serial.print("\n");
-          #endif // DEBUG_IR_RECV
+            if (IsDiagEnabled(DIAG_IR_RECV)) AsyncLog.print("\n");
             return false;
         } // if
 
@@ -522,9 +550,7 @@ bool IrReceive(TIrPacket& irPacket)
     {
         if (countDown > 0)
         {
-          #ifdef DEBUG_IR_RECV
-            Serial.print("\n");
-          #endif // DEBUG_IR_RECV
+            if (IsDiagEnabled(DIAG_IR_RECV)) AsyncLog.print("\n");
             return false;
         } // if
 
@@ -552,9 +578,22 @@ bool IrReceive(TIrPacket& irPacket)
         } // if
     } // if
 
-  #ifdef DEBUG_IR_RECV
-    Serial.printf_P(PSTR(" --> FIRING (%u)\n"), nFirings);
-  #endif // DEBUG_IR_RECV
+    if (IsDiagEnabled(DIAG_IR_RECV)) AsyncLog.printf_P(PSTR(" --> FIRING (%u)\n"), nFirings);
 
     return true;
 } // IrReceive
+
+int IrMetricsText(int item, char* buf, const int n)
+{
+    switch (item)
+    {
+        case 0:
+            return ScalarMetric(buf, n, PSTR("ir_frames_received_total"), counterStr,
+                PSTR("Infrared frames received."), nIrFramesReceived);
+        case 1:
+            return ScalarMetric(buf, n, PSTR("ir_frames_dropped_total"), counterStr,
+                PSTR("Infrared frames dropped because the frame queue was full."), nIrFramesDropped);
+        default:
+            return 0;
+    } // switch
+} // IrMetricsText
@@ -0,0 +1,369 @@
+
+// Functions for measuring the end-to-end latency, from VAN bus packet reception to the update of the MFD screen
+//
+// A VAN bus packet JSON message is stamped with "trace": [class, received, sent] , where 'received' is the
+// VAN bus packet reception time stamp (from the ISR) and 'sent' is the time the message was handed over for sending,
+// both in ESP milliseconds. The client (MFD.js) echoes the stamp back with a "latency_trace:" websocket message
+// as soon as it has written the message into the DOM. The latency is measured when the echo arrives, so it includes
+// the return trip.
+//
+// Separately, for infrared remote control button presses, the time from the start of the IR frame (as seen by the
+// ISR) until the message is handed over for sending is measured on the ESP itself ("press to frame").
+
+#include "SpscRing.h"
+
+// Defined in PacketToJson.ino
+extern const char emptyStr[];
+
+// Defined in VanLiveConnect.ino
+extern char vanJsonBuffer[];
+
+// Defined in Metrics.ino
+extern const char histogramStr[];
+int MetricHeader(char* buf, const int n, PGM_P name, PGM_P type, PGM_P help);
+
+// When set, the client echoes the "trace" stamps. Set by the client with the "latency_trace_on_client:YES"
+// websocket message.
+bool latencyTraceOnClient = false;
+
+// Each packet class is stamped at most once per this number of milliseconds, to limit the echo traffic
+#define LATENCY_TRACE_INTERVAL_MS (250)
+
+enum LatencyClass_t
+{
+    LATENCY_CLASS_BUTTON,  // Stalk and head unit button presses
+    LATENCY_CLASS_SATNAV,
+    LATENCY_CLASS_OTHER,
+    N_LATENCY_CLASSES
+}; // enum LatencyClass_t
+
+// Returns a PSTR (allocated in flash, saves RAM)
+PGM_P LatencyClassStr(int latencyClass)
+{
+    return
+        latencyClass == LATENCY_CLASS_BUTTON ? PSTR("button") :
+        latencyClass == LATENCY_CLASS_SATNAV ? PSTR("satnav") :
+        PSTR("other");
+} // LatencyClassStr
+
+int LatencyClassOf(uint16_t iden)
+{
+    switch (iden)
+    {
+        case HEAD_UNIT_STALK_IDEN:
+        case DEVICE_REPORT:
+        case CAR_STATUS1_IDEN:
+        case MFD_TO_HEAD_UNIT_IDEN:
+            return LATENCY_CLASS_BUTTON;
+
+        case SATNAV_STATUS_1_IDEN:
+        case SATNAV_STATUS_2_IDEN:
+        case SATNAV_STATUS_3_IDEN:
+        case SATNAV_GUIDANCE_DATA_IDEN:
+        case SATNAV_GUIDANCE_IDEN:
+        case SATNAV_REPORT_IDEN:
+        case MFD_TO_SATNAV_IDEN:
+        case SATNAV_TO_MFD_IDEN:
+            return LATENCY_CLASS_SATNAV;
+
+        default:
+            return LATENCY_CLASS_OTHER;
+    } // switch
+} // LatencyClassOf
+
+// Latency histogram buckets, by upper bound in milliseconds. The last bucket catches everything above.
+const uint16_t latencyBucketUpperBound[] PROGMEM =
+    { 5, 10, 20, 30, 40, 50, 75, 100, 150, 200, 300, 500, 750, 1000, 2000, 0xFFFF };
+#define N_LATENCY_BUCKETS (sizeof(latencyBucketUpperBound) / sizeof(latencyBucketUpperBound[0]))
+
+struct LatencyHistogram_t
+{
+    uint32_t count[N_LATENCY_BUCKETS];
+    uint32_t total;
+    uint32_t sumMsec;
+}; // struct LatencyHistogram_t
+
+LatencyHistogram_t latencyHistograms[N_LATENCY_CLASSES];
+
+// Infrared remote control button presses: from the start of the IR frame until handed over for sending
+LatencyHistogram_t irPressToFrameHistogram;
+
+void AddToLatencyHistogram(LatencyHistogram_t& histogram, unsigned long msec)
+{
+    unsigned int bucket = 0;
+    while (bucket < N_LATENCY_BUCKETS - 1 && msec > pgm_read_word(&latencyBucketUpperBound[bucket])) bucket++;
+
+    histogram.count[bucket]++;
+    histogram.total++;
+    histogram.sumMsec += msec;
+} // AddToLatencyHistogram
+
+void RecordLatency(int latencyClass, unsigned long msec)
+{
+    if (latencyClass < 0 || latencyClass >= N_LATENCY_CLASSES) return;
+
+    AddToLatencyHistogram(latencyHistograms[latencyClass], msec);
+} // RecordLatency
+
+void RecordIrPressToFrame(unsigned long msec)
+{
+    AddToLatencyHistogram(irPressToFrameHistogram, msec);
+} // RecordIrPressToFrame
+
+// Returns the upper bound (in milliseconds) of the bucket containing the specified percentile, or 0 if there are
+// no measurements
+unsigned int HistogramPercentile(const LatencyHistogram_t& histogram, unsigned int percentile)
+{
+    if (histogram.total == 0) return 0;
+
+    uint32_t threshold = ((uint64_t)histogram.total * percentile + 99) / 100;
+    uint32_t cumulative = 0;
+    for (unsigned int bucket = 0; bucket < N_LATENCY_BUCKETS; bucket++)
+    {
+        cumulative += histogram.count[bucket];
+        if (cumulative >= threshold) return pgm_read_word(&latencyBucketUpperBound[bucket]);
+    } // for
+
+    return 0xFFFF;
+} // HistogramPercentile
+
+unsigned int LatencyPercentile(int latencyClass, unsigned int percentile)
+{
+    return HistogramPercentile(latencyHistograms[latencyClass], percentile);
+} // LatencyPercentile
+
+// Stamp a VAN bus packet JSON message (in 'vanJsonBuffer') with the packet class, the packet reception time and the
+// current time
+const char* StampLatencyTrace(const char* json, const VanPacket_t& pkt)
+{
+    if (! latencyTraceOnClient || json != vanJsonBuffer || json[0] != '{') return json;
+
+    int latencyClass = LatencyClassOf(pkt.Iden());
+
+    static unsigned long lastStampedAt[N_LATENCY_CLASSES];
+    unsigned long now = millis();
+    if (now - lastStampedAt[latencyClass] < LATENCY_TRACE_INTERVAL_MS) return json;  // Arithmetic has safe roll-over
+    lastStampedAt[latencyClass] = now;
+
+    char stamp[48];
+    int stampLen = snprintf_P(stamp, sizeof(stamp), PSTR("\n\"trace\": [%d, %lu, %lu],"),
+        latencyClass,
+        pkt.Millis(),
+        now
+    );
+
+    // Insert the stamp directly after the opening brace
+    int len = strlen(json);
+    if (len + stampLen >= JSON_BUFFER_SIZE) return json;
+    memmove(vanJsonBuffer + 1 + stampLen, vanJsonBuffer + 1, len);  // Includes the terminating '\0'
+    memcpy(vanJsonBuffer + 1, stamp, stampLen);
+
+    return json;
+} // StampLatencyTrace
+
+// Measured latencies, handed over from the WebSocket event handler to the main loop, which owns the histograms.
+// Holds 8 measurements; the echoes are limited to a few per second (see LATENCY_TRACE_INTERVAL_MS).
+SpscRing_t<128> latencyEchoRing;
+
+// Process the echo of a "trace" stamp, as sent by the client: "<class>,<received>,<sent>".
+// Called by the WebSocket event handler: the latency is measured here, but recorded by the main loop (see
+// RecordLatencyTraceEchoes).
+void ProcessLatencyTraceEcho(const char* echo)
+{
+    char* end;
+    int latencyClass = strtol(echo, &end, 10);
+    if (*end != ',') return;
+    unsigned long received = strtoul(end + 1, &end, 10);
+
+    uint32_t msec = millis() - received;  // Arithmetic has safe roll-over
+    latencyEchoRing.Push(&msec, sizeof(msec), latencyClass);  // If full: drop the measurement
+} // ProcessLatencyTraceEcho
+
+// Main loop: record the latencies measured by ProcessLatencyTraceEcho
+void RecordLatencyTraceEchoes()
+{
+    uint32_t len;
+    uint32_t latencyClass;
+    const uint8_t* msec;
+    while ((msec = latencyEchoRing.Front(len, latencyClass)) != nullptr)
+    {
+        RecordLatency(latencyClass, *(const uint32_t*)msec);
+        latencyEchoRing.Pop();
+    } // while
+} // RecordLatencyTraceEchoes
+
+// Report the latency percentiles of all packet classes, for the "system" screen
+const char* LatencyStatsToJson(char* buf, const int n)
+{
+    if (! latencyTraceOnClient) return "";
+
+    const static char jsonFormatter[] PROGMEM =
+    "{\n"
+        "\"event\": \"display\",\n"
+        "\"data\":\n"
+        "{\n"
+            "\"latency_stats\": \"";
+
+    int at = snprintf_P(buf, n, jsonFormatter);
+
+    for (int latencyClass = 0; latencyClass < N_LATENCY_CLASSES; latencyClass++)
+    {
+        at += at >= n ? 0 :
+            snprintf_P(buf + at, n - at, PSTR("%sLatency %s (p50 / p95 / p99): %u / %u / %u msec (n=%" PRIu32 ")"),
+                latencyClass == 0 ? emptyStr : PSTR("<br />"),
+                LatencyClassStr(latencyClass),
+                LatencyPercentile(latencyClass, 50),
+                LatencyPercentile(latencyClass, 95),
+                LatencyPercentile(latencyClass, 99),
+                latencyHistograms[latencyClass].total
+            );
+    } // for
+
+    at += at >= n ? 0 :
+        snprintf_P(buf + at, n - at,
+            PSTR("<br />IR press to frame (p50 / p95 / p99): %u / %u / %u msec (n=%" PRIu32 ")"),
+            HistogramPercentile(irPressToFrameHistogram, 50),
+            HistogramPercentile(irPressToFrameHistogram, 95),
+            HistogramPercentile(irPressToFrameHistogram, 99),
+            irPressToFrameHistogram.total
+        );
+
+    at += at >= n ? 0 : snprintf_P(buf + at, n - at, PSTR("\"\n}\n}\n"));
+
+    // JSON buffer overflow?
+    if (at >= n) return "";
+
+    return buf;
+} // LatencyStatsToJson
+
+// Report the latency histograms and percentiles of all packet classes, for export over HTTP
+int LatencyHistogramsToJson(char* buf, const int n)
+{
+    int at = snprintf_P(buf, n, PSTR("{\n\"bucket_upper_bounds_msec\": ["));
+
+    for (unsigned int bucket = 0; bucket < N_LATENCY_BUCKETS; bucket++)
+    {
+        at += at >= n ? 0 :
+            snprintf_P(buf + at, n - at, PSTR("%s%u"),
+                bucket == 0 ? emptyStr : PSTR(", "),
+                pgm_read_word(&latencyBucketUpperBound[bucket])
+            );
+    } // for
+
+    at += at >= n ? 0 : snprintf_P(buf + at, n - at, PSTR("]"));
+
+    // All packet classes, followed by the infrared button press-to-frame histogram
+    for (int latencyClass = 0; latencyClass <= N_LATENCY_CLASSES; latencyClass++)
+    {
+        const LatencyHistogram_t& histogram =
+            latencyClass < N_LATENCY_CLASSES ? latencyHistograms[latencyClass] : irPressToFrameHistogram;
+
+        const static char jsonFormatter[] PROGMEM =
+            ",\n"
+            "\"%s\":\n"
+            "{\n"
+                "\"count\": %" PRIu32 ",\n"
+                "\"p50_msec\": %u,\n"
+                "\"p95_msec\": %u,\n"
+                "\"p99_msec\": %u,\n"
+                "\"histogram\": [";
+
+        at += at >= n ? 0 :
+            snprintf_P(buf + at, n - at, jsonFormatter,
+                latencyClass < N_LATENCY_CLASSES ? LatencyClassStr(latencyClass) : PSTR("ir_press_to_frame"),
+                histogram.total,
+                HistogramPercentile(histogram, 50),
+                HistogramPercentile(histogram, 95),
+                HistogramPercentile(histogram, 99)
+            );
+
+        for (unsigned int bucket = 0; bucket < N_LATENCY_BUCKETS; bucket++)
+        {
+            at += at >= n ? 0 :
+                snprintf_P(buf + at, n - at, PSTR("%s%" PRIu32),
+                    bucket == 0 ? emptyStr : PSTR(", "),
+                    histogram.count[bucket]
+                );
+        } // for
+
+        at += at >= n ? 0 : snprintf_P(buf + at, n - at, PSTR("]\n}"));
+    } // for
+
+    at += at >= n ? 0 : snprintf_P(buf + at, n - at, PSTR("\n}\n"));
+
+    return at;
+} // LatencyHistogramsToJson
+
+// Write one item of a histogram for "/metrics": a bucket, or the "_sum" or "_count"
+int HistogramMetricText(
+    unsigned int item,
+    char* buf,
+    const int n,
+    PGM_P name,
+    PGM_P latencyClassName,  // 'nullptr' for no "class" label
+    const LatencyHistogram_t& histogram)
+{
+    char classLabel[24] = "";
+    if (latencyClassName != nullptr) snprintf_P(classLabel, sizeof(classLabel), PSTR("class=\"%s\""), latencyClassName);
+
+    if (item == N_LATENCY_BUCKETS || item == N_LATENCY_BUCKETS + 1)
+    {
+        return snprintf_P(buf, n, PSTR("vanlive_%s_%s%s%s%s %" PRIu32 "\n"),
+            name,
+            item == N_LATENCY_BUCKETS ? PSTR("sum") : PSTR("count"),
+            classLabel[0] == 0 ? emptyStr : PSTR("{"),
+            classLabel,
+            classLabel[0] == 0 ? emptyStr : PSTR("}"),
+            item == N_LATENCY_BUCKETS ? histogram.sumMsec : histogram.total);
+    } // if
+
+    // Buckets are cumulative
+    uint32_t cumulative = 0;
+    for (unsigned int i = 0; i <= item; i++) cumulative += histogram.count[i];
+
+    char le[8];
+    if (item == N_LATENCY_BUCKETS - 1) strcpy_P(le, PSTR("+Inf"));
+    else sprintf_P(le, PSTR("%u"), pgm_read_word(&latencyBucketUpperBound[item]));
+
+    return snprintf_P(buf, n, PSTR("vanlive_%s_bucket{%s%sle=\"%s\"} %" PRIu32 "\n"),
+        name,
+        classLabel,
+        classLabel[0] == 0 ? emptyStr : PSTR(","),
+        le,
+        cumulative);
+} // HistogramMetricText
+
+// Report the latency histograms for "/metrics", one bucket per item: per packet class, followed by the infrared
+// button press-to-frame histogram
+int LatencyMetricsText(int item, char* buf, const int n)
+{
+    // Per histogram: the buckets, followed by "_sum" and "_count"
+    const int itemsPerHistogram = N_LATENCY_BUCKETS + 2;
+
+    if (item == 0)
+    {
+        return MetricHeader(buf, n, PSTR("latency_msec"), histogramStr,
+            PSTR("Time from VAN bus packet reception until the client has written it into the DOM, plus return trip."));
+    } // if
+    item--;
+
+    if (item < N_LATENCY_CLASSES * itemsPerHistogram)
+    {
+        int latencyClass = item / itemsPerHistogram;
+        return HistogramMetricText(item % itemsPerHistogram, buf, n, PSTR("latency_msec"),
+            LatencyClassStr(latencyClass), latencyHistograms[latencyClass]);
+    } // if
+    item -= N_LATENCY_CLASSES * itemsPerHistogram;
+
+    if (item == 0)
+    {
+        return MetricHeader(buf, n, PSTR("ir_press_to_frame_msec"), histogramStr,
+            PSTR("Time from the start of an infrared remote control frame until the button press is handed over"
+                " for sending."));
+    } // if
+    item--;
+
+    if (item >= itemsPerHistogram) return 0;
+
+    return HistogramMetricText(item, buf, n, PSTR("ir_press_to_frame_msec"), nullptr, irPressToFrameHistogram);
+} // LatencyMetricsText
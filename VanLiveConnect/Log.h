@@ -0,0 +1,57 @@
+#ifndef Log_h
+#define Log_h
+
+#include <Arduino.h>
+
+enum LogLevel_t
+{
+    LOG_LEVEL_ERROR,
+    LOG_LEVEL_WARNING,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_DEBUG
+}; // enum LogLevel_t
+
+// Log text is collected in a ring buffer, and written to the serial port from the main loop, only as much as the
+// serial port can take without waiting (see Log.ino). When the ring buffer is full, log text is dropped.
+class LogBuffer_t : public Print
+{
+  public:
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buf, size_t size) override;
+    using Print::write;
+}; // class LogBuffer_t
+
+// Log at level "info"
+extern LogBuffer_t AsyncLog;
+
+// Returns the log if 'level' is currently logged, otherwise a sink that discards everything
+Print& Log(int level);
+
+// Diagnostic output, switchable at run time per category (see Log.ino)
+enum DiagCategory_t
+{
+    DIAG_WEBSOCKET,
+    DIAG_WEBSERVER,
+    DIAG_IR_RECV,
+    DIAG_ORIGINAL_MFD,
+    DIAG_RAW_PACKET_DATA,
+    DIAG_JSON_BUFFERS,
+    DIAG_VAN_CRC_ERROR_PACKETS,
+    DIAG_VAN_RX_STATS,
+    N_DIAG_CATEGORIES
+}; // enum DiagCategory_t
+
+// Per category: 0 = off, 1 = on; some categories have more output at levels 2 and 3
+extern uint8_t diagLevels[N_DIAG_CATEGORIES];
+
+// Costs one predictable branch when the category is off
+inline bool IsDiagEnabled(int category, uint8_t level = 1)
+{
+    return diagLevels[category] >= level;
+} // IsDiagEnabled
+
+// Returns true if diagnostic output for packets with the specified IDEN is selected
+bool IsDiagPacketSelected(uint16_t iden);
+
+#endif // Log_h
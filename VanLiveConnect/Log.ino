@@ -0,0 +1,376 @@
+
+// Non-blocking log
+//
+// At 115200 baud, writing a 100-byte line on the serial port takes about 9 milliseconds. Writing directly with
+// Serial.printf_P blocks for that long as soon as the UART transmit FIFO is full, which is long enough for the VAN
+// bus receive queue to overrun. Therefore, log text is first collected in a ring buffer. The main loop writes the
+// collected text to the serial port, but only when the VAN bus receive queue is empty, and only as much as the
+// serial port can take without waiting (see LoopLog).
+//
+// Each write (e.g. one printf_P call) is stored whole, or dropped whole when the ring buffer is full. Dropped
+// writes are counted, reported in "/metrics", and noted in the log itself.
+//
+// The log text can also be followed on a WebSocket ("/log"), e.g. with a browser or 'websocat', for debugging in
+// the car without a USB cable.
+//
+// Diagnostic output is grouped in categories (see DiagCategory_t in Log.h), each with its own level, which can be
+// changed at run time: on the "/diag" page (see ServeDiagnostics in WebServer.ino), or with a "diag:" message on
+// the WebSocket. The DEBUG_... and PRINT_... defines in Config.h only set the levels at startup.
+
+#include "Log.h"
+
+// Defined in DateTime.ino
+const char* TimeStamp();
+
+// Defined in Metrics.ino
+extern const char counterStr[];
+int ScalarMetric(char* buf, const int n, PGM_P name, PGM_P type, PGM_P help, uint32_t value);
+
+// Defined in PacketFilter.ino
+bool IsPacketSelected(uint16_t iden, VanPacketFilter_t filter);
+
+#ifdef LOG_WEBSOCKET
+// Defined in WebServer.ino
+extern AsyncWebServer webServer;
+#endif // LOG_WEBSOCKET
+
+#if (LOG_BUFFER_SIZE & (LOG_BUFFER_SIZE - 1)) != 0
+  #error "LOG_BUFFER_SIZE must be a power of 2"
+#endif
+
+// Discards everything written to it
+class NullLog_t : public Print
+{
+  public:
+
+    size_t write(uint8_t) override { return 1; }
+    size_t write(const uint8_t*, size_t size) override { return size; }
+    using Print::write;
+}; // class NullLog_t
+
+LogBuffer_t AsyncLog;
+NullLog_t nullLog;
+
+int logLevel = LOG_LEVEL;
+
+char logBuffer[LOG_BUFFER_SIZE];
+
+// Free-running indexes: the ring buffer holds the text from 'logTail' up to 'logHead'. Only the writer advances
+// 'logHead', and only the main loop advances 'logTail'.
+volatile uint32_t logHead = 0;
+volatile uint32_t logTail = 0;
+
+#ifdef ARDUINO_ARCH_ESP32
+// On the ESP32, the AsyncTCP task can log at the same time as the main loop
+portMUX_TYPE logMux = portMUX_INITIALIZER_UNLOCKED;
+#endif // ARDUINO_ARCH_ESP32
+
+// Counters, reported in "/metrics"
+uint32_t nLogWritesDropped = 0;
+uint32_t nLogBytesDropped = 0;
+
+uint32_t nLogWritesDroppedNoted = 0;  // Value of 'nLogWritesDropped' last noted in the log
+
+#ifdef LOG_WEBSOCKET
+AsyncWebSocket logWebSocket("/log");
+uint32_t nLogWebSocketBytesDropped = 0;
+#endif // LOG_WEBSOCKET
+
+size_t LogBuffer_t::write(const uint8_t* buf, size_t size)
+{
+    if (size == 0) return 0;
+
+  #ifdef ARDUINO_ARCH_ESP32
+    portENTER_CRITICAL(&logMux);
+  #endif // ARDUINO_ARCH_ESP32
+
+    uint32_t head = logHead;
+    if (size > LOG_BUFFER_SIZE - (head - logTail))
+    {
+        nLogWritesDropped++;
+        nLogBytesDropped += size;
+    }
+    else
+    {
+        uint32_t at = head & (LOG_BUFFER_SIZE - 1);
+        size_t first = std::min(size, (size_t)(LOG_BUFFER_SIZE - at));
+        memcpy(logBuffer + at, buf, first);
+        memcpy(logBuffer, buf + first, size - first);
+        logHead = head + size;
+    } // if
+
+  #ifdef ARDUINO_ARCH_ESP32
+    portEXIT_CRITICAL(&logMux);
+  #endif // ARDUINO_ARCH_ESP32
+
+    return size;
+} // LogBuffer_t::write
+
+Print& Log(int level)
+{
+    if (level > logLevel) return nullLog;
+    return AsyncLog;
+} // Log
+
+uint8_t diagLevels[N_DIAG_CATEGORIES] =
+{
+  #ifdef DEBUG_WEBSOCKET
+    DEBUG_WEBSOCKET,
+  #else
+    0,
+  #endif // DEBUG_WEBSOCKET
+
+  #ifdef DEBUG_WEBSERVER
+    1,
+  #else
+    0,
+  #endif // DEBUG_WEBSERVER
+
+  #ifdef DEBUG_IR_RECV
+    1,
+  #else
+    0,
+  #endif // DEBUG_IR_RECV
+
+  #ifdef DEBUG_ORIGINAL_MFD
+    1,
+  #else
+    0,
+  #endif // DEBUG_ORIGINAL_MFD
+
+  #ifdef PRINT_RAW_PACKET_DATA
+    1,
+  #else
+    0,
+  #endif // PRINT_RAW_PACKET_DATA
+
+  #ifdef PRINT_JSON_BUFFERS_ON_SERIAL
+    1,
+  #else
+    0,
+  #endif // PRINT_JSON_BUFFERS_ON_SERIAL
+
+  #ifdef PRINT_VAN_CRC_ERROR_PACKETS_ON_SERIAL
+    1,
+  #else
+    0,
+  #endif // PRINT_VAN_CRC_ERROR_PACKETS_ON_SERIAL
+
+  #ifdef SHOW_VAN_RX_STATS
+    1
+  #else
+    0
+  #endif // SHOW_VAN_RX_STATS
+};
+
+// Names as used in "/diag?<name>=<level>" and "diag:<name>=<level>", in the order of DiagCategory_t
+static const char diagWebSocketStr[] PROGMEM = "websocket";
+static const char diagWebServerStr[] PROGMEM = "webserver";
+static const char diagIrRecvStr[] PROGMEM = "ir_recv";
+static const char diagOriginalMfdStr[] PROGMEM = "original_mfd";
+static const char diagRawPacketDataStr[] PROGMEM = "raw_packet_data";
+static const char diagJsonBuffersStr[] PROGMEM = "json_buffers";
+static const char diagVanCrcErrorPacketsStr[] PROGMEM = "van_crc_error_packets";
+static const char diagVanRxStatsStr[] PROGMEM = "van_rx_stats";
+
+static PGM_P const diagCategoryNames[N_DIAG_CATEGORIES] PROGMEM =
+{
+    diagWebSocketStr,
+    diagWebServerStr,
+    diagIrRecvStr,
+    diagOriginalMfdStr,
+    diagRawPacketDataStr,
+    diagJsonBuffersStr,
+    diagVanCrcErrorPacketsStr,
+    diagVanRxStatsStr
+};
+
+// Which type of VAN-bus packets is printed by the "raw_packet_data" and "json_buffers" categories
+static const char diagPacketsStr[] PROGMEM = "packets";
+
+static const char diagPacketsAllStr[] PROGMEM = "all";
+static const char diagPacketsNoneStr[] PROGMEM = "none";
+static const char diagPacketsHeadUnitStr[] PROGMEM = "head_unit";
+static const char diagPacketsAirconStr[] PROGMEM = "aircon";
+static const char diagPacketsCom2000Str[] PROGMEM = "com2000";
+static const char diagPacketsSatNavStr[] PROGMEM = "sat_nav";
+
+// In the order of VanPacketFilter_t
+static PGM_P const diagPacketFilterNames[] PROGMEM =
+{
+    diagPacketsAllStr,
+    diagPacketsNoneStr,
+    diagPacketsHeadUnitStr,
+    diagPacketsAirconStr,
+    diagPacketsCom2000Str,
+    diagPacketsSatNavStr
+};
+
+#define N_DIAG_PACKET_FILTERS (sizeof(diagPacketFilterNames) / sizeof(diagPacketFilterNames[0]))
+
+uint8_t diagPacketFilter = SELECTED_PACKETS;
+
+bool IsDiagPacketSelected(uint16_t iden)
+{
+    return IsPacketSelected(iden, (VanPacketFilter_t)diagPacketFilter);
+} // IsDiagPacketSelected
+
+// Set the level of the diagnostic category 'name', or the packet selection if 'name' is "packets". Returns false if
+// 'name' or 'value' is not recognized.
+bool SetDiagnostic(const char* name, const char* value)
+{
+    if (strcmp_P(name, diagPacketsStr) == 0)
+    {
+        for (unsigned int i = 0; i < N_DIAG_PACKET_FILTERS; i++)
+        {
+            if (strcmp_P(value, (PGM_P)pgm_read_ptr(diagPacketFilterNames + i)) != 0) continue;
+
+            diagPacketFilter = i;
+            AsyncLog.printf_P(PSTR("%sDiagnostics: packets = %s\n"), TimeStamp(), value);
+            return true;
+        } // for
+
+        return false;
+    } // if
+
+    for (int i = 0; i < N_DIAG_CATEGORIES; i++)
+    {
+        if (strcmp_P(name, (PGM_P)pgm_read_ptr(diagCategoryNames + i)) != 0) continue;
+
+        char* end;
+        unsigned long level = strtoul(value, &end, 10);
+        if (end == value || *end != 0 || level > 3) return false;
+
+        diagLevels[i] = level;
+        AsyncLog.printf_P(PSTR("%sDiagnostics: %s = %lu\n"), TimeStamp(), name, level);
+        return true;
+    } // for
+
+    return false;
+} // SetDiagnostic
+
+// Set a diagnostic from a "<name>=<level>" string, e.g. "websocket=2"
+bool SetDiagnostic(const char* assignment)
+{
+    const char* eq = strchr(assignment, '=');
+    if (eq == nullptr || eq - assignment >= 32) return false;
+
+    char name[32];
+    memcpy(name, assignment, eq - assignment);
+    name[eq - assignment] = 0;
+
+    return SetDiagnostic(name, eq + 1);
+} // SetDiagnostic
+
+// Print the current diagnostic levels
+void PrintDiagnostics(Print& s)
+{
+    s.print(F("Diagnostics (change with \"/diag?<name>=<level>\"):\n"));
+    for (int i = 0; i < N_DIAG_CATEGORIES; i++)
+    {
+        s.printf_P(PSTR("- %s = %u\n"), (PGM_P)pgm_read_ptr(diagCategoryNames + i), diagLevels[i]);
+    } // for
+    s.printf_P(PSTR("- %s = %s\n"), diagPacketsStr, (PGM_P)pgm_read_ptr(diagPacketFilterNames + diagPacketFilter));
+} // PrintDiagnostics
+
+// Current diagnostic levels, as JSON
+const char* DiagnosticsToJson(char* buf, const int n)
+{
+    int at = snprintf_P(buf, n, PSTR("{\n"));
+    for (int i = 0; i < N_DIAG_CATEGORIES; i++)
+    {
+        at += at >= n ? 0 :
+            snprintf_P(buf + at, n - at, PSTR("  \"%s\": %u,\n"),
+                (PGM_P)pgm_read_ptr(diagCategoryNames + i), diagLevels[i]);
+    } // for
+    at += at >= n ? 0 :
+        snprintf_P(buf + at, n - at, PSTR("  \"%s\": \"%s\"\n}\n"),
+            diagPacketsStr, (PGM_P)pgm_read_ptr(diagPacketFilterNames + diagPacketFilter));
+
+    // JSON buffer overflow?
+    if (at >= n) return "";
+
+    return buf;
+} // DiagnosticsToJson
+
+// Write at most 'maxLen' bytes of collected log text on the serial port (and the log WebSocket). Returns the number
+// of bytes written.
+int DrainLog(int maxLen)
+{
+    uint32_t tail = logTail;
+    uint32_t at = tail & (LOG_BUFFER_SIZE - 1);
+
+    // Up to the end of the ring buffer; the rest will follow with the next call
+    int len = std::min((uint32_t)maxLen, std::min(logHead - tail, (uint32_t)(LOG_BUFFER_SIZE - at)));
+    if (len <= 0) return 0;
+
+    Serial.write((const uint8_t*)logBuffer + at, len);
+
+  #ifdef LOG_WEBSOCKET
+    if (logWebSocket.count() > 0)
+    {
+        if (logWebSocket.availableForWriteAll()) logWebSocket.textAll(logBuffer + at, len);
+        else nLogWebSocketBytesDropped += len;
+    } // if
+  #endif // LOG_WEBSOCKET
+
+    logTail = tail + len;
+    return len;
+} // DrainLog
+
+// Write all collected log text on the serial port, waiting as long as needed. To be called e.g. before going to
+// sleep or restarting.
+void FlushLog()
+{
+    while (DrainLog(LOG_BUFFER_SIZE) > 0);
+    Serial.flush();
+} // FlushLog
+
+void SetupLog()
+{
+  #ifdef LOG_WEBSOCKET
+    webServer.addHandler(&logWebSocket);
+  #endif // LOG_WEBSOCKET
+} // SetupLog
+
+// Called from the main loop: write collected log text on the serial port, but only when there are no VAN bus
+// packets waiting, and without waiting for the serial port
+void LoopLog()
+{
+    if (nLogWritesDropped != nLogWritesDroppedNoted)
+    {
+        uint32_t nDropped = nLogWritesDropped - nLogWritesDroppedNoted;
+        nLogWritesDroppedNoted = nLogWritesDropped;
+        AsyncLog.printf_P(PSTR("%s==> Log buffer full: %" PRIu32 " log writes dropped\n"), TimeStamp(), nDropped);
+    } // if
+
+    if (VanBusRx.GetNQueued() > 0) return;
+
+    int room = Serial.availableForWrite();
+    while (room > 0)
+    {
+        int len = DrainLog(room);
+        if (len <= 0) break;
+        room -= len;
+    } // while
+} // LoopLog
+
+int LogMetricsText(int item, char* buf, const int n)
+{
+    switch (item)
+    {
+        case 0:
+            return ScalarMetric(buf, n, PSTR("log_writes_dropped_total"), counterStr,
+                PSTR("Log writes dropped because the log buffer was full."), nLogWritesDropped);
+        case 1:
+            return ScalarMetric(buf, n, PSTR("log_bytes_dropped_total"), counterStr,
+                PSTR("Log bytes dropped because the log buffer was full."), nLogBytesDropped);
+      #ifdef LOG_WEBSOCKET
+        case 2:
+            return ScalarMetric(buf, n, PSTR("log_websocket_bytes_dropped_total"), counterStr,
+                PSTR("Log bytes not sent on the log WebSocket because it was busy."), nLogWebSocketBytesDropped);
+      #endif // LOG_WEBSOCKET
+        default:
+            return 0;
+    } // switch
+} // LogMetricsText
@@ -0,0 +1,195 @@
+
+// Functions for measuring the time spent in each stage of the main loop, and for detecting stalls
+//
+// Only compiled in when MEASURE_LOOP_STAGES is defined (see Config.h). Otherwise the LOOP_STAGE_xxx macros
+// (see VanLiveConnect.ino) expand to nothing.
+
+#ifdef MEASURE_LOOP_STAGES
+
+// Defined in DateTime.ino
+const char* TimeStamp();
+
+// Defined in Metrics.ino
+extern const char counterStr[];
+extern const char gaugeStr[];
+int MetricHeader(char* buf, const int n, PGM_P name, PGM_P type, PGM_P help);
+
+// Returns a PSTR (allocated in flash, saves RAM)
+PGM_P LoopStageStr(int stage)
+{
+    return
+        stage == LOOP_STAGE_DNS ? PSTR("dns") :
+        stage == LOOP_STAGE_WIFI ? PSTR("wifi") :
+        stage == LOOP_STAGE_OTA ? PSTR("ota") :
+        stage == LOOP_STAGE_WEBSOCKET ? PSTR("ws") :
+        stage == LOOP_STAGE_WEBSERVER ? PSTR("http") :
+        stage == LOOP_STAGE_IR ? PSTR("ir") :
+        stage == LOOP_STAGE_VAN ? PSTR("van") :
+        stage == LOOP_STAGE_STATS ? PSTR("stats") :
+        PSTR("??");
+} // LoopStageStr
+
+struct LoopStageStats_t
+{
+    uint32_t nRuns;
+    uint64_t totalCycles;
+    uint32_t maxCycles;
+}; // struct LoopStageStats_t
+
+// Statistics since the last report
+LoopStageStats_t loopStageStats[N_LOOP_STAGES];
+
+// Statistics since boot, for "/metrics"
+LoopStageStats_t loopStageTotals[N_LOOP_STAGES];
+
+uint32_t loopStageStartedAt;  // In CPU cycles
+
+uint32_t nLoopStalls = 0;
+int lastStalledStage = -1;
+uint32_t lastStallUsec = 0;
+
+// Mark the start of the first stage in the main loop
+void LoopStagesStart()
+{
+    loopStageStartedAt = ESP.getCycleCount();
+} // LoopStagesStart
+
+// Account the CPU cycles since the previous mark to the specified stage, and mark the start of the next stage
+void LoopStageDone(int stage)
+{
+    uint32_t now = ESP.getCycleCount();
+    uint32_t cycles = now - loopStageStartedAt;  // Arithmetic has safe roll-over
+    loopStageStartedAt = now;
+
+    LoopStageStats_t& stats = loopStageStats[stage];
+    stats.nRuns++;
+    stats.totalCycles += cycles;
+    if (cycles > stats.maxCycles) stats.maxCycles = cycles;
+
+    LoopStageStats_t& totals = loopStageTotals[stage];
+    totals.nRuns++;
+    totals.totalCycles += cycles;
+    if (cycles > totals.maxCycles) totals.maxCycles = cycles;
+
+    uint32_t cpuMhz = ESP.getCpuFreqMHz();
+    uint32_t usec = cycles / cpuMhz;
+    if (usec >= LOOP_STAGE_STALL_MS * 1000UL)
+    {
+        nLoopStalls++;
+        lastStalledStage = stage;
+        lastStallUsec = usec;
+
+        // Printing takes time too; do not account that to the next stage
+        AsyncLog.printf_P(PSTR("%s==> loop() stage '%s' took %" PRIu32 " msec, overran by %" PRIu32 " msec\n"),
+            TimeStamp(),
+            LoopStageStr(stage),
+            usec / 1000,
+            usec / 1000 - LOOP_STAGE_STALL_MS
+        );
+        loopStageStartedAt = ESP.getCycleCount();
+    } // if
+} // LoopStageDone
+
+// Report the average and maximum time spent in each stage, in microseconds, for the "system" screen. Then start
+// a new measurement window.
+const char* LoopStatsToJson(char* buf, const int n)
+{
+    const static char jsonFormatter[] PROGMEM =
+    "{\n"
+        "\"event\": \"display\",\n"
+        "\"data\":\n"
+        "{\n"
+            "\"loop_stage_stats\": \"Loop avg/max usec:";
+
+    int at = snprintf_P(buf, n, jsonFormatter);
+
+    uint32_t cpuMhz = ESP.getCpuFreqMHz();
+
+    for (int stage = 0; stage < N_LOOP_STAGES; stage++)
+    {
+        LoopStageStats_t& stats = loopStageStats[stage];
+        if (stats.nRuns == 0) continue;
+
+        at += at >= n ? 0 :
+            snprintf_P(buf + at, n - at, PSTR(" %s %" PRIu32 "/%" PRIu32),
+                LoopStageStr(stage),
+                (uint32_t)(stats.totalCycles / stats.nRuns / cpuMhz),
+                stats.maxCycles / cpuMhz
+            );
+
+        stats = LoopStageStats_t();
+    } // for
+
+    if (nLoopStalls > 0)
+    {
+        at += at >= n ? 0 :
+            snprintf_P(buf + at, n - at, PSTR("<br />Stalls: %" PRIu32 ", last: %s %" PRIu32 " msec"),
+                nLoopStalls,
+                LoopStageStr(lastStalledStage),
+                lastStallUsec / 1000
+            );
+    } // if
+
+    at += at >= n ? 0 : snprintf_P(buf + at, n - at, PSTR("\"\n}\n}\n"));
+
+    // JSON buffer overflow?
+    if (at >= n) return "";
+
+    return buf;
+} // LoopStatsToJson
+
+// Report the time spent in each stage since boot for "/metrics": per metric a header item, followed by one item
+// per stage
+int LoopStageMetricsText(int item, char* buf, const int n)
+{
+    const int itemsPerMetric = N_LOOP_STAGES + 1;
+    int metric = item / itemsPerMetric;
+    int stage = item % itemsPerMetric - 1;
+
+    if (stage < 0)
+    {
+        switch (metric)
+        {
+            case 0:
+                return MetricHeader(buf, n, PSTR("loop_stage_seconds_total"), counterStr,
+                    PSTR("Time spent in each stage of the main loop."));
+            case 1:
+                return MetricHeader(buf, n, PSTR("loop_stage_runs_total"), counterStr,
+                    PSTR("Number of runs of each stage of the main loop."));
+            case 2:
+                return MetricHeader(buf, n, PSTR("loop_stage_max_usec"), gaugeStr,
+                    PSTR("Longest run of each stage of the main loop."));
+            default:
+                return 0;
+        } // switch
+    } // if
+
+    const LoopStageStats_t& totals = loopStageTotals[stage];
+    uint32_t cpuMhz = ESP.getCpuFreqMHz();
+
+    switch (metric)
+    {
+        case 0:
+        {
+            // Split up into two 32-bit halves; printing 64-bit values is not supported on all platforms
+            uint64_t usec = totals.totalCycles / cpuMhz;
+            uint32_t seconds = usec / 1000000;
+            return snprintf_P(buf, n,
+                PSTR("vanlive_loop_stage_seconds_total{stage=\"%s\"} %" PRIu32 ".%06" PRIu32 "\n"),
+                LoopStageStr(stage),
+                seconds,
+                (uint32_t)(usec % 1000000)
+            );
+        }
+        case 1:
+            return snprintf_P(buf, n, PSTR("vanlive_loop_stage_runs_total{stage=\"%s\"} %" PRIu32 "\n"),
+                LoopStageStr(stage), totals.nRuns);
+        case 2:
+            return snprintf_P(buf, n, PSTR("vanlive_loop_stage_max_usec{stage=\"%s\"} %" PRIu32 "\n"),
+                LoopStageStr(stage), totals.maxCycles / cpuMhz);
+        default:
+            return 0;
+    } // switch
+} // LoopStageMetricsText
+
+#endif // MEASURE_LOOP_STAGES
@@ -2618,7 +2618,7 @@ const char mfd_html[] PROGMEM = R"=====(
 			<div style="font-size:50px; text-align:center; padding-top:10px;">System</div>
 
 			<div class="tabTop tabActive" style="position:absolute; font-size:35px; left:30px; top:60px; height:50px; padding-left:20px; padding-right:20px;">Browser</div>
-			<div class="iconBorder" style="display:block; position:absolute; left:20px; top:110px; width:340px; height:270px;">
+			<div class="iconBorder" style="display:block; position:absolute; left:20px; top:110px; width:340px; height:380px;">
 				<div class="tag" style="left:130px; top:10px; width:120px;">Width</div>
 				<div class="tag" style="left:240px; top:10px; width:120px;">Height</div>
 				<div class="tag" style="top:60px; width:150px;">Screen</div>
@@ -2633,9 +2633,22 @@ const char mfd_html[] PROGMEM = R"=====(
 
 				<div class="tag" style="left:10px; top:200px; width:370px; text-align:left; font-size:25px;">Websocket server host:</div>
 				<div id="web_socket_server_host" class="tag" style="left:10px; top:230px; width:370px; text-align:left; font-size:25px;">---</div>
+
+				<div class="tag" style="left:10px; top:260px; width:370px; text-align:left; font-size:25px;">DOM update time (avg / max):</div>
+				<div id="dom_update_frame_time" class="tag" style="left:10px; top:285px; width:370px; text-align:left; font-size:25px;">---</div>
+				<div class="tag" style="left:10px; top:315px; width:370px; text-align:left; font-size:25px;">WebSocket frames:</div>
+				<div id="websocket_frame_stats" class="tag" style="left:10px; top:340px; width:370px; text-align:left; font-size:25px;">---</div>
 			</div>
 
 			<div class="tabTop tabActive" style="position:absolute; font-size:35px; left:430px; top:60px; height:50px; padding-left:20px; padding-right:20px;">ESP</div>
+
+			<!-- VAN bus trace recorder status; tap to start or stop recording (see also "/trace") -->
+			<div id="van_trace_status" class="tag" onclick="toggleVanTrace();"
+				style="left:220px; top:70px; width:190px; text-align:left; font-size:18px;"></div>
+
+			<!-- VAN bus load and busiest IDEN values (see also "/bus") -->
+			<div id="bus_stats" class="tag"
+				style="left:560px; top:62px; width:770px; height:46px; text-align:left; font-size:15px; white-space:normal;"></div>
 			<div class="iconBorder" style="display:block; position:absolute; left:420px; top:110px; width:910px; height:380px;">
 				<div style="font-size:20px; line-height: 1.2;">
 					<div class="tag" style="top:10px; width:230px;">Boot Version</div>
@@ -2681,8 +2694,13 @@ const char mfd_html[] PROGMEM = R"=====(
 				<div id="esp_free_ram" class="tag" style="left:590px; top:157px;">---</div>
 				<div id="uptime" class="tag" style="left:680px; top:187px;">---</div>
 				<div id="websocket_n_connects" class="tag" style="left:680px; top:217px">---</div>
+				<div id="loop_stage_stats" class="tag" style="left:590px; top:247px; width:310px; height:60px; text-align:left; white-space:normal; font-size:14px;"></div>
 			</div>
 
+			<!-- End-to-end latency (p50 / p95 / p99) per packet class, from VAN bus reception until written into the DOM -->
+			<div id="latency_stats" class="tag"
+				style="left:20px; top:495px; width:400px; text-align:left; font-size:15px; white-space:normal;"></div>
+
 			<div id="van_bus_stats" class="tag"
 				style="left:420px; top:470px; width:830px; text-align:left; font-size:25px; white-space:normal;"></div>
 
@@ -2836,6 +2854,7 @@ COMMS_LED
 
 R"=====(
 		<script src="jquery-3.5.1.min.js"></script>	<!-- jQuery -->
+		<script src="VanStrings.js"></script>	<!-- String tables, generated by the ESP -->
 
 		<!-- Our own stuff. Added '?foo=1' to force Chrome reload; see also https://stackoverflow.com/a/70410178 -->
 		<script src="MFD.js?foo=1" async></script>
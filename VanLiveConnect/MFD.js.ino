@@ -111,20 +111,50 @@ function showViewportSizes()
 // Associative array, using the data item as key
 var liveData = {};
 
-function processJsonObject(item, jsonObject)
-{
-	var selectorById = '#' + item;  // Select by 'id' attribute (must be unique in the DOM)
-	var selectorByAttr = '[gid="' + item + '"]';  // Select also by custom attribute 'gid' (need not be unique)
+// Elements showing each data item: the element with 'id' equal to the item, plus all elements with custom
+// attribute 'gid' equal to the item. Built once, on first use, so that updating an item does not need to search
+// the DOM.
+var itemElements = null;
 
-	// jQuery-style loop over merged, unique-element array
-	$.each($.unique($.merge($(selectorByAttr), $(selectorById))), function (index, selector)
+function elementsForItem(item)
+{
+	if (itemElements === null)
 	{
-		if ($(selector).length <= 0) return;  // Go to next iteration in .each()
+		itemElements = {};
+		let add = function(item, element)
+		{
+			if (itemElements[item] === undefined) itemElements[item] = [];
+			if (itemElements[item].indexOf(element) < 0) itemElements[item].push(element);
+		};
+		$("[gid]").each(function() { add(this.getAttribute("gid"), this); });
+		$("[id]").each(function() { add(this.id, this); });
+	} // if
+
+	return itemElements[item] || [];
+}
+
+// Set the HTML content of an element, skipping the write if it would not change anything
+function setElementHtml(element, html)
+{
+	html = String(html);
+
+	// Compare also with the content as last written, in case other code has changed the element
+	if (element.vanHtml === html && element.innerHTML === element.vanInnerHtml) return;
 
+	element.innerHTML = html;
+	element.vanHtml = html;
+	element.vanInnerHtml = element.innerHTML;
+}
+
+// Write the value of a data item into the DOM, and invoke the handler
+function applyJsonObject(item, jsonObject)
+{
+	elementsForItem(item).forEach(function(element)
+	{
 		if (Array.isArray(jsonObject))
 		{
 			// Handling of multi-line DOM objects to show lists
-			$(selector).html(jsonObject.join('<br />'));
+			setElementHtml(element, jsonObject.join('<br />'));
 		}
 		else if (!!jsonObject && typeof(jsonObject) === "object")
 		{
@@ -139,39 +169,41 @@ function processJsonObject(item, jsonObject)
 					for (let property in propertyObj)
 					{
 						let value = propertyObj[property];
-						$(selector).get(0)[attribute][property] = value;
+						if (element[attribute][property] !== value) element[attribute][property] = value;
 					} // for
 				}
 				else
 				{
 					let attrValue = attributeObj[attribute];
-					$(selector).attr(attribute, attrValue);
+					$(element).attr(attribute, attrValue);
 				} // if
 			} // for
 		}
 		else
 		{
 			let itemText = jsonObject;
-			if ($(selector).hasClass("led"))
+			let on = itemText === "ON" || itemText === "YES";
+			if ($(element).hasClass("led"))
 			{
 				// Handle "led" class objects: no text copy, just turn ON or OFF
-				let on = itemText === "ON" || itemText === "YES";
-				$(selector).toggleClass("ledOn", on);
-				$(selector).toggleClass("ledOff", ! on);
+				if ($(element).hasClass("ledOn") !== on || $(element).hasClass("ledOff") === on)
+				{
+					$(element).toggleClass("ledOn", on);
+					$(element).toggleClass("ledOff", ! on);
+				} // if
 			}
-			else if ($(selector).hasClass("icon") || $(selector).get(0) instanceof SVGElement)
+			else if ($(element).hasClass("icon") || element instanceof SVGElement)
 			{
 				// Handle SVG elements and "icon" class objects: no text copy, just show or hide
-				let on = itemText === "ON" || itemText === "YES";
-				$(selector).toggle(on);
+				if (on || element.style.display !== "none") $(element).toggle(on);
 			}
 			else
 			{
 				// Handle simple "text" objects
-				$(selector).html(itemText);
+				setElementHtml(element, itemText);
 			} // if
 		} // if
-	}); // each
+	}); // forEach
 
 	let changed = jsonObject != liveData[item];
 	liveData[item] = jsonObject;
@@ -180,6 +212,126 @@ function processJsonObject(item, jsonObject)
 	handleItemChange(item, jsonObject, changed);
 }
 
+// Data items are not written into the DOM immediately, but once per animation frame, in order of arrival.
+var pendingItems = [];  // Entries { item, value }, in order of arrival; null if superseded
+var pendingItemIndex = {};  // Index into 'pendingItems' of the coalesced items, using the data item as key
+
+// Display values that only show the latest state. If one of these is received more than once within a frame, only
+// the last value is written, in the place of its last arrival. All other items (e.g. popups, notifications, button
+// presses, guidance, list pages) are events: each value is handled.
+const coalescedItems =
+{
+	"engine_rpm": true,
+	"vehicle_speed": true,
+	"wheel_speed_rear_left": true,
+	"wheel_speed_rear_right": true,
+	"wheel_pulses_rear_left": true,
+	"wheel_pulses_rear_right": true,
+	"odometer_1": true,
+	"odometer_2": true,
+	"coolant_temp": true,
+	"exterior_temp": true,
+	"exterior_temp_loc": true,
+	"fuel_level": true,
+	"dash_actual_brightness": true,
+	"delivered_power": true,
+	"delivered_torque": true,
+	"inst_consumption": true,
+	"avg_consumption_1": true,
+	"avg_consumption_2": true,
+	"avg_speed_1": true,
+	"avg_speed_2": true,
+	"exp_moving_avg_speed": true,
+	"distance_1": true,
+	"distance_2": true,
+	"distance_to_empty": true,
+	"evaporator_temp": true,
+	"condenser_pressure_bar": true,
+	"condenser_pressure_psi": true
+};
+
+// Statistics on the time spent in writing the queued items into the DOM, per animation frame
+var frameStats = { nFrames: 0, totalTime: 0, maxTime: 0 };
+
+function processJsonObject(item, jsonObject)
+{
+	if (coalescedItems[item])
+	{
+		// Last value wins
+		let index = pendingItemIndex[item];
+		if (index !== undefined) pendingItems[index] = null;
+		pendingItemIndex[item] = pendingItems.length;
+	} // if
+
+	pendingItems.push({ item: item, value: jsonObject });
+
+	if (pendingItems.length === 1) scheduleFlushPendingItems();
+}
+
+// Browsers do not run animation frame callbacks while the page is hidden: then flush on a timer instead, so that the
+// queue does not grow without limit and replay as a burst of stale events when the page becomes visible again
+function scheduleFlushPendingItems()
+{
+	if (document.hidden) setTimeout(flushPendingItems, 0); else requestAnimationFrame(flushPendingItems);
+}
+
+// An animation frame callback that was requested just before the page was hidden will not run until the page is
+// visible again: flush right away
+document.addEventListener("visibilitychange", function()
+{
+	if (pendingItems.length > 0 || pendingTraces.length > 0) flushPendingItems();
+});
+
+function flushPendingItems()
+{
+	let start = performance.now();
+
+	// Handlers may process further items; these are queued for the next frame
+	let items = pendingItems;
+	pendingItems = [];
+	pendingItemIndex = {};
+
+	items.forEach(function(entry) { if (entry !== null) applyJsonObject(entry.item, entry.value); });
+
+	let frameTime = performance.now() - start;
+	frameStats.nFrames++;
+	frameStats.totalTime += frameTime;
+	frameStats.maxTime = Math.max(frameStats.maxTime, frameTime);
+
+	echoLatencyTraces();
+}
+
+// "trace" stamps of the messages that were received, but not yet written into the DOM
+var pendingTraces = [];
+
+function queueLatencyTrace(trace)
+{
+	if (trace === undefined) return;
+	pendingTraces.push(trace);
+
+	// Make sure the stamp is echoed, even if the message did not queue any item
+	if (pendingItems.length === 0 && pendingTraces.length === 1) scheduleFlushPendingItems();
+}
+
+// Echo the "trace" stamps to the ESP, now that the messages have been written into the DOM
+function echoLatencyTraces()
+{
+	if (webSocket) pendingTraces.forEach(function(trace) { webSocket.send("latency_trace:" + trace.join(",")); });
+	pendingTraces = [];
+}
+
+// Show the frame time statistics on the "system" screen, once per second
+setInterval(function()
+{
+	if (! $("#system").is(":visible")) return;
+
+	let avg = frameStats.nFrames > 0 ? frameStats.totalTime / frameStats.nFrames : 0;
+	$("#dom_update_frame_time").text(
+		avg.toFixed(1) + " / " + frameStats.maxTime.toFixed(1) + " msec, " + frameStats.nFrames + " per sec");
+
+	frameStats = { nFrames: 0, totalTime: 0, maxTime: 0 };
+}, 1000);
+
 // For replaying console logs
 function sleep(ms)
 {
@@ -199,6 +351,22 @@ R"=====(
 
 	for (let item in jsonObj)
 	{
+		// Unit-neutral value: convert and format here, before handing over to the DOM
+		if (unitNeutralItems[item] !== undefined)
+		{
+			unitNeutralData[item] = jsonObj[item];
+			processUnitNeutralItem(item, jsonObj[item]);
+			continue;
+		} // if
+
+		// Coded value: look up the text here
+		if (codedItems[item] !== undefined)
+		{
+			codedData[item] = jsonObj[item];
+			processCodedItem(item, jsonObj[item]);
+			continue;
+		} // if
+
 		// A nested object with an item name that ends with '_' indicates namespace
 		if (item.slice(-1) === "_" && !!jsonObj[item] && typeof(jsonObj[item]) === "object")
 		{
@@ -212,6 +380,218 @@ R"=====(
 	} // for
 }
 
+// -----
+// Functions for converting and formatting unit-neutral values
+
+// In "units_on_client" mode, the ESP sends a number of values as integers in fixed metric units, e.g.
+// "exterior_temp_c_x10": -35 . These are converted here into the selected unit and formatted for the selected
+// language, resulting in the same items (e.g. "exterior_temp" and "exterior_temp_loc") as the ESP would send
+// otherwise. A change of units or language is handled by re-processing the last received values.
+
+// Last received unit-neutral values, using the data item as key
+var unitNeutralData = {};
+
+function isImperial() { return localStorage.mfdDistanceUnit === "set_units_mph"; }
+function isFahrenheit() { return localStorage.mfdTemperatureUnit === "set_units_deg_fahrenheit"; }
+
+// Integer division, rounding towards zero like C does (IE11 does not support Math.trunc)
+function intDiv(n, d) { let q = n / d; return q < 0 ? Math.ceil(q) : Math.floor(q); }
+
+// Same rounding as the integer variants of 'ToMiles' and 'ToFahrenheit' in PacketToJson.ino
+function toMiles(km) { return intDiv(intDiv(km * 2000 + 1609, 1609), 2); }
+function toFahrenheit(celsius) { return intDiv(celsius * 90 + 50 / 2, 50) + 32; }
+
+function toLocalizedFixed(value, digits)
+{
+	return value.toFixed(digits).replace(".", decimalSeparator);
+}
+
+function formatDistanceKm(km)
+{
+	if (km === null) return "--";
+	return String(isImperial() ? toMiles(km) : km);
+}
+
+function formatSpeedKmh(kmh)
+{
+	return String(isImperial() ? toMiles(kmh) : kmh);
+}
+
+function formatConsumption(lt100_x10, infinityBelow)
+{
+	if (isImperial())
+	{
+		if (lt100_x10 === null) return "--";
+		if (lt100_x10 <= infinityBelow) return "&infin;";
+		return (2824.8 / lt100_x10).toFixed(0);  // Assuming imperial gallons
+	} // if
+
+	if (lt100_x10 === null) return "--.-";
+	return toLocalizedFixed(lt100_x10 / 10, 1);
+}
+
+function formatVolumeLt_x10(lt_x10)
+{
+	return toLocalizedFixed(isImperial() ? lt_x10 / 10 / 4.546 : lt_x10 / 10, 1);  // Assuming imperial gallons
+}
+
+function formatOdometerKm_x10(km_x10)
+{
+	return toLocalizedFixed(isImperial() ? km_x10 / 10 / 1.609 : km_x10 / 10, 1);
+}
+
+// For each unit-neutral item, a function returning the resulting item(s) with their formatted value
+var unitNeutralItems =
+{
+	"coolant_temp_c": function(c)
+	{
+		return { "coolant_temp": c === null ? "---" : String(isFahrenheit() ? toFahrenheit(c) : c) };
+	},
+	"odometer_1_km_x10": function(v) { return { "odometer_1": formatOdometerKm_x10(v) }; },
+	"odometer_2_km_x10": function(v) { return { "odometer_2": formatOdometerKm_x10(v) }; },
+	"exterior_temp_c_x10": function(c_x10)
+	{
+		let temp = isFahrenheit() ? (c_x10 / 10 * 1.8 + 32).toFixed(0) : (c_x10 / 10).toFixed(1);
+		return { "exterior_temp": temp, "exterior_temp_loc": temp.replace(".", decimalSeparator) };
+	},
+	"distance_to_service_km": function(km)
+	{
+		let dist = isImperial() ? toMiles(km) : km;
+		return { "distance_to_service": String(dist), "distance_to_service_dash": String(Math.floor(dist / 100) * 100) };
+	},
+	"exp_moving_avg_speed_kmh": function(v) { return { "exp_moving_avg_speed": formatSpeedKmh(v) }; },
+	"avg_speed_1_kmh": function(v) { return { "avg_speed_1": formatSpeedKmh(v) }; },
+	"avg_speed_2_kmh": function(v) { return { "avg_speed_2": formatSpeedKmh(v) }; },
+	"inst_consumption_lt100_x10": function(v) { return { "inst_consumption": formatConsumption(v, 2) }; },
+	"avg_consumption_1_lt100_x10": function(v) { return { "avg_consumption_1": formatConsumption(v, 1) }; },
+	"avg_consumption_2_lt100_x10": function(v) { return { "avg_consumption_2": formatConsumption(v, 1) }; },
+	"distance_to_empty_km": function(v) { return { "distance_to_empty": formatDistanceKm(v) }; },
+	"distance_1_km": function(v) { return { "distance_1": formatDistanceKm(v) }; },
+	"distance_2_km": function(v) { return { "distance_2": formatDistanceKm(v) }; },
+	"vehicle_speed_kmh_x100": function(v_x100)
+	{
+		if (v_x100 === null) return { "vehicle_speed": "--" };
+		let kmh = v_x100 / 100;
+		return { "vehicle_speed": (isImperial() ? kmh / 1.609 : kmh).toFixed(0) };
+	},
+	"fuel_level_lt_x10": function(v)
+	{
+		return { "fuel_level": formatVolumeLt_x10(v), "fuel_level_unit": isImperial() ? "gl" : "lt" };
+	},
+	"fuel_level_raw_lt_x10": function(v) { return { "fuel_level_raw": formatVolumeLt_x10(v) }; }
+};
+
+function processUnitNeutralItem(item, value)
+{
+	let formatted = unitNeutralItems[item](value);
+	for (let formattedItem in formatted) processJsonObject(formattedItem, formatted[formattedItem]);
+}
+
+// To be called after a change of units or language
+function renderUnitNeutralData()
+{
+	for (let item in unitNeutralData) processUnitNeutralItem(item, unitNeutralData[item]);
+}
+
+// -----
+// Functions for looking up coded values
+
+// In "codes_on_client" mode, the ESP sends notifications and RDS program types (PTY) as numeric codes, e.g.
+// "notification_code": 23 . The texts are looked up here in the string tables of "/VanStrings.js" (variable
+// 'vanStrings'), resulting in the same items (e.g. "notification_message_on_mfd") as the ESP would send otherwise.
+// A change of language is handled by re-processing the last received values.
+//
+// Similarly, in "guidance_icons_on_client" mode, the ESP sends the legs of guidance instruction icons as bit
+// patterns, which are expanded here into one item per leg.
+
+// Last received coded values, using the data item as key
+var codedData = {};
+
+// Language used for looking up notification texts; set by 'setLanguage'
+var codedLanguage = "set_language_english";
+
+function hasStringTables() { return typeof vanStrings !== "undefined"; }
+
+function notificationTable()
+{
+	return vanStrings.notifications[codedLanguage] || vanStrings.notifications["set_language_english"];
+}
+
+function ptyItems(prefix, code)
+{
+	let result = {};
+	["pty_8", "pty_16", "pty_full"].forEach(function(table)
+	{
+		result[prefix + table] = code === 0 ? "---" : vanStrings[table][code];
+	});
+	return result;
+}
+
+// For each coded item, a function returning the resulting item(s) with their text value
+var codedItems =
+{
+	"alarm_codes": function(codes)
+	{
+		let table = notificationTable();
+		return { "alarm_list": codes.map(function(code) { return table[code]; }).filter(function(txt) { return txt !== ""; }) };
+	},
+	"notification_code": function(code)
+	{
+		if (code === null) return { "notification_message_on_mfd": "", "notification_icon_on_mfd": "" };
+		return { "notification_message_on_mfd": notificationTable()[code], "notification_icon_on_mfd": vanStrings.notification_icons[code] };
+	},
+	"selected_pty": function(code) { return ptyItems("selected_", code); },
+	"pty": function(code) { return ptyItems("", code); },
+	"satnav_curr_turn_icon_legs": function(bits) { return legItems("satnav_curr_turn_icon_leg_", bits); },
+	"satnav_curr_turn_icon_no_entry": function(bits) { return legItems("satnav_curr_turn_icon_no_entry_", bits); },
+	"satnav_curr_turn_icon_turn": function(turn) { return turnItems("satnav_curr_turn_icon_direction", turn); },
+	"satnav_next_turn_icon_legs": function(bits) { return legItems("satnav_next_turn_icon_leg_", bits); },
+	"satnav_next_turn_icon_no_entry": function(bits) { return legItems("satnav_next_turn_icon_no_entry_", bits); },
+	"satnav_next_turn_icon_turn": function(turn) { return turnItems("satnav_next_turn_icon_direction", turn); }
+};
+
+// Guidance instruction icon legs: bit 1 is the leg at 22.5 degrees, running clockwise up to bit 15 at 337.5 degrees.
+// Results in items like "satnav_curr_turn_icon_leg_22_5": "ON" .
+function legItems(prefix, bits)
+{
+	let result = {};
+	for (let legBit = 1; legBit < 16; legBit++)
+	{
+		let degrees10 = legBit * 225;
+		result[prefix + intDiv(degrees10, 10) + "_" + degrees10 % 10] = bits & (1 << legBit) ? "ON" : "OFF";
+	} // for
+	return result;
+}
+
+// Guidance instruction icon direction, in increments of 22.5 degrees
+function turnItems(item, turn)
+{
+	let degrees10 = turn * 225;
+	let degrees = intDiv(degrees10, 10) + "." + degrees10 % 10;
+	let result = {};
+	result[item + "_as_text"] = degrees;
+	result[item] = { "style": { "transform": "rotate(" + degrees + "deg)" } };
+	return result;
+}
+
+function processCodedItem(item, value)
+{
+	let texts = codedItems[item](value);
+	for (let textItem in texts) processJsonObject(textItem, texts[textItem]);
+}
+
+// To be called after a change of language
+function renderCodedData()
+{
+	for (let item in codedData)
+	{
+		// Don't pop up the current notification again
+		if (item === "notification_code") continue;
+
+		processCodedItem(item, codedData[item]);
+	} // for
+}
+
 // -----
 // Functions for handling the WebSocket
 
@@ -256,7 +636,19 @@ var fancyWebSocket = function(url)
 			console.log("// Error parsing json data '" + evt.data + "'!");
 		}
 
+		// In "batched_frames_on_client" mode, a frame may contain an array of JSON objects
+		if (Array.isArray(json))
+		{
+			json.forEach(function(obj)
+			{
+				dispatch(obj.event, obj.data);
+				queueLatencyTrace(obj.trace);
+			});
+			return;
+		} // if
+
 		dispatch(json.event, json.data);
+		queueLatencyTrace(json.trace);
 	}
 
 	conn.onopen = function()
@@ -339,6 +731,18 @@ function connectToWebSocket()
 	(
 		'open', function()
 		{
+			webSocket.send("units_on_client:YES");  // Let the ESP send unit-neutral values
+			if (hasStringTables()) webSocket.send("codes_on_client:YES");  // Let the ESP send notification and PTY codes
+			webSocket.send("guidance_icons_on_client:YES");  // Let the ESP send guidance icons as bit patterns
+			webSocket.send("satnav_list_pages_on_client:YES");  // Let the ESP send sat nav lists in pages
+			webSocket.send("batched_frames_on_client:YES");  // Let the ESP send multiple updates per frame
+
+			// Diagnostics, costing bandwidth and ESP time: only if asked for in the page URL, e.g.
+			// "MFD.html?latency_trace&bus_stats"
+			let urlParams = new URLSearchParams(window.location.search);
+			if (urlParams.has("latency_trace")) webSocket.send("latency_trace_on_client:YES");  // Stamp messages
+			if (urlParams.has("bus_stats")) webSocket.send("bus_stats_on_client:YES");  // Send the VAN bus load analysis
+
 			webSocket.send("mfd_language:" + localStorage.mfdLanguage);
 			webSocket.send("mfd_distance_unit:" + localStorage.mfdDistanceUnit);
 			webSocket.send("mfd_temperature_unit:" + localStorage.mfdTemperatureUnit);
@@ -3520,6 +3924,14 @@ function showPowerSavePopup()
 // -----
 // Handling of 'system' screen
 
+// Start or stop recording a VAN bus trace on the ESP (see VanTrace.ino)
+function toggleVanTrace()
+{
+	if (! webSocket) return;
+	let isRecording = $("#van_trace_status").text().indexOf("REC") === 0;
+	webSocket.send("van_trace:" + (isRecording ? "STOP" : "START"));
+}
+
 function gearIconAreaClicked()
 {
 	if ($("#clock").is(":visible"))
@@ -3785,8 +4197,8 @@ function handleItemChange(item, value, changed)
 			let newUnit = map[value] || "";
 			if (! newUnit) break;
 			if (newUnit === localStorage.mfdDistanceUnit) break;
-			setUnits(newUnit, localStorage.mfdTemperatureUnit, localStorage.mfdTimeUnit);
 			invalidateAllDistanceFields();
+			setUnits(newUnit, localStorage.mfdTemperatureUnit, localStorage.mfdTimeUnit);
 		} // case
 		break;
 
@@ -5577,6 +5989,53 @@ function handleItemChange(item, value, changed)
 		} // case
 		break;
 
+		case "satnav_list_page_offset":
+		{
+			// In "satnav_list_pages_on_client" mode, a sat nav list arrives in pages; offset 0 starts a new list
+			if (value === 0) handleItemChange.satnavListPages = [];
+		} // case
+		break;
+
+		case "satnav_list_page":
+		{
+			if (handleItemChange.satnavListPages === undefined) break;  // Missed the first page
+			handleItemChange.satnavListPages = handleItemChange.satnavListPages.concat(value);
+
+			// Show the entries received so far; the complete list is handled as "satnav_list" when the last page
+			// arrives
+			clearTimeout(satnavGotoListScreen.showSpinningDiscTimer);
+			$("#satnav_choose_from_list_spinning_disc").hide();
+
+			let lines = handleItemChange.satnavListPages;
+			let isFollowUpChunk =
+				(mfdToSatnavRequest === "enter_city" || mfdToSatnavRequest === "enter_street")
+				&& handleItemChange.mfdToSatnavOffset != 0
+				&& $("#satnav_choice_list").text() != "";
+			if (isFollowUpChunk)
+			{
+				lines = splitIntoLines("satnav_choice_list").slice(0, handleItemChange.mfdToSatnavOffset).concat(lines);
+			} // if
+			$("#satnav_choice_list").html(lines.join('<br />'));
+		} // case
+		break;
+
+		case "satnav_list_last_page":
+		{
+			if (handleItemChange.satnavListPages === undefined) break;  // Missed the first page
+			let list = handleItemChange.satnavListPages.concat(value);
+			handleItemChange.satnavListPages = undefined;
+			processJsonObject("satnav_list", list);
+		} // case
+		break;
+
+		case "satnav_list_aborted":
+		{
+			// A fragment of the list was missed: no more pages will come. The entries received so far stay on the
+			// screen.
+			handleItemChange.satnavListPages = undefined;
+		} // case
+		break;
+
 		case "mfd_to_satnav_offset":
 		{
 			if (value === "") break;
@@ -6055,6 +6514,8 @@ function handleItemChange(item, value, changed)
 
 function setLanguage(language)
 {
+	codedLanguage = language;
+
 	var languageSelections = "D E F GB NL I ".replace(/(.*?) /g, "<span class='languageIcon'>$1</span>");
 
 	decimalSeparator = ",";  // Default
@@ -7185,6 +7646,9 @@ function setLanguage(language)
 		satnavMode === "IN_GUIDANCE_MODE" ? stopGuidanceText : resumeGuidanceText);
 	$("#satnav_guidance_tools_menu .button:eq(3)").html(
 		satnavMode === "IN_GUIDANCE_MODE" ? stopGuidanceText : resumeGuidanceText);
+
+	renderUnitNeutralData();  // Decimal separator may have changed
+	renderCodedData();
 }
 
 function setUnits(distanceUnit, temperatureUnit, timeUnit)
@@ -7220,6 +7684,8 @@ function setUnits(distanceUnit, temperatureUnit, timeUnit)
 		$('[gid="coolant_temp_unit"]').html("&deg;C");
 		$("#climate_control_popup .tag:eq(3)").html("&deg;C");
 	} // if
+
+	renderUnitNeutralData();
 }
 
 // To be called by the body "onload" event
@@ -0,0 +1,105 @@
+
+// Memory governor: admits or rejects work, per subsystem, based on the free heap and on the largest block that can
+// still be allocated
+//
+// The total free heap alone is not a good indicator: when the heap is fragmented, AsyncTCP can fail to allocate
+// its buffers even with plenty of memory free in total. Therefore, each subsystem must leave both a minimum amount
+// of free heap and a minimum contiguous block (see Config.h) for the others.
+
+// Defined in Esp.ino
+uint32_t MaxFreeBlockSize();
+
+// Defined in Metrics.ino
+extern const char counterStr[];
+extern const char gaugeStr[];
+int MetricHeader(char* buf, const int n, PGM_P name, PGM_P type, PGM_P help);
+int ScalarMetric(char* buf, const int n, PGM_P name, PGM_P type, PGM_P help, uint32_t value);
+
+enum MemoryBudget_t
+{
+    MEMORY_FOR_WEB_SERVING,
+    MEMORY_FOR_JSON_QUEUE,
+    MEMORY_FOR_WEBSOCKET_CLEANUP,
+    N_MEMORY_BUDGETS
+}; // enum MemoryBudget_t
+
+// Returns a PSTR (allocated in flash, saves RAM)
+PGM_P MemoryBudgetStr(int budget)
+{
+    return
+        budget == MEMORY_FOR_WEB_SERVING ? PSTR("web_serving") :
+        budget == MEMORY_FOR_JSON_QUEUE ? PSTR("json_queue") :
+        budget == MEMORY_FOR_WEBSOCKET_CLEANUP ? PSTR("websocket_cleanup") :
+        PSTR("??");
+} // MemoryBudgetStr
+
+struct MemoryBudgetSpec_t
+{
+    uint32_t minFreeHeap;  // Free heap that must remain after admitting the work
+    uint32_t minFreeBlock;  // Largest free block that must remain after admitting the work
+}; // struct MemoryBudgetSpec_t
+
+const MemoryBudgetSpec_t memoryBudgets[N_MEMORY_BUDGETS] =
+{
+    { MEMORY_WEB_SERVING_MIN_FREE_HEAP, MEMORY_WEB_SERVING_MIN_FREE_BLOCK },
+    { MEMORY_JSON_QUEUE_MIN_FREE_HEAP, MEMORY_JSON_QUEUE_MIN_FREE_BLOCK },
+    { MEMORY_WEBSOCKET_CLEANUP_MIN_FREE_HEAP, MEMORY_WEBSOCKET_CLEANUP_MIN_FREE_BLOCK },
+}; // memoryBudgets
+
+uint32_t nMemoryRejections[N_MEMORY_BUDGETS];
+
+// Percentage of the free heap that is not in the largest free block
+unsigned int HeapFragmentation()
+{
+    uint32_t freeHeap = system_get_free_heap_size();
+    if (freeHeap == 0) return 0;
+    uint32_t maxFreeBlock = MaxFreeBlockSize();
+    if (maxFreeBlock >= freeHeap) return 0;
+    return 100 - maxFreeBlock * 100 / freeHeap;
+} // HeapFragmentation
+
+// Returns true if 'size' bytes can be allocated for work of the specified subsystem, while still leaving its
+// budgeted minimum free heap and free block
+bool IsMemoryAvailable(int budget, size_t size = 0)
+{
+    const MemoryBudgetSpec_t& spec = memoryBudgets[budget];
+
+    // Assume the worst case, i.e. that the allocation is taken from the largest free block
+    return
+        system_get_free_heap_size() >= spec.minFreeHeap + size
+        && MaxFreeBlockSize() >= spec.minFreeBlock + size;
+} // IsMemoryAvailable
+
+// As IsMemoryAvailable, but counts the rejections, for reporting in "/metrics"
+bool AdmitMemory(int budget, size_t size = 0)
+{
+    if (IsMemoryAvailable(budget, size)) return true;
+
+    nMemoryRejections[budget]++;
+    return false;
+} // AdmitMemory
+
+// Report the heap fragmentation and the number of rejections per subsystem, for "/metrics"
+int MemoryMetricsText(int item, char* buf, const int n)
+{
+    if (item == 0)
+    {
+        return ScalarMetric(buf, n, PSTR("heap_fragmentation_percent"), gaugeStr,
+            PSTR("Percentage of the free heap that is not in the largest free block."), HeapFragmentation());
+    } // if
+    item--;
+
+    if (item == 0)
+    {
+        return MetricHeader(buf, n, PSTR("memory_rejections_total"), counterStr,
+            PSTR("Work rejected by the memory governor, per subsystem."));
+    } // if
+    item--;
+
+    if (item >= N_MEMORY_BUDGETS) return 0;
+
+    return snprintf_P(buf, n, PSTR("vanlive_memory_rejections_total{budget=\"%s\"} %" PRIu32 "\n"),
+        MemoryBudgetStr(item),
+        nMemoryRejections[item]
+    );
+} // MemoryMetricsText
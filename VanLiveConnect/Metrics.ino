@@ -0,0 +1,211 @@
+
+// Functions for reporting operational metrics in the Prometheus text exposition format
+//
+// The text is generated piece by piece, directly into the chunks of the HTTP response (see ServeMetrics in
+// WebServer.ino), so that no large buffer or String is needed. Each module that has metrics to report provides
+// a function that writes one piece at a time, for a given item index, and returns 0 when it has no more items.
+
+// Defined in VanLiveConnect.ino
+extern uint32_t nVanRxQueueOverruns;
+extern uint32_t nVanPacketsDiscarded;
+
+// Defined in Esp.ino
+extern uint32_t lowestFreeHeap;
+uint32_t MaxFreeBlockSize();
+
+// Defined in BusStats.ino
+int BusStatsMetricsText(int item, char* buf, const int n);
+
+// Defined in IRrecv.ino
+int IrMetricsText(int item, char* buf, const int n);
+
+// Defined in LatencyTrace.ino
+int LatencyMetricsText(int item, char* buf, const int n);
+
+// Defined in Log.ino
+int LogMetricsText(int item, char* buf, const int n);
+
+// Defined in Memory.ino
+int MemoryMetricsText(int item, char* buf, const int n);
+
+#ifdef MEASURE_LOOP_STAGES
+// Defined in LoopStats.ino
+int LoopStageMetricsText(int item, char* buf, const int n);
+#endif // MEASURE_LOOP_STAGES
+
+// Defined in PacketToJson.ino
+int VanPacketMetricsText(int item, char* buf, const int n);
+
+#ifdef RAW_VAN_WEBSOCKET
+// Defined in RawWebSocket.ino
+int RawWebSocketMetricsText(int item, char* buf, const int n);
+#endif // RAW_VAN_WEBSOCKET
+
+// Defined in Settings.ino
+int SettingsMetricsText(int item, char* buf, const int n);
+
+// Defined in VanRxPolicy.ino
+int VanDropMetricsText(int item, char* buf, const int n);
+
+#ifdef VAN_RX_PARSE_TASK
+// Defined in VanRxTask.ino
+int VanRxTaskMetricsText(int item, char* buf, const int n);
+#endif // VAN_RX_PARSE_TASK
+
+// Defined in WakeTrace.ino
+int WakeTraceMetricsText(int item, char* buf, const int n);
+
+// Defined in WebSocket.ino
+extern uint32_t nWebSocketFramesSent;
+extern uint32_t nWebSocketBytesSent;
+extern uint32_t nWebSocketEventsSent;
+extern uint32_t nWebSocketSendFailures;
+extern uint32_t nQueuedJsonEvictions;
+extern int nWebSocketConnections;
+extern size_t queuedJsonBytes;
+
+const char PROGMEM counterStr[] = "counter";
+const char PROGMEM gaugeStr[] = "gauge";
+const char PROGMEM histogramStr[] = "histogram";
+
+// Write the "# HELP" and "# TYPE" lines of a metric
+int MetricHeader(char* buf, const int n, PGM_P name, PGM_P type, PGM_P help)
+{
+    return snprintf_P(buf, n, PSTR("# HELP vanlive_%s %s\n# TYPE vanlive_%s %s\n"), name, help, name, type);
+} // MetricHeader
+
+// Write a metric without labels, including its "# HELP" and "# TYPE" lines
+int ScalarMetric(char* buf, const int n, PGM_P name, PGM_P type, PGM_P help, uint32_t value)
+{
+    int at = MetricHeader(buf, n, name, type, help);
+    at += at >= n ? 0 : snprintf_P(buf + at, n - at, PSTR("vanlive_%s %" PRIu32 "\n"), name, value);
+    return at;
+} // ScalarMetric
+
+int EspMetricsText(int item, char* buf, const int n)
+{
+    switch (item)
+    {
+        case 0:
+            return ScalarMetric(buf, n, PSTR("uptime_seconds"), counterStr,
+                PSTR("Time since boot."), millis() / 1000);
+        case 1:
+            return ScalarMetric(buf, n, PSTR("heap_free_bytes"), gaugeStr,
+                PSTR("Free heap."), system_get_free_heap_size());
+        case 2:
+            return ScalarMetric(buf, n, PSTR("heap_min_free_bytes"), gaugeStr,
+                PSTR("Lowest free heap since boot."), lowestFreeHeap);
+        case 3:
+            return ScalarMetric(buf, n, PSTR("heap_max_free_block_bytes"), gaugeStr,
+                PSTR("Largest block that can be allocated."), MaxFreeBlockSize());
+        default:
+            return 0;
+    } // switch
+} // EspMetricsText
+
+int VanRxMetricsText(int item, char* buf, const int n)
+{
+    switch (item)
+    {
+        case 0:
+            return ScalarMetric(buf, n, PSTR("van_rx_packets_total"), counterStr,
+                PSTR("VAN bus packets received."), VanBusRx.GetCount());
+        case 1:
+            return ScalarMetric(buf, n, PSTR("van_rx_queue_overruns_total"), counterStr,
+                PSTR("VAN bus receive queue overruns."), nVanRxQueueOverruns);
+        case 2:
+            return ScalarMetric(buf, n, PSTR("van_rx_dropped_total"), counterStr,
+                PSTR("VAN bus packets discarded to prevent a receive queue overrun."), nVanPacketsDiscarded);
+        case 3:
+          #ifdef VAN_RX_PARSE_TASK
+            const static uint32_t parseTask = 1;
+          #else
+            const static uint32_t parseTask = 0;
+          #endif // VAN_RX_PARSE_TASK
+
+            // For comparing the overrun rate with and without VAN_RX_PARSE_TASK
+            return ScalarMetric(buf, n, PSTR("van_rx_parse_task"), gaugeStr,
+                PSTR("1 if VAN bus packets are parsed in a separate task, 0 if in the main loop."), parseTask);
+        default:
+            return 0;
+    } // switch
+} // VanRxMetricsText
+
+int WebSocketMetricsText(int item, char* buf, const int n)
+{
+    switch (item)
+    {
+        case 0:
+            return ScalarMetric(buf, n, PSTR("websocket_frames_sent_total"), counterStr,
+                PSTR("WebSocket frames sent."), nWebSocketFramesSent);
+        case 1:
+            return ScalarMetric(buf, n, PSTR("websocket_events_sent_total"), counterStr,
+                PSTR("JSON objects sent on the WebSocket."), nWebSocketEventsSent);
+        case 2:
+            return ScalarMetric(buf, n, PSTR("json_bytes_sent_total"), counterStr,
+                PSTR("JSON bytes sent on the WebSocket."), nWebSocketBytesSent);
+        case 3:
+            return ScalarMetric(buf, n, PSTR("websocket_send_failures_total"), counterStr,
+                PSTR("WebSocket frames that could not be sent to any connected client."), nWebSocketSendFailures);
+        case 4:
+            return ScalarMetric(buf, n, PSTR("websocket_queue_evictions_total"), counterStr,
+                PSTR("Queued JSON objects discarded before they could be (re-)sent."), nQueuedJsonEvictions);
+        case 5:
+            return ScalarMetric(buf, n, PSTR("websocket_connections_total"), counterStr,
+                PSTR("WebSocket connections accepted."), nWebSocketConnections);
+        case 6:
+            return ScalarMetric(buf, n, PSTR("json_queue_bytes"), gaugeStr,
+                PSTR("Bytes in the queue of JSON objects stored for (re-)sending."), queuedJsonBytes);
+        default:
+            return 0;
+    } // switch
+} // WebSocketMetricsText
+
+typedef int (*TMetricsText)(int item, char* buf, const int n);
+
+const TMetricsText metricsSections[] =
+{
+    &EspMetricsText,
+    &MemoryMetricsText,
+    &VanRxMetricsText,
+  #ifdef VAN_RX_PARSE_TASK
+    &VanRxTaskMetricsText,
+  #endif // VAN_RX_PARSE_TASK
+    &BusStatsMetricsText,
+    &VanDropMetricsText,
+    &VanPacketMetricsText,
+    &WebSocketMetricsText,
+  #ifdef RAW_VAN_WEBSOCKET
+    &RawWebSocketMetricsText,
+  #endif // RAW_VAN_WEBSOCKET
+    &IrMetricsText,
+    &LatencyMetricsText,
+    &LogMetricsText,
+    &SettingsMetricsText,
+    &WakeTraceMetricsText,
+  #ifdef MEASURE_LOOP_STAGES
+    &LoopStageMetricsText,
+  #endif // MEASURE_LOOP_STAGES
+}; // metricsSections
+
+#define N_METRICS_SECTIONS (sizeof(metricsSections) / sizeof(metricsSections[0]))
+
+// Write the next piece of the metrics text, as indicated by 'section' and 'item' (both start at 0), and advance
+// these to the piece after that. Returns the number of characters written, or 0 when done.
+int MetricsText(int& section, int& item, char* buf, const int n)
+{
+    while (section < (int)N_METRICS_SECTIONS)
+    {
+        int len = metricsSections[section](item, buf, n);
+        if (len > 0)
+        {
+            item++;
+            return len;
+        } // if
+
+        section++;
+        item = 0;
+    } // while
+
+    return 0;
+} // MetricsText
@@ -4,8 +4,9 @@
 //
 // The original MFD has pretty weird logic for showing its various screens.
 
-// Defined in Eeprom.ino
-void WriteEeprom(int const address, uint8_t const val, const char* message);
+// Defined in Settings.ino
+uint8_t ReadSetting(int key);
+void WriteSetting(int const key, uint8_t const val, const char* message);
 
 // Defined in PacketToJson.ino
 extern const char yesStr[];
@@ -35,7 +36,7 @@ enum MFD_SmallScreen_t
     N_SMALL_SCREENS
 }; // enum MFD_SmallScreen_t
 
-#define SMALL_SCREEN_EEPROM_POS (1)
+#define SMALL_SCREEN_SETTING_KEY (1)
 uint8_t smallScreen = SMALL_SCREEN_INVALID;
 uint8_t smallScreenBeforeGoingIntoGuidanceMode = SMALL_SCREEN_INVALID;
 
@@ -57,7 +58,7 @@ enum MFD_LargeScreen_t
 }; // enum MFD_LargeScreen_t
 
 // Keeps track of the content that is shown on the "large" (right-hand side) screen on the original MFD.
-// Not stored in EEPROM; the "large" screen always starts with the "clock".
+// Not stored in the settings; the "large" screen always starts with the "clock".
 uint8_t largeScreen = LARGE_SCREEN_CLOCK;
 uint8_t largeScreenBeforeGoingIntoGuidanceMode = LARGE_SCREEN_CLOCK;
 
@@ -170,9 +171,7 @@ void NoPopup()
     TripComputerPopupShowingSince = 0;
     popupDuration = 0;
 
-  #ifdef DEBUG_ORIGINAL_MFD
-    Serial.printf_P(PSTR("[originalMfd] NoPopup()\n"));
-  #endif // DEBUG_ORIGINAL_MFD
+    if (IsDiagEnabled(DIAG_ORIGINAL_MFD)) AsyncLog.printf_P(PSTR("[originalMfd] NoPopup()\n"));
 } // NoPopup
 
 // Register the fact that a notification popup (not the trip computer popup) is showing.
@@ -184,9 +183,10 @@ void NotificationPopupShowing(unsigned long since, unsigned long duration)
     TripComputerPopupShowingSince = 0;
     popupDuration = duration;
 
-  #ifdef DEBUG_ORIGINAL_MFD
-    Serial.printf_P(PSTR("[originalMfd] NotificationPopupShowing(%lu msec)\n"), popupDuration);
-  #endif // DEBUG_ORIGINAL_MFD
+    if (IsDiagEnabled(DIAG_ORIGINAL_MFD))
+    {
+        AsyncLog.printf_P(PSTR("[originalMfd] NotificationPopupShowing(%lu msec)\n"), popupDuration);
+    } // if
 } // NotificationPopupShowing
 
 // Return true if a notification popup (not the trip computer popup) is showing, otherwise return false
@@ -197,21 +197,22 @@ bool IsNotificationPopupShowing(bool beVerbose)
 
     if (beVerbose)
     {
-      #ifdef DEBUG_ORIGINAL_MFD
-        Serial.printf_P(
-            PSTR("[originalMfd] IsNotificationPopupShowing = %s (popupDuration = %lu"),
-            result ? yesStr : noStr,
-            popupDuration
-        );
-        if (popupDuration != 0)
+        if (IsDiagEnabled(DIAG_ORIGINAL_MFD))
         {
-            Serial.printf_P(
-                PSTR(", millis() - NotificationPopupShowingSince = %ld"),
-                millis() - NotificationPopupShowingSince
+            AsyncLog.printf_P(
+                PSTR("[originalMfd] IsNotificationPopupShowing = %s (popupDuration = %lu"),
+                result ? yesStr : noStr,
+                popupDuration
             );
+            if (popupDuration != 0)
+            {
+                AsyncLog.printf_P(
+                    PSTR(", millis() - NotificationPopupShowingSince = %ld"),
+                    millis() - NotificationPopupShowingSince
+                );
+            } // if
+            AsyncLog.print(")\n");
         } // if
-        Serial.print(")\n");
-      #endif // DEBUG_ORIGINAL_MFD
     } // if
 
     return result;
@@ -224,13 +225,14 @@ void TripComputerPopupShowing(unsigned long since, unsigned long duration)
     TripComputerPopupShowingSince = since;
     popupDuration = duration;
 
-  #ifdef DEBUG_ORIGINAL_MFD
-    Serial.printf_P(
-        PSTR("[originalMfd] TripComputerPopupShowing(%lu msec); TripComputer = %s\n"),
-        popupDuration,
-        TripComputerStr()
-    );
-  #endif // DEBUG_ORIGINAL_MFD
+    if (IsDiagEnabled(DIAG_ORIGINAL_MFD))
+    {
+        AsyncLog.printf_P(
+            PSTR("[originalMfd] TripComputerPopupShowing(%lu msec); TripComputer = %s\n"),
+            popupDuration,
+            TripComputerStr()
+        );
+    } // if
 } // TripComputerPopupShowing
 
 // Return true if the trip computer popup is showing, otherwise return false
@@ -255,24 +257,25 @@ void InitSmallScreen()
     // Already initialized?
     if (smallScreen != SMALL_SCREEN_INVALID) return;
 
-    // Initialize from (emulated) EEPROM
-    smallScreen = EEPROM.read(SMALL_SCREEN_EEPROM_POS);
+    // Initialize from the stored settings
+    smallScreen = ReadSetting(SMALL_SCREEN_SETTING_KEY);
 
-  #ifdef DEBUG_ORIGINAL_MFD
-    Serial.printf_P(
-        PSTR("[originalMfd] smallScreen: read value %u (%s) from EEPROM position %d\n"),
-        smallScreen,
-        SmallScreenStr(),
-        SMALL_SCREEN_EEPROM_POS);
-  #endif // DEBUG_ORIGINAL_MFD
+    if (IsDiagEnabled(DIAG_ORIGINAL_MFD))
+    {
+        AsyncLog.printf_P(
+            PSTR("[originalMfd] smallScreen: read value %u (%s) from setting %d\n"),
+            smallScreen,
+            SmallScreenStr(),
+            SMALL_SCREEN_SETTING_KEY);
+    } // if
 
-    // Successfully read from EEPROM?
+    // Successfully read from the settings?
     if (smallScreen <= SMALL_SCREEN_LAST) return;
 
-    // No valid value from EEPROM: fall back to default. When the original MFD is plugged in, this is what
+    // No valid value stored: fall back to default. When the original MFD is plugged in, this is what
     // it starts with.
     smallScreen = SMALL_SCREEN_TRIP_INFO_1;
-    WriteEeprom(SMALL_SCREEN_EEPROM_POS, smallScreen, PSTR("Small screen"));
+    WriteSetting(SMALL_SCREEN_SETTING_KEY, smallScreen, PSTR("Small screen"));
 } // InitSmallScreen
 
 // Called when an MFD status is received indicating a reset of one of the trip computers. Called after a long-press
@@ -291,14 +294,15 @@ void ResetTripInfo(uint16_t mfdStatus)
     // Set tab index for trip computer on small screen (left hand side of the display)
     smallScreen = newSmallScreen;
 
-  #ifdef DEBUG_ORIGINAL_MFD
-    Serial.printf_P(
-        PSTR("[originalMfd] Right stalk button long-press; SmallScreen = %s\n"),
-        SmallScreenStr()
-    );
-  #endif // DEBUG_ORIGINAL_MFD
+    if (IsDiagEnabled(DIAG_ORIGINAL_MFD))
+    {
+        AsyncLog.printf_P(
+            PSTR("[originalMfd] Right stalk button long-press; SmallScreen = %s\n"),
+            SmallScreenStr()
+        );
+    } // if
 
-    if (mustWrite) WriteEeprom(SMALL_SCREEN_EEPROM_POS, smallScreen, PSTR("Small screen"));
+    if (mustWrite) WriteSetting(SMALL_SCREEN_SETTING_KEY, smallScreen, PSTR("Small screen"));
 } // ResetTripInfo
 
 // Select the next tab in the trip computer screen (large screen) or trip computer popup.
@@ -325,14 +329,15 @@ void CycleTripInfo()
         // Select the next tab
         smallScreen = (smallScreen + 1) % N_SMALL_SCREENS;
 
-      #ifdef DEBUG_ORIGINAL_MFD
-        Serial.printf_P(
-            PSTR("[originalMfd] Right stalk button short-press; SmallScreen = %s\n"),
-            SmallScreenStr()
-        );
-      #endif // DEBUG_ORIGINAL_MFD
+        if (IsDiagEnabled(DIAG_ORIGINAL_MFD))
+        {
+            AsyncLog.printf_P(
+                PSTR("[originalMfd] Right stalk button short-press; SmallScreen = %s\n"),
+                SmallScreenStr()
+            );
+        } // if
 
-        WriteEeprom(SMALL_SCREEN_EEPROM_POS, smallScreen, PSTR("Small screen"));
+        WriteSetting(SMALL_SCREEN_SETTING_KEY, smallScreen, PSTR("Small screen"));
         return;
     } // if
 
@@ -343,14 +348,15 @@ void CycleTripInfo()
 
         NextSmallScreenSkipGpsInfo();  // Select the next tab, but skip the "GPS info" screen
 
-      #ifdef DEBUG_ORIGINAL_MFD
-        Serial.printf_P(
-            PSTR("[originalMfd] Right stalk button short-press; TripComputer = %s\n"),
-            TripComputerStr()
-        );
-      #endif // DEBUG_ORIGINAL_MFD
+        if (IsDiagEnabled(DIAG_ORIGINAL_MFD))
+        {
+            AsyncLog.printf_P(
+                PSTR("[originalMfd] Right stalk button short-press; TripComputer = %s\n"),
+                TripComputerStr()
+            );
+        } // if
 
-        WriteEeprom(SMALL_SCREEN_EEPROM_POS, smallScreen, PSTR("Small screen"));
+        WriteSetting(SMALL_SCREEN_SETTING_KEY, smallScreen, PSTR("Small screen"));
         return;
     } // if
 
@@ -369,12 +375,13 @@ void CycleTripInfo()
     {
         // The trip computer popup was not visible: the stalk button triggers the trip computer popup to appear
 
-      #ifdef DEBUG_ORIGINAL_MFD
-        Serial.printf_P(
-            PSTR("[originalMfd] Right stalk button short-press; trip computer popup appeared; TripComputer = %s\n"),
-            TripComputerStr()
-        );
-      #endif // DEBUG_ORIGINAL_MFD
+        if (IsDiagEnabled(DIAG_ORIGINAL_MFD))
+        {
+            AsyncLog.printf_P(
+                PSTR("[originalMfd] Right stalk button short-press; trip computer popup appeared; TripComputer = %s\n"),
+                TripComputerStr()
+            );
+        } // if
     }
     else
     {
@@ -382,12 +389,13 @@ void CycleTripInfo()
 
         NextSmallScreenSkipGpsInfo();  // Select the next tab, but skip the "GPS info" screen
 
-      #ifdef DEBUG_ORIGINAL_MFD
-        Serial.printf_P(
-            PSTR("[originalMfd] Right stalk button short-press; TripComputer = %s\n"),
-            TripComputerStr()
-        );
-      #endif // DEBUG_ORIGINAL_MFD
+        if (IsDiagEnabled(DIAG_ORIGINAL_MFD))
+        {
+            AsyncLog.printf_P(
+                PSTR("[originalMfd] Right stalk button short-press; TripComputer = %s\n"),
+                TripComputerStr()
+            );
+        } // if
     } // if
 
     TripComputerPopupShowing(now, 8000);  // (Re-)start the timer
@@ -409,15 +417,16 @@ void UpdateSmallScreenAfterStoppingGuidance()
             smallScreen = smallScreenBeforeGoingIntoGuidanceMode;
         } // if
 
-        if (smallScreen != oldSmallScreen) WriteEeprom(SMALL_SCREEN_EEPROM_POS, smallScreen, PSTR("Small screen"));
+        if (smallScreen != oldSmallScreen) WriteSetting(SMALL_SCREEN_SETTING_KEY, smallScreen, PSTR("Small screen"));
     } // if
 
-  #ifdef DEBUG_ORIGINAL_MFD
-    Serial.printf_P(
-        PSTR("[originalMfd] Going out of guidance; SmallScreen := %s\n"),
-        SmallScreenStr()
-    );
-  #endif // DEBUG_ORIGINAL_MFD
+    if (IsDiagEnabled(DIAG_ORIGINAL_MFD))
+    {
+        AsyncLog.printf_P(
+            PSTR("[originalMfd] Going out of guidance; SmallScreen := %s\n"),
+            SmallScreenStr()
+        );
+    } // if
 } // UpdateSmallScreenAfterStoppingGuidance
 
 // Called when the current street becomes known. The original MFD switches to the current street.
@@ -435,12 +444,13 @@ void UpdateLargeScreenForCurrentStreetKnown()
         } // if
     } // if
 
-  #ifdef DEBUG_ORIGINAL_MFD
-    Serial.printf_P(
-        PSTR("[originalMfd] current street known; largeScreen := %s\n"),
-        LargeScreenStr()
-    );
-  #endif // DEBUG_ORIGINAL_MFD
+    if (IsDiagEnabled(DIAG_ORIGINAL_MFD))
+    {
+        AsyncLog.printf_P(
+            PSTR("[originalMfd] current street known; largeScreen := %s\n"),
+            LargeScreenStr()
+        );
+    } // if
 } // UpdateLargeScreenForCurrentStreetKnown
 
 // Called when the head unit is powered on (tuner, tape, internal CD or CD changer). The original MFD switches to
@@ -467,16 +477,17 @@ void UpdateLargeScreenForHeadUnitOn()
         largeScreen = LARGE_SCREEN_HEAD_UNIT;
     } // if
 
-  #ifdef DEBUG_ORIGINAL_MFD
-    static char popupDurationStr[20] = {0};
-    sprintf_P(popupDurationStr, PSTR(" (%lu msec)\0"), popupDuration);
-    Serial.printf_P(
-        PSTR("[originalMfd] Head unit powered on; NotificationPopupShowing = %s%s; largeScreen := %s\n"),
-        IsNotificationPopupShowing() ? yesStr : noStr,
-        IsNotificationPopupShowing() ? popupDurationStr : emptyStr,
-        LargeScreenStr()
-    );
-  #endif // DEBUG_ORIGINAL_MFD
+    if (IsDiagEnabled(DIAG_ORIGINAL_MFD))
+    {
+        static char popupDurationStr[20] = {0};
+        sprintf_P(popupDurationStr, PSTR(" (%lu msec)"), popupDuration);
+        AsyncLog.printf_P(
+            PSTR("[originalMfd] Head unit powered on; NotificationPopupShowing = %s%s; largeScreen := %s\n"),
+            IsNotificationPopupShowing() ? yesStr : noStr,
+            IsNotificationPopupShowing() ? popupDurationStr : emptyStr,
+            LargeScreenStr()
+        );
+    } // if
 } // UpdateLargeScreenForHeadUnitOn
 
 // Called when the head unit is powered off
@@ -497,14 +508,15 @@ void UpdateLargeScreenForHeadUnitOff()
         } // if
     } // if
 
-  #ifdef DEBUG_ORIGINAL_MFD
-    Serial.printf_P(
-        PSTR("[originalMfd] Head unit powered off; guidance=%s; curr_street_known=%s; largeScreen := %s\n"),
-        isSatnavGuidanceActive ? yesStr : noStr,
-        isCurrentStreetKnown ? yesStr : noStr,
-        LargeScreenStr()
-    );
-  #endif // DEBUG_ORIGINAL_MFD
+    if (IsDiagEnabled(DIAG_ORIGINAL_MFD))
+    {
+        AsyncLog.printf_P(
+            PSTR("[originalMfd] Head unit powered off; guidance=%s; curr_street_known=%s; largeScreen := %s\n"),
+            isSatnavGuidanceActive ? yesStr : noStr,
+            isCurrentStreetKnown ? yesStr : noStr,
+            LargeScreenStr()
+        );
+    } // if
 } // UpdateLargeScreenForHeadUnitOff
 
 // Called when going into sat nav guidance mode. The original MFD switches to the guidance instruction screen.
@@ -518,13 +530,14 @@ void UpdateLargeScreenForGuidanceModeOn()
     largeScreenBeforeGoingIntoGuidanceMode = largeScreen;  // To return to later, when guidance ends
     largeScreen = LARGE_SCREEN_GUIDANCE;
 
-  #ifdef DEBUG_ORIGINAL_MFD
-    Serial.printf_P(
-        PSTR("[originalMfd] Going into guidance; largeScreenBefore=%s; largeScreen := %s\n"),
-        LargeScreenStr(largeScreenBeforeGoingIntoGuidanceMode),
-        LargeScreenStr()
-    );
-  #endif // DEBUG_ORIGINAL_MFD
+    if (IsDiagEnabled(DIAG_ORIGINAL_MFD))
+    {
+        AsyncLog.printf_P(
+            PSTR("[originalMfd] Going into guidance; largeScreenBefore=%s; largeScreen := %s\n"),
+            LargeScreenStr(largeScreenBeforeGoingIntoGuidanceMode),
+            LargeScreenStr()
+        );
+    } // if
 } // UpdateLargeScreenForGuidanceModeOn
 
 // Called when going out of sat nav guidance mode. The original MFD may switch the large (right hand side) screen to
@@ -562,14 +575,15 @@ void UpdateLargeScreenForGuidanceModeOff()
         if (! isHeadUnitPowerOn) largeScreen = LARGE_SCREEN_CLOCK;
     } // if
 
-  #ifdef DEBUG_ORIGINAL_MFD
-    Serial.printf_P(
-        PSTR("[originalMfd] Going out of guidance; head_unit=%s; curr_street_known=%s; largeScreen := %s\n"),
-        isHeadUnitPowerOn ? yesStr : noStr,
-        isCurrentStreetKnown ? yesStr : noStr,
-        LargeScreenStr()
-    );
-  #endif // DEBUG_ORIGINAL_MFD
+    if (IsDiagEnabled(DIAG_ORIGINAL_MFD))
+    {
+        AsyncLog.printf_P(
+            PSTR("[originalMfd] Going out of guidance; head_unit=%s; curr_street_known=%s; largeScreen := %s\n"),
+            isHeadUnitPowerOn ? yesStr : noStr,
+            isCurrentStreetKnown ? yesStr : noStr,
+            LargeScreenStr()
+        );
+    } // if
 } // UpdateLargeScreenForGuidanceModeOff
 
 // Called after receiving an MFD status "MFD_SCREEN_OFF" packet
@@ -579,12 +593,13 @@ void UpdateLargeScreenForMfdOff()
 
     smallScreenBeforeGoingIntoGuidanceMode = smallScreen;
 
-  #ifdef DEBUG_ORIGINAL_MFD
-    Serial.printf_P(
-        PSTR("[originalMfd] MFD turning off; largeScreen := %s\n"),
-        LargeScreenStr()
-    );
-  #endif // DEBUG_ORIGINAL_MFD
+    if (IsDiagEnabled(DIAG_ORIGINAL_MFD))
+    {
+        AsyncLog.printf_P(
+            PSTR("[originalMfd] MFD turning off; largeScreen := %s\n"),
+            LargeScreenStr()
+        );
+    } // if
 } // UpdateLargeScreenForMfdOff
 
 // Called after receiving a "MOD" button press from the IR remote control.
@@ -622,13 +637,14 @@ void CycleLargeScreen()
         largeScreen = LARGE_SCREEN_CLOCK;
     } // if
 
-  #ifdef DEBUG_ORIGINAL_MFD
-    Serial.printf_P(
-        PSTR("[originalMfd] \"MOD\" button press; guidance=%s; head_unit=%s; curr_street_known=%s; largeScreen := %s\n"),
-        isSatnavGuidanceActive ? yesStr : noStr,
-        isHeadUnitPowerOn ? yesStr : noStr,
-        isCurrentStreetKnown ? yesStr : noStr,
-        LargeScreenStr()
-    );
-  #endif // DEBUG_ORIGINAL_MFD
+    if (IsDiagEnabled(DIAG_ORIGINAL_MFD))
+    {
+        AsyncLog.printf_P(
+            PSTR("[originalMfd] \"MOD\" button press; guidance=%s; head_unit=%s; curr_street_known=%s; largeScreen := %s\n"),
+            isSatnavGuidanceActive ? yesStr : noStr,
+            isHeadUnitPowerOn ? yesStr : noStr,
+            isCurrentStreetKnown ? yesStr : noStr,
+            LargeScreenStr()
+        );
+    } // if
 } // CycleLargeScreen
@@ -4,9 +4,17 @@
 #include "VanIden.h"
 #include "Config.h"
 
+// Defined in BusStats.ino
+int BusStatsPrintSelection(uint16_t iden);
+
 // Filter on specific IDENs
 bool IsPacketSelected(uint16_t iden, VanPacketFilter_t filter)
 {
+    // A selection made at run time, on the "/bus" page (see ServeBusStats in WebServer.ino), overrides the
+    // compile-time filters below
+    int selection = BusStatsPrintSelection(iden);
+    if (selection >= 0) return selection;
+
     if (filter == VAN_PACKETS_ALL_VAN_PKTS)
     {
         // Show all packets, but discard the following:
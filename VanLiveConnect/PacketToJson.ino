@@ -7,6 +7,7 @@
  */
 
 #include "Notifications.h"
+#include "VanPacket.h"
 
 enum VanPacketParseResult_t
 {
@@ -37,7 +38,17 @@ PGM_P VanPacketParseResultStr(int result)
         "ERROR_??";
 } // ResultStr
 
-typedef VanPacketParseResult_t (*TPacketParser)(TVanPacketRxDesc&, char*, const int);
+typedef VanPacketParseResult_t (*TPacketParser)(VanPacket_t&, char*, const int);
+
+// Number of packets per parse result, for reporting in "/metrics"
+#define N_VAN_PACKET_PARSE_RESULTS (VAN_PACKET_NO_CONTENT - VAN_PACKET_PARSE_FRAGMENT_MISSED + 1)
+uint32_t vanPacketParseResultCount[N_VAN_PACKET_PARSE_RESULTS];
+uint32_t nVanPacketsCrcRepaired = 0;
+
+inline void CountVanPacketParseResult(int result)
+{
+    vanPacketParseResultCount[result - VAN_PACKET_PARSE_FRAGMENT_MISSED]++;
+} // CountVanPacketParseResult
 
 struct IdenHandler_t
 {
@@ -79,6 +90,9 @@ extern bool satnavDisclaimerAccepted;
 // Defined in PacketFilter.ino
 bool IsPacketSelected(uint16_t iden, VanPacketFilter_t filter);
 
+// Defined in BusStats.ino
+void CountBusCrcError(uint16_t iden);
+
 // Defined in OriginalMfd.ino
 extern uint8_t largeScreen;
 extern uint8_t mfdLanguage;
@@ -98,15 +112,24 @@ void UpdateLargeScreenForGuidanceModeOff();
 void UpdateLargeScreenForMfdOff();
 void CycleTripInfo();
 
-// Defined in Eeprom.ino
-void WriteEeprom(int const address, uint8_t const val, const char* message = 0);
-void CommitEeprom();
+// Defined in Settings.ino
+uint8_t ReadSetting(int key);
+void WriteSetting(int const key, uint8_t const val, const char* message = 0);
 
 // Defined in DateTime.ino
 const char* TimeStamp();
 
+// Defined in Metrics.ino
+extern const char counterStr[];
+int MetricHeader(char* buf, const int n, PGM_P name, PGM_P type, PGM_P help);
+int ScalarMetric(char* buf, const int n, PGM_P name, PGM_P type, PGM_P help, uint32_t value);
+
 // Forward declaration
 void ResetPacketPrevData();
+void ResetUnitDependentPacketPrevData();
+#ifdef VAN_RX_PARSE_TASK
+void HandlePacketPrevDataResetRequests();
+#endif // VAN_RX_PARSE_TASK
 
 // Default, and unless otherwise specified, the following units are used:
 // - Distance: kilometers
@@ -131,6 +154,29 @@ enum MFD_TemperatureUnit_t
 
 uint8_t mfdTemperatureUnit = MFD_TEMPERATURE_UNIT_CELSIUS;
 
+// When set, the most frequently reported unit-dependent values (temperatures, distances, speeds, fuel) are sent
+// as unit-neutral integers in fixed metric units, e.g. "exterior_temp_c_x10": -35 . The client (MFD.js) then
+// takes care of unit conversion and localized formatting, so that a change of units does not require all
+// packets to be re-parsed and re-sent. Set by the client with the "units_on_client:YES" websocket message.
+bool unitsOnClient = false;
+
+// When set, notification popups and RDS program types (PTY) are sent as numeric codes, e.g.
+// "notification_code": 23 . The client (MFD.js) looks up the texts in the string tables that are served once as
+// the cacheable asset "/VanStrings.js" (see 'StringTablesJsLine' below). Set by the client with the
+// "codes_on_client:YES" websocket message.
+bool codesOnClient = false;
+
+// When set, sat nav guidance instruction icons are sent as bit patterns, e.g. "satnav_curr_turn_icon_legs": 4369 ,
+// instead of one "ON"/"OFF" item per leg. The client (MFD.js) expands these into the SVG leg visibility. Set by the
+// client with the "guidance_icons_on_client:YES" websocket message.
+bool guidanceIconsOnClient = false;
+
+// When set, sat nav lists (cities, streets, services, directory entries) are sent in pages as the report fragments
+// arrive, e.g. "satnav_list_page_offset": 8, "satnav_list_page": [...] , with "satnav_list_last_page" for the
+// last page, or "satnav_list_aborted" if a fragment was missed after the first page. The client (MFD.js) assembles
+// the pages into the complete list. Set by the client with the "satnav_list_pages_on_client:YES" websocket message.
+bool satnavListPagesOnClient = false;
+
 // Index of user-selected time unit
 enum MFD_TimeUnit_t
 {
@@ -228,26 +274,94 @@ char* ToFloatStr(char* buffer, float f, int prec, bool useLocalizedDecimalSepara
     return strippedStr;
 } // ToFloatStr
 
-// Replace special (e.g. extended Ascii) characters by their HTML-safe representation.
-// See also: https://www.ascii-code.com/ .
-void AsciiToHtml(String& in)
+// Substitution table for converting the (Latin-1) text bytes as received on the VAN bus into HTML-safe text
+// that can be put in a JSON string. Each entry is the substitution for one byte; an empty entry means: copy the
+// byte as-is. The table is generated at compile time and lives in flash.
+struct HtmlSubstitutionTable_t
+{
+    // Longest substitution is "&#x24E7;" (8 characters)
+    #define MAX_HTML_SUBSTITUTION_SIZE 8
+    char str[256][MAX_HTML_SUBSTITUTION_SIZE + 1];
+
+    constexpr HtmlSubstitutionTable_t() : str()
+    {
+        // Characters that would break the JSON string
+        SetStr('"', "&quot;");
+        SetStr('\\', "&#92;");
+
+        // Extended Ascii characters, e.g. "\xEB" (ë) becomes "&#235;". See also: https://www.ascii-code.com/ .
+        for (int c = 0x80; c <= 0xFF; c++)
+        {
+            str[c][0] = '&';
+            str[c][1] = '#';
+            str[c][2] = '0' + c / 100;
+            str[c][3] = '0' + c / 10 % 10;
+            str[c][4] = '0' + c % 10;
+            str[c][5] = ';';
+        } // for
+    }
+
+    constexpr void SetStr(int c, const char* s)
+    {
+        for (int i = 0; s[i] != 0 && i < MAX_HTML_SUBSTITUTION_SIZE; i++) str[c][i] = s[i];
+    }
+}; // struct HtmlSubstitutionTable_t
+
+constexpr HtmlSubstitutionTable_t htmlSubstitutionTable PROGMEM;
+
+// Options for 'VanTextToHtml'
+enum VanTextToHtmlOptions_t
+{
+    VAN_TEXT_SOFT_HYPHENS = 0x01,  // '#' indicates a "soft hyphen"
+    VAN_TEXT_NON_BREAKING_SPACES = 0x02,
+    VAN_TEXT_SATNAV_MARKERS = 0x04  // 0x80 and 0x81 mark entries that cannot be selected
+}; // enum VanTextToHtmlOptions_t
+
+// Convert text as received on the VAN bus into HTML-safe text, in a single pass, using a table lookup for each
+// byte. The result is written into 'out'. Returns the length of the result, or -1 if the result does not fit.
+int VanTextToHtml(const char* in, char* out, const int n, uint8_t options = 0)
 {
-    for (unsigned int i = 0; i < in.length(); i++)
+    int at = 0;
+    for (const uint8_t* c = (const uint8_t*)in; *c != 0; c++)
     {
-        char c = in.c_str()[i];
+        const char* subst = htmlSubstitutionTable.str[*c];
+
+        // Sat nav specific substitutions
+        if (options != 0)
+        {
+            if (*c == '#' && (options & VAN_TEXT_SOFT_HYPHENS)) subst = PSTR("&shy;");
+            else if (*c == ' ' && (options & VAN_TEXT_NON_BREAKING_SPACES)) subst = PSTR("&nbsp;");
+
+            // Special (last) characters in sat nav strings:
+            // - 0x80: indicates that the entry cannot be selected because the current navigation disc cannot be
+            //   read. This is shown as a "?".
+            // - 0x81: indicates that the entry cannot be selected because the current navigation disc is for a
+            //   different country/region. This is shown on the original MFD as an circle with a bar "(-)"; here
+            //   we use a circle with a cross "(X)".
+            // In other texts (e.g. RDS), these are ordinary extended Ascii characters.
+            else if (*c == 0x80 && (options & VAN_TEXT_SATNAV_MARKERS)) subst = PSTR("?");
+            else if (*c == 0x81 && (options & VAN_TEXT_SATNAV_MARKERS)) subst = PSTR("&#x24E7;");
+        } // if
 
         // Vast majority of characters is printable, so this if-statement is entered seldomly
-        if (c > 127)
+        if (pgm_read_byte(subst) != 0)
         {
-            // Hope this is somewhat efficient...
-            String from(c);
-            String to((int)c, DEC);
-            to = "&#" + to + ";";
-            in.replace(from, to);  // in.length() will become larger; no problem
-            i += 5;  // We can skip the just added characters
+            int len = strlen_P(subst);
+            if (at + len >= n) return -1;
+            memcpy_P(out + at, subst, len);
+            at += len;
+        }
+        else
+        {
+            if (at + 1 >= n) return -1;
+            out[at++] = *c;
         } // if
     } // for
-} // ToHtml
+
+    if (at >= n) return -1;
+    out[at] = 0;
+    return at;
+} // VanTextToHtml
 
 // Pretty-print a JSON formatted string, adding indentation
 void PrintJsonText(const char* jsonBuffer)
@@ -264,7 +378,7 @@ void PrintJsonText(const char* jsonBuffer)
         if (subString[0] == '}' || subString[0] == ']') indent -= PRETTY_PRINT_JSON_INDENT;
 
         size_t n = strcspn(subString, "\n");
-        if (n != strlen(subString)) Serial.printf("%*s%.*s\n", indent, "", n, subString);
+        if (n != strlen(subString)) AsyncLog.printf("%*s%.*s\n", indent, "", n, subString);
         j = j + n + 1;
 
         if (subString[0] == '{' || subString[0] == '[') indent += PRETTY_PRINT_JSON_INDENT;
@@ -623,6 +737,28 @@ PGM_P SatNavGuidancePreferenceStr(uint8_t data)
 //
 void GuidanceInstructionIconJson(const char* iconName, const uint8_t data[8], char* buf, int& at, const int n)
 {
+    if (guidanceIconsOnClient)
+    {
+        // Compact format: bit patterns of bytes 2, 3 and 4, 5 and the turn angle of byte 0, as-is
+        const static char jsonFormatter[] PROGMEM =
+            ",\n"
+            "\"%s_legs\": %u,\n"
+            "\"%s_no_entry\": %u,\n"
+            "\"%s_turn\": %u";
+
+        at += at >= n ? 0 :
+            snprintf_P(buf + at, n - at, jsonFormatter,
+                iconName,
+                (uint16_t)data[2] << 8 | data[3],
+                iconName,
+                (uint16_t)data[4] << 8 | data[5],
+                iconName,
+                data[0]
+            );
+
+        return;
+    } // if
+
     // Show all the legs in the junction
 
     // Use "namespace" notation
@@ -696,7 +832,7 @@ enum Fuel_t
 char vinNumber[VIN_NUMBER_LENGTH + 1] = {0};
 int fuelType = FUEL_PETROL;
 
-VanPacketParseResult_t ParseVinPkt(TVanPacketRxDesc& pkt, char* buf, const int n)
+VanPacketParseResult_t ParseVinPkt(VanPacket_t& pkt, char* buf, const int n)
 {
     // http://graham.auld.me.uk/projects/vanbus/packets.html#E24
     // http://pinterpeti.hu/psavanbus/PSA-VAN.html#E24
@@ -764,7 +900,7 @@ bool SkipEnginePktDupDetect = false;
 int contactKeyPosition = CKP_UNKNOWN;
 bool economyMode = false;
 
-VanPacketParseResult_t ParseEnginePkt(TVanPacketRxDesc& pkt, char* buf, const int n)
+VanPacketParseResult_t ParseEnginePkt(VanPacket_t& pkt, char* buf, const int n)
 {
     // http://graham.auld.me.uk/projects/vanbus/packets.html#8A4
     // http://pinterpeti.hu/psavanbus/PSA-VAN.html#8A4
@@ -824,8 +960,6 @@ VanPacketParseResult_t ParseEnginePkt(TVanPacketRxDesc& pkt, char* buf, const in
     economyMode = statusBits & 0x10;
     bool isCoolantTempValid = coolantTempRaw != 0xFF;
     int16_t coolantTemp = (uint16_t)coolantTempRaw - 38;
-    float odometer = odometerRaw / 10.0;
-    float exteriorTemp = exteriorTempRaw / 2.0 - 40;
 
     const static char jsonFormatter[] PROGMEM =
     "{\n"
@@ -839,19 +973,13 @@ VanPacketParseResult_t ParseEnginePkt(TVanPacketRxDesc& pkt, char* buf, const in
             "\"economy_mode\": \"%s\",\n"
             "\"in_reverse\": \"%s\",\n"
             "\"trailer\": \"%s\",\n"
-            "\"coolant_temp\": \"%s\",\n"
             "\"coolant_temp_perc\":\n"
             "{\n"
                 "\"style\":\n"
                 "{\n"
                     "\"transform\": \"scaleX(%s)\"\n"
                 "}\n"
-            "},\n"
-            "\"odometer_1\": \"%s\",\n"
-            "\"exterior_temp\": \"%s\",\n"  // Machine format, e.g. "3.0"
-            "\"exterior_temp_loc\": \"%s\"\n"  // Localized, e.g. "3,5" or "3.5", depending on language
-        "}\n"
-    "}\n";
+            "}";
 
     char floatBuf[4][MAX_FLOAT_SIZE];
     int at = snprintf_P(buf, n, jsonFormatter,
@@ -866,29 +994,64 @@ VanPacketParseResult_t ParseEnginePkt(TVanPacketRxDesc& pkt, char* buf, const in
         statusBits & 0x20 ? yesStr : noStr,
         statusBits & 0x40 ? presentStr : notPresentStr,
 
-        ! isCoolantTempValid ? notApplicable3Str :
-            mfdTemperatureUnit == MFD_TEMPERATURE_UNIT_CELSIUS ?
-                String(coolantTemp).c_str() :
-                String(ToFahrenheit(coolantTemp)).c_str(),
-
         // TODO - hard coded value 130 degrees Celsius for 100%
         #define MAX_COOLANT_TEMP (130)
         ! isCoolantTempValid || coolantTemp <= 0 ? PSTR("0") :
             coolantTemp >= MAX_COOLANT_TEMP ? PSTR("1") :
-                ToFloatStr(floatBuf[0], (float)coolantTemp / MAX_COOLANT_TEMP, 2, false),
+                ToFloatStr(floatBuf[0], (float)coolantTemp / MAX_COOLANT_TEMP, 2, false)
+    );
 
-        mfdDistanceUnit == MFD_DISTANCE_UNIT_METRIC ?
-            ToFloatStr(floatBuf[1], odometer, 1) :
-            ToFloatStr(floatBuf[1], ToMiles(odometer), 1),
+    if (unitsOnClient)
+    {
+        // Unit-neutral values; conversion and formatting is done by the client
+        const static char jsonFormatterRaw[] PROGMEM = ",\n"
+            "\"coolant_temp_c\": %s,\n"
+            "\"odometer_1_km_x10\": %" PRIu32 ",\n"
+            "\"exterior_temp_c_x10\": %d\n"
+        "}\n"
+    "}\n";
+
+        at += at >= n ? 0 :
+            snprintf_P(buf + at, n - at, jsonFormatterRaw,
+                ! isCoolantTempValid ? PSTR("null") : String(coolantTemp).c_str(),
+                odometerRaw,
+                exteriorTempRaw * 5 - 400  // Raw value is in steps of 0.5 degrees Celsius, offset -40
+            );
+    }
+    else
+    {
+        const static char jsonFormatterUnits[] PROGMEM = ",\n"
+            "\"coolant_temp\": \"%s\",\n"
+            "\"odometer_1\": \"%s\",\n"
+            "\"exterior_temp\": \"%s\",\n"  // Machine format, e.g. "3.0"
+            "\"exterior_temp_loc\": \"%s\"\n"  // Localized, e.g. "3,5" or "3.5", depending on language
+        "}\n"
+    "}\n";
 
-        mfdTemperatureUnit == MFD_TEMPERATURE_UNIT_CELSIUS ?
-            ToFloatStr(floatBuf[2], exteriorTemp, 1, false) :
-            ToFloatStr(floatBuf[2], ToFahrenheit(exteriorTemp), 0, false),
+        float odometer = odometerRaw / 10.0;
+        float exteriorTemp = exteriorTempRaw / 2.0 - 40;
 
-        mfdTemperatureUnit == MFD_TEMPERATURE_UNIT_CELSIUS ?
-            ToFloatStr(floatBuf[3], exteriorTemp, 1) :
-            ToFloatStr(floatBuf[3], ToFahrenheit(exteriorTemp), 0)
-    );
+        at += at >= n ? 0 :
+            snprintf_P(buf + at, n - at, jsonFormatterUnits,
+
+                ! isCoolantTempValid ? notApplicable3Str :
+                    mfdTemperatureUnit == MFD_TEMPERATURE_UNIT_CELSIUS ?
+                        String(coolantTemp).c_str() :
+                        String(ToFahrenheit(coolantTemp)).c_str(),
+
+                mfdDistanceUnit == MFD_DISTANCE_UNIT_METRIC ?
+                    ToFloatStr(floatBuf[1], odometer, 1) :
+                    ToFloatStr(floatBuf[1], ToMiles(odometer), 1),
+
+                mfdTemperatureUnit == MFD_TEMPERATURE_UNIT_CELSIUS ?
+                    ToFloatStr(floatBuf[2], exteriorTemp, 1, false) :
+                    ToFloatStr(floatBuf[2], ToFahrenheit(exteriorTemp), 0, false),
+
+                mfdTemperatureUnit == MFD_TEMPERATURE_UNIT_CELSIUS ?
+                    ToFloatStr(floatBuf[3], exteriorTemp, 1) :
+                    ToFloatStr(floatBuf[3], ToFahrenheit(exteriorTemp), 0)
+            );
+    } // if
 
     // TODO? - if contactKeyPosition changed to 0x00 ("OFF"), and satnavStatus2 == 0x05 ("IN_GUIDANCE_MODE"), then
     // store a boolean indicating to ask for continuation of guidance.
@@ -899,7 +1062,7 @@ VanPacketParseResult_t ParseEnginePkt(TVanPacketRxDesc& pkt, char* buf, const in
     return VAN_PACKET_PARSE_OK;
 } // ParseEnginePkt
 
-VanPacketParseResult_t ParseHeadUnitStalkPkt(TVanPacketRxDesc& pkt, char* buf, const int n)
+VanPacketParseResult_t ParseHeadUnitStalkPkt(VanPacket_t& pkt, char* buf, const int n)
 {
     // http://graham.auld.me.uk/projects/vanbus/packets.html#9C4
     // http://pinterpeti.hu/psavanbus/PSA-VAN.html#9C4
@@ -960,7 +1123,7 @@ bool doorOpen = false;
 #define LIGHTS_STRING_LEN 50
 char lightsStr[LIGHTS_STRING_LEN] = "";
 
-VanPacketParseResult_t ParseLightsStatusPkt(TVanPacketRxDesc& pkt, char* buf, const int n)
+VanPacketParseResult_t ParseLightsStatusPkt(VanPacket_t& pkt, char* buf, const int n)
 {
     // http://graham.auld.me.uk/projects/vanbus/packets.html#4FC
     // http://pinterpeti.hu/psavanbus/PSA-VAN.html#4FC_1
@@ -996,8 +1159,6 @@ VanPacketParseResult_t ParseLightsStatusPkt(TVanPacketRxDesc& pkt, char* buf, co
             "\"hazard_lights\": \"%s\",\n"
             "\"diesel_glow_plugs\": \"%s\",\n"
             "\"door_open\": \"%s\",\n"
-            "\"distance_to_service\": \"%" PRId32 "\",\n"
-            "\"distance_to_service_dash\": \"%" PRId32 "\",\n"
             "\"distance_to_service_perc\":\n"
             "{\n"
                 "\"style\":\n"
@@ -1016,16 +1177,6 @@ VanPacketParseResult_t ParseLightsStatusPkt(TVanPacketRxDesc& pkt, char* buf, co
         data[0] & 0x04 ? onStr : offStr,
         doorOpen ? yesStr : noStr,
 
-        mfdDistanceUnit == MFD_DISTANCE_UNIT_METRIC ?
-            remainingKmToService :
-            ToMiles(remainingKmToService),
-
-        // Round downwards (even if negative) to nearest multiple of 100
-        // TODO - not sure if the "miles" type instrument cluster also rounds down like this; I don't have one
-        mfdDistanceUnit == MFD_DISTANCE_UNIT_METRIC ?
-            _floor(remainingKmToService, 100) :
-            _floor(ToMiles(remainingKmToService), 100),
-
         // TODO - hard coded value 20,000 kms for 100%
         #define SERVICE_INTERVAL (20000)
         remainingKmToService <= 0 ? PSTR("0") :
@@ -1037,6 +1188,37 @@ VanPacketParseResult_t ParseLightsStatusPkt(TVanPacketRxDesc& pkt, char* buf, co
         data[5] & 0x04 ? PSTR("INDICATOR_LEFT ") : emptyStr
     );
 
+    if (unitsOnClient)
+    {
+        // Unit-neutral value; conversion and rounding is done by the client
+        at += at >= n ? 0 :
+            snprintf_P(buf + at, n - at,
+                PSTR(",\n\"distance_to_service_km\": %" PRId32),
+                remainingKmToService
+            );
+    }
+    else
+    {
+        at += at >= n ? 0 :
+            snprintf_P(buf + at, n - at,
+                PSTR(
+                    ",\n"
+                    "\"distance_to_service\": \"%" PRId32 "\",\n"
+                    "\"distance_to_service_dash\": \"%" PRId32 "\""
+                ),
+
+                mfdDistanceUnit == MFD_DISTANCE_UNIT_METRIC ?
+                    remainingKmToService :
+                    ToMiles(remainingKmToService),
+
+                // Round downwards (even if negative) to nearest multiple of 100
+                // TODO - not sure if the "miles" type instrument cluster also rounds down like this; I don't have one
+                mfdDistanceUnit == MFD_DISTANCE_UNIT_METRIC ?
+                    _floor(remainingKmToService, 100) :
+                    _floor(ToMiles(remainingKmToService), 100)
+            );
+    } // if
+
     if (data[5] & 0x02)
     {
         at += at >= n ? 0 :
@@ -1152,7 +1334,7 @@ VanPacketParseResult_t ParseLightsStatusPkt(TVanPacketRxDesc& pkt, char* buf, co
     return VAN_PACKET_PARSE_OK;
 } // ParseLightsStatusPkt
 
-VanPacketParseResult_t ParseDeviceReportPkt(TVanPacketRxDesc& pkt, char* buf, const int n)
+VanPacketParseResult_t ParseDeviceReportPkt(VanPacket_t& pkt, char* buf, const int n)
 {
     // http://graham.auld.me.uk/projects/vanbus/packets.html#8C4
     // http://pinterpeti.hu/psavanbus/PSA-VAN.html#8C4
@@ -1443,7 +1625,7 @@ bool isCurrentStreetKnown = false;
 // Set to true to disable (once) duplicate detection. For use when switching to other units.
 bool SkipCarStatus1PktDupDetect = false;
 
-VanPacketParseResult_t ParseCarStatus1Pkt(TVanPacketRxDesc& pkt, char* buf, const int n)
+VanPacketParseResult_t ParseCarStatus1Pkt(VanPacket_t& pkt, char* buf, const int n)
 {
     // http://graham.auld.me.uk/projects/vanbus/packets.html#564
     // http://pinterpeti.hu/psavanbus/PSA-VAN.html#564
@@ -1594,12 +1776,8 @@ VanPacketParseResult_t ParseCarStatus1Pkt(TVanPacketRxDesc& pkt, char* buf, cons
             "\"door_rear_right\": \"%s\",\n"
             "\"door_rear_left\": \"%s\",\n"
             "\"door_boot\": \"%s\",\n"
-            "\"exp_moving_avg_speed\": \"%u\",\n"
             "\"delivered_power\": \"%s\",\n"
-            "\"delivered_torque\": \"%s\",\n"
-            "\"inst_consumption\": \"%s\",\n"
-            "\"distance_to_empty\": \"%s\",\n"
-            "\"avg_speed_1\": \"%u\"";
+            "\"delivered_torque\": \"%s\"";
 
     char floatBuf[3][MAX_FLOAT_SIZE];
     at += at >= n ? 0 :
@@ -1610,59 +1788,107 @@ VanPacketParseResult_t ParseCarStatus1Pkt(TVanPacketRxDesc& pkt, char* buf, cons
             data[7] & 0x10 ? openStr : closedStr,
             data[7] & 0x08 ? openStr : closedStr,
 
-            // When engine running but stopped (actual vehicle speed is 0), this value counts down by 1 every
-            // 10 - 20 seconds or so. When driving, this goes up and down slowly toward the current speed.
-            // Looking at the time stamps when this value changes, this seems to be an exponential moving
-            // average (EMA) of the recent vehicle speed. When the actual speed is 0, the value is seen to decrease
-            // about 12% per minute. If the actual vehicle speed is sampled every second, then, in the
-            // following formula, K would be around 12% / 60 = 0.2% = 0.002 :
-            //
-            //   exp_moving_avg_speed := exp_moving_avg_speed * (1 − K) + actual_vehicle_speed * K
-            //
-            // Often used in EMA is the constant N, where K = 2 / (N + 1). That means N would be around 1000 (given
-            // a sampling time of 1 second).
-            //
-            mfdDistanceUnit == MFD_DISTANCE_UNIT_METRIC ? (uint16_t)data[13] : ToMiles((uint16_t)data[13]),
-
             deliveredPower >= 0.0 ? ToFloatStr(floatBuf[0], deliveredPower, 1) : notApplicableFloatStr,
-            deliveredTorque >= 0.0 ? ToFloatStr(floatBuf[1], deliveredTorque, 1) : notApplicableFloatStr,
+            deliveredTorque >= 0.0 ? ToFloatStr(floatBuf[1], deliveredTorque, 1) : notApplicableFloatStr
+        );
 
-            mfdDistanceUnit == MFD_DISTANCE_UNIT_METRIC ?
-                ! instConsumptionValid ? notApplicableFloatStr :
-                    ToFloatStr(floatBuf[2], (float)instConsumptionLt100_x10 / 10.0, 1) :
-                ! instConsumptionValid ? notApplicable2Str :
-                    instConsumptionLt100_x10 <= 2 ? PSTR("&infin;") :
-                    ToFloatStr(floatBuf[2], ToMilesPerGallon(instConsumptionLt100_x10), 0),
+    // When engine running but stopped (actual vehicle speed is 0), the value in data[13] counts down by 1 every
+    // 10 - 20 seconds or so. When driving, this goes up and down slowly toward the current speed.
+    // Looking at the time stamps when this value changes, this seems to be an exponential moving
+    // average (EMA) of the recent vehicle speed. When the actual speed is 0, the value is seen to decrease
+    // about 12% per minute. If the actual vehicle speed is sampled every second, then, in the
+    // following formula, K would be around 12% / 60 = 0.2% = 0.002 :
+    //
+    //   exp_moving_avg_speed := exp_moving_avg_speed * (1 − K) + actual_vehicle_speed * K
+    //
+    // Often used in EMA is the constant N, where K = 2 / (N + 1). That means N would be around 1000 (given
+    // a sampling time of 1 second).
 
-            distanceToEmpty == 0xFFFF ? notApplicable2Str :
-                mfdDistanceUnit == MFD_DISTANCE_UNIT_METRIC ?
-                    String(distanceToEmpty).c_str() :
-                    String(ToMiles(distanceToEmpty)).c_str(),
+    if (unitsOnClient)
+    {
+        // Unit-neutral values; conversion and formatting is done by the client. Value 0xFFFF (invalid) is
+        // reported as null.
+        const static char jsonFormatterRaw[] PROGMEM =
+            ",\n"
+            "\"exp_moving_avg_speed_kmh\": %u,\n"
+            "\"inst_consumption_lt100_x10\": %s,\n"
+            "\"distance_to_empty_km\": %s,\n"
+            "\"avg_speed_1_kmh\": %u,\n"
+            "\"distance_1_km\": %s,\n"
+            "\"avg_consumption_1_lt100_x10\": %s,\n"
+            "\"avg_speed_2_kmh\": %u,\n"
+            "\"distance_2_km\": %s,\n"
+            "\"avg_consumption_2_lt100_x10\": %s\n"
+        "}\n"
+    "}\n";
 
-            mfdDistanceUnit == MFD_DISTANCE_UNIT_METRIC ? avgSpeedTrip1 : ToMiles(avgSpeedTrip1)
-        );
+        #define RAW_UINT16_OR_NULL(v) ((v) == 0xFFFF ? PSTR("null") : String(v).c_str())
 
-    const static char jsonFormatter3[] PROGMEM =
+        at += at >= n ? 0 :
+            snprintf_P(buf + at, n - at, jsonFormatterRaw,
+                data[13],
+                RAW_UINT16_OR_NULL(instConsumptionLt100_x10),
+                RAW_UINT16_OR_NULL(distanceToEmpty),
+                avgSpeedTrip1,
+                RAW_UINT16_OR_NULL(distanceTrip1),
+                RAW_UINT16_OR_NULL(avgConsumptionLt100Trip1_x10),
+                avgSpeedTrip2,
+                RAW_UINT16_OR_NULL(distanceTrip2),
+                RAW_UINT16_OR_NULL(avgConsumptionLt100Trip2_x10)
+            );
+
+        #undef RAW_UINT16_OR_NULL
+    }
+    else
+    {
+        const static char jsonFormatterUnits1[] PROGMEM =
+            ",\n"
+            "\"exp_moving_avg_speed\": \"%u\",\n"
+            "\"inst_consumption\": \"%s\",\n"
+            "\"distance_to_empty\": \"%s\",\n"
+            "\"avg_speed_1\": \"%u\"";
+
+        at += at >= n ? 0 :
+            snprintf_P(buf + at, n - at, jsonFormatterUnits1,
+
+                mfdDistanceUnit == MFD_DISTANCE_UNIT_METRIC ? (uint16_t)data[13] : ToMiles((uint16_t)data[13]),
+
+                mfdDistanceUnit == MFD_DISTANCE_UNIT_METRIC ?
+                    ! instConsumptionValid ? notApplicableFloatStr :
+                        ToFloatStr(floatBuf[2], (float)instConsumptionLt100_x10 / 10.0, 1) :
+                    ! instConsumptionValid ? notApplicable2Str :
+                        instConsumptionLt100_x10 <= 2 ? PSTR("&infin;") :
+                        ToFloatStr(floatBuf[2], ToMilesPerGallon(instConsumptionLt100_x10), 0),
+
+                distanceToEmpty == 0xFFFF ? notApplicable2Str :
+                    mfdDistanceUnit == MFD_DISTANCE_UNIT_METRIC ?
+                        String(distanceToEmpty).c_str() :
+                        String(ToMiles(distanceToEmpty)).c_str(),
+
+                mfdDistanceUnit == MFD_DISTANCE_UNIT_METRIC ? avgSpeedTrip1 : ToMiles(avgSpeedTrip1)
+            );
+
+        const static char jsonFormatterUnits2[] PROGMEM =
             ",\n"
             "\"distance_1\": \"%s\",\n"
             "\"avg_consumption_1\": \"%s\"";
 
-    at += at >= n ? 0 :
-        snprintf_P(buf + at, n - at, jsonFormatter3,
-            distanceTrip1 == 0xFFFF ? notApplicable2Str :
+        at += at >= n ? 0 :
+            snprintf_P(buf + at, n - at, jsonFormatterUnits2,
+                distanceTrip1 == 0xFFFF ? notApplicable2Str :
+                    mfdDistanceUnit == MFD_DISTANCE_UNIT_METRIC ?
+                        String(distanceTrip1).c_str() :
+                        String(ToMiles(distanceTrip1)).c_str(),
+
                 mfdDistanceUnit == MFD_DISTANCE_UNIT_METRIC ?
-                    String(distanceTrip1).c_str() :
-                    String(ToMiles(distanceTrip1)).c_str(),
-
-            mfdDistanceUnit == MFD_DISTANCE_UNIT_METRIC ?
-                avgConsumptionLt100Trip1_x10 == 0xFFFF ? notApplicableFloatStr :
-                    ToFloatStr(floatBuf[0], (float)avgConsumptionLt100Trip1_x10 / 10.0, 1) :
-                avgConsumptionLt100Trip1_x10 == 0xFFFF ? notApplicable2Str :
-                    avgConsumptionLt100Trip1_x10 <= 1 ? PSTR("&infin;") :
-                    ToFloatStr(floatBuf[0], ToMilesPerGallon(avgConsumptionLt100Trip1_x10), 0)
-        );
+                    avgConsumptionLt100Trip1_x10 == 0xFFFF ? notApplicableFloatStr :
+                        ToFloatStr(floatBuf[0], (float)avgConsumptionLt100Trip1_x10 / 10.0, 1) :
+                    avgConsumptionLt100Trip1_x10 == 0xFFFF ? notApplicable2Str :
+                        avgConsumptionLt100Trip1_x10 <= 1 ? PSTR("&infin;") :
+                        ToFloatStr(floatBuf[0], ToMilesPerGallon(avgConsumptionLt100Trip1_x10), 0)
+            );
 
-    const static char jsonFormatter4[] PROGMEM =
+        const static char jsonFormatterUnits3[] PROGMEM =
             ",\n"
             "\"avg_speed_2\": \"%u\",\n"
             "\"distance_2\": \"%s\",\n"
@@ -1670,23 +1896,24 @@ VanPacketParseResult_t ParseCarStatus1Pkt(TVanPacketRxDesc& pkt, char* buf, cons
         "}\n"
     "}\n";
 
-    at += at >= n ? 0 :
-        snprintf_P(buf + at, n - at, jsonFormatter4,
+        at += at >= n ? 0 :
+            snprintf_P(buf + at, n - at, jsonFormatterUnits3,
 
-            mfdDistanceUnit == MFD_DISTANCE_UNIT_METRIC ? avgSpeedTrip2 : ToMiles(avgSpeedTrip2),
+                mfdDistanceUnit == MFD_DISTANCE_UNIT_METRIC ? avgSpeedTrip2 : ToMiles(avgSpeedTrip2),
+
+                distanceTrip2 == 0xFFFF ? notApplicable2Str :
+                    mfdDistanceUnit == MFD_DISTANCE_UNIT_METRIC ?
+                        String(distanceTrip2).c_str() :
+                        String(ToMiles(distanceTrip2)).c_str(),
 
-            distanceTrip2 == 0xFFFF ? notApplicable2Str :
                 mfdDistanceUnit == MFD_DISTANCE_UNIT_METRIC ?
-                    String(distanceTrip2).c_str() :
-                    String(ToMiles(distanceTrip2)).c_str(),
-
-            mfdDistanceUnit == MFD_DISTANCE_UNIT_METRIC ?
-                avgConsumptionLt100Trip2_x10 == 0xFFFF ? notApplicableFloatStr :
-                    ToFloatStr(floatBuf[0], (float)avgConsumptionLt100Trip2_x10 / 10.0, 1) :
-                avgConsumptionLt100Trip2_x10 == 0xFFFF ? notApplicable2Str :
-                    avgConsumptionLt100Trip2_x10 <= 1 ? PSTR("&infin;") :
-                    ToFloatStr(floatBuf[0], ToMilesPerGallon(avgConsumptionLt100Trip2_x10), 0)
-        );
+                    avgConsumptionLt100Trip2_x10 == 0xFFFF ? notApplicableFloatStr :
+                        ToFloatStr(floatBuf[0], (float)avgConsumptionLt100Trip2_x10 / 10.0, 1) :
+                    avgConsumptionLt100Trip2_x10 == 0xFFFF ? notApplicable2Str :
+                        avgConsumptionLt100Trip2_x10 <= 1 ? PSTR("&infin;") :
+                        ToFloatStr(floatBuf[0], ToMilesPerGallon(avgConsumptionLt100Trip2_x10), 0)
+            );
+    } // if
 
     // JSON buffer overflow?
     if (at >= n) return VAN_PACKET_PARSE_JSON_TOO_LONG;
@@ -1694,7 +1921,58 @@ VanPacketParseResult_t ParseCarStatus1Pkt(TVanPacketRxDesc& pkt, char* buf, cons
     return VAN_PACKET_PARSE_OK;
 } // ParseCarStatus1Pkt
 
-VanPacketParseResult_t ParseCarStatus2Pkt(TVanPacketRxDesc& pkt, char* buf, const int n)
+// Report the alarms and the notification popup as indices into the notification tables (msgTable_...), which
+// are shipped to the client as part of the "/VanStrings.js" asset
+VanPacketParseResult_t CarStatus2CodesToJson(const uint8_t* data, int dataLen, char* buf, const int n)
+{
+    const static char jsonFormatter[] PROGMEM =
+    "{\n"
+        "\"event\": \"display\",\n"
+        "\"data\":\n"
+        "{\n"
+            "\"alarm_codes\": [";
+
+    int at = snprintf_P(buf, n, jsonFormatter);
+
+    bool first = true;
+    for (int byte = 0; byte < dataLen; byte++)
+    {
+        // Skip byte 9; it is the index of the current message
+        if (byte == 9) byte++;
+
+        for (int bit = 0; bit < 8; bit++)
+        {
+            if (data[byte] >> bit & 0x01)
+            {
+                at += at >= n ? 0 :
+                    snprintf_P(buf + at, n - at, PSTR("%s%d"), first ? emptyStr : PSTR(", "), byte * 8 + bit);
+                first = false;
+            } // if
+        } // for
+    } // for
+
+    uint8_t currentMsg = data[9];
+
+    at += at >= n ? 0 :
+        snprintf_P(buf + at, n - at,
+            PSTR(
+                    "],\n"
+                    "\"notification_code\": %s,\n"
+                    "\"doors_locked\": \"%s\"\n"
+                "}\n"
+            "}\n"
+            ),
+            currentMsg <= 0x7F ? String(currentMsg).c_str() : PSTR("null"),
+            data[8] & 0x01 ? yesStr : noStr
+        );
+
+    // JSON buffer overflow?
+    if (at >= n) return VAN_PACKET_PARSE_JSON_TOO_LONG;
+
+    return VAN_PACKET_PARSE_OK;
+} // CarStatus2CodesToJson
+
+VanPacketParseResult_t ParseCarStatus2Pkt(VanPacket_t& pkt, char* buf, const int n)
 {
     // http://graham.auld.me.uk/projects/vanbus/packets.html#524
     // http://pinterpeti.hu/psavanbus/PSA-VAN.html#524
@@ -1712,10 +1990,12 @@ VanPacketParseResult_t ParseCarStatus2Pkt(TVanPacketRxDesc& pkt, char* buf, cons
             "\"alarm_list\":\n"
             "[";
 
-    int at = snprintf_P(buf, n, jsonFormatter);
-
     const uint8_t* data = pkt.Data();
 
+    if (codesOnClient) return CarStatus2CodesToJson(data, dataLen, buf, n);
+
+    int at = snprintf_P(buf, n, jsonFormatter);
+
     // Select the correct table, based on the chosen MFD language
     const char* const* msgTable =
         mfdLanguage == MFD_LANGUAGE_FRENCH ? msgTable_fr :
@@ -1736,7 +2016,7 @@ VanPacketParseResult_t ParseCarStatus2Pkt(TVanPacketRxDesc& pkt, char* buf, cons
             if (data[byte] >> bit & 0x01)
             {
                 char alarmText[80];  // Make sure this is large enough for the largest string it must hold; see above
-                strncpy_P(alarmText, (char *)pgm_read_dword(&(msgTable[byte * 8 + bit])), sizeof(alarmText) - 1);
+                strncpy_P(alarmText, (PGM_P)pgm_read_ptr(&(msgTable[byte * 8 + bit])), sizeof(alarmText) - 1);
                 alarmText[sizeof(alarmText) - 1] = 0;
 
                 // TODO - with lots of alarms set, this packet could become very large and overflow the JSON buffer
@@ -1785,7 +2065,7 @@ VanPacketParseResult_t ParseCarStatus2Pkt(TVanPacketRxDesc& pkt, char* buf, cons
     return VAN_PACKET_PARSE_OK;
 } // ParseCarStatus2Pkt
 
-VanPacketParseResult_t ParseDashboardPkt(TVanPacketRxDesc& pkt, char* buf, const int n)
+VanPacketParseResult_t ParseDashboardPkt(VanPacket_t& pkt, char* buf, const int n)
 {
     // http://graham.auld.me.uk/projects/vanbus/packets.html#824
     // http://pinterpeti.hu/psavanbus/PSA-VAN.html#824
@@ -1831,17 +2111,39 @@ VanPacketParseResult_t ParseDashboardPkt(TVanPacketRxDesc& pkt, char* buf, const
         "}\n"
     "}\n";
 
+    // Unit-neutral variant; conversion and formatting of the vehicle speed is done by the client
+    const static char jsonFormatterRaw[] PROGMEM =
+    "{\n"
+        "\"event\": \"display\",\n"
+        "\"data\":\n"
+        "{\n"
+            "\"engine_rpm\": \"%s\",\n"
+            "\"vehicle_speed_kmh_x100\": %s\n"
+        "}\n"
+    "}\n";
+
     char floatBuf[2][MAX_FLOAT_SIZE];
-    int at = snprintf_P(buf, n, jsonFormatter,
-        ! IsEngineRpmValid() ?
-            notApplicable3Str :
-            ToFloatStr(floatBuf[0], engineRpm_x8 / 8.0, 0),
-        ! IsVehicleSpeedValid() ?
-            notApplicable2Str :
-            mfdDistanceUnit == MFD_DISTANCE_UNIT_METRIC ?
-                ToFloatStr(floatBuf[1], vehicleSpeed, 0) :
-                ToFloatStr(floatBuf[1], ToMiles(vehicleSpeed), 0)
-    );
+    int at = unitsOnClient ?
+
+        snprintf_P(buf, n, jsonFormatterRaw,
+            ! IsEngineRpmValid() ?
+                notApplicable3Str :
+                ToFloatStr(floatBuf[0], engineRpm_x8 / 8.0, 0),
+            ! IsVehicleSpeedValid() ?
+                PSTR("null") :
+                String(vehicleSpeed_x100).c_str()
+        ) :
+
+        snprintf_P(buf, n, jsonFormatter,
+            ! IsEngineRpmValid() ?
+                notApplicable3Str :
+                ToFloatStr(floatBuf[0], engineRpm_x8 / 8.0, 0),
+            ! IsVehicleSpeedValid() ?
+                notApplicable2Str :
+                mfdDistanceUnit == MFD_DISTANCE_UNIT_METRIC ?
+                    ToFloatStr(floatBuf[1], vehicleSpeed, 0) :
+                    ToFloatStr(floatBuf[1], ToMiles(vehicleSpeed), 0)
+        );
 
     // JSON buffer overflow?
     if (at >= n) return VAN_PACKET_PARSE_JSON_TOO_LONG;
@@ -1849,7 +2151,7 @@ VanPacketParseResult_t ParseDashboardPkt(TVanPacketRxDesc& pkt, char* buf, const
     return VAN_PACKET_PARSE_OK;
 } // ParseDashboardPkt
 
-VanPacketParseResult_t ParseDashboardButtonsPkt(TVanPacketRxDesc& pkt, char* buf, const int n)
+VanPacketParseResult_t ParseDashboardButtonsPkt(VanPacket_t& pkt, char* buf, const int n)
 {
     // http://graham.auld.me.uk/projects/vanbus/packets.html#664
     // http://pinterpeti.hu/psavanbus/PSA-VAN.html#664
@@ -1894,19 +2196,43 @@ VanPacketParseResult_t ParseDashboardButtonsPkt(TVanPacketRxDesc& pkt, char* buf
                 "}\n"
             "}";
 
-        at += at >= n ? 0 :
-            snprintf_P(buf + at, n - at, jsonFormatterFuel,
+      #define FULL_TANK_LITRES (73.0)
 
-                mfdDistanceUnit == MFD_DISTANCE_UNIT_METRIC ?
-                    ToFloatStr(floatBuf[0], fuelLevelFiltered, 1) :
-                    ToFloatStr(floatBuf[0], ToGallons(fuelLevelFiltered), 1),
+        if (unitsOnClient)
+        {
+            // Unit-neutral value (litres x 10); conversion and formatting is done by the client
+            const static char jsonFormatterFuelRaw[] PROGMEM = ",\n"
+                "\"fuel_level_lt_x10\": %u,\n"
+                "\"fuel_level_perc\":\n"
+                "{\n"
+                    "\"style\":\n"
+                    "{\n"
+                        "\"transform\": \"scaleX(%s)\"\n"
+                    "}\n"
+                "}";
 
-                mfdDistanceUnit == MFD_DISTANCE_UNIT_METRIC ? PSTR("lt") : PSTR("gl"),
+            at += at >= n ? 0 :
+                snprintf_P(buf + at, n - at, jsonFormatterFuelRaw,
+                    data[4] * 5,
+                    fuelLevelFiltered >= FULL_TANK_LITRES ? PSTR("1") :
+                        ToFloatStr(floatBuf[1], fuelLevelFiltered / FULL_TANK_LITRES, 2, false)
+                );
+        }
+        else
+        {
+            at += at >= n ? 0 :
+                snprintf_P(buf + at, n - at, jsonFormatterFuel,
 
-              #define FULL_TANK_LITRES (73.0)
-                fuelLevelFiltered >= FULL_TANK_LITRES ? PSTR("1") :
-                    ToFloatStr(floatBuf[1], fuelLevelFiltered / FULL_TANK_LITRES, 2, false)
-            );
+                    mfdDistanceUnit == MFD_DISTANCE_UNIT_METRIC ?
+                        ToFloatStr(floatBuf[0], fuelLevelFiltered, 1) :
+                        ToFloatStr(floatBuf[0], ToGallons(fuelLevelFiltered), 1),
+
+                    mfdDistanceUnit == MFD_DISTANCE_UNIT_METRIC ? PSTR("lt") : PSTR("gl"),
+
+                    fuelLevelFiltered >= FULL_TANK_LITRES ? PSTR("1") :
+                        ToFloatStr(floatBuf[1], fuelLevelFiltered / FULL_TANK_LITRES, 2, false)
+                );
+        } // if
     } // if
 
     if (data[5] != 0xFF && data[5] != 0x00)
@@ -1914,11 +2240,13 @@ VanPacketParseResult_t ParseDashboardButtonsPkt(TVanPacketRxDesc& pkt, char* buf
         float fuelLevelRaw = data[5] / 2.0;  // Instantaneous value; can vary wildly
 
         at += at >= n ? 0 :
-            snprintf_P(buf + at, n - at, ",\n\"fuel_level_raw\": \"%s\"",
-                mfdDistanceUnit == MFD_DISTANCE_UNIT_METRIC ?
-                    ToFloatStr(floatBuf[2], fuelLevelRaw, 1) :
-                    ToFloatStr(floatBuf[2], ToGallons(fuelLevelRaw), 1)
-            );
+            unitsOnClient ?
+                snprintf_P(buf + at, n - at, PSTR(",\n\"fuel_level_raw_lt_x10\": %u"), data[5] * 5) :
+                snprintf_P(buf + at, n - at, ",\n\"fuel_level_raw\": \"%s\"",
+                    mfdDistanceUnit == MFD_DISTANCE_UNIT_METRIC ?
+                        ToFloatStr(floatBuf[2], fuelLevelRaw, 1) :
+                        ToFloatStr(floatBuf[2], ToGallons(fuelLevelRaw), 1)
+                );
     } // if
 
     at += at >= n ? 0 : snprintf_P(buf + at, n - at, PSTR("\n}\n}\n"));
@@ -1929,7 +2257,7 @@ VanPacketParseResult_t ParseDashboardButtonsPkt(TVanPacketRxDesc& pkt, char* buf
     return VAN_PACKET_PARSE_OK;
 } // ParseDashboardButtonsPkt
 
-VanPacketParseResult_t ParseHeadUnitPkt(TVanPacketRxDesc& pkt, char* buf, const int n)
+VanPacketParseResult_t ParseHeadUnitPkt(VanPacket_t& pkt, char* buf, const int n)
 {
     // http://graham.auld.me.uk/projects/vanbus/packets.html#554
 
@@ -2131,20 +2459,16 @@ VanPacketParseResult_t ParseHeadUnitPkt(TVanPacketRxDesc& pkt, char* buf, const
                 uint8_t currPty = data[11] & 0x1F;
 
                 // data[12]...data[20]: RDS text
-                char rdsTxt[9];
-                strncpy(rdsTxt, (const char*) data + 12, 8);
-                rdsTxt[8] = 0;
+                char rdsRaw[9];
+                strncpy(rdsRaw, (const char*) data + 12, 8);
+                rdsRaw[8] = 0;
+                char rdsTxt[8 * MAX_HTML_SUBSTITUTION_SIZE + 1];
+                if (VanTextToHtml(rdsRaw, rdsTxt, sizeof(rdsTxt)) < 0) rdsTxt[0] = 0;
 
                 const static char jsonFormatterFmBand[] PROGMEM = ",\n"
                     "\"pty_selection_menu\": \"%s\",\n"
-                    "\"selected_pty_8\": \"%s\",\n"
-                    "\"selected_pty_16\": \"%s\",\n"
-                    "\"selected_pty_full\": \"%s\",\n"
                     "\"pty_standby_mode\": \"%s\",\n"
                     "\"pty_match\": \"%s\",\n"
-                    "\"pty_8\": \"%s\",\n"
-                    "\"pty_16\": \"%s\",\n"
-                    "\"pty_full\": \"%s\",\n"
                     "\"pi_country\": \"%s\",\n"
                     "\"pi_area_coverage\": \"%s\",\n"
                     "\"regional\": \"%s\",\n"
@@ -2158,16 +2482,8 @@ VanPacketParseResult_t ParseHeadUnitPkt(TVanPacketRxDesc& pkt, char* buf, const
                 at += at >= n ? 0 :
                     snprintf_P(buf + at, n - at, jsonFormatterFmBand,
                         ptySelectionMenu ? onStr : offStr,
-
-                        selectedPty == 0x00 ? notApplicable3Str : PtyStr8(selectedPty),
-                        selectedPty == 0x00 ? notApplicable3Str : PtyStr16(selectedPty),
-                        selectedPty == 0x00 ? notApplicable3Str : PtyStrFull(selectedPty),
-
                         ptyStandbyMode ? yesStr : noStr,
                         ptyMatch ? yesStr : noStr,
-                        currPty == 0x00 ? notApplicable3Str : PtyStr8(currPty),
-                        currPty == 0x00 ? notApplicable3Str : PtyStr16(currPty),
-                        currPty == 0x00 ? notApplicable3Str : PtyStrFull(currPty),
 
                         piCode == 0xFFFF ? notApplicable2Str : RadioPiCountry(countryCode),
                         piCode == 0xFFFF ? notApplicable3Str : RadioPiAreaCoverage(coverageCode),
@@ -2181,6 +2497,42 @@ VanPacketParseResult_t ParseHeadUnitPkt(TVanPacketRxDesc& pkt, char* buf, const
 
                         taAnnounce ? yesStr : noStr
                     );
+
+                if (codesOnClient)
+                {
+                    // PTY code 0 means: none
+                    at += at >= n ? 0 :
+                        snprintf_P(buf + at, n - at,
+                            PSTR(
+                                ",\n"
+                                "\"selected_pty\": %u,\n"
+                                "\"pty\": %u"
+                            ),
+                            selectedPty,
+                            currPty
+                        );
+                }
+                else
+                {
+                    const static char jsonFormatterPty[] PROGMEM = ",\n"
+                        "\"selected_pty_8\": \"%s\",\n"
+                        "\"selected_pty_16\": \"%s\",\n"
+                        "\"selected_pty_full\": \"%s\",\n"
+                        "\"pty_8\": \"%s\",\n"
+                        "\"pty_16\": \"%s\",\n"
+                        "\"pty_full\": \"%s\"";
+
+                    at += at >= n ? 0 :
+                        snprintf_P(buf + at, n - at, jsonFormatterPty,
+                            selectedPty == 0x00 ? notApplicable3Str : PtyStr8(selectedPty),
+                            selectedPty == 0x00 ? notApplicable3Str : PtyStr16(selectedPty),
+                            selectedPty == 0x00 ? notApplicable3Str : PtyStrFull(selectedPty),
+
+                            currPty == 0x00 ? notApplicable3Str : PtyStr8(currPty),
+                            currPty == 0x00 ? notApplicable3Str : PtyStr16(currPty),
+                            currPty == 0x00 ? notApplicable3Str : PtyStrFull(currPty)
+                        );
+                } // if
             } // if
 
             at += at >= n ? 0 : snprintf_P(buf + at, n - at, PSTR("\n}\n}\n"));
@@ -2245,9 +2597,11 @@ VanPacketParseResult_t ParseHeadUnitPkt(TVanPacketRxDesc& pkt, char* buf, const
             uint8_t tunerBand = data[2] >> 4 & 0x07;
             uint8_t tunerMemory = data[2] & 0x0F;
 
-            char rdsOrFreqTxt[9];
-            strncpy(rdsOrFreqTxt, (const char*) data + 3, 8);
-            rdsOrFreqTxt[8] = 0;
+            char rdsOrFreqRaw[9];
+            strncpy(rdsOrFreqRaw, (const char*) data + 3, 8);
+            rdsOrFreqRaw[8] = 0;
+            char rdsOrFreqTxt[8 * MAX_HTML_SUBSTITUTION_SIZE + 1];
+            if (VanTextToHtml(rdsOrFreqRaw, rdsOrFreqTxt, sizeof(rdsOrFreqTxt)) < 0) rdsOrFreqTxt[0] = 0;
 
             const static char jsonFormatter[] PROGMEM =
             "{\n"
@@ -2360,7 +2714,7 @@ VanPacketParseResult_t ParseHeadUnitPkt(TVanPacketRxDesc& pkt, char* buf, const
     return VAN_PACKET_PARSE_OK;
 } // ParseHeadUnitPkt
 
-VanPacketParseResult_t ParseMfdLanguageUnitsPkt(TVanPacketRxDesc& pkt, char* buf, const int n)
+VanPacketParseResult_t ParseMfdLanguageUnitsPkt(VanPacket_t& pkt, char* buf, const int n)
 {
     // http://graham.auld.me.uk/projects/vanbus/packets.html#984
     // http://pinterpeti.hu/psavanbus/PSA-VAN.html#984
@@ -2417,7 +2771,10 @@ VanPacketParseResult_t ParseMfdLanguageUnitsPkt(TVanPacketRxDesc& pkt, char* buf
 
     mfdTimeUnit = data[4] & 0x08 ? MFD_TIME_UNIT_12H : MFD_TIME_UNIT_24H;
 
-    if (mfdTemperatureUnit != prevMfdTemperatureUnit || mfdDistanceUnit != prevMfdDistanceUnit) ResetPacketPrevData();
+    if (mfdTemperatureUnit != prevMfdTemperatureUnit || mfdDistanceUnit != prevMfdDistanceUnit)
+    {
+        ResetUnitDependentPacketPrevData();
+    } // if
 
     // JSON buffer overflow?
     if (at >= n) return VAN_PACKET_PARSE_JSON_TOO_LONG;
@@ -2429,7 +2786,7 @@ bool isHeadUnitPowerOn = false;
 bool seenTapePresence = false;
 bool seenCdPresence = false;
 
-VanPacketParseResult_t ParseAudioSettingsPkt(TVanPacketRxDesc& pkt, char* buf, const int n)
+VanPacketParseResult_t ParseAudioSettingsPkt(VanPacket_t& pkt, char* buf, const int n)
 {
     // http://graham.auld.me.uk/projects/vanbus/packets.html#4D4
     // http://pinterpeti.hu/psavanbus/PSA-VAN.html#4D4
@@ -2557,7 +2914,7 @@ VanPacketParseResult_t ParseAudioSettingsPkt(TVanPacketRxDesc& pkt, char* buf, c
 // Saved equipment status (volatile)
 int16_t satnavServiceListSize = -1;
 
-VanPacketParseResult_t ParseMfdStatusPkt(TVanPacketRxDesc& pkt, char* buf, const int n)
+VanPacketParseResult_t ParseMfdStatusPkt(VanPacket_t& pkt, char* buf, const int n)
 {
     // http://graham.auld.me.uk/projects/vanbus/packets.html#5E4
     // http://pinterpeti.hu/psavanbus/PSA-VAN.html#5E4
@@ -2635,11 +2992,6 @@ VanPacketParseResult_t ParseMfdStatusPkt(TVanPacketRxDesc& pkt, char* buf, const
     {
         mfdWasOff = true;
 
-        // The moment the MFD switches off seems to be the best time to check if the store must be saved; better than
-        // when the MFD is active and VAN packets are being received. VAN bus and ESP8266 flash system (SPI based)
-        // don't work well together.
-        CommitEeprom();
-
         at += at >= n ? 0 :
             snprintf_P(buf + at, n - at,
                 PSTR(
@@ -2666,7 +3018,7 @@ VanPacketParseResult_t ParseMfdStatusPkt(TVanPacketRxDesc& pkt, char* buf, const
 #define SET_FAN_SPEED_INVALID (0xFF)
 uint8_t setFanSpeed = SET_FAN_SPEED_INVALID;
 
-VanPacketParseResult_t ParseAirCon1Pkt(TVanPacketRxDesc& pkt, char* buf, const int n)
+VanPacketParseResult_t ParseAirCon1Pkt(VanPacket_t& pkt, char* buf, const int n)
 {
     // http://graham.auld.me.uk/projects/vanbus/packets.html#464
     // http://pinterpeti.hu/psavanbus/PSA-VAN.html#464
@@ -2792,7 +3144,7 @@ uint8_t condenserPressure = CONDENSER_PRESSURE_INVALID;
 #define EVAPORATOR_TEMP_INVALID (0xFFFF)
 uint16_t evaporatorTemp = EVAPORATOR_TEMP_INVALID;
 
-VanPacketParseResult_t ParseAirCon2Pkt(TVanPacketRxDesc& pkt, char* buf, const int n)
+VanPacketParseResult_t ParseAirCon2Pkt(VanPacket_t& pkt, char* buf, const int n)
 {
     // http://graham.auld.me.uk/projects/vanbus/packets.html#4DC
     // http://pinterpeti.hu/psavanbus/PSA-VAN.html#4DC
@@ -2902,7 +3254,7 @@ VanPacketParseResult_t ParseAirCon2Pkt(TVanPacketRxDesc& pkt, char* buf, const i
 // Saved equipment status (volatile)
 bool cdChangerCartridgePresent = false;
 
-VanPacketParseResult_t ParseCdChangerPkt(TVanPacketRxDesc& pkt, char* buf, const int n)
+VanPacketParseResult_t ParseCdChangerPkt(VanPacket_t& pkt, char* buf, const int n)
 {
     // http://graham.auld.me.uk/projects/vanbus/packets.html#4EC
     // http://pinterpeti.hu/psavanbus/PSA-VAN.html#4EC
@@ -3030,7 +3382,7 @@ VanPacketParseResult_t ParseCdChangerPkt(TVanPacketRxDesc& pkt, char* buf, const
 
 String satnavCurrentStreet = "";
 
-VanPacketParseResult_t ParseSatNavStatus1Pkt(TVanPacketRxDesc& pkt, char* buf, const int n)
+VanPacketParseResult_t ParseSatNavStatus1Pkt(VanPacket_t& pkt, char* buf, const int n)
 {
     // http://graham.auld.me.uk/projects/vanbus/packets.html#54E
     // http://pinterpeti.hu/psavanbus/PSA-VAN.html#54E
@@ -3145,7 +3497,7 @@ bool satnavInitialized = false;
 bool reachedDestination = false;
 uint32_t satnavDownloadProgress = 0;
 
-VanPacketParseResult_t ParseSatNavStatus2Pkt(TVanPacketRxDesc& pkt, char* buf, const int n)
+VanPacketParseResult_t ParseSatNavStatus2Pkt(VanPacket_t& pkt, char* buf, const int n)
 {
     // http://graham.auld.me.uk/projects/vanbus/packets.html#7CE
     // http://pinterpeti.hu/psavanbus/PSA-VAN.html#7CE
@@ -3373,33 +3725,33 @@ VanPacketParseResult_t ParseSatNavStatus2Pkt(TVanPacketRxDesc& pkt, char* buf, c
     return VAN_PACKET_PARSE_OK;
 } // ParseSatNavStatus2Pkt
 
-// Value stored in (emulated) EEPROM
+// Value stored in the settings (see Settings.ino)
 uint8_t satnavGuidancePreference = SGP_INVALID;
-#define SATNAV_GUIDANCE_PREFERENCE_EEPROM_POS (2)
+#define SATNAV_GUIDANCE_PREFERENCE_SETTING_KEY (2)
 
 // Initialize satnavGuidancePreference, if necessary
 void InitSatnavGuidancePreference()
 {
     if (IsValidSatNavGuidancePreferenceValue(satnavGuidancePreference)) return;
 
-    satnavGuidancePreference = EEPROM.read(SATNAV_GUIDANCE_PREFERENCE_EEPROM_POS);
+    satnavGuidancePreference = ReadSetting(SATNAV_GUIDANCE_PREFERENCE_SETTING_KEY);
 
     // TODO - remove
-    Serial.printf_P(
-        PSTR("satnavGuidancePreference: read value %u (%s) from EEPROM position %d\n"),
+    AsyncLog.printf_P(
+        PSTR("satnavGuidancePreference: read value %u (%s) from setting %d\n"),
         satnavGuidancePreference,
         SatNavGuidancePreferenceStr(satnavGuidancePreference),
-        SATNAV_GUIDANCE_PREFERENCE_EEPROM_POS);
+        SATNAV_GUIDANCE_PREFERENCE_SETTING_KEY);
 
     if (IsValidSatNavGuidancePreferenceValue(satnavGuidancePreference)) return;
 
     // When the original MFD is plugged in, this is what it starts with
     satnavGuidancePreference = SGP_FASTEST_ROUTE;
 
-    WriteEeprom(SATNAV_GUIDANCE_PREFERENCE_EEPROM_POS, satnavGuidancePreference, PSTR("Sat nav guidance preference"));
+    WriteSetting(SATNAV_GUIDANCE_PREFERENCE_SETTING_KEY, satnavGuidancePreference, PSTR("Sat nav guidance preference"));
 } // InitSatnavGuidancePreference
 
-VanPacketParseResult_t ParseSatNavStatus3Pkt(TVanPacketRxDesc& pkt, char* buf, const int n)
+VanPacketParseResult_t ParseSatNavStatus3Pkt(VanPacket_t& pkt, char* buf, const int n)
 {
     // http://graham.auld.me.uk/projects/vanbus/packets.html#8CE
     // http://pinterpeti.hu/psavanbus/PSA-VAN.html#8CE
@@ -3477,7 +3829,10 @@ VanPacketParseResult_t ParseSatNavStatus3Pkt(TVanPacketRxDesc& pkt, char* buf, c
 
         at = snprintf_P(buf, n, jsonFormatter, SatNavGuidancePreferenceStr(satnavGuidancePreference));
 
-        WriteEeprom(SATNAV_GUIDANCE_PREFERENCE_EEPROM_POS, satnavGuidancePreference, PSTR("Sat nav guidance preference"));
+        WriteSetting(
+            SATNAV_GUIDANCE_PREFERENCE_SETTING_KEY,
+            satnavGuidancePreference,
+            PSTR("Sat nav guidance preference"));
     }
     else if (dataLen == 17 && data[0] == 0x20)
     {
@@ -3516,7 +3871,7 @@ VanPacketParseResult_t ParseSatNavStatus3Pkt(TVanPacketRxDesc& pkt, char* buf, c
     return VAN_PACKET_PARSE_OK;
 } // ParseSatNavStatus3Pkt
 
-VanPacketParseResult_t ParseSatNavGuidanceDataPkt(TVanPacketRxDesc& pkt, char* buf, const int n)
+VanPacketParseResult_t ParseSatNavGuidanceDataPkt(VanPacket_t& pkt, char* buf, const int n)
 {
     // http://graham.auld.me.uk/projects/vanbus/packets.html#9CE
     // http://pinterpeti.hu/psavanbus/PSA-VAN.html#9CE
@@ -3605,7 +3960,7 @@ VanPacketParseResult_t ParseSatNavGuidanceDataPkt(TVanPacketRxDesc& pkt, char* b
     return VAN_PACKET_PARSE_OK;
 } // ParseSatNavGuidanceDataPkt
 
-VanPacketParseResult_t ParseSatNavGuidancePkt(TVanPacketRxDesc& pkt, char* buf, const int n)
+VanPacketParseResult_t ParseSatNavGuidancePkt(VanPacket_t& pkt, char* buf, const int n)
 {
     // http://graham.auld.me.uk/projects/vanbus/packets.html#64E
     // http://pinterpeti.hu/psavanbus/PSA-VAN.html#64E
@@ -3784,7 +4139,7 @@ VanPacketParseResult_t ParseSatNavGuidancePkt(TVanPacketRxDesc& pkt, char* buf,
 } // ParseSatNavGuidancePkt
 
 // Compose a string for a street name
-String ComposeStreetString(const String& records5, const String& records6)
+String ComposeStreetString(const char* records5, const char* records6)
 {
     String result = "";
 
@@ -3792,8 +4147,8 @@ String ComposeStreetString(const String& records5, const String& records6)
     // First letter 'I' indicates building name??
     if (records5[0] == 'G' || records5[0] == 'I')
     {
-        result += records5.substring(1);  // Skip the 'G' or 'I'
-        if (records5.length() > 1) result += String(" ");
+        result += records5 + 1;  // Skip the 'G' or 'I'
+        if (records5[1] != 0) result += String(" ");
     } // if
 
     result += records6;
@@ -3801,22 +4156,145 @@ String ComposeStreetString(const String& records5, const String& records6)
     // First letter 'D' indicates postfix, e.g. "Strasse" as in "ORANIENBURGER Strasse"
     if (records5[0] == 'D')
     {
-        if (records5.length() > 1) result += String(" ");
-        result += records5.substring(1);  // Skip the 'D'
+        if (records5[1] != 0) result += String(" ");
+        result += records5 + 1;  // Skip the 'D'
     } // if
 
     return result;
 } // ComposeStreetString
 
 // Compose a string for a city name plus optional district
-String ComposeCityString(const String& records3, const String& records4)
+String ComposeCityString(const char* records3, const char* records4)
 {
     String result = records3;
-    if (records4.length() > 0) result += " - " + records4;
+    if (records4[0] != 0) result += String(" - ") + records4;
     return result;
 } // ComposeCityString
 
-VanPacketParseResult_t ParseSatNavReportPkt(TVanPacketRxDesc& pkt, char* buf, const int n)
+// The strings of the sat nav report currently being received, already converted to HTML. The strings are stored
+// back-to-back in a fixed-size arena, instead of each in its own heap-allocated String. When not sent in pages, a
+// list is sent in one JSON message, so it never needs more space than the JSON buffer.
+#define MAX_SATNAV_RECORDS 80
+#define SATNAV_RECORD_ARENA_SIZE JSON_BUFFER_SIZE
+#define SATNAV_RECORD_NONE (0xFFFF)
+char satnavRecordArena[SATNAV_RECORD_ARENA_SIZE];
+int satnavRecordArenaUsed = 0;
+uint16_t satnavRecordOffset[MAX_SATNAV_RECORDS];
+
+void ClearSatNavRecords()
+{
+    satnavRecordArenaUsed = 0;
+    for (int i = 0; i < MAX_SATNAV_RECORDS; i++) satnavRecordOffset[i] = SATNAV_RECORD_NONE;
+} // ClearSatNavRecords
+
+// Returns an empty string for a record that was not received
+const char* SatNavRecord(int i)
+{
+    if (i < 0 || i >= MAX_SATNAV_RECORDS || satnavRecordOffset[i] == SATNAV_RECORD_NONE) return "";
+    return satnavRecordArena + satnavRecordOffset[i];
+} // SatNavRecord
+
+// Store a string as record 'i', replacing any previous string for that record
+void StoreSatNavRecord(int i, const char* str, bool nonBreakingSpaces)
+{
+    if (i < 0 || i >= MAX_SATNAV_RECORDS) return;
+
+    // Replacing the most recently stored string (e.g. the next string of the same list record)? Then re-use its
+    // space.
+    int at = satnavRecordArenaUsed;
+    int offset = satnavRecordOffset[i];
+    if (offset != SATNAV_RECORD_NONE && offset + (int)strlen(satnavRecordArena + offset) + 1 == satnavRecordArenaUsed)
+    {
+        at = offset;
+    } // if
+
+    int len = VanTextToHtml(
+        str,
+        satnavRecordArena + at,
+        SATNAV_RECORD_ARENA_SIZE - at,
+        VAN_TEXT_SOFT_HYPHENS | VAN_TEXT_SATNAV_MARKERS | (nonBreakingSpaces ? VAN_TEXT_NON_BREAKING_SPACES : 0));
+
+    if (len < 0)
+    {
+        // Warning in the log
+        Log(LOG_LEVEL_WARNING).printf_P(PSTR("%s==> WARNING: satnav report does not fit in record arena!\n"),
+            TimeStamp()
+        );
+
+        if (at == offset) satnavRecordOffset[i] = SATNAV_RECORD_NONE;
+        satnavRecordArenaUsed = at;
+        return;
+    } // if
+
+    satnavRecordOffset[i] = at;
+    satnavRecordArenaUsed = at + len + 1;
+} // StoreSatNavRecord
+
+// Free the records before 'keep', moving the string of record 'keep' (if any) to the start of the arena
+void DiscardSatNavRecordsBefore(int keep)
+{
+    for (int i = 0; i < keep && i < MAX_SATNAV_RECORDS; i++) satnavRecordOffset[i] = SATNAV_RECORD_NONE;
+
+    if (keep >= MAX_SATNAV_RECORDS || satnavRecordOffset[keep] == SATNAV_RECORD_NONE)
+    {
+        satnavRecordArenaUsed = 0;
+        return;
+    } // if
+
+    int from = satnavRecordOffset[keep];
+    memmove(satnavRecordArena, satnavRecordArena + from, satnavRecordArenaUsed - from);
+    satnavRecordArenaUsed -= from;
+    satnavRecordOffset[keep] = 0;
+} // DiscardSatNavRecordsBefore
+
+// Append the records in range [from, to) as JSON array items. Each item in the list is a single string in a
+// separate record.
+void SatNavRecordsJson(int from, int to, char* buf, int& at, const int n)
+{
+    for (int i = from; i < to; i++)
+    {
+        at += at >= n ? 0 :
+            snprintf_P(buf + at, n - at,
+                PSTR("%s\n\"%s\""),
+                i == from ? emptyStr : commaStr,
+                SatNavRecord(i)
+            );
+    } // for
+} // SatNavRecordsJson
+
+// Is the specified report a list that can be sent in pages?
+bool IsSatNavListPaged(uint8_t report)
+{
+    return
+        satnavListPagesOnClient
+        && (report == SR_ENTER_CITY
+            || report == SR_ENTER_STREET
+            || report == SR_PERSONAL_ADDRESS_LIST
+            || report == SR_PROFESSIONAL_ADDRESS_LIST
+            || report == SR_SERVICE_LIST);
+} // IsSatNavListPaged
+
+// Append a page with the records in range [from, to) under the specified item name, then free the records of
+// that page
+void SatNavListPageJson(PGM_P itemName, int from, int to, char* buf, int& at, const int n, bool isFirstItem)
+{
+    const static char jsonFormatter[] PROGMEM =
+        "%s\n"
+        "\"satnav_list_page_offset\": %d,\n"
+        "\"%s\":\n"
+        "[";
+
+    at += at >= n ? 0 :
+        snprintf_P(buf + at, n - at, jsonFormatter, isFirstItem ? emptyStr : commaStr, from, itemName);
+
+    SatNavRecordsJson(from, to, buf, at, n);
+
+    at += at >= n ? 0 : snprintf_P(buf + at, n - at, PSTR("\n]"));
+
+    DiscardSatNavRecordsBefore(to);
+} // SatNavListPageJson
+
+VanPacketParseResult_t ParseSatNavReportPkt(VanPacket_t& pkt, char* buf, const int n)
 {
     // http://graham.auld.me.uk/projects/vanbus/packets.html#6CE
     // http://pinterpeti.hu/psavanbus/PSA-VAN.html#6CE
@@ -3825,12 +4303,16 @@ VanPacketParseResult_t ParseSatNavReportPkt(TVanPacketRxDesc& pkt, char* buf, co
     if (dataLen < 3) return VAN_PACKET_PARSE_UNEXPECTED_LENGTH;
 
     #define MAX_SATNAV_STRINGS_PER_RECORD 15
-    #define MAX_SATNAV_RECORDS 80
-    static String records[MAX_SATNAV_RECORDS];
 
     static int currentRecord = 0;
     static int currentString = 0;
 
+    // In paged mode: number of records already sent
+    static int pagedRecords = 0;
+
+    // In paged mode: minimum number of records to send in a page, before the last fragment
+    #define SATNAV_LIST_PAGE_SIZE 8
+
     // String currently being read
     #define MAX_SATNAV_STRING_SIZE 128
     static char buffer[MAX_SATNAV_STRING_SIZE];
@@ -3858,11 +4340,11 @@ VanPacketParseResult_t ParseSatNavReportPkt(TVanPacketRxDesc& pkt, char* buf, co
 
         // Clear all records and reset array indexes. Otherwise, if the last fragment of the previous report
         // was missed, the data will continue to pile up after the previous records.
-        // TODO - check if the following can be commented out:
-        //for (int i = 0; i < MAX_SATNAV_RECORDS; i++) records[i] = "";
+        ClearSatNavRecords();
 
         currentRecord = 0;
         currentString = 0;
+        pagedRecords = 0;
     }
     else
     {
@@ -3875,14 +4357,34 @@ VanPacketParseResult_t ParseSatNavReportPkt(TVanPacketRxDesc& pkt, char* buf, co
         // Missed the expected fragment?
         if (packetFragmentNo != expectedFragmentNo)
         {
-            Serial.printf_P(
+            Log(LOG_LEVEL_ERROR).printf_P(
                 PSTR("%s==> ERROR: satnav report (IDEN 0x6CE) packetFragmentNo = %u ; expectedFragmentNo = %u\n"),
                 TimeStamp(),
                 packetFragmentNo,
                 expectedFragmentNo
             );
             report = INVALID_SATNAV_REPORT;
-            return VAN_PACKET_PARSE_FRAGMENT_MISSED;
+
+            // In paged mode: let the client know that the pages it has received so far will not be followed by a
+            // last page
+            if (pagedRecords == 0) return VAN_PACKET_PARSE_FRAGMENT_MISSED;
+            pagedRecords = 0;
+
+            const static char jsonFormatter[] PROGMEM =
+            "{\n"
+                "\"event\": \"display\",\n"
+                "\"data\":\n"
+                "{\n"
+                    "\"satnav_list_aborted\": \"YES\"\n"
+                "}\n"
+            "}\n";
+
+            int at = snprintf_P(buf, n, jsonFormatter);
+
+            // JSON buffer overflow?
+            if (at >= n) return VAN_PACKET_PARSE_JSON_TOO_LONG;
+
+            return VAN_PACKET_PARSE_OK;
         } // if
 
         lastFragmentNo = packetFragmentNo;
@@ -3897,8 +4399,10 @@ VanPacketParseResult_t ParseSatNavReportPkt(TVanPacketRxDesc& pkt, char* buf, co
 
             if (++currentRecord >= MAX_SATNAV_RECORDS)
             {
-                // Warning on Serial output
-                Serial.printf_P(PSTR("%s==> WARNING: too many records in satnav report!\n"), TimeStamp());
+                // Warning in the log
+                Log(LOG_LEVEL_WARNING).printf_P(PSTR("%s==> WARNING: too many records in satnav report!\n"),
+                    TimeStamp()
+                );
             } // if
 
             currentString = 0;
@@ -3962,38 +4466,45 @@ VanPacketParseResult_t ParseSatNavReportPkt(TVanPacketRxDesc& pkt, char* buf, co
         // Better safe than sorry
         if (i >= MAX_SATNAV_RECORDS) continue;
 
-        // Copy the current string buffer into the array of Strings
-        records[i] = buffer;
+        // Copy the current string buffer into the record arena, replacing special characters by HTML-safe ones
+        StoreSatNavRecord(i, buffer, report == SR_PERSONAL_ADDRESS_LIST || report == SR_PROFESSIONAL_ADDRESS_LIST);
 
-        // Fix a bug in the original MFD: '#' is used to indicate a "soft hyphen"
-        records[i].replace("#", "&shy;");
+        if (++currentString >= MAX_SATNAV_STRINGS_PER_RECORD)
+        {
+            // Warning in the log
+            Log(LOG_LEVEL_WARNING).printf_P(PSTR("%s==> WARNING: too many strings in record in satnav report!\n"),
+                TimeStamp()
+            );
+        } // if
+    } // while
 
-        if (report == SR_PERSONAL_ADDRESS_LIST || report == SR_PROFESSIONAL_ADDRESS_LIST)
+    // Not last fragment?
+    if ((data[0] & 0x80) == 0x00)
+    {
+        // In paged mode, send the records received so far, as soon as there are enough for a page
+        if (! IsSatNavListPaged(report) || currentRecord - pagedRecords < SATNAV_LIST_PAGE_SIZE)
         {
-            records[i].replace(" ", "&nbsp;");
+            return VAN_PACKET_NO_CONTENT;
         } // if
 
-        // Special (last) characters:
-        // - 0x80: indicates that the entry cannot be selected because the current navigation disc cannot be
-        //   read. This is shown as a "?".
-        // - 0x81: indicates that the entry cannot be selected because the current navigation disc is for a
-        //   different country/region. This is shown on the original MFD as an circle with a bar "(-)"; here we
-        //   use a circle with a cross "(X)".
-        records[i].replace("\x80", "?");
-        records[i].replace("\x81", "&#x24E7;");
+        const static char jsonFormatter[] PROGMEM =
+        "{\n"
+            "\"event\": \"display\",\n"
+            "\"data\":\n"
+            "{";
 
-        // Replace special characters by HTML-safe ones, e.g. "\xEB" (ë) by "&euml;"
-        AsciiToHtml(records[i]);
+        int at = snprintf_P(buf, n, jsonFormatter);
 
-        if (++currentString >= MAX_SATNAV_STRINGS_PER_RECORD)
-        {
-            // Warning on serial output
-            Serial.printf_P(PSTR("%s==> WARNING: too many strings in record in satnav report!\n"), TimeStamp());
-        } // if
-    } // while
+        SatNavListPageJson(PSTR("satnav_list_page"), pagedRecords, currentRecord, buf, at, n, true);
+        pagedRecords = currentRecord;
 
-    // Not last fragment?
-    if ((data[0] & 0x80) == 0x00) return VAN_PACKET_NO_CONTENT;
+        at += at >= n ? 0 : snprintf_P(buf + at, n - at, PSTR("\n}\n}\n"));
+
+        // JSON buffer overflow?
+        if (at >= n) return VAN_PACKET_PARSE_JSON_TOO_LONG;
+
+        return VAN_PACKET_PARSE_OK;
+    } // if
 
     // Fragment was missed?
     if (report == INVALID_SATNAV_REPORT) return VAN_PACKET_PARSE_FRAGMENT_MISSED;
@@ -4018,9 +4529,9 @@ VanPacketParseResult_t ParseSatNavReportPkt(TVanPacketRxDesc& pkt, char* buf, co
         case SR_CURRENT_STREET:
         case SR_NEXT_STREET:
         {
-            String city = ComposeCityString(records[3], records[4]);  // City (if any) + optional district
+            String city = ComposeCityString(SatNavRecord(3), SatNavRecord(4));  // City (if any) + optional district
 
-            if (records[6].length() == 0)
+            if (SatNavRecord(6)[0] == 0)
             {
                 // In this case, the original MFD says: "Street not listed". We just show the city.
 
@@ -4046,7 +4557,7 @@ VanPacketParseResult_t ParseSatNavReportPkt(TVanPacketRxDesc& pkt, char* buf, co
                 break;
             } // if
 
-            String street = ComposeStreetString(records[5], records[6]).c_str();
+            String street = ComposeStreetString(SatNavRecord(5), SatNavRecord(6));
 
             if (report == SR_CURRENT_STREET)
             {
@@ -4093,21 +4604,21 @@ VanPacketParseResult_t ParseSatNavReportPkt(TVanPacketRxDesc& pkt, char* buf, co
                         PSTR("satnav_last_destination_country"),
 
                     // Country
-                    records[1].c_str(),
+                    SatNavRecord(1),
 
                     report == SR_DESTINATION ?
                         PSTR("satnav_current_destination_province") :
                         PSTR("satnav_last_destination_province"),
 
                     // Province
-                    records[2].c_str(),
+                    SatNavRecord(2),
 
                     report == SR_DESTINATION ?
                         PSTR("satnav_current_destination_city") :
                         PSTR("satnav_last_destination_city"),
 
                     // City + optional district
-                    ComposeCityString(records[3], records[4]).c_str(),
+                    ComposeCityString(SatNavRecord(3), SatNavRecord(4)).c_str(),
 
                     report == SR_DESTINATION ?
                         PSTR("satnav_current_destination_street") :
@@ -4115,7 +4626,7 @@ VanPacketParseResult_t ParseSatNavReportPkt(TVanPacketRxDesc& pkt, char* buf, co
 
                     // Street
                     // Note: if the street is empty: it means "City centre"
-                    ComposeStreetString(records[5], records[6]).c_str(),
+                    ComposeStreetString(SatNavRecord(5), SatNavRecord(6)).c_str(),
 
                     report == SR_DESTINATION ?
                         PSTR("satnav_current_destination_house_number") :
@@ -4123,8 +4634,8 @@ VanPacketParseResult_t ParseSatNavReportPkt(TVanPacketRxDesc& pkt, char* buf, co
 
                     // First string is either "C" or "V"; "C" has GPS coordinates in [7] and [8]; "V" has house number
                     // in [7]. If we see "V", show house number
-                    records[0] == "V" && records[7] != "0" ?
-                        records[7].c_str() :
+                    strcmp(SatNavRecord(0), "V") == 0 && strcmp(SatNavRecord(7), "0") != 0 ?
+                        SatNavRecord(7) :
                         emptyStr
                 );
         } // case
@@ -4152,7 +4663,7 @@ VanPacketParseResult_t ParseSatNavReportPkt(TVanPacketRxDesc& pkt, char* buf, co
                         PSTR("satnav_professional_address_entry"),
 
                     // Name of the entry
-                    records[0] == "C" ? records[9].c_str() : records[8].c_str(),
+                    strcmp(SatNavRecord(0), "C") == 0 ? SatNavRecord(9) : SatNavRecord(8),
 
                     // Address
 
@@ -4161,21 +4672,21 @@ VanPacketParseResult_t ParseSatNavReportPkt(TVanPacketRxDesc& pkt, char* buf, co
                         PSTR("satnav_professional_address_country"),
 
                     // Country
-                    records[1].c_str(),
+                    SatNavRecord(1),
 
                     report == SR_PERSONAL_ADDRESS ?
                         PSTR("satnav_personal_address_province") :
                         PSTR("satnav_professional_address_province"),
 
                     // Province
-                    records[2].c_str(),
+                    SatNavRecord(2),
 
                     report == SR_PERSONAL_ADDRESS ?
                         PSTR("satnav_personal_address_city") :
                         PSTR("satnav_professional_address_city"),
 
                     // City + optional district
-                    ComposeCityString(records[3], records[4]).c_str(),
+                    ComposeCityString(SatNavRecord(3), SatNavRecord(4)).c_str(),
 
                     report == SR_PERSONAL_ADDRESS ?
                         PSTR("satnav_personal_address_street") :
@@ -4183,7 +4694,7 @@ VanPacketParseResult_t ParseSatNavReportPkt(TVanPacketRxDesc& pkt, char* buf, co
 
                     // Street
                     // Note: if the street is empty: it means "City centre"
-                    ComposeStreetString(records[5], records[6]).c_str(),
+                    ComposeStreetString(SatNavRecord(5), SatNavRecord(6)).c_str(),
 
                     report == SR_PERSONAL_ADDRESS ?
                         PSTR("satnav_personal_address_house_number") :
@@ -4191,8 +4702,8 @@ VanPacketParseResult_t ParseSatNavReportPkt(TVanPacketRxDesc& pkt, char* buf, co
 
                     // First string is either "C" or "V"; "C" has GPS coordinates in [7] and [8]; "V" has house number
                     // in [7]. If we see "V", show house number
-                    records[0] == "V" && records[7] != "0" ?
-                        records[7].c_str() :
+                    strcmp(SatNavRecord(0), "V") == 0 && strcmp(SatNavRecord(7), "0") != 0 ?
+                        SatNavRecord(7) :
                         emptyStr
                 );
         } // case
@@ -4215,24 +4726,24 @@ VanPacketParseResult_t ParseSatNavReportPkt(TVanPacketRxDesc& pkt, char* buf, co
                 snprintf_P(buf + at, n - at, jsonFormatter,
 
                     // Name of the service address
-                    records[9].c_str(),
+                    SatNavRecord(9),
 
                     // Service address
 
                     // Country
-                    records[1].c_str(),
+                    SatNavRecord(1),
 
                     // Province
-                    records[2].c_str(),
+                    SatNavRecord(2),
 
                     // City + optional district
-                    ComposeCityString(records[3], records[4]).c_str(),
+                    ComposeCityString(SatNavRecord(3), SatNavRecord(4)).c_str(),
 
                     // Street
-                    ComposeStreetString(records[5], records[6]).c_str(),
+                    ComposeStreetString(SatNavRecord(5), SatNavRecord(6)).c_str(),
 
                     // Distance to the service address (sat nav reports in metres or in yards)
-                    records[11].c_str(),
+                    SatNavRecord(11),
                     mfdDistanceUnit == MFD_DISTANCE_UNIT_METRIC ? PSTR("m") : PSTR("yd")
                 );
         } // case
@@ -4242,7 +4753,15 @@ VanPacketParseResult_t ParseSatNavReportPkt(TVanPacketRxDesc& pkt, char* buf, co
         case SR_ENTER_STREET:
         case SR_PERSONAL_ADDRESS_LIST:
         case SR_PROFESSIONAL_ADDRESS_LIST:
+        case SR_SERVICE_LIST:
         {
+            if (IsSatNavListPaged(report))
+            {
+                // Send the remaining records
+                SatNavListPageJson(PSTR("satnav_list_last_page"), pagedRecords, currentRecord, buf, at, n, false);
+                break;
+            } // if
+
             const static char jsonFormatter[] PROGMEM =
                 ",\n"
                 "\"satnav_list\":\n"
@@ -4251,16 +4770,8 @@ VanPacketParseResult_t ParseSatNavReportPkt(TVanPacketRxDesc& pkt, char* buf, co
             at += at >= n ? 0 :
                 snprintf_P(buf + at, n - at, jsonFormatter);
 
-            // Each item in the list is a single string in a separate record
-            for (int i = 0; i < currentRecord; i++)
-            {
-                at += at >= n ? 0 :
-                    snprintf_P(buf + at, n - at,
-                        PSTR("%s\n\"%s\""),
-                        i == 0 ? emptyStr : commaStr,
-                        records[i].c_str()
-                    );
-            } // for
+            // Each item (or "service") in the list is a single string in a separate record
+            SatNavRecordsJson(0, currentRecord, buf, at, n);
 
             at += at >= n ? 0 :
                 snprintf_P(buf + at, n - at, PSTR("\n]"));
@@ -4280,38 +4791,12 @@ VanPacketParseResult_t ParseSatNavReportPkt(TVanPacketRxDesc& pkt, char* buf, co
             at += at >= n ? 0 :
                 snprintf_P(buf + at, n - at, jsonFormatter,
 
-                    records[0].c_str(),
-                    records[1].c_str()
+                    SatNavRecord(0),
+                    SatNavRecord(1)
                 );
         } // case
         break;
 
-        case SR_SERVICE_LIST:
-        {
-            const static char jsonFormatter[] PROGMEM =
-                ",\n"
-                "\"satnav_list\":\n"
-                "[";
-
-            at += at >= n ? 0 :
-                snprintf_P(buf + at, n - at, jsonFormatter);
-
-            // Each "service" in the list is a single string in a separate record
-            for (int i = 0; i < currentRecord; i++)
-            {
-                at += at >= n ? 0 :
-                    snprintf_P(buf + at, n - at,
-                        PSTR("%s\n\"%s\""),
-                        i == 0 ? emptyStr : commaStr,
-                        records[i].c_str()
-                    );
-            } // for
-
-            at += at >= n ? 0 :
-                snprintf_P(buf + at, n - at, PSTR("\n]"));
-        } // case
-        break;
-
         case SR_SOFTWARE_MODULE_VERSIONS:
         {
             // To see the module versions on the original MFD:
@@ -4336,9 +4821,9 @@ VanPacketParseResult_t ParseSatNavReportPkt(TVanPacketRxDesc& pkt, char* buf, co
                     snprintf_P(buf + at, n - at,
                         PSTR("%s\n\"%s - %s - %s\""),
                         i == 0 ? emptyStr : commaStr,
-                        records[i * 3].c_str(),
-                        records[i * 3 + 1].c_str(),
-                        records[i * 3 + 2].c_str()
+                        SatNavRecord(i * 3),
+                        SatNavRecord(i * 3 + 1),
+                        SatNavRecord(i * 3 + 2)
                     );
             } // for
 
@@ -4367,8 +4852,7 @@ VanPacketParseResult_t ParseSatNavReportPkt(TVanPacketRxDesc& pkt, char* buf, co
 
     // Clear all records and reset array indexes. Otherwise, if the first fragment of the next report
     // is missed, the data will continue to pile up after the current records.
-    // TODO - check if the following can be commented out:
-    //for (int i = 0; i < MAX_SATNAV_RECORDS; i++) records[i] = "";
+    ClearSatNavRecords();
 
     currentRecord = 0;
     currentString = 0;
@@ -4379,7 +4863,7 @@ VanPacketParseResult_t ParseSatNavReportPkt(TVanPacketRxDesc& pkt, char* buf, co
     return VAN_PACKET_PARSE_OK;
 } // ParseSatNavReportPkt
 
-VanPacketParseResult_t ParseMfdToSatNavPkt(TVanPacketRxDesc& pkt, char* buf, const int n)
+VanPacketParseResult_t ParseMfdToSatNavPkt(VanPacket_t& pkt, char* buf, const int n)
 {
     // http://graham.auld.me.uk/projects/vanbus/packets.html#94E
     // http://pinterpeti.hu/psavanbus/PSA-VAN.html#94E
@@ -4686,7 +5170,7 @@ VanPacketParseResult_t ParseMfdToSatNavPkt(TVanPacketRxDesc& pkt, char* buf, con
     return VAN_PACKET_PARSE_OK;
 } // ParseMfdToSatNavPkt
 
-VanPacketParseResult_t ParseSatNavToMfdPkt(TVanPacketRxDesc& pkt, char* buf, const int n)
+VanPacketParseResult_t ParseSatNavToMfdPkt(VanPacket_t& pkt, char* buf, const int n)
 {
     // http://graham.auld.me.uk/projects/vanbus/packets.html#74E
     // http://pinterpeti.hu/psavanbus/PSA-VAN.html#74E
@@ -4786,7 +5270,7 @@ VanPacketParseResult_t ParseSatNavToMfdPkt(TVanPacketRxDesc& pkt, char* buf, con
     return VAN_PACKET_PARSE_OK;
 } // ParseSatNavToMfdPkt
 
-VanPacketParseResult_t ParseSatNavDownloading(TVanPacketRxDesc&, char* buf, const int n)
+VanPacketParseResult_t ParseSatNavDownloading(VanPacket_t&, char* buf, const int n)
 {
     const static char jsonFormatter[] PROGMEM =
     "{\n"
@@ -4808,7 +5292,7 @@ VanPacketParseResult_t ParseSatNavDownloading(TVanPacketRxDesc&, char* buf, cons
     return VAN_PACKET_PARSE_OK;
 } // ParseSatNavDownloading
 
-VanPacketParseResult_t ParseWheelSpeedPkt(TVanPacketRxDesc& pkt, char* buf, const int n)
+VanPacketParseResult_t ParseWheelSpeedPkt(VanPacket_t& pkt, char* buf, const int n)
 {
     // http://pinterpeti.hu/psavanbus/PSA-VAN.html#744
 
@@ -4841,14 +5325,36 @@ VanPacketParseResult_t ParseWheelSpeedPkt(TVanPacketRxDesc& pkt, char* buf, cons
     return VAN_PACKET_PARSE_OK;
 } // ParseWheelSpeedPkt
 
-VanPacketParseResult_t ParseOdometerPkt(TVanPacketRxDesc& pkt, char* buf, const int n)
+VanPacketParseResult_t ParseOdometerPkt(VanPacket_t& pkt, char* buf, const int n)
 {
     // http://graham.auld.me.uk/projects/vanbus/packets.html#8FC
     // http://pinterpeti.hu/psavanbus/PSA-VAN.html#8FC
 
     const uint8_t* data = pkt.Data();
 
-    float odometer = ((uint32_t)data[1] << 16 | (uint32_t)data[2] << 8 | data[3]) / 10.0;
+    uint32_t odometerRaw = (uint32_t)data[1] << 16 | (uint32_t)data[2] << 8 | data[3];
+
+    if (unitsOnClient)
+    {
+        // Unit-neutral value (km x 10); conversion and formatting is done by the client
+        const static char jsonFormatterRaw[] PROGMEM =
+        "{\n"
+            "\"event\": \"display\",\n"
+            "\"data\":\n"
+            "{\n"
+                "\"odometer_2_km_x10\": %" PRIu32 "\n"
+            "}\n"
+        "}\n";
+
+        int at = snprintf_P(buf, n, jsonFormatterRaw, odometerRaw);
+
+        // JSON buffer overflow?
+        if (at >= n) return VAN_PACKET_PARSE_JSON_TOO_LONG;
+
+        return VAN_PACKET_PARSE_OK;
+    } // if
+
+    float odometer = odometerRaw / 10.0;
 
     const static char jsonFormatter[] PROGMEM =
     "{\n"
@@ -4873,7 +5379,7 @@ VanPacketParseResult_t ParseOdometerPkt(TVanPacketRxDesc& pkt, char* buf, const
     return VAN_PACKET_PARSE_OK;
 } // ParseOdometerPkt
 
-VanPacketParseResult_t ParseCom2000Pkt(TVanPacketRxDesc& pkt, char* buf, const int n)
+VanPacketParseResult_t ParseCom2000Pkt(VanPacket_t& pkt, char* buf, const int n)
 {
     // http://pinterpeti.hu/psavanbus/PSA-VAN.html#450
 
@@ -4951,7 +5457,7 @@ VanPacketParseResult_t ParseCom2000Pkt(TVanPacketRxDesc& pkt, char* buf, const i
     return VAN_PACKET_PARSE_OK;
 } // ParseCom2000Pkt
 
-VanPacketParseResult_t ParseCdChangerCmdPkt(TVanPacketRxDesc& pkt, char* buf, const int n)
+VanPacketParseResult_t ParseCdChangerCmdPkt(VanPacket_t& pkt, char* buf, const int n)
 {
     // http://pinterpeti.hu/psavanbus/PSA-VAN.html#8EC
 
@@ -4992,7 +5498,7 @@ VanPacketParseResult_t ParseCdChangerCmdPkt(TVanPacketRxDesc& pkt, char* buf, co
     return VAN_PACKET_PARSE_OK;
 } // ParseCdChangerCmdPkt
 
-VanPacketParseResult_t ParseMfdToHeadUnitPkt(TVanPacketRxDesc& pkt, char* buf, const int n)
+VanPacketParseResult_t ParseMfdToHeadUnitPkt(VanPacket_t& pkt, char* buf, const int n)
 {
     // http://graham.auld.me.uk/projects/vanbus/packets.html#8D4
     // http://pinterpeti.hu/psavanbus/PSA-VAN.html#8D4
@@ -5401,22 +5907,82 @@ const char* EquipmentStatusDataToJson(char* buf, const int n)
     // JSON buffer overflow?
     if (at >= n) return "";
 
-  #ifdef PRINT_JSON_BUFFERS_ON_SERIAL
-    Serial.printf_P(PSTR("%sEquipment status data as JSON object:\n"), TimeStamp());
-    PrintJsonText(buf);
-  #endif // PRINT_JSON_BUFFERS_ON_SERIAL
+    if (IsDiagEnabled(DIAG_JSON_BUFFERS))
+    {
+        AsyncLog.printf_P(PSTR("%sEquipment status data as JSON object:\n"), TimeStamp());
+        PrintJsonText(buf);
+    } // if
 
     return buf;
 } // EquipmentStatusDataToJson
 
+// Generates the "/VanStrings.js" asset, one line per call. The asset contains the string tables that the client
+// (MFD.js) needs to look up the numeric codes in the JSON data when 'codesOnClient' is set.
+// Returns the length of the generated line, or 0 when there are no more lines.
+int StringTablesJsLine(int line, char* buf, const int n)
+{
+    struct StringTable_t
+    {
+        PGM_P name;
+        const char* const* table;  // Either a PROGMEM table of strings ...
+        PGM_P (*lookup)(uint8_t code);  // ... or a lookup function
+        int size;
+    };
+
+    const StringTable_t tables[] =
+    {
+        // The names of the notification tables match the language identifiers used by the client
+        { PSTR("set_language_english"), msgTable_eng, nullptr, 128 },
+        { PSTR("set_language_french"), msgTable_fr, nullptr, 128 },
+        { PSTR("set_language_german"), msgTable_ger, nullptr, 128 },
+        { PSTR("set_language_spanish"), msgTable_spa, nullptr, 128 },
+        { PSTR("set_language_italian"), msgTable_ita, nullptr, 128 },
+        { PSTR("set_language_dutch"), msgTable_dut, nullptr, 128 },
+        { PSTR("notification_icons"), notificationIconTable, nullptr, 128 },
+        { PSTR("pty_8"), nullptr, PtyStr8, 32 },
+        { PSTR("pty_16"), nullptr, PtyStr16, 32 },
+        { PSTR("pty_full"), nullptr, PtyStrFull, 32 }
+    };
+    const int nTables = sizeof(tables) / sizeof(tables[0]);
+
+    if (line == 0) return snprintf_P(buf, n, PSTR("var vanStrings =\n{\n"));
+    line--;
+
+    // Each table takes one line for its opening, one line per string, and one line for its closing
+    for (int t = 0; t < nTables; t++)
+    {
+        const StringTable_t& table = tables[t];
+
+        if (line == 0) return snprintf_P(buf, n, PSTR("\"%s\":\n[\n"), table.name);
+        line--;
+
+        if (line < table.size)
+        {
+            PGM_P str =
+                table.table != nullptr ? (PGM_P)pgm_read_ptr(&table.table[line]) :
+                line == 0 ? emptyStr :  // PTY code 0 means: none
+                table.lookup(line);
+            if (str == nullptr) str = emptyStr;
+
+            // The strings in the tables do not contain any characters that need escaping
+            return snprintf_P(buf, n, PSTR("\"%s\"%s\n"), str, line < table.size - 1 ? commaStr : emptyStr);
+        } // if
+        line -= table.size;
+
+        if (line == 0) return snprintf_P(buf, n, PSTR("]%s\n"), t < nTables - 1 ? commaStr : emptyStr);
+        line--;
+    } // for
+
+    if (line == 0) return snprintf_P(buf, n, PSTR("};\n"));
+
+    return 0;
+} // StringTablesJsLine
+
 // Check if the new packet data differs from the previous.
 // Optionally, print the new packet on serial port, highlighting the bytes that differ.
-bool IsPacketDataDuplicate(TVanPacketRxDesc& pkt, IdenHandler_t* handler)
+bool IsPacketDataDuplicate(VanPacket_t& pkt, IdenHandler_t* handler)
 {
-  #ifdef PRINT_RAW_PACKET_DATA
     uint16_t iden = pkt.Iden();
-  #endif // PRINT_RAW_PACKET_DATA
-
     int dataLen = pkt.DataLen();
     const uint8_t* data = pkt.Data();
 
@@ -5431,41 +5997,42 @@ bool IsPacketDataDuplicate(TVanPacketRxDesc& pkt, IdenHandler_t* handler)
     // Don't repeatedly print the same packet
     if (isDuplicate) return false;  // Duplicate packet, not to be ignored, but don't print over and over
 
-  #ifdef PRINT_RAW_PACKET_DATA
-    // Not a duplicate packet: print the diff, and save the packet to compare with the next
-    if (IsPacketSelected(iden, SELECTED_PACKETS))
+    if (IsDiagEnabled(DIAG_RAW_PACKET_DATA))
     {
-        Serial.printf_P(PSTR("%sReceived: %s packet (IDEN %03X)\n"), TimeStamp(), handler->idenStr, iden);
-
-        // The first time, or after an call to ResetPacketPrevData, handler->prevDataLen will be -1, so only
-        // the "FULL: " line will be printed
-        if (handler->prevData != nullptr && handler->prevDataLen >= 0)
+        // Not a duplicate packet: print the diff, and save the packet to compare with the next
+        if (IsDiagPacketSelected(iden))
         {
-            // First line: print the new packet's data where it differs from the previous packet
-            Serial.printf_P(PSTR("DIFF: %03X %1X (%s) "), iden, pkt.CommandFlags(), pkt.CommandFlagsStr());
-            if (dataLen > 0)
+            AsyncLog.printf_P(PSTR("%sReceived: %s packet (IDEN %03X)\n"), TimeStamp(), handler->idenStr, iden);
+
+            // The first time, or after an call to ResetPacketPrevData, handler->prevDataLen will be -1, so only
+            // the "FULL: " line will be printed
+            if (handler->prevData != nullptr && handler->prevDataLen >= 0)
             {
-                int n = handler->prevDataLen;
-                for (int i = 0; i < n; i++)
+                // First line: print the new packet's data where it differs from the previous packet
+                AsyncLog.printf_P(PSTR("DIFF: %03X %1X (%s) "), iden, pkt.CommandFlags(), pkt.CommandFlagsStr());
+                if (dataLen > 0)
                 {
-                    char diffByte[] = "\u00b7\u00b7";  // \u00b7 is center dot character
-
-                    // Relying on short-circuit boolean evaluation
-                    if (i >= dataLen || data[i] != handler->prevData[i])
+                    int n = handler->prevDataLen;
+                    for (int i = 0; i < n; i++)
                     {
-                        snprintf_P(diffByte, sizeof(diffByte), PSTR("%02X"), handler->prevData[i]);
-                    } // if
-                    Serial.printf_P(PSTR("%s%s"), diffByte, i < n - 1 ? dashStr : emptyStr);
-                } // for
-                Serial.print("\n");
-            }
-            else
-            {
-                Serial.print("<no_data>\n");
+                        char diffByte[] = "\u00b7\u00b7";  // \u00b7 is center dot character
+
+                        // Relying on short-circuit boolean evaluation
+                        if (i >= dataLen || data[i] != handler->prevData[i])
+                        {
+                            snprintf_P(diffByte, sizeof(diffByte), PSTR("%02X"), handler->prevData[i]);
+                        } // if
+                        AsyncLog.printf_P(PSTR("%s%s"), diffByte, i < n - 1 ? dashStr : emptyStr);
+                    } // for
+                    AsyncLog.print("\n");
+                }
+                else
+                {
+                    AsyncLog.print("<no_data>\n");
+                } // if
             } // if
         } // if
     } // if
-  #endif // PRINT_RAW_PACKET_DATA
 
     if (handler->prevData == nullptr) handler->prevData = (uint8_t*) malloc(VAN_MAX_DATA_BYTES);
 
@@ -5477,25 +6044,26 @@ bool IsPacketDataDuplicate(TVanPacketRxDesc& pkt, IdenHandler_t* handler)
         handler->prevDataLen = dataLen;
     } // if
 
-  #ifdef PRINT_RAW_PACKET_DATA
-    if (IsPacketSelected(iden, SELECTED_PACKETS))
+    if (IsDiagEnabled(DIAG_RAW_PACKET_DATA))
     {
-        // Now print the new packet's data in full
-        Serial.printf_P(PSTR("FULL: %03X %1X (%s) "), iden, pkt.CommandFlags(), pkt.CommandFlagsStr());
-        if (dataLen > 0)
+        if (IsDiagPacketSelected(iden))
         {
-            for (int i = 0; i < dataLen; i++)
+            // Now print the new packet's data in full
+            AsyncLog.printf_P(PSTR("FULL: %03X %1X (%s) "), iden, pkt.CommandFlags(), pkt.CommandFlagsStr());
+            if (dataLen > 0)
             {
-                Serial.printf_P(PSTR("%02X%s"), data[i], i < dataLen - 1 ? dashStr : emptyStr);
-            } // for
-            Serial.print("\n");
-        }
-        else
-        {
-            Serial.print("<no_data>\n");
+                for (int i = 0; i < dataLen; i++)
+                {
+                    AsyncLog.printf_P(PSTR("%02X%s"), data[i], i < dataLen - 1 ? dashStr : emptyStr);
+                } // for
+                AsyncLog.print("\n");
+            }
+            else
+            {
+                AsyncLog.print("<no_data>\n");
+            } // if
         } // if
     } // if
-  #endif // PRINT_RAW_PACKET_DATA
 
     return false;
 } // IsPacketDataDuplicate
@@ -5509,6 +6077,7 @@ static IdenHandler_t handlers[] =
     // 4. Ignore duplicates (boolean)
     // 5. handler function
     // 6. prevDataLen: must be initialized to -1 to indicate "unknown"
+    // 7. prevData: allocated when the first packet arrives
     { VIN_IDEN, "vin", 17, true, &ParseVinPkt, -1, nullptr },
     { ENGINE_IDEN, "engine", 7, true, &ParseEnginePkt, -1, nullptr },
     { HEAD_UNIT_STALK_IDEN, "head_unit_stalk", 2, true, &ParseHeadUnitStalkPkt, -1, nullptr },
@@ -5543,8 +6112,62 @@ static IdenHandler_t handlers[] =
 
 const IdenHandler_t* const handlers_end = handlers + sizeof(handlers) / sizeof(handlers[0]);
 
-const char* ParseVanPacketToJson(TVanPacketRxDesc& pkt)
+// Number of packets received per IDEN value, in the same order as 'handlers'
+uint32_t handlerPacketCount[sizeof(handlers) / sizeof(handlers[0])];
+
+// Report the number of packets per IDEN value and per parse result, for "/metrics"
+int VanPacketMetricsText(int item, char* buf, const int n)
 {
+    const int nHandlers = handlers_end - handlers;
+
+    if (item == 0)
+    {
+        return MetricHeader(buf, n, PSTR("van_packets_total"), counterStr,
+            PSTR("VAN bus packets with a correct CRC, per recognized IDEN value."));
+    } // if
+    item--;
+
+    if (item < nHandlers)
+    {
+        return snprintf_P(buf, n, PSTR("vanlive_van_packets_total{iden=\"0x%03X\",name=\"%s\"} %" PRIu32 "\n"),
+            handlers[item].iden,
+            handlers[item].idenStr,
+            handlerPacketCount[item]
+        );
+    } // if
+    item -= nHandlers;
+
+    if (item == 0)
+    {
+        return MetricHeader(buf, n, PSTR("van_parse_results_total"), counterStr,
+            PSTR("VAN bus packets, per parse result."));
+    } // if
+    item--;
+
+    if (item < N_VAN_PACKET_PARSE_RESULTS)
+    {
+        return snprintf_P(buf, n, PSTR("vanlive_van_parse_results_total{result=\"%s\"} %" PRIu32 "\n"),
+            VanPacketParseResultStr(item + VAN_PACKET_PARSE_FRAGMENT_MISSED),
+            vanPacketParseResultCount[item]
+        );
+    } // if
+    item -= N_VAN_PACKET_PARSE_RESULTS;
+
+    if (item == 0)
+    {
+        return ScalarMetric(buf, n, PSTR("van_crc_repaired_total"), counterStr,
+            PSTR("VAN bus packets with a CRC error that could be repaired."), nVanPacketsCrcRepaired);
+    } // if
+
+    return 0;
+} // VanPacketMetricsText
+
+const char* ParseVanPacketToJson(VanPacket_t& pkt)
+{
+  #ifdef VAN_RX_PARSE_TASK
+    HandlePacketPrevDataResetRequests();
+  #endif // VAN_RX_PARSE_TASK
+
     int dataLen = pkt.DataLen();
     if (dataLen < 0 || dataLen > VAN_MAX_DATA_BYTES) return ""; // Unexpected packet length
 
@@ -5554,44 +6177,59 @@ const char* ParseVanPacketToJson(TVanPacketRxDesc& pkt)
       // On the desk test setup, we want to see a lot of detailed output
         if (! pkt.CheckCrc())
         {
-            Serial.printf_P(PSTR("%sVAN PACKET CRC ERROR!\n"), TimeStamp());
+            Log(LOG_LEVEL_WARNING).printf_P(PSTR("%sVAN PACKET CRC ERROR!\n"), TimeStamp());
 
           #ifdef VAN_RX_ISR_DEBUGGING
             // Show byte content of packet, plus full dump of bit timings for packets that have CRC ERROR,
             // for further analysis
-            pkt.DumpRaw(Serial);
-            pkt.getIsrDebugPacket().Dump(Serial);
+            pkt.DumpRaw(AsyncLog);
+            pkt.DumpIsrDebugPacket(AsyncLog);
           #endif // VAN_RX_ISR_DEBUGGING
 
             // Show byte content of packet for easy comparing with the repaired version
-            pkt.DumpRaw(Serial);
+            pkt.DumpRaw(AsyncLog);
+
+            if (! pkt.CheckCrcAndRepair())
+            {
+                CountVanPacketParseResult(VAN_PACKET_PARSE_CRC_ERROR);
+                CountBusCrcError(pkt.Iden());
+                return ""; // CRC error
+            } // if
 
-            if (! pkt.CheckCrcAndRepair()) return ""; // CRC error
+            nVanPacketsCrcRepaired++;
 
             // Print again, after fix
-            pkt.DumpRaw(Serial);
+            pkt.DumpRaw(AsyncLog);
         } // if
     }
     else
     {
   #endif // ON_DESK_MFD_ESP_MAC
 
-        if (! pkt.CheckCrcAndRepair())
+        bool crcOk = pkt.CheckCrc();
+        if (! crcOk && ! pkt.CheckCrcAndRepair())
         {
-          #ifdef PRINT_VAN_CRC_ERROR_PACKETS_ON_SERIAL
-            // Show byte content of packet
-            Serial.printf_P(PSTR("%sVAN PACKET CRC ERROR!\n"), TimeStamp());
-            pkt.DumpRaw(Serial);
+            CountVanPacketParseResult(VAN_PACKET_PARSE_CRC_ERROR);
+            CountBusCrcError(pkt.Iden());
 
-          #ifdef VAN_RX_ISR_DEBUGGING
-            // Fully dump bit timings for packets that have CRC ERROR, for further analysis
-            pkt.getIsrDebugPacket().Dump(Serial);
-          #endif // VAN_RX_ISR_DEBUGGING
-          #endif // PRINT_VAN_CRC_ERROR_PACKETS_ON_SERIAL
+            if (IsDiagEnabled(DIAG_VAN_CRC_ERROR_PACKETS))
+            {
+                // Show byte content of packet
+                Print& log = Log(LOG_LEVEL_WARNING);
+                log.printf_P(PSTR("%sVAN PACKET CRC ERROR!\n"), TimeStamp());
+                pkt.DumpRaw(log);
+
+              #ifdef VAN_RX_ISR_DEBUGGING
+                // Fully dump bit timings for packets that have CRC ERROR, for further analysis
+                pkt.DumpIsrDebugPacket(AsyncLog);
+              #endif // VAN_RX_ISR_DEBUGGING
+            } // if
 
             return ""; // CRC error
         } // if
 
+        if (! crcOk) nVanPacketsCrcRepaired++;
+
   #ifdef ON_DESK_MFD_ESP_MAC
     } // if
   #endif // ON_DESK_MFD_ESP_MAC
@@ -5603,14 +6241,29 @@ const char* ParseVanPacketToJson(TVanPacketRxDesc& pkt)
     while (handler != handlers_end && handler->iden != iden) handler++;
 
     // Hander found?
-    if (handler == handlers_end) return ""; // Unrecognized IDEN value
+    if (handler == handlers_end)
+    {
+        CountVanPacketParseResult(VAN_PACKET_PARSE_UNRECOGNIZED_IDEN);
+        return ""; // Unrecognized IDEN value
+    } // if
 
-    if (handler->dataLen >= 0 && dataLen != handler->dataLen) return ""; // Unexpected packet length
+    handlerPacketCount[handler - handlers]++;
+
+    if (handler->dataLen >= 0 && dataLen != handler->dataLen)
+    {
+        CountVanPacketParseResult(VAN_PACKET_PARSE_UNEXPECTED_LENGTH);
+        return ""; // Unexpected packet length
+    } // if
 
     // Check if packet content is the same as in previous packet and must therefore be ignored
-    if (IsPacketDataDuplicate(pkt, handler)) return "";
+    if (IsPacketDataDuplicate(pkt, handler))
+    {
+        CountVanPacketParseResult(VAN_PACKET_DUPLICATE);
+        return "";
+    } // if
 
-    int result = handler->parser(pkt, jsonBuffer, JSON_BUFFER_SIZE);
+    int result = handler->parser(pkt, vanJsonBuffer, JSON_BUFFER_SIZE);
+    CountVanPacketParseResult(result);
 
     // Errors we would like to see printed on the serial port
     if (result == VAN_PACKET_PARSE_UNEXPECTED_LENGTH
@@ -5618,13 +6271,14 @@ const char* ParseVanPacketToJson(TVanPacketRxDesc& pkt)
         || result == VAN_PACKET_PARSE_JSON_TOO_LONG
        )
     {
-        Serial.printf_P(
+        Print& log = Log(LOG_LEVEL_WARNING);
+        log.printf_P(
             PSTR("%s==> WARNING: VAN packet parsing result = '%s'!\n"),
             TimeStamp(),
             VanPacketParseResultStr(result)
         );
 
-        pkt.DumpRaw(Serial);
+        pkt.DumpRaw(log);
 
         // No use to return the JSON buffer; it is invalid
         return "";
@@ -5633,20 +6287,19 @@ const char* ParseVanPacketToJson(TVanPacketRxDesc& pkt)
     // Any other errors: silently ignore
     if (result != VAN_PACKET_PARSE_OK) return "";
 
-  #ifdef PRINT_JSON_BUFFERS_ON_SERIAL
-    if (IsPacketSelected(iden, SELECTED_PACKETS))
+    if (IsDiagEnabled(DIAG_JSON_BUFFERS))
     {
-        Serial.printf_P(PSTR("%sParsed to JSON object:\n"), TimeStamp());
-        PrintJsonText(jsonBuffer);
+        if (IsDiagPacketSelected(iden))
+        {
+            AsyncLog.printf_P(PSTR("%sParsed to JSON object:\n"), TimeStamp());
+            PrintJsonText(vanJsonBuffer);
+        } // if
     } // if
-  #endif // PRINT_JSON_BUFFERS_ON_SERIAL
 
-    return jsonBuffer;
+    return vanJsonBuffer;
 } // ParseVanPacketToJson
 
-// Called when the user chooses a different distance unit or temperature unit, so that reporting is done immediately,
-// instead of having to wait for a differing packet.
-void ResetPacketPrevData()
+void DoResetPacketPrevData()
 {
     IdenHandler_t* handler = handlers;
 
@@ -5665,4 +6318,81 @@ void ResetPacketPrevData()
     SkipCarStatus1PktDupDetect = true;
     SkipAirCon2PktDupDetect = true;
     SkipEnginePktDupDetect = true;
+} // DoResetPacketPrevData
+
+void DoResetUnitDependentPacketPrevData()
+{
+    if (! unitsOnClient)
+    {
+        DoResetPacketPrevData();
+        return;
+    } // if
+
+    IdenHandler_t* handler = handlers;
+
+    while (handler != handlers_end)
+    {
+        if (handler->prevData != nullptr)
+        {
+            if (handler->iden == AIRCON2_IDEN
+                || handler->iden == SATNAV_STATUS_2_IDEN
+                || handler->iden == SATNAV_GUIDANCE_DATA_IDEN
+                || handler->iden == SATNAV_REPORT_IDEN)
+            {
+                memset(handler->prevData, 0, VAN_MAX_DATA_BYTES);
+                handler->prevDataLen = -1;  // Re-initialize
+            } // if
+        } // if
+
+        handler++;
+    } // while
+
+    SkipAirCon2PktDupDetect = true;
+} // DoResetUnitDependentPacketPrevData
+
+#ifdef VAN_RX_PARSE_TASK
+
+// With VAN_RX_PARSE_TASK, the duplicate detection state is used by the VAN bus receive task while the reset is
+// requested from the main loop or a web server handler. The reset is then only flagged here, and done by the VAN
+// bus receive task before it parses the next packet (see ParseVanPacketToJson).
+volatile bool packetPrevDataResetRequested = false;
+volatile bool unitDependentPacketPrevDataResetRequested = false;
+
+void HandlePacketPrevDataResetRequests()
+{
+    if (packetPrevDataResetRequested)
+    {
+        packetPrevDataResetRequested = false;
+        unitDependentPacketPrevDataResetRequested = false;
+        DoResetPacketPrevData();
+    }
+    else if (unitDependentPacketPrevDataResetRequested)
+    {
+        unitDependentPacketPrevDataResetRequested = false;
+        DoResetUnitDependentPacketPrevData();
+    } // if
+} // HandlePacketPrevDataResetRequests
+
+#endif // VAN_RX_PARSE_TASK
+
+// Called when the client changes the format in which it wants the values, so that reporting is done immediately,
+// instead of having to wait for a differing packet.
+void ResetPacketPrevData()
+{
+  #ifdef VAN_RX_PARSE_TASK
+    packetPrevDataResetRequested = true;
+  #else
+    DoResetPacketPrevData();
+  #endif // VAN_RX_PARSE_TASK
 } // ResetPacketPrevData
+
+// Called on a change of distance or temperature unit. If the client does its own unit conversion
+// ('unitsOnClient'), only the few packets that are still formatted in the selected unit need to be re-sent.
+void ResetUnitDependentPacketPrevData()
+{
+  #ifdef VAN_RX_PARSE_TASK
+    unitDependentPacketPrevDataResetRequested = true;
+  #else
+    DoResetUnitDependentPacketPrevData();
+  #endif // VAN_RX_PARSE_TASK
+} // ResetUnitDependentPacketPrevData
@@ -0,0 +1,295 @@
+
+// Raw VAN bus packet stream, for external analysers
+//
+// Undecoded VAN bus packets are streamed on a separate binary WebSocket ("/raw"), so that new or unknown IDENs can
+// be analysed without re-flashing with debug defines and watching the serial console. Packets are collected and
+// sent together in one binary message, at most every RAW_VAN_WEBSOCKET_BATCH_WINDOW_MS milliseconds. A message
+// that cannot be sent immediately, because the subscriber is too slow, is dropped: the main loop never waits for
+// the subscriber.
+//
+// There is one subscriber at a time; a new connection takes over from the previous one.
+//
+// Binary message format (multi-byte values are little-endian):
+// - Header (4 bytes): format version (1 byte), reserved (1 byte), number of packets dropped since the previous
+//   message (2 bytes, saturating)
+// - Records, one per packet:
+//   - reception time (4 bytes, ESP milliseconds)
+//   - IDEN << 4 | command flags (2 bytes)
+//   - data length in bits 0...4, "CRC OK" in bit 7 (1 byte)
+//   - data bytes
+//   - CRC, as received (2 bytes)
+//
+// Text messages from the subscriber set the IDEN filter (IDENs in hex, comma-separated):
+// - "allow:8A4,4D4": stream only these IDENs
+// - "deny:8A4,564": stream all IDENs except these
+// - "all": stream all IDENs (default)
+
+#ifdef RAW_VAN_WEBSOCKET
+
+// Defined in DateTime.ino
+const char* TimeStamp();
+
+// Defined in Memory.ino
+bool IsMemoryAvailable(int budget, size_t size);
+
+// Defined in Metrics.ino
+extern const char counterStr[];
+int ScalarMetric(char* buf, const int n, PGM_P name, PGM_P type, PGM_P help, uint32_t value);
+
+// Defined in WebServer.ino
+extern AsyncWebServer webServer;
+
+#define RAW_VAN_WEBSOCKET_VERSION (1)
+#define RAW_VAN_WEBSOCKET_HEADER_SIZE (4)
+
+// Largest possible record: time, IDEN and command flags, length, data, CRC
+#define RAW_VAN_WEBSOCKET_MAX_RECORD_SIZE (4 + 2 + 1 + VAN_MAX_DATA_BYTES + 2)
+
+#define RAW_VAN_FLAG_CRC_OK (1 << 7)
+
+AsyncWebSocket rawWebSocket("/raw");
+
+uint32_t rawWebSocketId = 0;  // 0 = no subscriber
+
+enum RawVanFilterMode_t
+{
+    RAW_VAN_FILTER_ALL,
+    RAW_VAN_FILTER_ALLOW,
+    RAW_VAN_FILTER_DENY
+}; // enum RawVanFilterMode_t
+
+uint8_t rawVanFilterMode = RAW_VAN_FILTER_ALL;
+uint16_t rawVanFilterIdens[RAW_VAN_WEBSOCKET_MAX_FILTER_IDENS];
+int nRawVanFilterIdens = 0;
+
+// Packets collected for sending in one message
+uint8_t rawVanBatchBuffer[RAW_VAN_WEBSOCKET_BATCH_MAX_BYTES];
+int rawVanBatchLen = 0;
+int nRawVanBatchedPackets = 0;
+unsigned long rawVanBatchStartedAt = 0;
+
+uint32_t nRawVanDroppedSinceSent = 0;
+
+// Counters, reported in "/metrics"
+uint32_t nRawVanPacketsSent = 0;
+uint32_t nRawVanPacketsDropped = 0;
+uint32_t nRawVanMessagesSent = 0;
+
+// Returns true if the subscriber wants to see packets with the specified IDEN
+bool IsRawVanIdenSelected(uint16_t iden)
+{
+    if (rawVanFilterMode == RAW_VAN_FILTER_ALL) return true;
+
+    bool listed = false;
+    for (int i = 0; i < nRawVanFilterIdens; i++)
+    {
+        if (rawVanFilterIdens[i] == iden)
+        {
+            listed = true;
+            break;
+        } // if
+    } // for
+
+    return rawVanFilterMode == RAW_VAN_FILTER_ALLOW ? listed : ! listed;
+} // IsRawVanIdenSelected
+
+// Send the collected packets as one binary message, or drop them if the subscriber is not ready for it
+void FlushRawVanBatch()
+{
+    if (nRawVanBatchedPackets == 0) return;
+
+    uint16_t nDropped = nRawVanDroppedSinceSent > 0xFFFF ? 0xFFFF : nRawVanDroppedSinceSent;
+    rawVanBatchBuffer[0] = RAW_VAN_WEBSOCKET_VERSION;
+    rawVanBatchBuffer[1] = 0;
+    rawVanBatchBuffer[2] = nDropped & 0xFF;
+    rawVanBatchBuffer[3] = nDropped >> 8;
+
+    if (rawWebSocketId != 0 && rawWebSocket.hasClient(rawWebSocketId) && rawWebSocket.availableForWrite(rawWebSocketId))
+    {
+        rawWebSocket.binary(rawWebSocketId, rawVanBatchBuffer, rawVanBatchLen);
+        nRawVanPacketsSent += nRawVanBatchedPackets;
+        nRawVanMessagesSent++;
+        nRawVanDroppedSinceSent = 0;
+    }
+    else
+    {
+        nRawVanPacketsDropped += nRawVanBatchedPackets;
+        nRawVanDroppedSinceSent += nRawVanBatchedPackets;
+    } // if
+
+    rawVanBatchLen = 0;
+    nRawVanBatchedPackets = 0;
+} // FlushRawVanBatch
+
+// Add a packet to the batch, if there is a subscriber that wants to see it
+void StreamRawVanPacket(const VanPacket_t& pkt)
+{
+    if (rawWebSocketId == 0) return;
+    if (! IsRawVanIdenSelected(pkt.Iden())) return;
+
+    int dataLen = pkt.DataLen();
+    if (dataLen < 0 || dataLen > VAN_MAX_DATA_BYTES) return;
+
+    if (rawVanBatchLen + RAW_VAN_WEBSOCKET_MAX_RECORD_SIZE > RAW_VAN_WEBSOCKET_BATCH_MAX_BYTES) FlushRawVanBatch();
+
+    if (rawVanBatchLen == 0)
+    {
+        rawVanBatchStartedAt = millis();
+        rawVanBatchLen = RAW_VAN_WEBSOCKET_HEADER_SIZE;  // Header is filled in when sending
+    } // if
+
+    uint8_t* p = rawVanBatchBuffer + rawVanBatchLen;
+
+    uint32_t rxTime = pkt.Millis();
+    *p++ = rxTime & 0xFF;
+    *p++ = rxTime >> 8 & 0xFF;
+    *p++ = rxTime >> 16 & 0xFF;
+    *p++ = rxTime >> 24;
+
+    uint16_t idenFlags = pkt.Iden() << 4 | (pkt.CommandFlags() & 0x0F);
+    *p++ = idenFlags & 0xFF;
+    *p++ = idenFlags >> 8;
+
+    *p++ = dataLen | (pkt.CheckCrc() ? RAW_VAN_FLAG_CRC_OK : 0);
+
+    memcpy(p, pkt.Data(), dataLen);
+    p += dataLen;
+
+    uint16_t crc = pkt.Crc();
+    *p++ = crc & 0xFF;
+    *p++ = crc >> 8;
+
+    rawVanBatchLen = p - rawVanBatchBuffer;
+    nRawVanBatchedPackets++;
+} // StreamRawVanPacket
+
+// Set the IDEN filter from a text message of the subscriber
+void ProcessRawWebSocketMessage(const char* payload)
+{
+    const char* list = nullptr;
+    uint8_t mode = RAW_VAN_FILTER_ALL;
+
+    if (strncmp_P(payload, PSTR("allow:"), 6) == 0)
+    {
+        mode = RAW_VAN_FILTER_ALLOW;
+        list = payload + 6;
+    }
+    else if (strncmp_P(payload, PSTR("deny:"), 5) == 0)
+    {
+        mode = RAW_VAN_FILTER_DENY;
+        list = payload + 5;
+    }
+    else if (strcmp_P(payload, PSTR("all")) != 0)
+    {
+        return;
+    } // if
+
+    int n = 0;
+    while (list != nullptr && *list != 0 && n < RAW_VAN_WEBSOCKET_MAX_FILTER_IDENS)
+    {
+        char* end;
+        unsigned long iden = strtoul(list, &end, 16);
+        if (end == list) break;
+        rawVanFilterIdens[n++] = iden & 0xFFF;
+        list = *end == ',' ? end + 1 : end;
+    } // while
+
+    nRawVanFilterIdens = n;
+    rawVanFilterMode = mode;
+
+    AsyncLog.printf_P(PSTR("%s[rawWebSocket] Filter set: '%s'\n"), TimeStamp(), payload);
+} // ProcessRawWebSocketMessage
+
+void RawWebSocketEvent(
+    AsyncWebSocket*,
+    AsyncWebSocketClient* client,
+    AwsEventType type,
+    void* arg,
+    uint8_t* data,
+    size_t len)
+{
+    uint32_t id = client->id();
+
+    switch(type)
+    {
+        case WS_EVT_DISCONNECT:
+        {
+            AsyncLog.printf_P(PSTR("%s[rawWebSocket %" PRIu32 "] Disconnected!\n"), TimeStamp(), id);
+            if (id == rawWebSocketId) rawWebSocketId = 0;
+        }
+        break;
+
+        case WS_EVT_CONNECT:
+        {
+            AsyncLog.printf_P(PSTR("%s[rawWebSocket %" PRIu32 "] Connection from %s\n"),
+                TimeStamp(),
+                id,
+                client->remoteIP().toString().c_str());
+
+            // Take over from the previous subscriber, if any
+            if (rawWebSocketId != 0 && rawWebSocket.hasClient(rawWebSocketId)) rawWebSocket.close(rawWebSocketId);
+            rawWebSocketId = id;
+
+            rawVanFilterMode = RAW_VAN_FILTER_ALL;
+            nRawVanFilterIdens = 0;
+            rawVanBatchLen = 0;  // Discard any collected packets
+            nRawVanBatchedPackets = 0;
+            nRawVanDroppedSinceSent = 0;
+        }
+        break;
+
+        case WS_EVT_DATA:
+        {
+            AwsFrameInfo* info = (AwsFrameInfo*)arg;
+            if (id == rawWebSocketId && info != nullptr && info->final && info->index == 0 && info->len == len
+                && info->opcode == WS_TEXT)
+            {
+                data[len] = '\0';  // See WebSocketEvent in WebSocket.ino
+                ProcessRawWebSocketMessage((char*)data);
+            } // if
+        }
+        break;
+
+        default:
+        break;
+    } // switch
+} // RawWebSocketEvent
+
+void SetupRawWebSocket()
+{
+    rawWebSocket.onEvent(RawWebSocketEvent);
+    webServer.addHandler(&rawWebSocket);
+} // SetupRawWebSocket
+
+void LoopRawWebSocket()
+{
+    // See LoopWebSocket in WebSocket.ino
+    if (IsMemoryAvailable(MEMORY_FOR_WEBSOCKET_CLEANUP, 0)) rawWebSocket.cleanupClients();
+
+    // Send the collected packets when the batch window has passed
+    if (nRawVanBatchedPackets > 0 && millis() - rawVanBatchStartedAt >= RAW_VAN_WEBSOCKET_BATCH_WINDOW_MS)
+    {
+        FlushRawVanBatch();
+    } // if
+} // LoopRawWebSocket
+
+int RawWebSocketMetricsText(int item, char* buf, const int n)
+{
+    switch (item)
+    {
+        case 0:
+            return ScalarMetric(buf, n, PSTR("raw_van_packets_sent_total"), counterStr,
+                PSTR("VAN bus packets streamed on the raw WebSocket."), nRawVanPacketsSent);
+        case 1:
+            return ScalarMetric(buf, n, PSTR("raw_van_packets_dropped_total"), counterStr,
+                PSTR("VAN bus packets dropped because the raw WebSocket subscriber was too slow."),
+                nRawVanPacketsDropped);
+        case 2:
+            return ScalarMetric(buf, n, PSTR("raw_van_messages_sent_total"), counterStr,
+                PSTR("Binary messages sent on the raw WebSocket."), nRawVanMessagesSent);
+        default:
+            return 0;
+    } // switch
+} // RawWebSocketMetricsText
+
+#endif // RAW_VAN_WEBSOCKET
@@ -0,0 +1,348 @@
+// Functions for persistent settings
+//
+// Settings are single bytes, identified by a key (1...SETTINGS_N_KEYS - 1; the former EEPROM position). They are
+// kept in RAM; changes are written to flash later, by LoopSettings, as soon as the VAN bus has been silent for a
+// while, or just before going to sleep (see GoToSleep in Sleep.ino).
+//
+// Writing to flash needs the VAN bus receiver to be disabled, so packets arriving in the meantime are lost. With the
+// emulated EEPROM, every commit erased and rewrote the whole flash sector (tens of milliseconds) for a single changed
+// byte. Therefore, on the ESP8266, the settings are stored as an append-only journal in the flash sector of the
+// emulated EEPROM and the sector just below it: each change appends one 4-byte record, which takes well under a
+// millisecond. Only when the sector is full, it is compacted: the other sector is erased and the current values are
+// written into it. The full sector is left as it is until the next compaction, so a power loss at any moment leaves
+// at least one complete copy (see SETTINGS_JOURNAL_N_SECTORS in Config.h for the flash layout this requires).
+//
+// Sector layout:
+// - Header (12 bytes): "VLCS", sequence number (4 bytes), "complete" marker (4 bytes, 0 when the compaction into
+//   this sector has completed). At startup, the complete sector with the highest sequence number is used.
+// - Records (4 bytes each): key, value, check byte (key ^ value ^ 0x5A), 0x00. The first record that is erased
+//   (all bits set) or invalid ends the journal.
+//
+// On the ESP32, the EEPROM library already stores its data in NVS, which is journaled and wear-levelled by itself;
+// there, only the scheduling of the commits applies.
+
+#ifndef ARDUINO_ARCH_ESP32
+#include <flash_hal.h>  // FS_PHYS_ADDR, FS_PHYS_SIZE
+
+extern "C" uint32_t _EEPROM_start;
+#endif // ARDUINO_ARCH_ESP32
+
+// Defined in PacketToJson.ino
+extern const char emptyStr[];
+
+// Defined in DateTime.ino
+const char* TimeStamp();
+
+// Defined in BusStats.ino
+extern unsigned long busLastPacketAt;
+uint32_t BusPacketsExpectedBetween(unsigned long from, unsigned long to);
+
+// Defined in Metrics.ino
+extern const char counterStr[];
+int ScalarMetric(char* buf, const int n, PGM_P name, PGM_P type, PGM_P help, uint32_t value);
+
+#define SETTINGS_N_KEYS (64)
+
+uint8_t settingsValues[SETTINGS_N_KEYS];
+uint8_t settingsDirty[SETTINGS_N_KEYS / 8];
+bool settingsAnyDirty = false;
+
+// Counters, reported in "/metrics"
+uint32_t nSettingsRecordsWritten = 0;
+uint32_t nSettingsCompactions = 0;
+uint32_t nVanPacketsLostToFlashWrites = 0;  // Estimated
+
+#ifndef ARDUINO_ARCH_ESP32
+
+#define SETTINGS_HEADER_SIZE (12)
+#define SETTINGS_RECORD_SIZE (4)
+#define SETTINGS_RECORD_CHECK(key, value) ((key) ^ (value) ^ 0x5A)
+
+static const char settingsMagic[] = "VLCS";
+
+// The journal occupies 'settingsJournalNSectors' sectors, the last one being the sector of the emulated EEPROM.
+// Normally SETTINGS_JOURNAL_N_SECTORS, but only 1 if the flash layout has no free sector below the emulated EEPROM
+// (see SetupSettings).
+int settingsJournalNSectors = SETTINGS_JOURNAL_N_SECTORS;
+
+#define SETTINGS_FIRST_SECTOR \
+    (((uintptr_t)&_EEPROM_start - 0x40200000) / SPI_FLASH_SEC_SIZE - (settingsJournalNSectors - 1))
+
+int settingsSector = 0;  // Relative to SETTINGS_FIRST_SECTOR
+uint32_t settingsSeqNo = 0;
+uint32_t settingsWriteOffset = 0;  // Within the current sector; SPI_FLASH_SEC_SIZE if a compaction is needed
+
+inline uint32_t SettingsSectorAddress(int sector)
+{
+    return (SETTINGS_FIRST_SECTOR + sector) * SPI_FLASH_SEC_SIZE;
+} // SettingsSectorAddress
+
+// Returns the sequence number of a sector, or 0 if it has no journal
+uint32_t ReadSettingsSectorHeader(int sector, bool& complete)
+{
+    uint32_t header[SETTINGS_HEADER_SIZE / 4];
+    if (! ESP.flashRead(SettingsSectorAddress(sector), header, sizeof(header))) return 0;
+    if (memcmp(header, settingsMagic, 4) != 0 || header[1] == 0xFFFFFFFF) return 0;
+    complete = header[2] == 0;
+    return header[1];
+} // ReadSettingsSectorHeader
+
+// Read the journal of the current sector into 'settingsValues'; sets 'settingsWriteOffset'
+void ReplaySettingsJournal()
+{
+    uint32_t address = SettingsSectorAddress(settingsSector);
+    uint32_t offset = SETTINGS_HEADER_SIZE;
+
+    while (offset < SPI_FLASH_SEC_SIZE)
+    {
+        uint32_t record;
+        if (! ESP.flashRead(address + offset, &record, sizeof(record))) break;
+        if (record == 0xFFFFFFFF) break;  // End of journal
+
+        uint8_t key = record & 0xFF;
+        uint8_t value = record >> 8 & 0xFF;
+        uint8_t check = record >> 16 & 0xFF;
+        if (key >= SETTINGS_N_KEYS || check != SETTINGS_RECORD_CHECK(key, value) || record >> 24 != 0)
+        {
+            // Corrupt record, e.g. after a power loss while writing: do not append after it
+            offset = SPI_FLASH_SEC_SIZE;
+            break;
+        } // if
+
+        settingsValues[key] = value;
+        offset += SETTINGS_RECORD_SIZE;
+    } // while
+
+    settingsWriteOffset = offset;
+} // ReplaySettingsJournal
+
+// Erase the next sector and write all current values into it
+bool CompactSettings()
+{
+    int sector = (settingsSector + 1) % settingsJournalNSectors;
+    uint32_t address = SettingsSectorAddress(sector);
+
+    if (! ESP.flashEraseSector(address / SPI_FLASH_SEC_SIZE)) return false;
+
+    uint32_t header[SETTINGS_HEADER_SIZE / 4];
+    memcpy(header, settingsMagic, 4);
+    header[1] = settingsSeqNo + 1;
+    header[2] = 0xFFFFFFFF;  // Not yet complete
+    if (! ESP.flashWrite(address, header, sizeof(header))) return false;
+
+    uint32_t offset = SETTINGS_HEADER_SIZE;
+    for (int key = 1; key < SETTINGS_N_KEYS; key++)
+    {
+        uint8_t value = settingsValues[key];
+        if (value == 0xFF) continue;  // Never written; reads as "erased"
+
+        uint32_t record = key | value << 8 | SETTINGS_RECORD_CHECK(key, value) << 16;
+        if (! ESP.flashWrite(address + offset, &record, sizeof(record))) return false;
+        offset += SETTINGS_RECORD_SIZE;
+    } // for
+
+    // Mark complete; a sector of which the compaction was interrupted is only used if there is no other
+    uint32_t complete = 0;
+    if (! ESP.flashWrite(address + 8, &complete, sizeof(complete))) return false;
+
+    settingsSector = sector;
+    settingsSeqNo++;
+    settingsWriteOffset = offset;
+    nSettingsCompactions++;
+
+    return true;
+} // CompactSettings
+
+#endif // ARDUINO_ARCH_ESP32
+
+uint8_t ReadSetting(int key)
+{
+    if (key <= 0 || key >= SETTINGS_N_KEYS) return 0xFF;
+    return settingsValues[key];
+} // ReadSetting
+
+void WriteSetting(int const key, uint8_t const val, const char* message)
+{
+    if (key <= 0 || key >= SETTINGS_N_KEYS) return;
+
+    settingsValues[key] = val;
+    settingsDirty[key / 8] |= 1 << (key % 8);
+    settingsAnyDirty = true;
+
+    AsyncLog.printf_P(
+        PSTR("==> %s: written value %u to setting %d (but not yet committed)\n"),
+        message ? message : emptyStr,
+        val,
+        key);
+} // WriteSetting
+
+// Write all changed settings to flash. Returns false if that requires more time than the bus silence allows; the
+// caller can then try again later, or pass 'force'.
+bool CommitSettings(bool force)
+{
+    if (! settingsAnyDirty) return true;
+
+  #ifndef ARDUINO_ARCH_ESP32
+    int nDirty = 0;
+    for (int key = 1; key < SETTINGS_N_KEYS; key++) if (settingsDirty[key / 8] & 1 << (key % 8)) nDirty++;
+
+    bool mustCompact = settingsWriteOffset + nDirty * SETTINGS_RECORD_SIZE > SPI_FLASH_SEC_SIZE;
+    if (mustCompact && ! force && millis() - busLastPacketAt < SETTINGS_COMPACT_AFTER_BUS_SILENCE_MS) return false;
+  #endif // ARDUINO_ARCH_ESP32
+
+    unsigned long disabledAt = millis();
+    VanBusRx.Disable();
+
+    bool ok = true;
+
+  #ifdef ARDUINO_ARCH_ESP32
+    for (int key = 1; key < SETTINGS_N_KEYS; key++) EEPROM.write(key, settingsValues[key]);
+    ok = EEPROM.commit();  // Will only write to flash if any data was actually changed
+    if (ok) nSettingsRecordsWritten++;
+  #else
+    if (mustCompact)
+    {
+        // Compaction writes all current values, so no need to append anything
+        ok = CompactSettings();
+    }
+    else
+    {
+        uint32_t address = SettingsSectorAddress(settingsSector);
+        for (int key = 1; ok && key < SETTINGS_N_KEYS; key++)
+        {
+            if ((settingsDirty[key / 8] & 1 << (key % 8)) == 0) continue;
+
+            uint8_t value = settingsValues[key];
+            uint32_t record = key | value << 8 | SETTINGS_RECORD_CHECK(key, value) << 16;
+            ok = ESP.flashWrite(address + settingsWriteOffset, &record, sizeof(record));
+            if (ok)
+            {
+                settingsWriteOffset += SETTINGS_RECORD_SIZE;
+                nSettingsRecordsWritten++;
+            } // if
+        } // for
+    } // if
+  #endif // ARDUINO_ARCH_ESP32
+
+    VanBusRx.Enable();
+    unsigned long enabledAt = millis();
+
+    nVanPacketsLostToFlashWrites += BusPacketsExpectedBetween(disabledAt, enabledAt);
+
+    if (! ok)
+    {
+        Log(LOG_LEVEL_ERROR).printf_P(PSTR("%s==> Failed to write settings to flash\n"), TimeStamp());
+
+      #ifndef ARDUINO_ARCH_ESP32
+        settingsWriteOffset = SPI_FLASH_SEC_SIZE;  // Compact at the next attempt
+      #endif // ARDUINO_ARCH_ESP32
+
+        return false;
+    } // if
+
+    memset(settingsDirty, 0, sizeof(settingsDirty));
+    settingsAnyDirty = false;
+
+    AsyncLog.printf_P(PSTR("%s==> Committed settings to flash in %lu msec\n"), TimeStamp(), enabledAt - disabledAt);
+
+    return true;
+} // CommitSettings
+
+void SetupSettings()
+{
+    memset(settingsValues, 0xFF, sizeof(settingsValues));
+
+  #ifdef ARDUINO_ARCH_ESP32
+    EEPROM.begin(SETTINGS_N_KEYS);
+    for (int key = 1; key < SETTINGS_N_KEYS; key++) settingsValues[key] = EEPROM.read(key);
+  #else
+    // Do not write into the flash file system
+    if (SettingsSectorAddress(0) < FS_PHYS_ADDR + FS_PHYS_SIZE)
+    {
+        Serial.printf_P(
+            PSTR("Settings: no free flash sector below the EEPROM sector; settings may be lost at a power loss"
+                " (see SETTINGS_JOURNAL_N_SECTORS in Config.h)\n")
+        );
+        settingsJournalNSectors = 1;
+    } // if
+
+    // Find the sector with the most recent journal, preferring complete ones
+    settingsSeqNo = 0;
+    bool foundComplete = false;
+    for (int sector = 0; sector < settingsJournalNSectors; sector++)
+    {
+        bool complete = false;
+        uint32_t seqNo = ReadSettingsSectorHeader(sector, complete);
+        if (seqNo == 0 || (foundComplete && ! complete)) continue;
+        if (seqNo <= settingsSeqNo && complete == foundComplete) continue;
+        settingsSeqNo = seqNo;
+        settingsSector = sector;
+        foundComplete = complete;
+    } // for
+
+    if (settingsSeqNo > 0)
+    {
+        ReplaySettingsJournal();
+
+        if (! foundComplete)
+        {
+            // Best effort: use what the interrupted compaction has written, and compact again at the first commit
+            settingsWriteOffset = SPI_FLASH_SEC_SIZE;
+            settingsDirty[0] = 1 << 1;
+            settingsAnyDirty = true;
+        } // if
+    }
+    else
+    {
+        // No journal yet: take over any values stored by the emulated EEPROM (one byte per position, at the start
+        // of the last sector), and write them into a journal at the first commit. The compaction goes into the other
+        // sector, so the EEPROM values stay until the journal is complete.
+        settingsSector = settingsJournalNSectors - 1;
+        uint32_t legacy[SETTINGS_N_KEYS / 4];
+        if (ESP.flashRead(SettingsSectorAddress(settingsSector), legacy, sizeof(legacy)))
+        {
+            memcpy(settingsValues, legacy, sizeof(settingsValues));
+        } // if
+        settingsValues[0] = 0xFF;
+
+        settingsWriteOffset = SPI_FLASH_SEC_SIZE;
+        settingsDirty[0] = 1 << 1;  // Any key will do; the compaction writes all values
+        settingsAnyDirty = true;
+    } // if
+
+    Serial.printf_P(
+        PSTR("Settings: journal sequence number %" PRIu32 ", %" PRIu32 " bytes used\n"),
+        settingsSeqNo,
+        settingsWriteOffset
+    );
+  #endif // ARDUINO_ARCH_ESP32
+} // SetupSettings
+
+// Called from the main loop: commit changed settings once the VAN bus has been silent for a while
+void LoopSettings()
+{
+    if (! settingsAnyDirty) return;
+    if (VanBusRx.GetNQueued() > 0) return;
+    if (millis() - busLastPacketAt < SETTINGS_COMMIT_AFTER_BUS_SILENCE_MS) return;  // Arithmetic has safe roll-over
+
+    CommitSettings(false);
+} // LoopSettings
+
+int SettingsMetricsText(int item, char* buf, const int n)
+{
+    switch (item)
+    {
+        case 0:
+            return ScalarMetric(buf, n, PSTR("settings_records_written_total"), counterStr,
+                PSTR("Setting changes written to flash."), nSettingsRecordsWritten);
+        case 1:
+            return ScalarMetric(buf, n, PSTR("settings_compactions_total"), counterStr,
+                PSTR("Compactions of the settings journal in flash."), nSettingsCompactions);
+        case 2:
+            return ScalarMetric(buf, n, PSTR("van_packets_lost_to_flash_writes_total"), counterStr,
+                PSTR("Estimated VAN bus packets lost because the receiver was disabled for writing settings to flash."),
+                nVanPacketsLostToFlashWrites);
+        default:
+            return 0;
+    } // switch
+} // SettingsMetricsText
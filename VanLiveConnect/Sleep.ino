@@ -15,17 +15,44 @@
   }
 #endif // ARDUINO_ARCH_ESP32
 
-// Defined in Eeprom.ino
-void CommitEeprom();
+// Defined in Settings.ino
+bool CommitSettings(bool force);
 
 // Defined in IRrecv.ino
 void IrDisable();
 
+// Defined in Log.ino
+void FlushLog();
+
 unsigned long lastActivityAt = 0;
 
+// Set by SetupSleep: true if this start is a wake-up from sleep, not a power-on or reset (see WakeTrace.ino)
+bool wokeUpFromSleep = false;
+
+// Time from waking up until the restart that follows it; ESP8266 only (see GoToSleep)
+uint32_t msecFromWakeToRestart = 0;
+
+#ifndef ARDUINO_ARCH_ESP32
+
+// Passed on in RTC memory, which survives a restart, from GoToSleep to SetupSleep
+struct WakeInfo_t
+{
+    uint32_t magic;
+    uint32_t msecFromWakeToRestart;
+}; // struct WakeInfo_t
+
+#define WAKE_INFO_MAGIC (0x57414B45)  // "WAKE"
+// In 4-byte blocks, within the RTC user memory. Blocks 0...31 are used by the boot loader for OTA updates (eboot
+// command), so stay clear of those.
+#define WAKE_INFO_RTC_OFFSET (32)
+
+#endif // ARDUINO_ARCH_ESP32
+
 void SetupSleep()
 {
   #ifdef ARDUINO_ARCH_ESP32
+    wokeUpFromSleep = esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_EXT0;
+
     esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_ALL);
 
     // Configure pullup/downs via RTCIO to tie wakeup pins to inactive level during deepsleep.
@@ -35,6 +62,18 @@ void SetupSleep()
     rtc_gpio_pulldown_dis(LIGHT_SLEEP_WAKE_PIN);
 
   #else
+    WakeInfo_t wakeInfo;
+    if (ESP.rtcUserMemoryRead(WAKE_INFO_RTC_OFFSET, (uint32_t*)&wakeInfo, sizeof(wakeInfo))
+        && wakeInfo.magic == WAKE_INFO_MAGIC)
+    {
+        wokeUpFromSleep = true;
+        msecFromWakeToRestart = wakeInfo.msecFromWakeToRestart;
+
+        // Don't mistake a later reset for a wake-up
+        wakeInfo.magic = 0;
+        ESP.rtcUserMemoryWrite(WAKE_INFO_RTC_OFFSET, (uint32_t*)&wakeInfo, sizeof(wakeInfo));
+    } // if
+
     gpio_pin_wakeup_disable();
     pinMode(LIGHT_SLEEP_WAKE_PIN, INPUT_PULLUP);
     pinMode(LIGHT_SLEEP_WAKE_PIN_ALT, INPUT_PULLUP);
@@ -57,6 +96,9 @@ void WakeupCallback()
 
 void GoToSleep()
 {
+    // Write any collected log text first
+    FlushLog();
+
     Serial.printf_P
     (
         PSTR("%s===> Entering %s sleep mode; will wake up when detecting VAN bus activity on pin %s (GPIO%u)\n"),
@@ -75,14 +117,16 @@ void GoToSleep()
     delay(1);
 
     IrDisable();
+
+    // Last chance to write changed settings; no need to wait for bus silence anymore
+    CommitSettings(true);
+
     VanBusRx.Disable();
 
   #ifndef ARDUINO_ARCH_ESP32
     ESP.wdtFeed();
   #endif // ARDUINO_ARCH_ESP32
 
-    CommitEeprom();
-
     delay(1000);
 
     // TODO - need this?
@@ -113,6 +157,9 @@ void GoToSleep()
     // is pulled low (~ 0 Volt) when dominant, i.e. when VAN bus activity occurs.
 
     // Execution resumes here after wakeup
+  #ifndef ARDUINO_ARCH_ESP32
+    unsigned long wokeUpAt = millis();
+  #endif // ARDUINO_ARCH_ESP32
 
     delay(100);
 
@@ -129,7 +176,13 @@ void GoToSleep()
     );
     Serial.flush();
 
-    delay(500);
+  #ifndef ARDUINO_ARCH_ESP32
+    // Tell the restarted sketch that it is waking up, and how long ago (see WakeTrace.ino)
+    WakeInfo_t wakeInfo;
+    wakeInfo.magic = WAKE_INFO_MAGIC;
+    wakeInfo.msecFromWakeToRestart = millis() - wokeUpAt;
+    ESP.rtcUserMemoryWrite(WAKE_INFO_RTC_OFFSET, (uint32_t*)&wakeInfo, sizeof(wakeInfo));
+  #endif // ARDUINO_ARCH_ESP32
 
     // Let's go for a fresh 'n fruity start
     ESP.restart();
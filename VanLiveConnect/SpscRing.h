@@ -0,0 +1,124 @@
+#ifndef SpscRing_h
+#define SpscRing_h
+
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+
+// Lock-free ring buffer of variable-length messages, for exactly one producer and one consumer, each in its own
+// task (thread). Each message is stored contiguously, so that the consumer can use it in place. When a message
+// does not fit in the space left at the end of the ring, that space is skipped.
+//
+// Has no dependencies on Arduino, so that it can be tested on a host with std::thread.
+//
+// 'SIZE' (in bytes) must be a power of 2, and a multiple of 8.
+template <uint32_t SIZE>
+class SpscRing_t
+{
+  public:
+
+    // Producer side: copy a message into the ring. Returns false, without queueing anything, if there is no room.
+    bool Push(const void* data, uint32_t len, uint32_t tag = 0)
+    {
+        uint32_t recordSize = RecordSize(len);
+        if (recordSize > SIZE) return false;
+
+        uint32_t head = this->head.load(std::memory_order_relaxed);
+        uint32_t tail = this->tail.load(std::memory_order_acquire);
+
+        uint32_t at = head % SIZE;
+        uint32_t toEnd = SIZE - at;
+        uint32_t needed = recordSize <= toEnd ? recordSize : toEnd + recordSize;
+        if (needed > SIZE - (head - tail)) return false;  // Arithmetic has safe roll-over
+
+        if (recordSize > toEnd)
+        {
+            // Skip the space at the end of the ring
+            Header_t skip = { SKIP_MARKER, 0 };
+            memcpy(ring + at, &skip, sizeof(skip));
+            head += toEnd;
+            at = 0;
+        } // if
+
+        Header_t header = { len, tag };
+        memcpy(ring + at, &header, sizeof(header));
+        memcpy(ring + at + sizeof(header), data, len);
+
+        head += recordSize;
+        this->head.store(head, std::memory_order_release);
+
+        if (head - tail > maxBytesUsed) maxBytesUsed = head - tail;
+
+        return true;
+    } // Push
+
+    // Consumer side: returns the oldest message, or nullptr if the ring is empty. The message remains valid until
+    // Pop() is called.
+    const uint8_t* Front(uint32_t& len, uint32_t& tag)
+    {
+        uint32_t tail = this->tail.load(std::memory_order_relaxed);
+        uint32_t head = this->head.load(std::memory_order_acquire);
+        if (tail == head) return nullptr;
+
+        uint32_t at = tail % SIZE;
+        Header_t header;
+        memcpy(&header, ring + at, sizeof(header));
+
+        if (header.len == SKIP_MARKER)
+        {
+            // The producer wraps around only when the message itself is complete, so it can be read right away
+            tail += SIZE - at;
+            this->tail.store(tail, std::memory_order_release);
+            at = 0;
+            memcpy(&header, ring, sizeof(header));
+        } // if
+
+        len = header.len;
+        tag = header.tag;
+        return ring + at + sizeof(header);
+    } // Front
+
+    // Consumer side: remove the message returned by Front()
+    void Pop()
+    {
+        uint32_t tail = this->tail.load(std::memory_order_relaxed);
+        Header_t header;
+        memcpy(&header, ring + tail % SIZE, sizeof(header));
+        this->tail.store(tail + RecordSize(header.len), std::memory_order_release);
+    } // Pop
+
+    bool IsEmpty() const
+    {
+        return tail.load(std::memory_order_acquire) == head.load(std::memory_order_acquire);
+    } // IsEmpty
+
+    // Highest number of bytes in use since start; written by the producer only
+    uint32_t maxBytesUsed = 0;
+
+  private:
+
+    struct Header_t
+    {
+        uint32_t len;
+        uint32_t tag;
+    }; // struct Header_t
+
+    static constexpr uint32_t SKIP_MARKER = 0xFFFFFFFF;
+
+    static_assert((SIZE & (SIZE - 1)) == 0 && SIZE % sizeof(Header_t) == 0, "SIZE must be a power of 2");
+
+    // Header plus message, rounded up to a multiple of the header size, so that a skipped space at the end of the
+    // ring can always hold a header
+    static uint32_t RecordSize(uint32_t len)
+    {
+        return (sizeof(Header_t) + len + sizeof(Header_t) - 1) / sizeof(Header_t) * sizeof(Header_t);
+    } // RecordSize
+
+    alignas(4) uint8_t ring[SIZE];
+
+    // Free-running byte counters; the producer owns 'head', the consumer owns 'tail'
+    std::atomic<uint32_t> head{0};
+    std::atomic<uint32_t> tail{0};
+}; // class SpscRing_t
+
+#endif // SpscRing_h
@@ -14,6 +14,8 @@
 
 #include "Config.h"
 #include "VanIden.h"
+#include "VanPacket.h"
+#include "Log.h"
 #include "VanLiveConnectVersion.h"
 
 // We need access to class AsyncWebSocketClient private members _runQueue() and _messageQueue
@@ -61,6 +63,7 @@ char dummy_var_to_use_cppXX[] PROGMEM = R"==(")==";
 
 // Defined in Sleep.ino
 extern unsigned long lastActivityAt;
+extern bool wokeUpFromSleep;
 
 // Over The Air (OTA) update, defined in BasicOTA.ino
 void SetupOta();
@@ -75,12 +78,36 @@ void LoopWebServer();
 
 // Defined in WebSocket.ino
 bool SendJsonOnWebSocket(const char* json, bool saveForLater = false, bool isTestMessage = false);
+bool SendIrJsonOnWebSocket(const char* json);
 void SetupWebSocket();
 void LoopWebSocket();
 
+// Defined in Log.ino
+void SetupLog();
+void LoopLog();
+void PrintDiagnostics(Print& s);
+
+#ifdef RAW_VAN_WEBSOCKET
+// Defined in RawWebSocket.ino
+void SetupRawWebSocket();
+void LoopRawWebSocket();
+void StreamRawVanPacket(const VanPacket_t& pkt);
+#endif // RAW_VAN_WEBSOCKET
+const char* WebSocketStatsToJson(char* buf, const int n);
+
+// Defined in Settings.ino
+void SetupSettings();
+void LoopSettings();
+
 // Defined in Esp.ino
 void PrintSystemSpecs();
 const char* EspRuntimeDataToJson(char* buf, const int n);
+void SampleFreeHeap();
+
+// Defined in LatencyTrace.ino
+const char* StampLatencyTrace(const char* json, const VanPacket_t& pkt);
+const char* LatencyStatsToJson(char* buf, const int n);
+void RecordIrPressToFrame(unsigned long msec);
 
 // Defined in Wifi.ino
 const char* SetupWifi();
@@ -97,6 +124,57 @@ enum VanPacketFilter_t
     VAN_PACKETS_SAT_NAV_PKTS
 }; // enum VanPacketFilter_t
 
+#ifdef MEASURE_LOOP_STAGES
+
+enum LoopStage_t
+{
+    LOOP_STAGE_DNS,
+    LOOP_STAGE_WIFI,
+    LOOP_STAGE_OTA,
+    LOOP_STAGE_WEBSOCKET,
+    LOOP_STAGE_WEBSERVER,
+    LOOP_STAGE_IR,
+    LOOP_STAGE_VAN,
+    LOOP_STAGE_STATS,
+    N_LOOP_STAGES
+}; // enum LoopStage_t
+
+// Defined in LoopStats.ino
+void LoopStagesStart();
+void LoopStageDone(int stage);
+const char* LoopStatsToJson(char* buf, const int n);
+
+#define LOOP_STAGES_START() LoopStagesStart()
+#define LOOP_STAGE_DONE(stage) LoopStageDone(stage)
+
+#else
+
+#define LOOP_STAGES_START()
+#define LOOP_STAGE_DONE(stage)
+
+#endif // MEASURE_LOOP_STAGES
+
+// Phases of the wake sequence, in the order in which they are normally first reached (see WakeTrace.ino)
+enum WakePhase_t
+{
+    WAKE_PHASE_SETUP,  // Entered setup()
+    WAKE_PHASE_SETTINGS,
+    WAKE_PHASE_VAN_RX,
+    WAKE_PHASE_WIFI,  // Access point started, or connecting to the hotspot
+    WAKE_PHASE_STORE,
+    WAKE_PHASE_WEB_SERVER,  // DNS, web server and WebSockets
+    WAKE_PHASE_READY,  // Left setup()
+    WAKE_PHASE_FIRST_VAN_PACKET,
+    WAKE_PHASE_WIFI_LINK,  // Client associated with the access point, or connected to the hotspot
+    WAKE_PHASE_WEBSOCKET_CLIENT,
+    WAKE_PHASE_FIRST_FRAME,  // First frame sent on a WebSocket
+    N_WAKE_PHASES
+}; // enum WakePhase_t
+
+// Defined in WakeTrace.ino
+void MarkWakePhase(int phase, unsigned long at);
+void MarkWakePhase(int phase);
+
 // Infrared receiver
 
 // Results returned from the IR decoder
@@ -105,8 +183,6 @@ typedef struct
     unsigned long value;  // Decoded value
     PGM_P buttonStr;
     int bits;  // Number of bits in decoded value
-    volatile unsigned int* rawbuf;  // Raw intervals in 50 usec ticks
-    int rawlen;  // Number of records in rawbuf
     bool held;
     unsigned long millis_;
 } TIrPacket;
@@ -126,34 +202,43 @@ bool IrReceive(TIrPacket& irPacket);
 
 String md5Checksum = "";
 
+// Counters, reported in "/metrics"
+uint32_t nVanRxQueueOverruns = 0;
+uint32_t nVanPacketsDiscarded = 0;  // To prevent RX queue overflow
+
 // The following VAN bus packets are considered very important, and should not be skipped when the VAN bus RX queue
 // is overrunning
-bool IRAM_ATTR IsVeryImportantPacket(const TVanPacketRxDesc& pkt)
+bool IRAM_ATTR IsVeryImportantIden(uint16_t iden, const uint8_t* data, int dataLen)
 {
     return
-        pkt.DataLen() >= 3 &&
+        dataLen >= 3 &&
         (
-            (pkt.Iden() == DEVICE_REPORT && pkt.Data()[0] == 0x07) // mfd_to_satnav_...
-            || (pkt.Iden() == DEVICE_REPORT && pkt.Data()[0] == 0x8A)  // head_unit_report, head_unit_button_pressed
-            || pkt.Iden() == CAR_STATUS1_IDEN  // Right-hand stalk button press
-            || pkt.Iden() == CAR_STATUS2_IDEN  // Info and alarm popups
-            || pkt.Iden() == MFD_LANGUAGE_UNITS_IDEN
-            || pkt.Iden() == AUDIO_SETTINGS_IDEN
-            || pkt.Iden() == SATNAV_STATUS_1_IDEN
-            || pkt.Iden() == SATNAV_STATUS_2_IDEN
-            || pkt.Iden() == SATNAV_GUIDANCE_IDEN
-            || pkt.Iden() == SATNAV_REPORT_IDEN
-            || pkt.Iden() == MFD_TO_SATNAV_IDEN
-            || pkt.Iden() == SATNAV_TO_MFD_IDEN
+            (iden == DEVICE_REPORT && data[0] == 0x07) // mfd_to_satnav_...
+            || (iden == DEVICE_REPORT && data[0] == 0x8A)  // head_unit_report, head_unit_button_pressed
+            || iden == CAR_STATUS1_IDEN  // Right-hand stalk button press
+            || iden == CAR_STATUS2_IDEN  // Info and alarm popups
+            || iden == MFD_LANGUAGE_UNITS_IDEN
+            || iden == AUDIO_SETTINGS_IDEN
+            || iden == SATNAV_STATUS_1_IDEN
+            || iden == SATNAV_STATUS_2_IDEN
+            || iden == SATNAV_GUIDANCE_IDEN
+            || iden == SATNAV_REPORT_IDEN
+            || iden == MFD_TO_SATNAV_IDEN
+            || iden == SATNAV_TO_MFD_IDEN
         );
+} // IsVeryImportantIden
+
+bool IRAM_ATTR IsVeryImportantPacket(const TVanPacketRxDesc& pkt)
+{
+    return IsVeryImportantIden(pkt.Iden(), pkt.Data(), pkt.DataLen());
 } // IsVeryImportantPacket
 
 // For VAN-bus packets identified as "important", the JSON data will be kept for later sending if the WebSocket
 // send queue is full. By default, the WebSocket has 8 slots; see AsyncWebSocket.h: "#define WS_MAX_QUEUED_MESSAGES 8".
-bool IsImportantPacket(const TVanPacketRxDesc& pkt)
+bool IsImportantPacket(const VanPacket_t& pkt)
 {
     return
-        IsVeryImportantPacket(pkt)
+        IsVeryImportantIden(pkt.Iden(), pkt.Data(), pkt.DataLen())
         ||
         (
             pkt.DataLen() >= 3 &&
@@ -166,6 +251,27 @@ bool IsImportantPacket(const TVanPacketRxDesc& pkt)
         );
 } // IsImportantPacket
 
+// Defined in VanRxPolicy.ino
+int SetupVanRxPolicy(int queueSize);
+bool IsPacketAdmitted(const TVanPacketRxDesc& pkt);
+bool IsPacketDecimated(const VanPacket_t& pkt);
+
+// Defined in BusStats.ino
+void RecordBusPacket(const VanPacket_t& pkt);
+void RollBusStatsWindow();
+const char* BusStatsToJson(char* buf, const int n);
+
+#ifdef VAN_TRACE_RECORDER
+// Defined in VanTrace.ino
+void RecordVanTrace(const TVanPacketRxDesc& pkt);
+bool VanTraceLoop();
+const char* VanTraceStatusToJson(char* buf, const int n);
+
+// Defined in VanTraceReplay.ino
+bool IsVanTraceReplaying();
+bool VanTraceReplayLoop();
+#endif // VAN_TRACE_RECORDER
+
 void SetupVanReceiver()
 {
   #if defined VAN_RX_IFS_DEBUGGING
@@ -177,9 +283,13 @@ void SetupVanReceiver()
     #define VAN_PACKET_QUEUE_SIZE 30
   #endif
 
+    int dropThreshold = SetupVanRxPolicy(VAN_PACKET_QUEUE_SIZE);
+
   #if VAN_BUS_VERSION_INT >= 000003003
-    // When queue fills above 80%, start dropping non-essential packets
-    VanBusRx.SetDropPolicy(VAN_PACKET_QUEUE_SIZE * 8 / 10, &IsVeryImportantPacket);
+    // When the queue fills above the lowest threshold, start dropping packets (see VanRxPolicy.ino)
+    VanBusRx.SetDropPolicy(dropThreshold, &IsPacketAdmitted);
+  #else
+    (void)dropThreshold;
   #endif
 
   // Use #defines, not const int, so that the Serial.printf_P below shows the correct pin name on the console.
@@ -222,7 +332,54 @@ void SetupVanReceiver()
 } // SetupVanReceiver
 
 // Defined in PacketToJson.ino
-const char* ParseVanPacketToJson(TVanPacketRxDesc& pkt);
+const char* ParseVanPacketToJson(VanPacket_t& pkt);
+
+#ifdef VAN_RX_PARSE_TASK
+// Defined in VanRxTask.ino
+void SetupVanRxTask();
+void LoopVanRxTask();
+void QueueVanJson(const char* json, bool saveForLater);
+void QueueRawVanPacket(const VanPacket_t& pkt);
+#endif // VAN_RX_PARSE_TASK
+
+// Send the JSON produced from a VAN bus packet. With VAN_RX_PARSE_TASK, the main loop does the actual sending.
+void SendVanJson(const char* json, bool saveForLater = false)
+{
+  #ifdef VAN_RX_PARSE_TASK
+    QueueVanJson(json, saveForLater);
+  #else
+    SendJsonOnWebSocket(json, saveForLater);
+  #endif // VAN_RX_PARSE_TASK
+} // SendVanJson
+
+#ifdef RAW_VAN_WEBSOCKET
+void SendRawVanPacket(const VanPacket_t& pkt)
+{
+  #ifdef VAN_RX_PARSE_TASK
+    QueueRawVanPacket(pkt);
+  #else
+    StreamRawVanPacket(pkt);
+  #endif // VAN_RX_PARSE_TASK
+} // SendRawVanPacket
+#endif // RAW_VAN_WEBSOCKET
+
+// Process a VAN bus packet, either taken from the VanBusRx receive queue or replayed from a trace (see
+// VanTraceReplay.ino)
+void ProcessVanPacket(VanPacket_t& pkt)
+{
+    RecordBusPacket(pkt);
+
+  #ifdef RAW_VAN_WEBSOCKET
+    SendRawVanPacket(pkt);
+  #endif // RAW_VAN_WEBSOCKET
+
+  #ifdef VAN_RX_DECIMATION
+    // Skip redundant packets of high-rate IDEN values before spending any time on them (see VanRxPolicy.ino)
+    if (IsPacketDecimated(pkt)) return;
+  #endif // VAN_RX_DECIMATION
+
+    SendVanJson(StampLatencyTrace(ParseVanPacketToJson(pkt), pkt), IsImportantPacket(pkt));
+} // ProcessVanPacket
 
 // Defined in Sleep.ino
 void SetupSleep();
@@ -232,10 +389,19 @@ void GoToSleep();
 const char* DateTime(time_t, boolean = false);
 void PrintTimeStamp();
 
-// TODO - reduce size of large JSON packets like the ones containing guidance instruction icons
+// Large JSON packets are the ones containing guidance instruction icons, unless the client has set
+// 'guidanceIconsOnClient' (see PacketToJson.ino)
 #define JSON_BUFFER_SIZE 4096
 char jsonBuffer[JSON_BUFFER_SIZE];
 
+// VAN bus packets are parsed into 'vanJsonBuffer'. With VAN_RX_PARSE_TASK, that is done by another task than the
+// main loop, so it needs a buffer of its own.
+#ifdef VAN_RX_PARSE_TASK
+char vanJsonBuffer[JSON_BUFFER_SIZE];
+#else
+#define vanJsonBuffer jsonBuffer
+#endif // VAN_RX_PARSE_TASK
+
 #ifdef SHOW_VAN_RX_STATS
 
 #include <PrintEx.h>  // https://github.com/Chris--A/PrintEx plus patches from https://github.com/0xCAFEDECAF/VanLiveConnect/tree/main/VanLiveConnect/Patches/Arduino/libraries/PrintEx
@@ -282,51 +448,117 @@ const char* VanBusStatsToJson(char* buf, const int n)
 void PrintDebugDefines()
 {
     Serial.print(F("Compiled with following debug #define's (see file 'Config.h'):\n"));
-  #if defined TEST_SETUP_KEEP_AWAKE || defined DEBUG_IR_RECV \
-    || defined DEBUG_WEBSERVER || defined DEBUG_WEBSOCKET \
-    || defined DEBUG_ORIGINAL_MFD || defined WIFI_STRESS_TEST \
-    || defined SHOW_VAN_RX_STATS || defined PRINT_RAW_PACKET_DATA \
-    || defined PRINT_JSON_BUFFERS_ON_SERIAL || defined PRINT_VAN_CRC_ERROR_PACKETS_ON_SERIAL
+  #if defined TEST_SETUP_KEEP_AWAKE || defined WIFI_STRESS_TEST || defined SHOW_VAN_RX_STATS
 
   #ifdef TEST_SETUP_KEEP_AWAKE
     Serial.print(F("- TEST_SETUP_KEEP_AWAKE\n"));
   #endif // TEST_SETUP_KEEP_AWAKE
-  #ifdef DEBUG_IR_RECV
-    Serial.print(F("- DEBUG_IR_RECV\n"));
-  #endif // DEBUG_IR_RECV
-  #ifdef DEBUG_WEBSERVER
-    Serial.print(F("- DEBUG_WEBSERVER\n"));
-  #endif // DEBUG_WEBSERVER
-  #ifdef DEBUG_WEBSOCKET
-    Serial.printf_P(PSTR("- DEBUG_WEBSOCKET = %d\n"), DEBUG_WEBSOCKET);
-  #endif // DEBUG_WEBSOCKET
-  #ifdef DEBUG_ORIGINAL_MFD
-    Serial.print(F("- DEBUG_ORIGINAL_MFD\n"));
-  #endif // DEBUG_ORIGINAL_MFD
   #ifdef WIFI_STRESS_TEST
     Serial.printf_P(PSTR("- WIFI_STRESS_TEST = %d\n"), WIFI_STRESS_TEST);
   #endif // WIFI_STRESS_TEST
   #ifdef SHOW_VAN_RX_STATS
     Serial.print(F("- SHOW_VAN_RX_STATS\n"));
   #endif // SHOW_VAN_RX_STATS
-  #ifdef PRINT_RAW_PACKET_DATA
-    Serial.print(F("- PRINT_RAW_PACKET_DATA\n"));
-  #endif // PRINT_RAW_PACKET_DATA
-  #ifdef PRINT_JSON_BUFFERS_ON_SERIAL
-    Serial.print(F("- PRINT_JSON_BUFFERS_ON_SERIAL\n"));
-  #endif // PRINT_JSON_BUFFERS_ON_SERIAL
-  #ifdef PRINT_VAN_CRC_ERROR_PACKETS_ON_SERIAL
-    Serial.print(F("- PRINT_VAN_CRC_ERROR_PACKETS_ON_SERIAL\n"));
-  #endif // PRINT_VAN_CRC_ERROR_PACKETS_ON_SERIAL
 
   #else
     Serial.print(F("<none>\n"));
   #endif // defined ...
+
+    PrintDiagnostics(Serial);
 } // PrintDebugDefines
 
 // After a few minutes of VAN bus inactivity, go to sleep to save power
 long sleepAfter = SLEEP_MS_AFTER_NO_VAN_BUS_ACTIVITY;
 
+// Receive and process one VAN bus packet, if available. Returns true if a packet was received. With
+// VAN_RX_PARSE_TASK, this runs in the VAN bus receive task (see VanRxTask.ino).
+bool ReceiveVanPacket()
+{
+    TVanPacketRxDesc pkt;
+    bool isQueueOverrun = false;
+    bool received = VanBusRx.Receive(pkt, &isQueueOverrun);
+    if (received)
+    {
+        lastActivityAt = millis();
+        MarkWakePhase(WAKE_PHASE_FIRST_VAN_PACKET, pkt.Millis());
+
+        // Set if the last packet taken from the RX queue is discarded as well
+        bool isDiscarded = false;
+
+      #if VAN_BUS_VERSION_INT >= 000003001 && VAN_BUS_VERSION_INT < 000003003
+
+        // If RX queue is starting to overrun, apply the drop policy here (see VanRxPolicy.ino). Each packet taken
+        // from the RX queue is accounted for exactly once: here if it is discarded, below if it is kept.
+        int nDiscarded = 0;
+        while (! IsPacketAdmitted(pkt))
+        {
+            RecordBusPacket(pkt);  // Still counts for the bus load
+          #ifdef RAW_VAN_WEBSOCKET
+            SendRawVanPacket(pkt);
+          #endif // RAW_VAN_WEBSOCKET
+          #ifdef VAN_TRACE_RECORDER
+            RecordVanTrace(pkt);
+          #endif // VAN_TRACE_RECORDER
+            nDiscarded++;
+
+            bool isQueueOverrun2 = false;
+            bool isReceived = VanBusRx.Receive(pkt, &isQueueOverrun2);
+            isQueueOverrun = isQueueOverrun || isQueueOverrun2;
+            if (! isReceived)
+            {
+                isDiscarded = true;
+                break;
+            } // if
+        } // while
+
+        if (nDiscarded > 0)
+        {
+            nVanPacketsDiscarded += nDiscarded;
+            AsyncLog.printf_P(PSTR("==> Discarded %u VAN bus packets to prevent RX queue overflow\n"), nDiscarded);
+        } // if
+
+      #endif
+
+      #ifdef VAN_RX_IFS_DEBUGGING
+        if (pkt.getIfsDebugPacket().IsAbnormal()) pkt.getIfsDebugPacket().Dump(AsyncLog);
+      #endif // VAN_RX_IFS_DEBUGGING
+
+      #ifdef VAN_TRACE_RECORDER
+        if (! isDiscarded) RecordVanTrace(pkt);
+
+        // While replaying a trace, packets received on the VAN bus are discarded (see VanTraceReplay.ino)
+        if (! IsVanTraceReplaying())
+      #endif // VAN_TRACE_RECORDER
+        if (! isDiscarded)
+        {
+            VanPacket_t vanPkt(pkt);
+            ProcessVanPacket(vanPkt);
+        }
+    }
+
+    if (isQueueOverrun)
+    {
+        nVanRxQueueOverruns++;
+        Log(LOG_LEVEL_WARNING).print(F("VAN PACKET QUEUE OVERRUN!\n"));
+
+      #ifdef SHOW_VAN_RX_STATS
+        const static char jsonFormatter[] PROGMEM =
+        "{\n"
+            "\"event\": \"display\",\n"
+            "\"data\":\n"
+            "{\n"
+                "\"van_bus_overrun\": \"YES\"\n"
+            "}\n"
+        "}\n";
+
+        snprintf_P(vanJsonBuffer, JSON_BUFFER_SIZE, jsonFormatter);
+        SendVanJson(vanJsonBuffer);
+      #endif // SHOW_VAN_RX_STATS
+    } // if
+
+    return received;
+} // ReceiveVanPacket
+
 #if defined ARDUINO_ARCH_ESP32
  #if defined ESP_ARDUINO_VERSION && ESP_ARDUINO_VERSION >= ESP_ARDUINO_VERSION_VAL(2, 0, 0)
   // This sets Arduino Stack Size - comment this line to use default 8K stack size
@@ -351,7 +583,9 @@ void setup()
 
     md5Checksum = ESP.getSketchMD5();
 
+    // Also finds out if this is a wake-up from sleep
     SetupSleep();
+    MarkWakePhase(WAKE_PHASE_SETUP);
 
     // Does this prevent the following crash?
     // "Fatal exception:29 flag:2 (EXCEPTION) epc1:0x4000e1c3 epc2:0x00000000 epc3:0x00000000 excvaddr:0x00000018 depc:0x00000000"
@@ -366,7 +600,23 @@ void setup()
     Serial.begin(115200);
     Serial.printf_P(PSTR("\nStarting VAN bus \"Live Connect\" server version %s\n"), VAN_LIVE_CONNECT_VERSION);
 
-    PrintDebugDefines();
+    // When waking up, every millisecond counts until the first client frame (see WakeTrace.ino). Writing to the
+    // serial port blocks as soon as its buffer is full, so skip the lengthy printouts.
+    if (! wokeUpFromSleep) PrintDebugDefines();
+
+    Serial.print(F("Initializing settings\n"));
+    SetupSettings();
+    MarkWakePhase(WAKE_PHASE_SETTINGS);
+
+  #ifdef VAN_RX_PARSE_TASK
+    // Start receiving before setting up the network: the VAN bus receive task parses the packets right away, so
+    // that the current state of the car is mostly known by the time the first client connects. Only while the flash
+    // file system is scanned (see SetupStore), the receiver is paused.
+    SetupVanReceiver();
+    SetupVanRxTask();
+    IrSetup();
+    MarkWakePhase(WAKE_PHASE_VAN_RX);
+  #endif // VAN_RX_PARSE_TASK
 
   #ifdef WIFI_AP_MODE
     apIP.fromString(IP_ADDR);
@@ -374,43 +624,53 @@ void setup()
     const char* wifiSsid =
   #endif
     SetupWifi();
-    PrintSystemSpecs();
+    MarkWakePhase(WAKE_PHASE_WIFI);
 
-    Serial.print(F("Initializing EEPROM\n"));
-    EEPROM.begin(64);
+    if (! wokeUpFromSleep) PrintSystemSpecs();
 
   #if defined SERVE_FROM_SPIFFS || defined SERVE_FROM_LITTLEFS
     // Setup non-volatile storage on SPIFFS resp. LittleFS
     SetupStore();
   #endif // defined SERVE_FROM_SPIFFS || defined SERVE_FROM_LITTLEFS
+    MarkWakePhase(WAKE_PHASE_STORE);
 
-    // Setup "Over The Air" (OTA) update
-    SetupOta();
+  #ifndef VAN_RX_PARSE_TASK
+    // Nothing takes packets from the RX queue until setup() is done, so starting earlier would only overrun it
+    SetupVanReceiver();
+    IrSetup();
+    MarkWakePhase(WAKE_PHASE_VAN_RX);
+  #endif // VAN_RX_PARSE_TASK
 
   #ifdef WIFI_AP_MODE
     // If DNSServer is started with "*" for domain name, it will reply with provided IP to all DNS request
     dnsServer.start(DNS_PORT, "*", apIP);
   #endif // WIFI_AP_MODE
 
+    SetupWebServer();
+    SetupWebSocket();
+    SetupLog();
+  #ifdef RAW_VAN_WEBSOCKET
+    SetupRawWebSocket();
+  #endif // RAW_VAN_WEBSOCKET
+    MarkWakePhase(WAKE_PHASE_WEB_SERVER);
+
+    // Not needed for serving the first client, so these come last
+
+    // Setup "Over The Air" (OTA) update
+    SetupOta();
+
   #ifdef USE_MDNS
     // Start the mDNS responder
     if (MDNS.begin(GetHostname())) Serial.print("mDNS responder started\n");
     else Serial.print("Error setting up MDNS responder!\n");
   #endif // USE_MDNS
 
-    SetupWebServer();
-    SetupWebSocket();
-
   #ifdef WIFI_AP_MODE
     Serial.printf_P(PSTR("Please connect to Wi-Fi network '%s', then surf to: http://"), wifiSsid);
     Serial.print(apIP);
     Serial.print(F("/MFD.html\n"));
   #endif // WIFI_AP_MODE
 
-    SetupVanReceiver();
-
-    IrSetup();
-
     sleepAfter = SLEEP_MS_AFTER_NO_VAN_BUS_ACTIVITY;
 
   #ifdef ON_DESK_MFD_ESP_MAC
@@ -448,24 +708,40 @@ void setup()
         );
       #endif
     } // if
+
+    MarkWakePhase(WAKE_PHASE_READY);
 } // setup
 
 void loop()
 {
+    LOOP_STAGES_START();
+
   #ifdef WIFI_AP_MODE
     dnsServer.processNextRequest();
+    LOOP_STAGE_DONE(LOOP_STAGE_DNS);
   #endif // WIFI_AP_MODE
 
     WifiCheckStatus();
+    LOOP_STAGE_DONE(LOOP_STAGE_WIFI);
 
     LoopOta();
+    LOOP_STAGE_DONE(LOOP_STAGE_OTA);
 
     LoopWebSocket();
+  #ifdef RAW_VAN_WEBSOCKET
+    LoopRawWebSocket();
+  #endif // RAW_VAN_WEBSOCKET
+    LOOP_STAGE_DONE(LOOP_STAGE_WEBSOCKET);
     LoopWebServer();
+    LOOP_STAGE_DONE(LOOP_STAGE_WEBSERVER);
 
     // IR receiver
     TIrPacket irPacket;
-    if (IrReceive(irPacket)) SendJsonOnWebSocket(ParseIrPacketToJson(irPacket), true);
+    if (IrReceive(irPacket) && SendIrJsonOnWebSocket(ParseIrPacketToJson(irPacket)))
+    {
+        RecordIrPressToFrame(millis() - irPacket.millis_);  // Arithmetic has safe roll-over
+    } // if
+    LOOP_STAGE_DONE(LOOP_STAGE_IR);
 
     if (sleepAfter > 0
 
@@ -484,60 +760,21 @@ void loop()
         } // if
     } // if
 
-    // VAN bus receiver
-
-    TVanPacketRxDesc pkt;
-    bool isQueueOverrun = false;
-    if (VanBusRx.Receive(pkt, &isQueueOverrun))
-    {
-        lastActivityAt = millis();
-
-      #if VAN_BUS_VERSION_INT >= 000003001 && VAN_BUS_VERSION_INT < 000003003
-
-        // If RX queue is starting to overrun, keep only important (sat nav, stalk button press) packets
-        #define PANIC_AT_PERCENTAGE (60)
-
-        int nDiscarded = 0;
-        while (VanBusRx.GetNQueued() * 100 / VanBusRx.QueueSize() > PANIC_AT_PERCENTAGE && ! IsVeryImportantPacket(pkt))
-        {
-            bool isQueueOverrun2 = false;
-            if (! VanBusRx.Receive(pkt, &isQueueOverrun2)) break;
-            isQueueOverrun = isQueueOverrun || isQueueOverrun2;
-            nDiscarded++;
-        } // while
-
-        if (nDiscarded > 0)
-        {
-            Serial.printf_P(PSTR("==> Discarded %u VAN bus packets to prevent RX queue overflow\n"), nDiscarded);
-        } // if
-
-      #endif
-
-      #ifdef VAN_RX_IFS_DEBUGGING
-        if (pkt.getIfsDebugPacket().IsAbnormal()) pkt.getIfsDebugPacket().Dump(Serial);
-      #endif // VAN_RX_IFS_DEBUGGING
-
-        SendJsonOnWebSocket(ParseVanPacketToJson(pkt), IsImportantPacket(pkt));
-    }
+  #ifdef VAN_RX_PARSE_TASK
+    // VAN bus packets are received and parsed by a separate task; send what it produced (see VanRxTask.ino)
+    LoopVanRxTask();
+  #else
+    ReceiveVanPacket();
+  #endif // VAN_RX_PARSE_TASK
 
-    if (isQueueOverrun)
-    {
-        Serial.print(F("VAN PACKET QUEUE OVERRUN!\n"));
+  #ifdef VAN_TRACE_RECORDER
+    if (VanTraceLoop()) SendJsonOnWebSocket(VanTraceStatusToJson(jsonBuffer, JSON_BUFFER_SIZE));
 
-      #ifdef SHOW_VAN_RX_STATS
-        const static char jsonFormatter[] PROGMEM =
-        "{\n"
-            "\"event\": \"display\",\n"
-            "\"data\":\n"
-            "{\n"
-                "\"van_bus_overrun\": \"YES\"\n"
-            "}\n"
-        "}\n";
+    VanTraceReplayLoop();
+    if (IsVanTraceReplaying()) lastActivityAt = millis();
+  #endif // VAN_TRACE_RECORDER
 
-        snprintf_P(jsonBuffer, JSON_BUFFER_SIZE, jsonFormatter);
-        SendJsonOnWebSocket(jsonBuffer);
-      #endif // SHOW_VAN_RX_STATS
-    } // if
+    LOOP_STAGE_DONE(LOOP_STAGE_VAN);
 
     static unsigned long lastUpdate = 0;
     if (millis() - lastUpdate >= 5000UL)  // Arithmetic has safe roll-over
@@ -547,7 +784,7 @@ void loop()
       #if VAN_BUS_VERSION_INT >= 000003002
         if (! VanBusRx.IsEnabled())
         {
-            Serial.print(F("==> Random noise detected on VAN bus; re-starting receiver\n"));
+            AsyncLog.print(F("==> Random noise detected on VAN bus; re-starting receiver\n"));
             VanBusRx.Enable();
         } // if
       #endif
@@ -555,23 +792,53 @@ void loop()
         // Send ESP runtime data to client
         SendJsonOnWebSocket(EspRuntimeDataToJson(jsonBuffer, JSON_BUFFER_SIZE));
 
+        // Send WebSocket frame statistics to client
+        SendJsonOnWebSocket(WebSocketStatsToJson(jsonBuffer, JSON_BUFFER_SIZE));
+
+        // Send end-to-end latency percentiles to client
+        SendJsonOnWebSocket(LatencyStatsToJson(jsonBuffer, JSON_BUFFER_SIZE));
+
+        // Send VAN bus load and busiest IDEN values to client
+      #ifndef VAN_RX_PARSE_TASK
+        RollBusStatsWindow();  // Otherwise done by the VAN bus receive task (see VanRxTask.ino)
+      #endif // VAN_RX_PARSE_TASK
+        SendJsonOnWebSocket(BusStatsToJson(jsonBuffer, JSON_BUFFER_SIZE));
+
+      #ifdef VAN_TRACE_RECORDER
+        // Send VAN bus trace recorder status to client
+        SendJsonOnWebSocket(VanTraceStatusToJson(jsonBuffer, JSON_BUFFER_SIZE));
+      #endif // VAN_TRACE_RECORDER
+
+      #ifdef MEASURE_LOOP_STAGES
+        // Send main loop stage timing to client
+        SendJsonOnWebSocket(LoopStatsToJson(jsonBuffer, JSON_BUFFER_SIZE));
+      #endif // MEASURE_LOOP_STAGES
+
       #ifdef SHOW_VAN_RX_STATS
         // Send VAN bus receiver status string to client
         SendJsonOnWebSocket(VanBusStatsToJson(jsonBuffer, JSON_BUFFER_SIZE));
       #endif // SHOW_VAN_RX_STATS
     } // if
 
-  #ifdef SHOW_VAN_RX_STATS
     static unsigned long lastUpdate2 = 0;
-    if (millis() - lastUpdate2 >= 15000UL)  // Arithmetic has safe roll-over
+    if (IsDiagEnabled(DIAG_VAN_RX_STATS) && millis() - lastUpdate2 >= 15000UL)  // Arithmetic has safe roll-over
     {
         lastUpdate2 = millis();
 
         // Print statistics
         PrintTimeStamp();
-        VanBusRx.DumpStats(Serial);
+        VanBusRx.DumpStats(AsyncLog);
     } // if
-  #endif // SHOW_VAN_RX_STATS
+
+    SampleFreeHeap();
+
+    // Write any collected log text on the serial port, if the VAN bus receive queue is empty
+    LoopLog();
+
+    // Write any changed settings to flash, if the VAN bus has been silent for a while
+    LoopSettings();
+
+    LOOP_STAGE_DONE(LOOP_STAGE_STATS);
 
     delay(9);
 } // loop
@@ -0,0 +1,66 @@
+#ifndef VanPacket_h
+#define VanPacket_h
+
+#include <VanBusRx.h>
+
+// A received VAN bus packet, as handed to the packet parsers (see PacketToJson.ino). Either refers to a packet
+// taken from the VanBusRx receive queue, or holds a packet replayed from a trace (see VanTraceReplay.ino).
+struct VanPacket_t
+{
+    // Packet taken from the VanBusRx receive queue
+    VanPacket_t(TVanPacketRxDesc& pkt) : rxDesc(&pkt) { }
+
+    // Replayed packet; 'data' must remain valid for the lifetime of this object
+    VanPacket_t(uint16_t _iden, uint8_t _commandFlags, const uint8_t* _data, int _dataLen, uint16_t _crc, bool _crcOk,
+        unsigned long _millis)
+        : rxDesc(nullptr), iden(_iden), commandFlags(_commandFlags), data(_data), dataLen(_dataLen), crc(_crc),
+          crcOk(_crcOk), rxMillis(_millis)
+    { }
+
+    uint16_t Iden() const { return rxDesc != nullptr ? rxDesc->Iden() : iden; }
+    uint8_t CommandFlags() const { return rxDesc != nullptr ? rxDesc->CommandFlags() : commandFlags; }
+    const char* CommandFlagsStr() const { return rxDesc != nullptr ? rxDesc->CommandFlagsStr() : "replay"; }
+    const uint8_t* Data() const { return rxDesc != nullptr ? rxDesc->Data() : data; }
+    int DataLen() const { return rxDesc != nullptr ? rxDesc->DataLen() : dataLen; }
+    uint16_t Crc() const { return rxDesc != nullptr ? rxDesc->Crc() : crc; }
+    unsigned long Millis() const { return rxDesc != nullptr ? rxDesc->Millis() : rxMillis; }
+
+    // A replayed packet has its CRC checked (and, if possible, repaired) at recording time
+    bool CheckCrc() const { return rxDesc != nullptr ? rxDesc->CheckCrc() : crcOk; }
+    bool CheckCrcAndRepair() { return rxDesc != nullptr ? rxDesc->CheckCrcAndRepair() : crcOk; }
+
+    void DumpRaw(Print& s) const
+    {
+        if (rxDesc != nullptr)
+        {
+            rxDesc->DumpRaw(s);
+            return;
+        } // if
+
+        s.printf_P(PSTR("Replay: IDEN %03X, flags %1X, %d bytes:"), iden, commandFlags, dataLen);
+        for (int i = 0; i < dataLen; i++) s.printf_P(PSTR(" %02X"), data[i]);
+        s.printf_P(PSTR(", CRC %04X\n"), crc);
+    } // DumpRaw
+
+  #ifdef VAN_RX_ISR_DEBUGGING
+    void DumpIsrDebugPacket(Print& s) const
+    {
+        if (rxDesc != nullptr) rxDesc->getIsrDebugPacket().Dump(s);
+    } // DumpIsrDebugPacket
+  #endif // VAN_RX_ISR_DEBUGGING
+
+    // The packet as taken from the VanBusRx receive queue, or nullptr if replayed
+    TVanPacketRxDesc* const rxDesc;
+
+  private:
+
+    uint16_t iden = 0;
+    uint8_t commandFlags = 0;
+    const uint8_t* data = nullptr;
+    int dataLen = 0;
+    uint16_t crc = 0;
+    bool crcOk = false;
+    unsigned long rxMillis = 0;
+}; // struct VanPacket_t
+
+#endif // VanPacket_h
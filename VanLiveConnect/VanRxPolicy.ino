@@ -0,0 +1,339 @@
+
+// VAN bus receive drop policy: sheds packets in tiers when the RX queue fills up, and limits each IDEN to a
+// budget of packets so that a chatty IDEN cannot starve the rest
+//
+// The policy is called by the VanBusRx library from its interrupt service routine (see VanBusRx.SetDropPolicy),
+// so everything it touches must be in RAM.
+
+// Defined in VanLiveConnect.ino
+bool IsVeryImportantPacket(const TVanPacketRxDesc& pkt);
+
+// Defined in Metrics.ino
+extern const char counterStr[];
+int MetricHeader(char* buf, const int n, PGM_P name, PGM_P type, PGM_P help);
+
+enum VanDropTier_t
+{
+    VAN_DROP_TIER_DIAGNOSTIC,  // Diagnostic and unknown IDENs: dropped first
+    VAN_DROP_TIER_TELEMETRY,  // High-rate telemetry, of which the next packet follows soon
+    VAN_DROP_TIER_STATE,  // State changes
+    N_VAN_DROP_TIERS,
+    VAN_DROP_TIER_CRITICAL = N_VAN_DROP_TIERS  // See IsVeryImportantPacket: never dropped
+}; // enum VanDropTier_t
+
+// Returns a PSTR (allocated in flash, saves RAM)
+PGM_P VanDropTierStr(int tier)
+{
+    return
+        tier == VAN_DROP_TIER_DIAGNOSTIC ? PSTR("diagnostic") :
+        tier == VAN_DROP_TIER_TELEMETRY ? PSTR("telemetry") :
+        tier == VAN_DROP_TIER_STATE ? PSTR("state") :
+        PSTR("critical");
+} // VanDropTierStr
+
+struct VanIdenTier_t
+{
+    uint16_t iden;
+    uint8_t tier;
+}; // struct VanIdenTier_t
+
+// Any IDEN not listed here is in tier VAN_DROP_TIER_DIAGNOSTIC
+const VanIdenTier_t vanIdenTiers[] PROGMEM =
+{
+    { ENGINE_IDEN, VAN_DROP_TIER_TELEMETRY },
+    { DASHBOARD_IDEN, VAN_DROP_TIER_TELEMETRY },
+    { AIRCON2_IDEN, VAN_DROP_TIER_TELEMETRY },
+    { WHEEL_SPEED_IDEN, VAN_DROP_TIER_TELEMETRY },
+    { ODOMETER_IDEN, VAN_DROP_TIER_TELEMETRY },
+    { COM2000_IDEN, VAN_DROP_TIER_TELEMETRY },
+    { VIN_IDEN, VAN_DROP_TIER_STATE },
+    { HEAD_UNIT_STALK_IDEN, VAN_DROP_TIER_STATE },
+    { LIGHTS_STATUS_IDEN, VAN_DROP_TIER_STATE },
+    { DEVICE_REPORT, VAN_DROP_TIER_STATE },
+    { CAR_STATUS1_IDEN, VAN_DROP_TIER_STATE },
+    { CAR_STATUS2_IDEN, VAN_DROP_TIER_STATE },
+    { DASHBOARD_BUTTONS_IDEN, VAN_DROP_TIER_STATE },
+    { HEAD_UNIT_IDEN, VAN_DROP_TIER_STATE },
+    { MFD_LANGUAGE_UNITS_IDEN, VAN_DROP_TIER_STATE },
+    { AUDIO_SETTINGS_IDEN, VAN_DROP_TIER_STATE },
+    { MFD_STATUS_IDEN, VAN_DROP_TIER_STATE },
+    { AIRCON1_IDEN, VAN_DROP_TIER_STATE },
+    { CDCHANGER_IDEN, VAN_DROP_TIER_STATE },
+    { SATNAV_STATUS_1_IDEN, VAN_DROP_TIER_STATE },
+    { SATNAV_STATUS_2_IDEN, VAN_DROP_TIER_STATE },
+    { SATNAV_STATUS_3_IDEN, VAN_DROP_TIER_STATE },
+    { SATNAV_GUIDANCE_DATA_IDEN, VAN_DROP_TIER_STATE },
+    { SATNAV_GUIDANCE_IDEN, VAN_DROP_TIER_STATE },
+    { SATNAV_REPORT_IDEN, VAN_DROP_TIER_STATE },
+    { MFD_TO_SATNAV_IDEN, VAN_DROP_TIER_STATE },
+    { SATNAV_TO_MFD_IDEN, VAN_DROP_TIER_STATE },
+    { SATNAV_DOWNLOADING_IDEN, VAN_DROP_TIER_STATE },
+    { CDCHANGER_COMMAND_IDEN, VAN_DROP_TIER_STATE },
+    { MFD_TO_HEAD_UNIT_IDEN, VAN_DROP_TIER_STATE },
+}; // vanIdenTiers
+
+#define N_VAN_IDEN_TIERS (sizeof(vanIdenTiers) / sizeof(vanIdenTiers[0]))
+
+// Per IDEN: the drop tier, the token bucket and the number of dropped packets. Open-addressed with linear
+// probing; the size must be a power of 2 and well above the number of listed IDENs. All IDENs that are not
+// listed share the last entry.
+#define VAN_IDEN_BUDGET_TABLE_SIZE (64)
+
+struct VanIdenBudget_t
+{
+    uint16_t iden;  // 0 = empty slot
+    uint8_t tier;
+    uint8_t tokens;
+    unsigned long lastRefill;
+    uint32_t nDropped;
+}; // struct VanIdenBudget_t
+
+VanIdenBudget_t vanIdenBudgets[VAN_IDEN_BUDGET_TABLE_SIZE + 1];
+VanIdenBudget_t* const otherIdenBudget = vanIdenBudgets + VAN_IDEN_BUDGET_TABLE_SIZE;
+
+// Per tier, the number of queued packets at which packets of that tier are dropped
+int vanDropThreshold[N_VAN_DROP_TIERS];
+
+// Per tier, the number of packets dropped because the RX queue was too full, or because the IDEN had no tokens
+// left
+uint32_t nVanDroppedByQueueFill[N_VAN_DROP_TIERS];
+uint32_t nVanDroppedByRate[N_VAN_DROP_TIERS];
+
+inline int IRAM_ATTR VanIdenHash(uint16_t iden)
+{
+    return (iden ^ iden >> 6) & (VAN_IDEN_BUDGET_TABLE_SIZE - 1);
+} // VanIdenHash
+
+VanIdenBudget_t* IRAM_ATTR FindVanIdenBudget(uint16_t iden)
+{
+    int slot = VanIdenHash(iden);
+    for (int i = 0; i < VAN_IDEN_BUDGET_TABLE_SIZE; i++)
+    {
+        if (vanIdenBudgets[slot].iden == iden) return vanIdenBudgets + slot;
+        if (vanIdenBudgets[slot].iden == 0) break;  // End of probe sequence
+        slot = (slot + 1) & (VAN_IDEN_BUDGET_TABLE_SIZE - 1);
+    } // for
+
+    return otherIdenBudget;
+} // FindVanIdenBudget
+
+// Set up the drop thresholds and the per-IDEN budgets, for a VAN bus RX queue of the specified size. Returns the
+// lowest threshold, at which the policy must start to be applied.
+int SetupVanRxPolicy(int queueSize)
+{
+    vanDropThreshold[VAN_DROP_TIER_DIAGNOSTIC] = queueSize * VAN_DROP_DIAGNOSTIC_AT_PERCENTAGE / 100;
+    vanDropThreshold[VAN_DROP_TIER_TELEMETRY] = queueSize * VAN_DROP_TELEMETRY_AT_PERCENTAGE / 100;
+    vanDropThreshold[VAN_DROP_TIER_STATE] = queueSize * VAN_DROP_STATE_AT_PERCENTAGE / 100;
+
+    for (unsigned int i = 0; i < N_VAN_IDEN_TIERS; i++)
+    {
+        VanIdenTier_t entry;
+        memcpy_P(&entry, vanIdenTiers + i, sizeof(entry));
+
+        int slot = VanIdenHash(entry.iden);
+        while (vanIdenBudgets[slot].iden != 0) slot = (slot + 1) & (VAN_IDEN_BUDGET_TABLE_SIZE - 1);
+
+        vanIdenBudgets[slot].iden = entry.iden;
+        vanIdenBudgets[slot].tier = entry.tier;
+        vanIdenBudgets[slot].tokens = VAN_IDEN_TOKEN_BURST;
+    } // for
+
+    otherIdenBudget->tier = VAN_DROP_TIER_DIAGNOSTIC;
+    otherIdenBudget->tokens = VAN_IDEN_TOKEN_BURST;
+
+    return vanDropThreshold[VAN_DROP_TIER_DIAGNOSTIC];
+} // SetupVanRxPolicy
+
+// Returns false if the packet must be dropped. Called from ISR context (see VanBusRx.SetDropPolicy), but also
+// usable from the main loop.
+bool IRAM_ATTR IsPacketAdmitted(const TVanPacketRxDesc& pkt)
+{
+    int nQueued = VanBusRx.GetNQueued();
+    if (nQueued < vanDropThreshold[VAN_DROP_TIER_DIAGNOSTIC]) return true;  // No pressure
+
+    if (IsVeryImportantPacket(pkt)) return true;
+
+    VanIdenBudget_t* budget = FindVanIdenBudget(pkt.Iden());
+    int tier = budget->tier;
+
+    if (nQueued >= vanDropThreshold[tier])
+    {
+        nVanDroppedByQueueFill[tier]++;
+        budget->nDropped++;
+        return false;
+    } // if
+
+    // Refill the token bucket. Use the packet reception time stamp; it is readily available.
+    unsigned long now = pkt.Millis();
+    unsigned long elapsed = now - budget->lastRefill;  // Arithmetic has safe roll-over
+    if (elapsed >= 1000UL / VAN_IDEN_TOKENS_PER_SEC)
+    {
+        unsigned long newTokens =
+            elapsed >= 1000UL * VAN_IDEN_TOKEN_BURST / VAN_IDEN_TOKENS_PER_SEC ? VAN_IDEN_TOKEN_BURST :
+            elapsed * VAN_IDEN_TOKENS_PER_SEC / 1000;
+        budget->tokens = std::min((unsigned long)VAN_IDEN_TOKEN_BURST, budget->tokens + newTokens);
+        budget->lastRefill = now;
+    } // if
+
+    if (budget->tokens == 0)
+    {
+        nVanDroppedByRate[tier]++;
+        budget->nDropped++;
+        return false;
+    } // if
+
+    budget->tokens--;
+    return true;
+} // IsPacketAdmitted
+
+// Decimation of high-rate IDENs: packets that repeat at bus cadence are sampled right after reception, before
+// spending any time on CRC checking, duplicate detection and parsing. A packet passes if at least 'minIntervalMs'
+// milliseconds have passed since the last packet that passed, or if one of the specified values has changed by
+// at least its threshold since then.
+//
+// Do not add IDENs that report button presses (e.g. COM2000_IDEN): a press could be missed.
+
+struct VanDecimationField_t
+{
+    int8_t offset;  // Offset of a big-endian 16-bit value in the packet data, or -1 if not used
+    uint16_t threshold;
+}; // struct VanDecimationField_t
+
+struct VanDecimation_t
+{
+    uint16_t iden;
+    uint16_t minIntervalMs;
+    VanDecimationField_t fields[2];
+}; // struct VanDecimation_t
+
+const VanDecimation_t vanDecimations[] PROGMEM =
+{
+    // Wheel speed (rear right, rear left) in km/h x 100: pass on a change of 1 km/h
+    { WHEEL_SPEED_IDEN, 500, { { 0, 100 }, { 2, 100 } } },
+
+    // Odometer in km x 10 (lower 16 bits): pass on a change of 0.1 km
+    { ODOMETER_IDEN, 1000, { { 2, 1 }, { -1, 0 } } },
+
+    // Engine RPM x 8 and vehicle speed in km/h x 100; same thresholds as in ParseDashboardPkt
+    { DASHBOARD_IDEN, 1000, { { 0, 20 * 8 }, { 2, 100 } } },
+}; // vanDecimations
+
+#define N_VAN_DECIMATIONS (sizeof(vanDecimations) / sizeof(vanDecimations[0]))
+
+struct VanDecimationState_t
+{
+    unsigned long lastPassedAt;
+    uint16_t lastValue[2];
+    uint32_t nDecimated;
+}; // struct VanDecimationState_t
+
+VanDecimationState_t vanDecimationStates[N_VAN_DECIMATIONS];
+
+// Returns true if the packet can be skipped without parsing
+bool IsPacketDecimated(const VanPacket_t& pkt)
+{
+    uint16_t iden = pkt.Iden();
+
+    for (unsigned int i = 0; i < N_VAN_DECIMATIONS; i++)
+    {
+        if (pgm_read_word(&vanDecimations[i].iden) != iden) continue;
+
+        // A corrupt packet must not update the decimation state: leave it to the parser to report (or repair)
+        if (! pkt.CheckCrc()) return false;
+
+        VanDecimation_t decimation;
+        memcpy_P(&decimation, vanDecimations + i, sizeof(decimation));
+        VanDecimationState_t& state = vanDecimationStates[i];
+
+        const uint8_t* data = pkt.Data();
+        int dataLen = pkt.DataLen();
+
+        bool pass = pkt.Millis() - state.lastPassedAt >= decimation.minIntervalMs;  // Arithmetic has safe roll-over
+        uint16_t value[2] = { 0, 0 };
+        for (int f = 0; f < 2; f++)
+        {
+            int offset = decimation.fields[f].offset;
+            if (offset < 0) continue;
+
+            // Unexpected length: leave it to the parser to report
+            if (offset + 1 >= dataLen) return false;
+
+            value[f] = (uint16_t)data[offset] << 8 | data[offset + 1];
+            int16_t diff = value[f] - state.lastValue[f];  // Handles roll-over
+            if (abs(diff) >= decimation.fields[f].threshold) pass = true;
+        } // for
+
+        if (! pass)
+        {
+            state.nDecimated++;
+            return true;
+        } // if
+
+        state.lastPassedAt = pkt.Millis();
+        state.lastValue[0] = value[0];
+        state.lastValue[1] = value[1];
+        return false;
+    } // for
+
+    return false;
+} // IsPacketDecimated
+
+// Report the number of dropped packets per tier and per IDEN, for "/metrics"
+int VanDropMetricsText(int item, char* buf, const int n)
+{
+    if (item == 0)
+    {
+        return MetricHeader(buf, n, PSTR("van_dropped_by_tier_total"), counterStr,
+            PSTR("VAN bus packets dropped by the RX policy, per tier and reason."));
+    } // if
+    item--;
+
+    if (item < N_VAN_DROP_TIERS * 2)
+    {
+        int tier = item / 2;
+        bool byRate = item % 2;
+        return snprintf_P(buf, n, PSTR("vanlive_van_dropped_by_tier_total{tier=\"%s\",reason=\"%s\"} %" PRIu32 "\n"),
+            VanDropTierStr(tier),
+            byRate ? PSTR("rate") : PSTR("queue_fill"),
+            byRate ? nVanDroppedByRate[tier] : nVanDroppedByQueueFill[tier]
+        );
+    } // if
+    item -= N_VAN_DROP_TIERS * 2;
+
+    if (item == 0)
+    {
+        return MetricHeader(buf, n, PSTR("van_dropped_by_iden_total"), counterStr,
+            PSTR("VAN bus packets dropped by the RX policy, per IDEN value (0x000 = any other)."));
+    } // if
+    item--;
+
+    // Find the slot of the item-th listed IDEN; the last one is for all other IDENs
+    for (int slot = 0; slot <= VAN_IDEN_BUDGET_TABLE_SIZE; slot++)
+    {
+        const VanIdenBudget_t& budget = vanIdenBudgets[slot];
+        if (budget.iden == 0 && &budget != otherIdenBudget) continue;
+        if (item-- > 0) continue;
+
+        return snprintf_P(buf, n, PSTR("vanlive_van_dropped_by_iden_total{iden=\"0x%03X\"} %" PRIu32 "\n"),
+            budget.iden,
+            budget.nDropped
+        );
+    } // for
+
+    if (item == 0)
+    {
+        return MetricHeader(buf, n, PSTR("van_decimated_total"), counterStr,
+            PSTR("VAN bus packets skipped by decimation, before parsing, per IDEN value."));
+    } // if
+    item--;
+
+    if (item < (int)N_VAN_DECIMATIONS)
+    {
+        return snprintf_P(buf, n, PSTR("vanlive_van_decimated_total{iden=\"0x%03X\"} %" PRIu32 "\n"),
+            pgm_read_word(&vanDecimations[item].iden),
+            vanDecimationStates[item].nDecimated
+        );
+    } // if
+
+    return 0;
+} // VanDropMetricsText
@@ -0,0 +1,179 @@
+
+// VAN bus receive and parse task (ESP32 only)
+//
+// Without this, everything runs in the Arduino main loop, so a slow 'webSocket.text()' or page serve delays the
+// parsing of VAN bus packets, and the VanBusRx receive queue may overrun. With VAN_RX_PARSE_TASK (see Config.h),
+// packets are received and parsed into JSON by a separate task, pinned to the other core than the main loop. The
+// JSON frames are handed over to the main loop, which owns the WebSockets, through a lock-free single-producer,
+// single-consumer ring buffer (see SpscRing.h). When the ring buffer is full, frames are dropped and counted.
+//
+// Undecoded packets for the raw VAN bus WebSocket (see RawWebSocket.ino) take the same route.
+//
+// A reset of the duplicate detection state of the packet parsers, as requested by the main loop, is done by this
+// task before it parses the next packet (see ResetPacketPrevData in PacketToJson.ino). Still shared without a lock:
+// the settings written by the parsers, the bus statistics and the latency histograms (see Config.h).
+
+#ifdef VAN_RX_PARSE_TASK
+
+#include "SpscRing.h"
+
+// Defined in Metrics.ino
+extern const char counterStr[];
+extern const char gaugeStr[];
+int ScalarMetric(char* buf, const int n, PGM_P name, PGM_P type, PGM_P help, uint32_t value);
+
+#ifdef RAW_VAN_WEBSOCKET
+// Defined in RawWebSocket.ino
+extern uint32_t rawWebSocketId;
+#endif // RAW_VAN_WEBSOCKET
+
+// On a single-core ESP32 (e.g. the ESP32-S2), the task runs on the same core as the main loop, but still takes
+// precedence over it
+#if CONFIG_FREERTOS_UNICORE
+  #define VAN_RX_TASK_CORE (0)
+#else
+  #define VAN_RX_TASK_CORE (1 - ARDUINO_RUNNING_CORE)
+#endif // CONFIG_FREERTOS_UNICORE
+
+enum VanRxFrameTag_t
+{
+    VAN_RX_FRAME_JSON,
+    VAN_RX_FRAME_IMPORTANT_JSON,  // To be kept for later sending if the WebSocket send queue is full
+    VAN_RX_FRAME_RAW_PACKET
+}; // enum VanRxFrameTag_t
+
+// Undecoded packet, for the raw VAN bus WebSocket
+struct RawVanFrame_t
+{
+    uint32_t millis_;
+    uint16_t iden;
+    uint16_t crc;
+    uint8_t commandFlags;
+    uint8_t crcOk;
+    uint8_t dataLen;
+    uint8_t data[VAN_MAX_DATA_BYTES];
+}; // struct RawVanFrame_t
+
+SpscRing_t<VAN_RX_TASK_RING_SIZE> vanRxRing;
+
+// Counters, reported in "/metrics"
+uint32_t nVanRxFramesQueued = 0;
+uint32_t nVanRxFramesDropped = 0;
+
+// VAN bus parse task: queue a JSON frame for the main loop to send
+void QueueVanJson(const char* json, bool saveForLater)
+{
+    if (json == nullptr || json[0] == 0) return;
+
+    uint32_t tag = saveForLater ? VAN_RX_FRAME_IMPORTANT_JSON : VAN_RX_FRAME_JSON;
+    if (vanRxRing.Push(json, strlen(json) + 1, tag)) nVanRxFramesQueued++;  // Including the terminating '\0'
+    else nVanRxFramesDropped++;
+} // QueueVanJson
+
+#ifdef RAW_VAN_WEBSOCKET
+// VAN bus parse task: queue an undecoded packet for the main loop to stream on the raw VAN bus WebSocket
+void QueueRawVanPacket(const VanPacket_t& pkt)
+{
+    if (rawWebSocketId == 0) return;  // No subscriber
+
+    int dataLen = pkt.DataLen();
+    if (dataLen < 0 || dataLen > VAN_MAX_DATA_BYTES) return;
+
+    RawVanFrame_t frame;
+    frame.millis_ = pkt.Millis();
+    frame.iden = pkt.Iden();
+    frame.crc = pkt.Crc();
+    frame.commandFlags = pkt.CommandFlags();
+    frame.crcOk = pkt.CheckCrc();
+    frame.dataLen = dataLen;
+    memcpy(frame.data, pkt.Data(), dataLen);
+
+    if (vanRxRing.Push(&frame, offsetof(RawVanFrame_t, data) + dataLen, VAN_RX_FRAME_RAW_PACKET))
+    {
+        nVanRxFramesQueued++;
+    }
+    else
+    {
+        nVanRxFramesDropped++;
+    } // if
+} // QueueRawVanPacket
+#endif // RAW_VAN_WEBSOCKET
+
+void VanRxTask(void*)
+{
+    unsigned long lastBusStatsRoll = millis();
+
+    for (;;)
+    {
+        // Nothing received: give the other tasks on this core (e.g. Wi-Fi, idle task) a chance
+        if (! ReceiveVanPacket()) vTaskDelay(1);
+
+        // Same interval as the bus statistics updates sent by the main loop. Done here, so that the per-packet
+        // counters are not reset by another task.
+        if (millis() - lastBusStatsRoll >= 5000UL)  // Arithmetic has safe roll-over
+        {
+            lastBusStatsRoll = millis();
+            RollBusStatsWindow();
+        } // if
+    } // for
+} // VanRxTask
+
+void SetupVanRxTask()
+{
+    Serial.printf_P(PSTR("Starting VAN bus receive task on core %d\n"), VAN_RX_TASK_CORE);
+
+    xTaskCreatePinnedToCore(
+        VanRxTask,
+        "VanRxTask",
+        VAN_RX_TASK_STACK_SIZE,
+        nullptr,
+        VAN_RX_TASK_PRIORITY,
+        nullptr,
+        VAN_RX_TASK_CORE);
+} // SetupVanRxTask
+
+// Main loop: send the frames queued by the VAN bus parse task
+void LoopVanRxTask()
+{
+    uint32_t len;
+    uint32_t tag;
+    const uint8_t* frame;
+
+    while ((frame = vanRxRing.Front(len, tag)) != nullptr)
+    {
+        if (tag == VAN_RX_FRAME_RAW_PACKET)
+        {
+          #ifdef RAW_VAN_WEBSOCKET
+            const RawVanFrame_t* raw = (const RawVanFrame_t*)frame;
+            VanPacket_t pkt(raw->iden, raw->commandFlags, raw->data, raw->dataLen, raw->crc, raw->crcOk, raw->millis_);
+            StreamRawVanPacket(pkt);
+          #endif // RAW_VAN_WEBSOCKET
+        }
+        else
+        {
+            SendJsonOnWebSocket((const char*)frame, tag == VAN_RX_FRAME_IMPORTANT_JSON);
+        } // if
+
+        vanRxRing.Pop();
+    } // while
+} // LoopVanRxTask
+
+int VanRxTaskMetricsText(int item, char* buf, const int n)
+{
+    switch (item)
+    {
+        case 0:
+            return ScalarMetric(buf, n, PSTR("van_rx_task_frames_queued_total"), counterStr,
+                PSTR("Frames handed over from the VAN bus receive task to the main loop."), nVanRxFramesQueued);
+        case 1:
+            return ScalarMetric(buf, n, PSTR("van_rx_task_frames_dropped_total"), counterStr,
+                PSTR("Frames dropped because the ring buffer to the main loop was full."), nVanRxFramesDropped);
+        case 2:
+            return ScalarMetric(buf, n, PSTR("van_rx_task_ring_max_bytes"), gaugeStr,
+                PSTR("Highest fill of the ring buffer to the main loop."), vanRxRing.maxBytesUsed);
+        default:
+            return 0;
+    } // switch
+} // VanRxTaskMetricsText
+
+#endif // VAN_RX_PARSE_TASK
@@ -0,0 +1,323 @@
+
+// Binary VAN bus trace recorder
+//
+// Records every received VAN bus packet in a compact binary format, into a staging buffer in RAM. The buffer is
+// written to a rotating set of files in the LittleFS flash file system only when the VAN bus is idle: writing to
+// flash interferes with packet reception, so the receiver is disabled while writing (as in SetupStore, see
+// WebServer.ino).
+//
+// File format (multi-byte values are little-endian):
+// - Header (12 bytes): "VANT", format version (1 byte), reserved (1 byte), sequence number of the file within
+//   the recording session (2 bytes), session start time (4 bytes, ESP milliseconds)
+// - Records, one per packet:
+//   - time since the previous record (or since session start), in milliseconds, as LEB128 varint (1...5 bytes)
+//   - IDEN << 4 | command flags (2 bytes)
+//   - data length in bits 0...4, "packets were missed before this one" in bit 6, "CRC OK" in bit 7 (1 byte)
+//   - data bytes
+//   - CRC, as received (2 bytes)
+//
+// Recording is started and stopped with the "van_trace:START" and "van_trace:STOP" websocket messages. The files
+// are listed and downloaded via "/trace" (see ServeVanTrace in WebServer.ino).
+
+#ifdef VAN_TRACE_RECORDER
+
+#include <LittleFS.h>
+
+// Defined in DateTime.ino
+const char* TimeStamp();
+
+// Defined in PacketToJson.ino
+extern const char emptyStr[];
+extern const char commaStr[];
+
+#define VAN_TRACE_VERSION (1)
+#define VAN_TRACE_HEADER_SIZE (12)
+
+// Largest possible record: time delta, IDEN and command flags, length, data, CRC
+#define VAN_TRACE_MAX_RECORD_SIZE (5 + 2 + 1 + VAN_MAX_DATA_BYTES + 2)
+
+#define VAN_TRACE_FLAG_GAP (1 << 6)
+#define VAN_TRACE_FLAG_CRC_OK (1 << 7)
+
+bool vanTraceRecording = false;
+
+// Set by the "van_trace:START" and "van_trace:STOP" websocket messages: 1 = start, 0 = stop, -1 = none. Handled
+// in the main loop, so that no flash file system operations are done in the websocket event handler.
+volatile int8_t vanTraceRequest = -1;
+
+uint8_t vanTraceBuffer[VAN_TRACE_BUFFER_SIZE];
+int vanTraceBufferLen = 0;
+
+unsigned long vanTraceSessionStart = 0;
+unsigned long vanTraceLastRecordAt = 0;  // Packet time stamp of the last record
+unsigned long vanTraceLastRxAt = 0;  // Time of the last packet offered for recording
+bool vanTraceGap = false;  // Packets were missed since the last record
+
+int vanTraceFileIdx = 0;
+uint16_t vanTraceFileSeqNo = 0;
+uint32_t vanTraceFileSize = 0;
+
+uint32_t nVanTracePackets = 0;
+uint32_t nVanTraceDropped = 0;
+uint32_t nVanTraceBytesWritten = 0;
+
+// Returns the path of the trace file with the specified index
+const char* VanTraceFileName(int idx)
+{
+    static char name[16];
+    snprintf_P(name, sizeof(name), PSTR("/trace%d.bin"), idx);
+    return name;
+} // VanTraceFileName
+
+// Write the staging buffer to the current trace file, starting a new file if the current one is full
+void WriteVanTraceBuffer()
+{
+    if (vanTraceBufferLen == 0) return;
+
+    VanBusRx.Disable();
+
+    bool isNewFile = vanTraceFileSize == 0 || vanTraceFileSize + vanTraceBufferLen > VAN_TRACE_FILE_SIZE;
+    if (isNewFile && vanTraceFileSize > 0)
+    {
+        // Rotate, overwriting the oldest file
+        vanTraceFileIdx = (vanTraceFileIdx + 1) % VAN_TRACE_N_FILES;
+        vanTraceFileSeqNo++;
+    } // if
+
+    File file = LittleFS.open(VanTraceFileName(vanTraceFileIdx), isNewFile ? "w" : "a");
+    bool ok = file;
+
+    if (ok && isNewFile)
+    {
+        uint8_t header[VAN_TRACE_HEADER_SIZE] =
+        {
+            'V', 'A', 'N', 'T',
+            VAN_TRACE_VERSION,
+            0,
+            (uint8_t)(vanTraceFileSeqNo & 0xFF), (uint8_t)(vanTraceFileSeqNo >> 8),
+            (uint8_t)(vanTraceSessionStart & 0xFF), (uint8_t)(vanTraceSessionStart >> 8 & 0xFF),
+            (uint8_t)(vanTraceSessionStart >> 16 & 0xFF), (uint8_t)(vanTraceSessionStart >> 24)
+        };
+        ok = file.write(header, sizeof(header)) == sizeof(header);
+        vanTraceFileSize = sizeof(header);
+    } // if
+
+    if (ok) ok = file.write(vanTraceBuffer, vanTraceBufferLen) == (size_t)vanTraceBufferLen;
+    if (file) file.close();
+
+    VanBusRx.Enable();
+
+    if (! ok)
+    {
+        Log(LOG_LEVEL_WARNING).printf_P(PSTR("%s==> Failed to write VAN bus trace file '%s'; recording stopped\n"),
+            TimeStamp(),
+            VanTraceFileName(vanTraceFileIdx)
+        );
+        vanTraceRecording = false;
+    } // if
+
+    vanTraceFileSize += vanTraceBufferLen;
+    nVanTraceBytesWritten += vanTraceBufferLen;
+    vanTraceBufferLen = 0;
+
+    // Packets that arrived while the receiver was disabled are lost
+    vanTraceGap = true;
+} // WriteVanTraceBuffer
+
+void StartVanTrace()
+{
+    if (vanTraceRecording) return;
+
+    // Remove the files of the previous session
+    VanBusRx.Disable();
+    for (int idx = 0; idx < VAN_TRACE_N_FILES; idx++)
+    {
+        if (LittleFS.exists(VanTraceFileName(idx))) LittleFS.remove(VanTraceFileName(idx));
+    } // for
+    VanBusRx.Enable();
+
+    vanTraceBufferLen = 0;
+    vanTraceSessionStart = vanTraceLastRecordAt = vanTraceLastRxAt = millis();
+    vanTraceGap = false;
+    vanTraceFileIdx = 0;
+    vanTraceFileSeqNo = 0;
+    vanTraceFileSize = 0;
+    nVanTracePackets = 0;
+    nVanTraceDropped = 0;
+    nVanTraceBytesWritten = 0;
+
+    vanTraceRecording = true;
+
+    AsyncLog.printf_P(PSTR("%sVAN bus trace recording started\n"), TimeStamp());
+} // StartVanTrace
+
+void StopVanTrace()
+{
+    if (! vanTraceRecording) return;
+
+    vanTraceRecording = false;
+
+    // Write whatever is left, regardless of bus activity
+    WriteVanTraceBuffer();
+
+    AsyncLog.printf_P(
+        PSTR("%sVAN bus trace recording stopped: %" PRIu32 " packets, %" PRIu32 " dropped, %" PRIu32 " bytes\n"),
+        TimeStamp(),
+        nVanTracePackets,
+        nVanTraceDropped,
+        nVanTraceBytesWritten
+    );
+} // StopVanTrace
+
+// Add a received packet to the staging buffer
+void RecordVanTrace(const TVanPacketRxDesc& pkt)
+{
+    if (! vanTraceRecording) return;
+
+    vanTraceLastRxAt = millis();
+
+    int dataLen = pkt.DataLen();
+    if (dataLen < 0 || dataLen > VAN_MAX_DATA_BYTES
+        || vanTraceBufferLen + VAN_TRACE_MAX_RECORD_SIZE > VAN_TRACE_BUFFER_SIZE)
+    {
+        // Buffer full: the bus was not idle long enough to write it to flash
+        nVanTraceDropped++;
+        vanTraceGap = true;
+        return;
+    } // if
+
+    uint8_t* p = vanTraceBuffer + vanTraceBufferLen;
+
+    // Packets received before the session started are stamped with the session start time
+    uint32_t delta = pkt.Millis() - vanTraceLastRecordAt;  // Arithmetic has safe roll-over
+    if ((int32_t)delta < 0) delta = 0;
+    else vanTraceLastRecordAt = pkt.Millis();
+
+    do
+    {
+        uint8_t b = delta & 0x7F;
+        delta >>= 7;
+        *p++ = delta != 0 ? b | 0x80 : b;
+    }
+    while (delta != 0);
+
+    uint16_t idenFlags = pkt.Iden() << 4 | (pkt.CommandFlags() & 0x0F);
+    *p++ = idenFlags & 0xFF;
+    *p++ = idenFlags >> 8;
+
+    *p++ = dataLen | (vanTraceGap ? VAN_TRACE_FLAG_GAP : 0) | (pkt.CheckCrc() ? VAN_TRACE_FLAG_CRC_OK : 0);
+
+    memcpy(p, pkt.Data(), dataLen);
+    p += dataLen;
+
+    uint16_t crc = pkt.Crc();
+    *p++ = crc & 0xFF;
+    *p++ = crc >> 8;
+
+    vanTraceBufferLen = p - vanTraceBuffer;
+    vanTraceGap = false;
+    nVanTracePackets++;
+} // RecordVanTrace
+
+// Called from the main loop: handle any start or stop request, and write the staging buffer to flash, but only if
+// the VAN bus is idle. Returns true if the recorder status changed.
+bool VanTraceLoop()
+{
+    int8_t request = vanTraceRequest;
+    vanTraceRequest = -1;
+    if (request == 1 && ! vanTraceRecording)
+    {
+        StartVanTrace();
+        return true;
+    } // if
+    if (request == 0 && vanTraceRecording)
+    {
+        StopVanTrace();
+        return true;
+    } // if
+
+    if (! vanTraceRecording || vanTraceBufferLen == 0) return false;
+    if (VanBusRx.GetNQueued() > 0) return false;
+    if (millis() - vanTraceLastRxAt < VAN_TRACE_FLUSH_IDLE_MS) return false;  // Arithmetic has safe roll-over
+
+    WriteVanTraceBuffer();
+
+    // Stopped because of a write error?
+    return ! vanTraceRecording;
+} // VanTraceLoop
+
+// Report the recorder status, for the "system" screen
+const char* VanTraceStatusToJson(char* buf, const int n)
+{
+    const static char jsonFormatter[] PROGMEM =
+    "{\n"
+        "\"event\": \"display\",\n"
+        "\"data\":\n"
+        "{\n"
+            "\"van_trace_status\": \"%s\"\n"
+        "}\n"
+    "}\n";
+
+    char status[48];
+    if (vanTraceRecording)
+    {
+        snprintf_P(status, sizeof(status), PSTR("REC %" PRIu32 " pkts, %" PRIu32 " KB"),
+            nVanTracePackets,
+            (nVanTraceBytesWritten + vanTraceBufferLen) / 1024
+        );
+    }
+    else
+    {
+        strcpy_P(status, PSTR("Trace: off"));
+    } // if
+
+    int at = snprintf_P(buf, n, jsonFormatter, status);
+
+    // JSON buffer overflow?
+    if (at >= n) return "";
+
+    return buf;
+} // VanTraceStatusToJson
+
+// List the trace files in JSON format, for "/trace"
+int VanTraceFilesToJson(char* buf, const int n)
+{
+    const static char jsonFormatter[] PROGMEM =
+    "{\n"
+        "\"recording\": %s,\n"
+        "\"packets\": %" PRIu32 ",\n"
+        "\"dropped\": %" PRIu32 ",\n"
+        "\"files\":\n"
+        "[";
+
+    int at = snprintf_P(buf, n, jsonFormatter,
+        vanTraceRecording ? PSTR("true") : PSTR("false"),
+        nVanTracePackets,
+        nVanTraceDropped
+    );
+
+    bool first = true;
+    for (int idx = 0; idx < VAN_TRACE_N_FILES; idx++)
+    {
+        if (! LittleFS.exists(VanTraceFileName(idx))) continue;
+
+        File file = LittleFS.open(VanTraceFileName(idx), "r");
+        if (! file) continue;
+
+        at += at >= n ? 0 :
+            snprintf_P(buf + at, n - at, PSTR("%s\n{\"file\": %d, \"size\": %u}"),
+                first ? emptyStr : commaStr,
+                idx,
+                (unsigned int)file.size()
+            );
+
+        file.close();
+        first = false;
+    } // for
+
+    at += at >= n ? 0 : snprintf_P(buf + at, n - at, PSTR("\n]\n}\n"));
+
+    return at;
+} // VanTraceFilesToJson
+
+#endif // VAN_TRACE_RECORDER
@@ -0,0 +1,419 @@
+
+// VAN bus trace replay
+//
+// Feeds a trace file, as recorded by the trace recorder (see VanTrace.ino for the file format), into the same path
+// as the packets taken from the VanBusRx receive queue: bus statistics, decimation, ParseVanPacketToJson and
+// SendJsonOnWebSocket (see ProcessVanPacket in VanLiveConnect.ino).
+//
+// The replayed packets pass through a "virtual" receive queue of the same size as the VanBusRx receive queue. The
+// queue is filled at the recorded pace (speed 1), N times faster (speed N), or as fast as the main loop drains it
+// (speed 0). The main loop takes one packet per iteration from the queue, as it does from the VanBusRx receive
+// queue. A packet that becomes due while the queue is full is lost, as it would be on the VanBusRx receive queue.
+// The drop policy of the VanBusRx receive queue (see VanRxPolicy.ino) is not applied to replayed packets.
+//
+// While replaying, packets received on the VAN bus are discarded.
+//
+// Replay is started with "/replay?file=<n>&speed=<s>", stopped with "/replay?stop=1", and its results are shown
+// with "/replay" (see ServeVanTraceReplay in WebServer.ino). The results are also printed on the serial port when
+// the replay finishes.
+
+#ifdef VAN_TRACE_RECORDER
+
+#include <LittleFS.h>
+
+// Defined in DateTime.ino
+const char* TimeStamp();
+
+// Defined in VanTrace.ino
+extern bool vanTraceRecording;
+const char* VanTraceFileName(int idx);
+// Also: VAN_TRACE_VERSION, VAN_TRACE_HEADER_SIZE, VAN_TRACE_FLAG_CRC_OK
+
+// Defined in VanLiveConnect.ino
+void ProcessVanPacket(VanPacket_t& pkt);
+
+// Defined in WebSocket.ino
+extern uint32_t nWebSocketSendFailures;
+extern uint32_t nQueuedJsonEvictions;
+
+// Number of bytes read from flash at a time
+#define VAN_TRACE_REPLAY_READ_SIZE (512)
+
+// Same size as the VanBusRx receive queue (see SetupVanReceiver in VanLiveConnect.ino)
+#define VAN_TRACE_REPLAY_QUEUE_SIZE (VAN_PACKET_QUEUE_SIZE)
+
+struct VanTraceReplayPacket_t
+{
+    unsigned long dueAt;  // Time at which the packet is "received"
+    uint16_t iden;
+    uint8_t commandFlags;
+    uint8_t dataLen;
+    bool crcOk;
+    uint16_t crc;
+    uint8_t data[VAN_MAX_DATA_BYTES];
+}; // struct VanTraceReplayPacket_t
+
+VanTraceReplayPacket_t vanTraceReplayQueue[VAN_TRACE_REPLAY_QUEUE_SIZE];
+int vanTraceReplayQueueHead = 0;  // Next packet to process
+int vanTraceReplayQueueLen = 0;
+
+// Set by "/replay": file index to replay (or -1 to stop), and speed. Handled in the main loop, so that no flash
+// file system operations are done in the web server event handler.
+volatile int8_t vanTraceReplayRequest = -2;  // -2 = none
+volatile uint8_t vanTraceReplayRequestSpeed = 1;
+
+bool vanTraceReplaying = false;
+int vanTraceReplayFileIdx = -1;
+uint8_t vanTraceReplaySpeed = 1;  // 0 = as fast as possible
+
+uint8_t vanTraceReplayReadBuffer[VAN_TRACE_REPLAY_READ_SIZE];
+int vanTraceReplayReadLen = 0;
+int vanTraceReplayReadAt = 0;
+uint32_t vanTraceReplayFilePos = 0;
+bool vanTraceReplayEof = false;
+
+// Record that was read from the file, but is not yet due
+bool vanTraceReplayHasPending = false;
+VanTraceReplayPacket_t vanTraceReplayPending;
+
+uint32_t vanTraceReplayTraceTime = 0;  // Trace time of the last record read, in ms since session start
+unsigned long vanTraceReplayStartedAt = 0;
+unsigned long vanTraceReplayFinishedAt = 0;
+
+// Results of the last (or current) replay
+uint32_t nVanTraceReplayPackets = 0;  // Packets processed
+uint32_t nVanTraceReplayOverruns = 0;  // Packets lost because the queue was full
+uint32_t nVanTraceReplayBadRecords = 0;
+uint32_t nVanTraceReplayDroppedUpdates = 0;  // WebSocket send failures and queue evictions during the replay
+int vanTraceReplayQueueHighWater = 0;
+unsigned long vanTraceReplayMaxLag = 0;  // Highest time between "reception" and processing, in ms
+
+uint32_t vanTraceReplaySendFailuresAtStart = 0;
+uint32_t vanTraceReplayEvictionsAtStart = 0;
+
+bool IsVanTraceReplaying()
+{
+    return vanTraceReplaying;
+} // IsVanTraceReplaying
+
+// Request a replay from the web server event handler; 'idx' = -1 to stop
+void RequestVanTraceReplay(int idx, int speed)
+{
+    vanTraceReplayRequestSpeed = speed < 0 ? 1 : speed > 255 ? 255 : speed;
+    vanTraceReplayRequest = idx;
+} // RequestVanTraceReplay
+
+// Returns the next byte from the trace file, or -1 at the end of the file
+int ReadVanTraceReplayByte()
+{
+    if (vanTraceReplayReadAt >= vanTraceReplayReadLen)
+    {
+        if (vanTraceReplayEof) return -1;
+
+        VanBusRx.Disable();
+        File file = LittleFS.open(VanTraceFileName(vanTraceReplayFileIdx), "r");
+        vanTraceReplayReadLen = 0;
+        if (file && file.seek(vanTraceReplayFilePos))
+        {
+            vanTraceReplayReadLen = file.read(vanTraceReplayReadBuffer, sizeof(vanTraceReplayReadBuffer));
+        } // if
+        if (file) file.close();
+        VanBusRx.Enable();
+
+        vanTraceReplayReadAt = 0;
+        if (vanTraceReplayReadLen <= 0)
+        {
+            vanTraceReplayReadLen = 0;
+            vanTraceReplayEof = true;
+            return -1;
+        } // if
+
+        vanTraceReplayFilePos += vanTraceReplayReadLen;
+    } // if
+
+    return vanTraceReplayReadBuffer[vanTraceReplayReadAt++];
+} // ReadVanTraceReplayByte
+
+// Read the next record from the trace file into 'vanTraceReplayPending'. Returns false at the end of the file.
+bool ReadVanTraceReplayRecord()
+{
+    uint32_t delta = 0;
+    int shift = 0;
+    int b;
+    do
+    {
+        b = ReadVanTraceReplayByte();
+        if (b < 0) return false;
+        if (shift < 32) delta |= (uint32_t)(b & 0x7F) << shift;
+        shift += 7;
+    }
+    while (b & 0x80);
+
+    uint8_t bytes[3];
+    for (int i = 0; i < 3; i++)
+    {
+        b = ReadVanTraceReplayByte();
+        if (b < 0) return false;
+        bytes[i] = b;
+    } // for
+
+    uint16_t idenFlags = bytes[0] | bytes[1] << 8;
+    int dataLen = bytes[2] & 0x1F;
+    if (dataLen > VAN_MAX_DATA_BYTES)
+    {
+        // Corrupt file: nothing more can be trusted
+        nVanTraceReplayBadRecords++;
+        return false;
+    } // if
+
+    VanTraceReplayPacket_t& rec = vanTraceReplayPending;
+    rec.iden = idenFlags >> 4;
+    rec.commandFlags = idenFlags & 0x0F;
+    rec.dataLen = dataLen;
+    rec.crcOk = bytes[2] & VAN_TRACE_FLAG_CRC_OK;
+
+    for (int i = 0; i < dataLen + 2; i++)
+    {
+        b = ReadVanTraceReplayByte();
+        if (b < 0) return false;
+        if (i < dataLen) rec.data[i] = b;
+        else if (i == dataLen) rec.crc = b;
+        else rec.crc |= b << 8;
+    } // for
+
+    vanTraceReplayTraceTime += delta;
+    rec.dueAt = vanTraceReplaySpeed == 0
+        ? 0  // Stamped when queued
+        : vanTraceReplayStartedAt + vanTraceReplayTraceTime / vanTraceReplaySpeed;
+
+    return true;
+} // ReadVanTraceReplayRecord
+
+void StopVanTraceReplay()
+{
+    if (! vanTraceReplaying) return;
+
+    vanTraceReplaying = false;
+    vanTraceReplayFinishedAt = millis();
+    vanTraceReplayQueueLen = 0;
+
+    nVanTraceReplayDroppedUpdates =
+        (nWebSocketSendFailures - vanTraceReplaySendFailuresAtStart)
+        + (nQueuedJsonEvictions - vanTraceReplayEvictionsAtStart);
+
+    unsigned long elapsed = vanTraceReplayFinishedAt - vanTraceReplayStartedAt;
+    AsyncLog.printf_P(
+        PSTR("%sVAN bus trace replay of '%s' at speed %u finished: %" PRIu32 " packets in %lu ms (%lu pkt/s),"
+            " queue high-water %d/%d, %" PRIu32 " overruns, max lag %lu ms, %" PRIu32 " dropped updates\n"),
+        TimeStamp(),
+        VanTraceFileName(vanTraceReplayFileIdx),
+        vanTraceReplaySpeed,
+        nVanTraceReplayPackets,
+        elapsed,
+        elapsed == 0 ? 0 : (unsigned long)((uint64_t)nVanTraceReplayPackets * 1000 / elapsed),
+        vanTraceReplayQueueHighWater,
+        VAN_TRACE_REPLAY_QUEUE_SIZE,
+        nVanTraceReplayOverruns,
+        vanTraceReplayMaxLag,
+        nVanTraceReplayDroppedUpdates
+    );
+} // StopVanTraceReplay
+
+void StartVanTraceReplay(int idx, uint8_t speed)
+{
+    if (vanTraceReplaying) StopVanTraceReplay();
+
+    // Replaying while recording would record nothing useful, and compete for the flash file system
+    if (vanTraceRecording)
+    {
+        Log(LOG_LEVEL_WARNING).printf_P(PSTR("%s==> Cannot replay a VAN bus trace while recording\n"), TimeStamp());
+        return;
+    } // if
+
+    vanTraceReplayFileIdx = idx;
+    vanTraceReplaySpeed = speed;
+    vanTraceReplayReadLen = vanTraceReplayReadAt = 0;
+    vanTraceReplayFilePos = 0;
+    vanTraceReplayEof = false;
+
+    uint8_t header[VAN_TRACE_HEADER_SIZE];
+    for (int i = 0; i < VAN_TRACE_HEADER_SIZE; i++)
+    {
+        int b = ReadVanTraceReplayByte();
+        if (b < 0)
+        {
+            Log(LOG_LEVEL_WARNING).printf_P(PSTR("%s==> Cannot read VAN bus trace file '%s'\n"),
+                TimeStamp(),
+                VanTraceFileName(idx)
+            );
+            return;
+        } // if
+        header[i] = b;
+    } // for
+
+    if (memcmp(header, "VANT", 4) != 0 || header[4] != VAN_TRACE_VERSION)
+    {
+        Log(LOG_LEVEL_WARNING).printf_P(PSTR("%s==> '%s' is not a VAN bus trace file\n"),
+            TimeStamp(),
+            VanTraceFileName(idx)
+        );
+        return;
+    } // if
+
+    vanTraceReplayQueueHead = vanTraceReplayQueueLen = 0;
+    vanTraceReplayHasPending = false;
+    vanTraceReplayTraceTime = 0;
+    vanTraceReplayStartedAt = millis();
+    vanTraceReplayFinishedAt = 0;
+
+    nVanTraceReplayPackets = 0;
+    nVanTraceReplayOverruns = 0;
+    nVanTraceReplayBadRecords = 0;
+    nVanTraceReplayDroppedUpdates = 0;
+    vanTraceReplayQueueHighWater = 0;
+    vanTraceReplayMaxLag = 0;
+    vanTraceReplaySendFailuresAtStart = nWebSocketSendFailures;
+    vanTraceReplayEvictionsAtStart = nQueuedJsonEvictions;
+
+    vanTraceReplaying = true;
+
+    AsyncLog.printf_P(PSTR("%sVAN bus trace replay of '%s' started at speed %u\n"),
+        TimeStamp(),
+        VanTraceFileName(idx),
+        speed
+    );
+} // StartVanTraceReplay
+
+// Move the records that are due into the queue
+void FillVanTraceReplayQueue()
+{
+    unsigned long now = millis();
+
+    for (;;)
+    {
+        if (! vanTraceReplayHasPending)
+        {
+            if (! ReadVanTraceReplayRecord()) return;
+            vanTraceReplayHasPending = true;
+        } // if
+
+        if (vanTraceReplaySpeed == 0)
+        {
+            // As fast as possible: keep the queue full, but never overrun it
+            if (vanTraceReplayQueueLen >= VAN_TRACE_REPLAY_QUEUE_SIZE) return;
+            vanTraceReplayPending.dueAt = now;
+        }
+        else
+        {
+            if ((long)(now - vanTraceReplayPending.dueAt) < 0) return;  // Arithmetic has safe roll-over
+        } // if
+
+        vanTraceReplayHasPending = false;
+
+        if (vanTraceReplayQueueLen >= VAN_TRACE_REPLAY_QUEUE_SIZE)
+        {
+            nVanTraceReplayOverruns++;
+            continue;
+        } // if
+
+        int tail = (vanTraceReplayQueueHead + vanTraceReplayQueueLen) % VAN_TRACE_REPLAY_QUEUE_SIZE;
+        vanTraceReplayQueue[tail] = vanTraceReplayPending;
+        vanTraceReplayQueueLen++;
+        if (vanTraceReplayQueueLen > vanTraceReplayQueueHighWater)
+        {
+            vanTraceReplayQueueHighWater = vanTraceReplayQueueLen;
+        } // if
+    } // for
+} // FillVanTraceReplayQueue
+
+// Called from the main loop, in place of taking a packet from the VanBusRx receive queue: handle any start or stop
+// request, and process the next replayed packet, if any. Returns true if the replay status changed.
+bool VanTraceReplayLoop()
+{
+    int8_t request = vanTraceReplayRequest;
+    vanTraceReplayRequest = -2;
+    if (request >= 0)
+    {
+        StartVanTraceReplay(request, vanTraceReplayRequestSpeed);
+        return true;
+    } // if
+    if (request == -1 && vanTraceReplaying)
+    {
+        StopVanTraceReplay();
+        return true;
+    } // if
+
+    if (! vanTraceReplaying) return false;
+
+    FillVanTraceReplayQueue();
+
+    if (vanTraceReplayQueueLen == 0)
+    {
+        if (vanTraceReplayHasPending || ! vanTraceReplayEof) return false;
+
+        // Done
+        StopVanTraceReplay();
+        return true;
+    } // if
+
+    const VanTraceReplayPacket_t& rec = vanTraceReplayQueue[vanTraceReplayQueueHead];
+    vanTraceReplayQueueHead = (vanTraceReplayQueueHead + 1) % VAN_TRACE_REPLAY_QUEUE_SIZE;
+    vanTraceReplayQueueLen--;
+
+    unsigned long lag = millis() - rec.dueAt;
+    if (lag > vanTraceReplayMaxLag) vanTraceReplayMaxLag = lag;
+
+    // Copy the data: the packet parsers may repair the data in place
+    uint8_t data[VAN_MAX_DATA_BYTES];
+    memcpy(data, rec.data, rec.dataLen);
+
+    VanPacket_t pkt(rec.iden, rec.commandFlags, data, rec.dataLen, rec.crc, rec.crcOk, rec.dueAt);
+    ProcessVanPacket(pkt);
+    nVanTraceReplayPackets++;
+
+    return false;
+} // VanTraceReplayLoop
+
+// Report the replay status and results in JSON format, for "/replay"
+int VanTraceReplayToJson(char* buf, const int n)
+{
+    const static char jsonFormatter[] PROGMEM =
+    "{\n"
+        "\"replaying\": %s,\n"
+        "\"file\": %d,\n"
+        "\"speed\": %u,\n"
+        "\"packets\": %" PRIu32 ",\n"
+        "\"elapsed_ms\": %lu,\n"
+        "\"packets_per_sec\": %lu,\n"
+        "\"queue_high_water\": %d,\n"
+        "\"queue_size\": %d,\n"
+        "\"queue_overruns\": %" PRIu32 ",\n"
+        "\"max_lag_ms\": %lu,\n"
+        "\"dropped_updates\": %" PRIu32 ",\n"
+        "\"bad_records\": %" PRIu32 "\n"
+    "}\n";
+
+    unsigned long elapsed = (vanTraceReplaying ? millis() : vanTraceReplayFinishedAt) - vanTraceReplayStartedAt;
+
+    uint32_t droppedUpdates = vanTraceReplaying
+        ? (nWebSocketSendFailures - vanTraceReplaySendFailuresAtStart)
+            + (nQueuedJsonEvictions - vanTraceReplayEvictionsAtStart)
+        : nVanTraceReplayDroppedUpdates;
+
+    return snprintf_P(buf, n, jsonFormatter,
+        vanTraceReplaying ? PSTR("true") : PSTR("false"),
+        vanTraceReplayFileIdx,
+        vanTraceReplaySpeed,
+        nVanTraceReplayPackets,
+        elapsed,
+        elapsed == 0 ? 0 : (unsigned long)((uint64_t)nVanTraceReplayPackets * 1000 / elapsed),
+        vanTraceReplayQueueHighWater,
+        VAN_TRACE_REPLAY_QUEUE_SIZE,
+        nVanTraceReplayOverruns,
+        vanTraceReplayMaxLag,
+        droppedUpdates,
+        nVanTraceReplayBadRecords
+    );
+} // VanTraceReplayToJson
+
+#endif // VAN_TRACE_RECORDER
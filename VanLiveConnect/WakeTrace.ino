@@ -0,0 +1,132 @@
+
+// Functions for measuring the time from waking up until the first frame is sent to a client
+//
+// Drivers tend to open the phone long before the display is live, so the time from waking up until the first
+// WebSocket frame matters. For each phase of the wake sequence (see enum WakePhase_t in VanLiveConnect.ino), the
+// moment it is first reached is recorded, in milliseconds since waking up:
+// - On the ESP8266, waking up from light sleep is followed by a restart (see GoToSleep in Sleep.ino). The time
+//   from waking up until the restart is passed on in RTC memory.
+// - On the ESP32, waking up from deep sleep is a boot; the time spent in the ROM and the bootloader is not measured.
+// After a power-on or reset, the times are since booting.
+//
+// The phases up to and including "ready" are under control of the ESP; their total must stay within
+// WAKE_READY_BUDGET_MS (see Config.h). The later phases also depend on the client.
+//
+// The wake trace is printed as soon as the first frame is sent, and reported in "/metrics".
+
+// Defined in Sleep.ino
+extern bool wokeUpFromSleep;
+extern uint32_t msecFromWakeToRestart;
+
+// Defined in DateTime.ino
+const char* TimeStamp();
+
+// Defined in Metrics.ino
+extern const char gaugeStr[];
+int MetricHeader(char* buf, const int n, PGM_P name, PGM_P type, PGM_P help);
+int ScalarMetric(char* buf, const int n, PGM_P name, PGM_P type, PGM_P help, uint32_t value);
+
+uint32_t wakePhaseAt[N_WAKE_PHASES];  // Milliseconds since waking up
+
+// One flag per phase instead of a bit mask: with VAN_RX_PARSE_TASK, phases are marked from more than one task
+volatile bool wakePhaseReached[N_WAKE_PHASES];
+
+// Returns a PSTR (allocated in flash, saves RAM)
+PGM_P WakePhaseStr(int phase)
+{
+    return
+        phase == WAKE_PHASE_SETUP ? PSTR("setup") :
+        phase == WAKE_PHASE_SETTINGS ? PSTR("settings") :
+        phase == WAKE_PHASE_VAN_RX ? PSTR("van_rx") :
+        phase == WAKE_PHASE_WIFI ? PSTR("wifi") :
+        phase == WAKE_PHASE_STORE ? PSTR("store") :
+        phase == WAKE_PHASE_WEB_SERVER ? PSTR("web_server") :
+        phase == WAKE_PHASE_READY ? PSTR("ready") :
+        phase == WAKE_PHASE_FIRST_VAN_PACKET ? PSTR("first_van_packet") :
+        phase == WAKE_PHASE_WIFI_LINK ? PSTR("wifi_link") :
+        phase == WAKE_PHASE_WEBSOCKET_CLIENT ? PSTR("websocket_client") :
+        phase == WAKE_PHASE_FIRST_FRAME ? PSTR("first_frame") :
+        PSTR("??");
+} // WakePhaseStr
+
+bool IsWakePhaseReached(int phase)
+{
+    return wakePhaseReached[phase];
+} // IsWakePhaseReached
+
+void PrintWakeTrace(Print& s)
+{
+    s.printf_P(PSTR("%sWake trace (msec since %s):"),
+        TimeStamp(),
+        wokeUpFromSleep ? PSTR("waking up") : PSTR("booting"));
+
+    for (int phase = 0; phase < N_WAKE_PHASES; phase++)
+    {
+        if (! IsWakePhaseReached(phase)) continue;
+        s.printf_P(PSTR(" %s %" PRIu32), WakePhaseStr(phase), wakePhaseAt[phase]);
+    } // for
+
+    s.print("\n");
+} // PrintWakeTrace
+
+// Record the moment 'at' (in ESP milliseconds) as the moment the specified phase is reached; only the first time
+// counts
+void MarkWakePhase(int phase, unsigned long at)
+{
+    if (IsWakePhaseReached(phase)) return;
+
+    wakePhaseAt[phase] = msecFromWakeToRestart + at;
+    wakePhaseReached[phase] = true;
+
+    if (phase == WAKE_PHASE_READY && wakePhaseAt[phase] > WAKE_READY_BUDGET_MS)
+    {
+        Log(LOG_LEVEL_WARNING).printf_P(PSTR("%s==> Ready after %" PRIu32 " msec; budget is %u msec\n"),
+            TimeStamp(), wakePhaseAt[phase], WAKE_READY_BUDGET_MS);
+    }
+    else if (phase == WAKE_PHASE_FIRST_FRAME)
+    {
+        PrintWakeTrace(AsyncLog);
+    } // if
+} // MarkWakePhase
+
+// Record now as the moment the specified phase is reached. Also called from the Wi-Fi and WebSocket event handlers.
+void MarkWakePhase(int phase)
+{
+    if (IsWakePhaseReached(phase)) return;
+    MarkWakePhase(phase, millis());
+} // MarkWakePhase
+
+int WakeTraceMetricsText(int item, char* buf, const int n)
+{
+    if (item == 0)
+    {
+        return MetricHeader(buf, n, PSTR("wake_phase_msec"), gaugeStr,
+            PSTR("Time from waking up (or booting) until first reaching each phase of the wake sequence."));
+    } // if
+
+    int phase = item - 1;
+    if (phase < N_WAKE_PHASES)
+    {
+        // Prometheus text format has "NaN" for "no value"
+        if (! IsWakePhaseReached(phase))
+        {
+            return snprintf_P(buf, n, PSTR("vanlive_wake_phase_msec{phase=\"%s\"} NaN\n"), WakePhaseStr(phase));
+        } // if
+
+        return snprintf_P(buf, n, PSTR("vanlive_wake_phase_msec{phase=\"%s\"} %" PRIu32 "\n"),
+            WakePhaseStr(phase), wakePhaseAt[phase]);
+    } // if
+
+    switch (phase - N_WAKE_PHASES)
+    {
+        case 0:
+            return ScalarMetric(buf, n, PSTR("wake_ready_budget_msec"), gaugeStr,
+                PSTR("Budget for the time from waking up until ready to serve clients."), WAKE_READY_BUDGET_MS);
+        case 1:
+            return ScalarMetric(buf, n, PSTR("woke_up_from_sleep"), gaugeStr,
+                PSTR("1 if the last start was a wake-up from sleep, 0 if it was a power-on or reset."),
+                wokeUpFromSleep);
+        default:
+            return 0;
+    } // switch
+} // WakeTraceMetricsText
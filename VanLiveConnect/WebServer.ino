@@ -1,5 +1,5 @@
 
-#include <map>
+#include <memory>
 
 #if defined SERVE_FROM_SPIFFS || defined SERVE_FROM_LITTLEFS
 
@@ -36,9 +36,82 @@ AsyncWebServer webServer(80);
 extern String md5Checksum;
 
 // Defined in WebSocket.ino
-extern std::map<uint32_t, unsigned long> lastWebSocketCommunication;
+bool GetLastWebSocketCommunication(uint32_t ip, unsigned long& lastCommunication);
 void DeleteAllQueuedJsons();
 
+// Defined in PacketToJson.ino
+int StringTablesJsLine(int line, char* buf, const int n);
+
+// Defined in LatencyTrace.ino
+int LatencyHistogramsToJson(char* buf, const int n);
+
+// Defined in Metrics.ino
+int MetricsText(int& section, int& item, char* buf, const int n);
+
+// Defined in Log.ino
+bool SetDiagnostic(const char* name, const char* value);
+const char* DiagnosticsToJson(char* buf, const int n);
+
+// Defined in BusStats.ino
+int BusStatsJsonText(int& slot, int& nListed, char* buf, const int n);
+bool SetBusStatsPrintSelection(uint16_t iden, int selection);
+
+#ifdef VAN_TRACE_RECORDER
+// Defined in VanTrace.ino
+const char* VanTraceFileName(int idx);
+int VanTraceFilesToJson(char* buf, const int n);
+
+// Defined in VanTraceReplay.ino
+void RequestVanTraceReplay(int idx, int speed);
+int VanTraceReplayToJson(char* buf, const int n);
+#endif // VAN_TRACE_RECORDER
+
+// Defined in Memory.ino
+bool AdmitMemory(int budget, size_t size);
+
+// Defined in Esp.ino
+uint32_t MaxFreeBlockSize();
+
+// Defined in Sleep.ino
+extern bool wokeUpFromSleep;
+
+// A chunked response that is generated piece by piece (e.g. line by line): the piece that is being copied into the
+// response chunks. Each response has its own, held by its filler function, so that it is freed together with the
+// response (see ServeStringTablesJs).
+template <int SIZE>
+struct ResponsePiece_t
+{
+    char buf[SIZE];
+    int len = 0;
+    int at = 0;
+
+    // Fill a response chunk with the pieces generated by 'next(buf, SIZE)', until that returns 0 or less. Returns
+    // the number of bytes written.
+    template <typename NextPiece>
+    size_t Fill(uint8_t* chunk, size_t maxLen, NextPiece next)
+    {
+        size_t filled = 0;
+        while (filled < maxLen)
+        {
+            if (at >= len)
+            {
+                // Generate the next piece; stop when done
+                len = next(buf, SIZE);
+                if (len <= 0) break;
+                if (len >= SIZE) len = SIZE - 1;  // Truncated
+                at = 0;
+            } // if
+
+            size_t n = std::min(maxLen - filled, (size_t)(len - at));
+            memcpy(chunk + filled, buf + at, n);
+            filled += n;
+            at += n;
+        } // while
+
+        return filled;
+    } // Fill
+}; // struct ResponsePiece_t
+
 #if defined SERVE_FROM_SPIFFS || defined SERVE_FROM_LITTLEFS
 
 // Table with the MD5 hash value of each file in the root directory
@@ -46,12 +119,22 @@ struct FileMd5Entry_t
 {
     String path;
     String md5;
+    size_t size;
+    time_t lastWrite;
 }; // FileMd5Entry_t
 
 #define MAX_FILE_MD5 20
 FileMd5Entry_t fileMd5[MAX_FILE_MD5];
 int fileMd5Last = 0;
 
+// Calculating the MD5 hash values of all files takes a long time, also when waking up (see WakeTrace.ino).
+// Therefore, the table is cached in this file. An entry is re-used as long as the file size and the time of the last
+// write are unchanged, so that a file that is rewritten with the same size (e.g. by uploading a single file) gets a
+// new hash value. Note: SPIFFS does not keep the time of the last write (it is always 0), so with SERVE_FROM_SPIFFS
+// a file that is rewritten with the same size keeps its old hash value, until a new file system image is uploaded
+// (which also removes this file).
+#define FILE_MD5_MANIFEST_PATH "/md5.txt"
+
 String _formatBytes(size_t bytes)
 {
     if (bytes < 1024) return String(bytes)+" Bytes";
@@ -60,6 +143,64 @@ String _formatBytes(size_t bytes)
     else return String(bytes/1024.0/1024.0/1024.0)+" GBytes";
 } // _formatBytes
 
+// Fill the MD5 hash value table from the manifest file. Lines are formatted as: "<md5> <size> <last write> <path>".
+void ReadFileMd5Manifest()
+{
+    fileMd5Last = 0;
+
+    File file = SPIFFS.open(FILE_MD5_MANIFEST_PATH, "r");
+    if (! file) return;
+
+    while (file.available() && fileMd5Last < MAX_FILE_MD5)
+    {
+        String md5 = file.readStringUntil(' ');
+        size_t size = file.readStringUntil(' ').toInt();
+        String lastWrite = file.readStringUntil(' ');
+        String path = file.readStringUntil('\n');
+        if (md5.length() != 32 || ! isdigit(lastWrite.c_str()[0]) || path.length() == 0) break;  // Corrupt or old
+
+        fileMd5[fileMd5Last].path = path;
+        fileMd5[fileMd5Last].md5 = md5;
+        fileMd5[fileMd5Last].size = size;
+        fileMd5[fileMd5Last].lastWrite = lastWrite.toInt();
+        fileMd5Last++;
+    } // while
+
+    file.close();
+} // ReadFileMd5Manifest
+
+void WriteFileMd5Manifest()
+{
+    File file = SPIFFS.open(FILE_MD5_MANIFEST_PATH, "w");
+    if (! file) return;
+
+    for (int i = 0; i < fileMd5Last; i++)
+    {
+        file.printf_P(
+            PSTR("%s %zu %lu %s\n"),
+            fileMd5[i].md5.c_str(),
+            fileMd5[i].size,
+            (unsigned long)fileMd5[i].lastWrite,
+            fileMd5[i].path.c_str()
+        );
+    } // for
+
+    file.close();
+} // WriteFileMd5Manifest
+
+// Returns true if the file is not a web document, so that its MD5 hash value is not needed
+bool IsNonDocumentFile(const String& path)
+{
+    if (path == FILE_MD5_MANIFEST_PATH) return true;
+
+  #ifdef VAN_TRACE_RECORDER
+    // Changes all the time, and is served without ETag (see ServeVanTrace)
+    for (int idx = 0; idx < VAN_TRACE_N_FILES; idx++) if (path == VanTraceFileName(idx)) return true;
+  #endif // VAN_TRACE_RECORDER
+
+    return false;
+} // IsNonDocumentFile
+
 void SetupStore()
 {
   #ifdef SERVE_FROM_SPIFFS
@@ -92,6 +233,11 @@ void SetupStore()
     Serial.printf_P(PSTR(" OK, total %s MByes\n"), FloatToStr(b, fs_info.totalBytes / 1024.0 / 1024.0, 2));
   #endif // ARDUINO_ARCH_ESP32
 
+    ReadFileMd5Manifest();
+    int nCached = fileMd5Last;
+    bool isSeen[MAX_FILE_MD5] = {};
+    bool manifestChanged = false;
+
     // Print the contents of the root directory
   #ifdef ARDUINO_ARCH_ESP32
     File dir = SPIFFS.open("/");
@@ -115,15 +261,35 @@ void SetupStore()
         String fileName = entry.name();
       #endif // SERVE_FROM_LITTLEFS
 
-        // Create a table with the MD5 hash value of each file
+        size_t fileSize = entry.size();
+        time_t fileLastWrite = entry.getLastWrite();
+
+        // Create a table with the MD5 hash value of each file, re-using the cached value if possible
         // Inspired by https://github.com/esp8266/Arduino/issues/3003
 
-        size_t fileSize = entry.size();
-        MD5Builder md5;
-        md5.begin();
-        md5.addStream(entry, fileSize);
-        md5.calculate();
-        md5.toString();
+        int i = 0;
+        while (i < fileMd5Last && fileMd5[i].path != fileName) i++;
+
+        bool isDocument = ! IsNonDocumentFile(fileName);
+        bool isCached =
+            isDocument && i < nCached && fileMd5[i].size == fileSize && fileMd5[i].lastWrite == fileLastWrite;
+
+        if (isDocument && ! isCached && i < MAX_FILE_MD5)
+        {
+            MD5Builder md5;
+            md5.begin();
+            md5.addStream(entry, fileSize);
+            md5.calculate();
+
+            fileMd5[i].path = fileName;
+            fileMd5[i].md5 = md5.toString();
+            fileMd5[i].size = fileSize;
+            fileMd5[i].lastWrite = fileLastWrite;
+            if (i == fileMd5Last) fileMd5Last++;
+            manifestChanged = true;
+        } // if
+
+        if (isDocument && i < MAX_FILE_MD5) isSeen[i] = true;
 
       #ifdef ARDUINO_ARCH_ESP32
         entry = dir.openNextFile();
@@ -131,16 +297,19 @@ void SetupStore()
         entry.close();
       #endif // ARDUINO_ARCH_ESP32
 
-        Serial.printf_P(
-            PSTR("FS File: '%s', size: %s, MD5: %s\n"),
-            fileName.c_str(),
-            _formatBytes(fileSize).c_str(),
-            md5.toString().c_str()
-        );
+        // Skip the printout when waking up (see setup() in VanLiveConnect.ino)
+        if (! wokeUpFromSleep)
+        {
+            Serial.printf_P(
+                PSTR("FS File: '%s', size: %s, MD5: %s%s\n"),
+                fileName.c_str(),
+                _formatBytes(fileSize).c_str(),
+                ! isDocument ? PSTR("-") : i < MAX_FILE_MD5 ? fileMd5[i].md5.c_str() : PSTR("?"),
+                isCached ? PSTR(" (cached)") : emptyStr
+            );
+        } // if
 
-        fileMd5[fileMd5Last].path = fileName;
-        fileMd5[fileMd5Last].md5 = md5.toString();
-        if (++fileMd5Last >= MAX_FILE_MD5)
+        if (isDocument && i >= MAX_FILE_MD5)
         {
             Serial.print(F("====> Too many files found: please increase MAX_FILE_MD5\n"));
             break;
@@ -151,6 +320,19 @@ void SetupStore()
     dir.close();
   #endif
 
+    // Remove the entries of files that no longer exist
+    int last = 0;
+    for (int i = 0; i < fileMd5Last; i++)
+    {
+        if (! isSeen[i]) continue;
+        if (i != last) fileMd5[last] = fileMd5[i];
+        last++;
+    } // for
+    if (last != fileMd5Last) manifestChanged = true;
+    fileMd5Last = last;
+
+    if (manifestChanged) WriteFileMd5Manifest();
+
     VanBusRx.Enable();
 } // SetupStore
 
@@ -172,50 +354,50 @@ String getMd5(const String& path)
 // Print all HTTP request details on Serial
 void printHttpRequest(class AsyncWebServerRequest* request)
 {
-  #ifdef DEBUG_WEBSERVER
-    Serial.printf_P(PSTR("%s[webServer] Received request from "), TimeStamp());
-    Serial.print(request->client()->remoteIP());
-    Serial.printf_P(PSTR(": %s - 'http://"), request->methodToString());
-    Serial.print(request->host());
-    Serial.print(request->url());
+    if (! IsDiagEnabled(DIAG_WEBSERVER)) return;
 
-    if (request->args() > 0) Serial.print("?");
+    AsyncLog.printf_P(PSTR("%s[webServer] Received request from "), TimeStamp());
+    AsyncLog.print(request->client()->remoteIP());
+    AsyncLog.printf_P(PSTR(": %s - 'http://"), request->methodToString());
+    AsyncLog.print(request->host());
+    AsyncLog.print(request->url());
+
+    if (request->args() > 0) AsyncLog.print("?");
 
     for (size_t i = 0; i < request->args(); i++)
     {
-        Serial.print(request->argName(i));
-        Serial.print("=");
-        Serial.print(request->arg(i));
-        if (i < request->args() - 1) Serial.print('&');
+        AsyncLog.print(request->argName(i));
+        AsyncLog.print("=");
+        AsyncLog.print(request->arg(i));
+        if (i < request->args() - 1) AsyncLog.print('&');
     } // for
 
-    Serial.print("'\n");
-  #else
-    (void)request;
-  #endif // DEBUG_WEBSERVER
+    AsyncLog.print("'\n");
 } // printHttpRequest
 
 // Returns true if the actual Etag is equal to the received Etag in an 'If-None-Match' header field.
 // Shameless copy from: https://werner.rothschopf.net/microcontroller/202011_arduino_webserver_caching_en.htm .
 bool checkETag(class AsyncWebServerRequest* request, const String& etag)
 {
-  #ifdef DEBUG_WEBSERVER
-    Serial.printf_P(PSTR("%s[webServer] checkETag(%s)\n"), TimeStamp(), etag.c_str());
-  #endif // DEBUG_WEBSERVER
+    if (IsDiagEnabled(DIAG_WEBSERVER))
+    {
+        AsyncLog.printf_P(PSTR("%s[webServer] checkETag(%s)\n"), TimeStamp(), etag.c_str());
+    } // if
 
     if (etag == "") return false;
 
-  #ifdef DEBUG_WEBSERVER
-    Serial.printf_P(PSTR("%s[webServer] request->headers = %zu\n"), TimeStamp(), request->headers());
-
-    Serial.printf_P(PSTR("%s[webServer] all request headers:\n"), TimeStamp());
-    for (int i = 0; i < 100; i++)
+    if (IsDiagEnabled(DIAG_WEBSERVER))
     {
-        String headerName = request->headerName(i);
-        if (headerName.length() == 0) continue;
-        Serial.printf_P(PSTR("               - %s : %s\n"), headerName.c_str(), request->header(i).c_str());
-    } // for
-  #endif // DEBUG_WEBSERVER
+        AsyncLog.printf_P(PSTR("%s[webServer] request->headers = %zu\n"), TimeStamp(), request->headers());
+
+        AsyncLog.printf_P(PSTR("%s[webServer] all request headers:\n"), TimeStamp());
+        for (int i = 0; i < 100; i++)
+        {
+            String headerName = request->headerName(i);
+            if (headerName.length() == 0) continue;
+            AsyncLog.printf_P(PSTR("               - %s : %s\n"), headerName.c_str(), request->header(i).c_str());
+        } // for
+    } // if
 
     if(request->hasHeader(F("If-None-Match")))
     {
@@ -241,12 +423,13 @@ bool checkETag(class AsyncWebServerRequest* request, const String& etag)
             response->addHeader("ETag", String("\"") + etag + "\"");
             request->send(response);
 
-          #ifdef DEBUG_WEBSERVER
-            Serial.printf_P(PSTR("%s"), TimeStamp());
-            Serial.print(F("[webServer] If-None-Match: "));
-            Serial.print(etag);
-            Serial.print(F(" - Not Modified\n"));
-          #endif // DEBUG_WEBSERVER
+            if (IsDiagEnabled(DIAG_WEBSERVER))
+            {
+                AsyncLog.printf_P(PSTR("%s"), TimeStamp());
+                AsyncLog.print(F("[webServer] If-None-Match: "));
+                AsyncLog.print(etag);
+                AsyncLog.print(F(" - Not Modified\n"));
+            } // if
             return true;
         } // if
     } // if
@@ -273,20 +456,23 @@ void HandleAndroidConnectivityCheck(class AsyncWebServerRequest* request)
 
     IPAddress clientIp = request->client()->remoteIP();
 
-    if (lastWebSocketCommunication.find(clientIp) != lastWebSocketCommunication.end())
+    unsigned long lastCommunication;
+    if (GetLastWebSocketCommunication(clientIp, lastCommunication))
     {
-        unsigned long since = millis() - lastWebSocketCommunication[clientIp];  // Arithmetic has safe roll-over
+        unsigned long since = millis() - lastCommunication;  // Arithmetic has safe roll-over
 
       #define WEBSERVER_RESPOND_TO_204_AFTER_MS (7 * 1000)
 
-      #ifdef DEBUG_WEBSERVER
-        Serial.printf_P(PSTR("%s[webServer] Last websocket communication with %s was %lu msecs ago: %sresponding\n"),
-            TimeStamp(),
-            clientIp.toString().c_str(),
-            since,
-            since < WEBSERVER_RESPOND_TO_204_AFTER_MS ? PSTR("NOT ") : emptyStr
-        );
-      #endif // DEBUG_WEBSERVER
+        if (IsDiagEnabled(DIAG_WEBSERVER))
+        {
+            AsyncLog.printf_P(
+                PSTR("%s[webServer] Last websocket communication with %s was %lu msecs ago: %sresponding\n"),
+                TimeStamp(),
+                clientIp.toString().c_str(),
+                since,
+                since < WEBSERVER_RESPOND_TO_204_AFTER_MS ? PSTR("NOT ") : emptyStr
+            );
+        } // if
 
         if (since < WEBSERVER_RESPOND_TO_204_AFTER_MS) return;
     } // if
@@ -295,18 +481,17 @@ void HandleAndroidConnectivityCheck(class AsyncWebServerRequest* request)
     // the browser will use this network connection to load the '/MFD.html' page from, and subsequently
     // connect via the WebSocket.
 
-  #ifdef DEBUG_WEBSERVER
     unsigned long start = millis();
-  #endif // DEBUG_WEBSERVER
 
     request->send(204);
 
-  #ifdef DEBUG_WEBSERVER
-    Serial.printf_P(PSTR("%s[webServer] Serving '%s' took: %lu msec\n"),
-        TimeStamp(),
-        request->url().c_str(),
-        millis() - start);
-  #endif // DEBUG_WEBSERVER
+    if (IsDiagEnabled(DIAG_WEBSERVER))
+    {
+        AsyncLog.printf_P(PSTR("%s[webServer] Serving '%s' took: %lu msec\n"),
+            TimeStamp(),
+            request->url().c_str(),
+            millis() - start);
+    } // if
 } // HandleAndroidConnectivityCheck
 
 // -----
@@ -370,9 +555,10 @@ void HandleNotFound(class AsyncWebServerRequest* request)
 {
     printHttpRequest(request);
 
-  #ifdef DEBUG_WEBSERVER
-    Serial.printf_P(PSTR("%s[webServer] File '%s' not found, "), TimeStamp(), request->url().c_str());
-  #endif // DEBUG_WEBSERVER
+    if (IsDiagEnabled(DIAG_WEBSERVER))
+    {
+        AsyncLog.printf_P(PSTR("%s[webServer] File '%s' not found, "), TimeStamp(), request->url().c_str());
+    } // if
 
     if (! request->client()->remoteIP()) return;  // No use to reply if there is no IP to reply to
 
@@ -389,9 +575,10 @@ void HandleNotFound(class AsyncWebServerRequest* request)
         response->addHeader(F("Location"), "http://" + String(IP_ADDR) + "/MFD.html");
         request->send(response);
 
-      #ifdef DEBUG_WEBSERVER
-        Serial.printf_P(PSTR("redirected (302) to 'http://%s/MFD.html'\n"), IP_ADDR);
-      #endif // DEBUG_WEBSERVER
+        if (IsDiagEnabled(DIAG_WEBSERVER))
+        {
+            AsyncLog.printf_P(PSTR("redirected (302) to 'http://%s/MFD.html'\n"), IP_ADDR);
+        } // if
 
         return;
       #endif // ifdef WIFI_AP_MODE
@@ -413,9 +600,7 @@ void HandleNotFound(class AsyncWebServerRequest* request)
 
     request->send(404, F("text/plain;charset=utf-8"), message);
 
-  #ifdef DEBUG_WEBSERVER
-    Serial.print(F("responded with 'Not Found' (404)\n"));
-  #endif // DEBUG_WEBSERVER
+    if (IsDiagEnabled(DIAG_WEBSERVER)) AsyncLog.print(F("responded with 'Not Found' (404)\n"));
 } // HandleNotFound
 
 void HandleLowMemory(class AsyncWebServerRequest* request)
@@ -440,15 +625,17 @@ void HandleLowMemory(class AsyncWebServerRequest* request)
     response->addHeader(F("Retry-After"), F("2"));  // Try again after 2 seconds
     request->send(response);
 
-  #ifdef DEBUG_WEBSERVER
-    Serial.printf_P(
-        PSTR("%s[webServer] File '%s': memory low (%" PRIu32 " bytes), responding with 429 (too many requests - try again later)\n"),
-        TimeStamp(),
-        request->url().c_str(),
-        system_get_free_heap_size()
-    );
+    if (IsDiagEnabled(DIAG_WEBSERVER))
+    {
+        Log(LOG_LEVEL_WARNING).printf_P(
+            PSTR("%s[webServer] File '%s': memory low (%" PRIu32 " bytes, largest block %" PRIu32 " bytes), responding with 429 (too many requests - try again later)\n"),
+            TimeStamp(),
+            request->url().c_str(),
+            system_get_free_heap_size(),
+            MaxFreeBlockSize()
+        );
 
-  #endif // DEBUG_WEBSERVER
+    } // if
 } // HandleLowMemory
 
 // Serve a specified font from program memory
@@ -460,9 +647,7 @@ void ServeFont(class AsyncWebServerRequest* request, const char* content, size_t
 
     DeleteAllQueuedJsons();  // Maximize free heap space
 
-  #ifdef DEBUG_WEBSERVER
     unsigned long start = millis();
-  #endif // DEBUG_WEBSERVER
 
   #if defined USE_OLD_ESP_ASYNC_WEB_SERVER || defined ESP8266
     request->send_P(200, asyncsrv::T_font_woff, (const uint8_t*)content, content_len);
@@ -470,12 +655,13 @@ void ServeFont(class AsyncWebServerRequest* request, const char* content, size_t
     request->send(200, asyncsrv::T_font_woff, (const uint8_t*)content, content_len);
   #endif
 
-  #ifdef DEBUG_WEBSERVER
-    Serial.printf_P(PSTR("%s[webServer] Serving font '%s' took: %lu msec\n"),
-        TimeStamp(),
-        request->url().c_str(),
-        millis() - start);
-  #endif // DEBUG_WEBSERVER
+    if (IsDiagEnabled(DIAG_WEBSERVER))
+    {
+        AsyncLog.printf_P(PSTR("%s[webServer] Serving font '%s' took: %lu msec\n"),
+            TimeStamp(),
+            request->url().c_str(),
+            millis() - start);
+    } // if
 } // ServeFont
 
 #if defined SERVE_FROM_SPIFFS || defined SERVE_FROM_LITTLEFS
@@ -496,22 +682,21 @@ void ServeFontFromFile(class AsyncWebServerRequest* request, const char* path)
 
     DeleteAllQueuedJsons();  // Maximize free heap space
 
-  #ifdef DEBUG_WEBSERVER
     unsigned long start = millis();
-  #endif // DEBUG_WEBSERVER
 
-    if (system_get_free_heap_size() < 8 * 1024) return HandleLowMemory(request);
+    if (! AdmitMemory(MEMORY_FOR_WEB_SERVING)) return HandleLowMemory(request);
 
     request->send(SPIFFS, asyncsrv::T_font_woff, path);
 
     VanBusRx.Enable();
 
-  #ifdef DEBUG_WEBSERVER
-    Serial.printf_P(PSTR("%s[webServer] Serving font '%s' from file system took: %lu msec\n"),
-        TimeStamp(),
-        path,
-        millis() - start);
-  #endif // DEBUG_WEBSERVER
+    if (IsDiagEnabled(DIAG_WEBSERVER))
+    {
+        AsyncLog.printf_P(PSTR("%s[webServer] Serving font '%s' from file system took: %lu msec\n"),
+            TimeStamp(),
+            path,
+            millis() - start);
+    } // if
 } // ServeFontFromFile
 
 #endif // defined SERVE_FROM_SPIFFS || defined SERVE_FROM_LITTLEFS
@@ -523,16 +708,14 @@ void ServeDocument(class AsyncWebServerRequest* request, PGM_P mimeType, PGM_P c
 
     if (request->method() != HTTP_GET) return;
 
-  #ifdef DEBUG_WEBSERVER
     unsigned long start = millis();
-  #endif // DEBUG_WEBSERVER
 
     bool eTagMatches = checkETag(request, md5Checksum);
     if (! eTagMatches)
     {
         DeleteAllQueuedJsons();  // Maximize free heap space
 
-        if (system_get_free_heap_size() < 8 * 1024) return HandleLowMemory(request);
+        if (! AdmitMemory(MEMORY_FOR_WEB_SERVING)) return HandleLowMemory(request);
 
         // Serve the complete document
       #if defined USE_OLD_ESP_ASYNC_WEB_SERVER || defined ESP8266
@@ -555,13 +738,14 @@ void ServeDocument(class AsyncWebServerRequest* request, PGM_P mimeType, PGM_P c
         request->send(response);
     } // if
 
-  #ifdef DEBUG_WEBSERVER
-    Serial.printf_P(PSTR("%s[webServer] %s '%s' took: %lu msec\n"),
-        TimeStamp(),
-        eTagMatches ? PSTR("Responding to request for") : PSTR("Serving"),
-        request->url().c_str(),
-        millis() - start);
-  #endif // DEBUG_WEBSERVER
+    if (IsDiagEnabled(DIAG_WEBSERVER))
+    {
+        AsyncLog.printf_P(PSTR("%s[webServer] %s '%s' took: %lu msec\n"),
+            TimeStamp(),
+            eTagMatches ? PSTR("Responding to request for") : PSTR("Serving"),
+            request->url().c_str(),
+            millis() - start);
+    } // if
 } // ServeDocument
 
 #if defined SERVE_FROM_SPIFFS || defined SERVE_FROM_LITTLEFS
@@ -585,16 +769,14 @@ void ServeDocumentFromFile(class AsyncWebServerRequest* request, const char* url
 
     if (request->method() != HTTP_GET) return;
 
-  #ifdef DEBUG_WEBSERVER
     unsigned long start = millis();
-  #endif // DEBUG_WEBSERVER
 
     bool eTagMatches = checkETag(request, md5);
     if (! eTagMatches)
     {
         DeleteAllQueuedJsons();  // Maximize free heap space
 
-        if (system_get_free_heap_size() < 8 * 1024) return HandleLowMemory(request);
+        if (! AdmitMemory(MEMORY_FOR_WEB_SERVING)) return HandleLowMemory(request);
 
         // Get the MIME type, if necessary
         if (mimeType == 0) mimeType = getContentType(path);
@@ -615,17 +797,269 @@ void ServeDocumentFromFile(class AsyncWebServerRequest* request, const char* url
         VanBusRx.Enable();
     } // if
 
-  #ifdef DEBUG_WEBSERVER
-    Serial.printf_P(PSTR("%s[webServer] %s '%s' from file system took: %lu msec\n"),
-        TimeStamp(),
-        eTagMatches ? PSTR("Responding to request for") : PSTR("Serving"),
-        request->url().c_str(),
-        millis() - start);
-  #endif // DEBUG_WEBSERVER
+    if (IsDiagEnabled(DIAG_WEBSERVER))
+    {
+        AsyncLog.printf_P(PSTR("%s[webServer] %s '%s' from file system took: %lu msec\n"),
+            TimeStamp(),
+            eTagMatches ? PSTR("Responding to request for") : PSTR("Serving"),
+            request->url().c_str(),
+            millis() - start);
+    } // if
 } // ServeDocumentFromFile
 
 #endif // defined SERVE_FROM_SPIFFS || defined SERVE_FROM_LITTLEFS
 
+// Serve the string tables that the client needs to look up the codes in the JSON data. The asset is generated
+// from the tables in program memory, line by line, so it does not need a large buffer. Since it can only change
+// with the firmware, the client can cache it.
+void ServeStringTablesJs(class AsyncWebServerRequest* request)
+{
+    printHttpRequest(request);
+
+    if (request->method() != HTTP_GET) return;
+
+    unsigned long start = millis();
+
+    bool eTagMatches = checkETag(request, md5Checksum);
+    if (! eTagMatches)
+    {
+        DeleteAllQueuedJsons();  // Maximize free heap space
+
+        if (! AdmitMemory(MEMORY_FOR_WEB_SERVING)) return HandleLowMemory(request);
+
+        // Per request: the number of the next line (see StringTablesJsLine in PacketToJson.ino)
+        struct StringTablesResponse_t
+        {
+            ResponsePiece_t<128> piece;
+            int line = 0;
+        }; // struct StringTablesResponse_t
+        std::shared_ptr<StringTablesResponse_t> state = std::make_shared<StringTablesResponse_t>();
+
+        AsyncWebServerResponse* response = request->beginChunkedResponse(asyncsrv::T_text_javascript,
+            [state](uint8_t* buffer, size_t maxLen, size_t) -> size_t
+            {
+                return state->piece.Fill(buffer, maxLen,
+                    [&state](char* buf, int n) { return StringTablesJsLine(state->line++, buf, n); });
+            }
+        );
+
+      #ifndef USE_OLD_ESP_ASYNC_WEB_SERVER
+        response->addHeader(F("Connection"), F("keep-alive"), true);
+        response->addHeader(F("Keep-Alive"), F("timeout=5, max=1"), true);
+      #endif
+
+        response->addHeader("ETag", String("\"") + md5Checksum + "\"");
+        response->addHeader(F("Cache-Control"), F("no-cache"));
+
+        request->send(response);
+    } // if
+
+    if (IsDiagEnabled(DIAG_WEBSERVER))
+    {
+        AsyncLog.printf_P(PSTR("%s[webServer] %s '%s' took: %lu msec\n"),
+            TimeStamp(),
+            eTagMatches ? PSTR("Responding to request for") : PSTR("Serving"),
+            request->url().c_str(),
+            millis() - start);
+    } // if
+} // ServeStringTablesJs
+
+// Serve the end-to-end latency histograms, as measured with the "trace" stamps echoed by the client, and the
+// infrared button press-to-frame histogram
+void ServeLatencyStats(class AsyncWebServerRequest* request)
+{
+    printHttpRequest(request);
+
+    if (! AdmitMemory(MEMORY_FOR_WEB_SERVING)) return HandleLowMemory(request);
+
+    char buf[1280];
+    if (LatencyHistogramsToJson(buf, sizeof(buf)) >= (int)sizeof(buf))
+    {
+        request->send(500);
+        return;
+    } // if
+
+    request->send(200, F("application/json"), buf);
+} // ServeLatencyStats
+
+// Serve the current diagnostic levels in JSON format. Diagnostic output can be switched on or off at run time, e.g.:
+// - "/diag?websocket=2": more output on WebSocket communication,
+// - "/diag?raw_packet_data=1&packets=sat_nav": print sat nav packets on the serial port,
+// - "/diag?ir_recv=0": stop printing infrared remote control codes.
+// See Log.ino for the category names.
+void ServeDiagnostics(class AsyncWebServerRequest* request)
+{
+    printHttpRequest(request);
+
+    for (size_t i = 0; i < request->args(); i++)
+    {
+        if (! SetDiagnostic(request->argName(i).c_str(), request->arg(i).c_str()))
+        {
+            request->send(400, F("text/plain"), F("Unknown diagnostic category or invalid level"));
+            return;
+        } // if
+    } // for
+
+    char buf[384];
+    const char* json = DiagnosticsToJson(buf, sizeof(buf));
+    if (json[0] == 0)
+    {
+        request->send(500);
+        return;
+    } // if
+
+    request->send(200, F("application/json"), json);
+} // ServeDiagnostics
+
+// Serve the VAN bus load analysis in JSON format. The text is generated piece by piece, directly into the response
+// chunks.
+//
+// Optionally, the printing of packets on the serial port (see diagnostic categories "raw_packet_data" and
+// "json_buffers" in Log.ino) can be selected per IDEN value, e.g.:
+// - "/bus?print=8C4": print packets with IDEN 8C4,
+// - "/bus?mute=8C4": do not print packets with IDEN 8C4,
+// - "/bus?auto=8C4": back to the "packets" selection (see ServeDiagnostics).
+void ServeBusStats(class AsyncWebServerRequest* request)
+{
+    printHttpRequest(request);
+
+    if (request->method() != HTTP_GET) return;
+
+    if (! AdmitMemory(MEMORY_FOR_WEB_SERVING)) return HandleLowMemory(request);
+
+    const char* const selectionArgs[] = { "mute", "print", "auto" };
+    for (int selection = 0; selection < 3; selection++)
+    {
+        if (! request->hasArg(selectionArgs[selection])) continue;
+
+        uint16_t iden = strtoul(request->arg(selectionArgs[selection]).c_str(), nullptr, 16);
+        if (! SetBusStatsPrintSelection(iden, selection == 2 ? -1 : selection))
+        {
+            request->send(404, F("text/plain"), F("IDEN not seen on the bus"));
+            return;
+        } // if
+    } // for
+
+    // Per request: the cursor in the IDEN table (see BusStatsJsonText in BusStats.ino)
+    struct BusStatsResponse_t
+    {
+        ResponsePiece_t<384> piece;
+        int slot = -1;
+        int nListed = 0;
+    }; // struct BusStatsResponse_t
+    std::shared_ptr<BusStatsResponse_t> state = std::make_shared<BusStatsResponse_t>();
+
+    AsyncWebServerResponse* response = request->beginChunkedResponse(F("application/json"),
+        [state](uint8_t* buffer, size_t maxLen, size_t) -> size_t
+        {
+            return state->piece.Fill(buffer, maxLen,
+                [&state](char* buf, int n) { return BusStatsJsonText(state->slot, state->nListed, buf, n); });
+        }
+    );
+
+    response->addHeader(F("Cache-Control"), F("no-cache"));
+    request->send(response);
+} // ServeBusStats
+
+#ifdef VAN_TRACE_RECORDER
+
+// Serve the list of VAN bus trace files in JSON format, or, with "/trace?file=<n>", the contents of a trace file
+void ServeVanTrace(class AsyncWebServerRequest* request)
+{
+    printHttpRequest(request);
+
+    if (request->method() != HTTP_GET) return;
+
+    if (! AdmitMemory(MEMORY_FOR_WEB_SERVING)) return HandleLowMemory(request);
+
+    if (! request->hasArg("file"))
+    {
+        char buf[512];
+        if (VanTraceFilesToJson(buf, sizeof(buf)) >= (int)sizeof(buf))
+        {
+            request->send(500);
+            return;
+        } // if
+
+        request->send(200, F("application/json"), buf);
+        return;
+    } // if
+
+    int idx = request->arg("file").toInt();
+    if (idx < 0 || idx >= VAN_TRACE_N_FILES || ! SPIFFS.exists(VanTraceFileName(idx))) return HandleNotFound(request);
+
+    String path(VanTraceFileName(idx));
+    AsyncWebServerResponse* response = request->beginResponse(SPIFFS, path, F("application/octet-stream"));
+    String disposition = String(F("attachment; filename=\"van")) + path.substring(1) + "\"";
+    response->addHeader(F("Content-Disposition"), disposition);
+    response->addHeader(F("Cache-Control"), F("no-cache"));
+
+    VanBusRx.Disable();
+    request->send(response);
+    VanBusRx.Enable();
+} // ServeVanTrace
+
+// Start ("?file=<n>&speed=<s>") or stop ("?stop=1") replaying a VAN bus trace file, and show the replay results
+// (see VanTraceReplay.ino). Speed 0 replays as fast as possible.
+void ServeVanTraceReplay(class AsyncWebServerRequest* request)
+{
+    printHttpRequest(request);
+
+    if (request->method() != HTTP_GET) return;
+
+    if (request->hasArg("stop")) RequestVanTraceReplay(-1, 1);
+    else if (request->hasArg("file"))
+    {
+        int idx = request->arg("file").toInt();
+        if (idx < 0 || idx >= VAN_TRACE_N_FILES) return HandleNotFound(request);
+
+        int speed = request->hasArg("speed") ? request->arg("speed").toInt() : 1;
+        RequestVanTraceReplay(idx, speed);
+    } // if
+
+    char buf[384];
+    if (VanTraceReplayToJson(buf, sizeof(buf)) >= (int)sizeof(buf))
+    {
+        request->send(500);
+        return;
+    } // if
+
+    request->send(200, F("application/json"), buf);
+} // ServeVanTraceReplay
+
+#endif // VAN_TRACE_RECORDER
+
+// Serve the operational metrics, in the Prometheus text exposition format. The text is generated piece by piece,
+// directly into the response chunks.
+void ServeMetrics(class AsyncWebServerRequest* request)
+{
+    printHttpRequest(request);
+
+    if (request->method() != HTTP_GET) return;
+
+    if (! AdmitMemory(MEMORY_FOR_WEB_SERVING)) return HandleLowMemory(request);
+
+    // Per request: the cursor in the metrics (see MetricsText in Metrics.ino)
+    struct MetricsResponse_t
+    {
+        ResponsePiece_t<256> piece;
+        int section = 0;
+        int item = 0;
+    }; // struct MetricsResponse_t
+    std::shared_ptr<MetricsResponse_t> state = std::make_shared<MetricsResponse_t>();
+
+    AsyncWebServerResponse* response = request->beginChunkedResponse(F("text/plain; version=0.0.4"),
+        [state](uint8_t* buffer, size_t maxLen, size_t) -> size_t
+        {
+            return state->piece.Fill(buffer, maxLen,
+                [&state](char* buf, int n) { return MetricsText(state->section, state->item, buf, n); });
+        }
+    );
+
+    response->addHeader(F("Cache-Control"), F("no-cache"));
+    request->send(response);
+} // ServeMetrics
+
 // Serve the main HTML page
 void ServeMainHtml(class AsyncWebServerRequest* request)
 {
@@ -685,6 +1119,8 @@ void SetupWebServer()
       #endif // SERVE_MAIN_FILES_FROM_FFS
     });
 
+    webServer.on("/VanStrings.js", ServeStringTablesJs);
+
     // -----
     // Cascading style sheet files
 
@@ -719,6 +1155,18 @@ void SetupWebServer()
     webServer.on("/generate_204", HandleAndroidConnectivityCheck);
     webServer.on("/gen_204", HandleAndroidConnectivityCheck);
 
+    // End-to-end latency statistics
+    webServer.on("/latency", ServeLatencyStats);
+    webServer.on("/bus", ServeBusStats);
+    webServer.on("/diag", ServeDiagnostics);
+  #ifdef VAN_TRACE_RECORDER
+    webServer.on("/trace", ServeVanTrace);
+    webServer.on("/replay", ServeVanTraceReplay);
+  #endif // VAN_TRACE_RECORDER
+
+    // Operational metrics, for scraping by Prometheus
+    webServer.on("/metrics", ServeMetrics);
+
   #if defined SERVE_FROM_SPIFFS || defined SERVE_FROM_LITTLEFS
 
     // Try to serve any not further listed document from the flash file system
@@ -1,5 +1,4 @@
 
-#include <map>
 #include <limits.h>
 
 #ifdef PREPEND_TIME_STAMP_TO_DEBUG_OUTPUT
@@ -13,9 +12,14 @@
 extern uint8_t mfdDistanceUnit;
 extern uint8_t mfdTemperatureUnit;
 extern uint8_t mfdTimeUnit;
+extern bool unitsOnClient;
+extern bool codesOnClient;
+extern bool guidanceIconsOnClient;
+extern bool satnavListPagesOnClient;
 extern int16_t satnavServiceListSize;
 void PrintJsonText(const char* jsonBuffer);
 void ResetPacketPrevData();
+void ResetUnitDependentPacketPrevData();
 
 // Defined in OriginalMfd.ino
 extern uint8_t mfdLanguage;
@@ -25,6 +29,32 @@ void NotificationPopupShowing(unsigned long since, unsigned long duration);
 // Defined in Esp.ino
 const char* EspSystemDataToJson(char* buf, const int n);
 
+// Defined in Memory.ino
+bool IsMemoryAvailable(int budget, size_t size);
+bool AdmitMemory(int budget, size_t size);
+
+// Defined in LatencyTrace.ino
+extern bool latencyTraceOnClient;
+void ProcessLatencyTraceEcho(const char* echo);
+void RecordLatencyTraceEchoes();
+
+// Defined in BusStats.ino
+extern bool busStatsOnClient;
+
+// Defined in Log.ino
+bool SetDiagnostic(const char* assignment);
+
+// Defined in WakeTrace.ino
+void MarkWakePhase(int phase);
+#ifdef LOG_WEBSOCKET
+extern AsyncWebSocket logWebSocket;
+#endif // LOG_WEBSOCKET
+
+#ifdef VAN_TRACE_RECORDER
+// Defined in VanTrace.ino
+extern volatile int8_t vanTraceRequest;
+#endif // VAN_TRACE_RECORDER
+
 // Defined in DateTime.ino
 void SetTimeZoneOffset(int newTimeZoneOffset);
 bool SetTime(uint32_t epoch, uint32_t msec);
@@ -35,8 +65,154 @@ const int WEBSOCKET_INVALID_ID = 0xFF;
 uint32_t websocketId_1 = WEBSOCKET_INVALID_ID;
 uint32_t websocketId_2 = WEBSOCKET_INVALID_ID;
 
-// Maps IP address (cast to uint32_t) to last time that webSocket communication occurred on that IP address
-std::map<uint32_t, unsigned long> lastWebSocketCommunication;
+// Options that a WebSocket client has opted in to (e.g. with "units_on_client:YES"), per client slot
+#define CLIENT_OPTION_UNITS (1 << 0)
+#define CLIENT_OPTION_CODES (1 << 1)
+#define CLIENT_OPTION_GUIDANCE_ICONS (1 << 2)
+#define CLIENT_OPTION_SATNAV_LIST_PAGES (1 << 3)
+#define CLIENT_OPTION_LATENCY_TRACE (1 << 4)
+#define CLIENT_OPTION_BUS_STATS (1 << 5)
+#define CLIENT_OPTION_BATCHED_FRAMES (1 << 6)
+uint8_t websocketOptions_1 = 0;
+uint8_t websocketOptions_2 = 0;
+
+// Set by the WebSocket event handler; the options are applied in LoopWebSocket (see ApplyWebSocketOptions)
+volatile bool webSocketOptionsChanged = false;
+volatile bool webSocketResendRequested = false;
+volatile unsigned long webSocketOptionsChangedAt = 0;
+
+// Set by the WebSocket event handler when a client slot is taken resp. freed; the collected updates are then
+// discarded resp. sent to the remaining client in the loop (see SendJsonOnWebSocket and LoopWebSocket)
+volatile bool webSocketBatchDiscardRequested = false;
+volatile bool webSocketBatchFlushRequested = false;
+
+// Bit masks of client slots
+#define WEBSOCKET_SLOT_1 (1 << 0)
+#define WEBSOCKET_SLOT_2 (1 << 1)
+#define WEBSOCKET_SLOTS_ALL (WEBSOCKET_SLOT_1 | WEBSOCKET_SLOT_2)
+
+// Returns the options of the slot serving the specified client, or nullptr if the client has no slot
+uint8_t* WebSocketOptions(uint32_t id)
+{
+    if (id == websocketId_1) return &websocketOptions_1;
+    if (id == websocketId_2) return &websocketOptions_2;
+    return nullptr;
+} // WebSocketOptions
+
+void WebSocketOptionsChanged()
+{
+    webSocketOptionsChangedAt = millis();
+    webSocketOptionsChanged = true;
+} // WebSocketOptionsChanged
+
+// Set or clear an option of the specified client
+void SetWebSocketOption(uint32_t id, uint8_t option, bool on)
+{
+    uint8_t* options = WebSocketOptions(id);
+    if (options == nullptr) return;
+
+    if (on) *options |= option; else *options &= ~option;
+    WebSocketOptionsChanged();
+} // SetWebSocketOption
+
+// Table with the last time that webSocket communication occurred, per client IP address (cast to uint32_t).
+// Open-addressed with linear probing, with a fixed capacity (must be a power of 2). Entries are never removed,
+// only overwritten: when the table is full, a new client takes the slot of the least recently active one.
+#define CLIENT_ACTIVITY_TABLE_SIZE (8)
+
+struct ClientActivity_t
+{
+    uint32_t ip;  // 0 = empty slot
+    unsigned long lastCommunication;
+    uint32_t websocketId;  // The WebSocket client that last communicated from this IP address
+}; // struct ClientActivity_t
+
+ClientActivity_t clientActivity[CLIENT_ACTIVITY_TABLE_SIZE];
+
+// The slot in 'clientActivity' of the client served in websocketId_1 resp. websocketId_2, or -1 if not known.
+// Only a hint: valid if the slot still has the same 'websocketId'.
+int websocketActivitySlot_1 = -1;
+int websocketActivitySlot_2 = -1;
+
+inline int ClientActivityHash(uint32_t ip)
+{
+    // Fibonacci hashing; the last octet of the IP address varies most, and is in the most significant byte
+    return (ip * 2654435769UL) >> 29 & (CLIENT_ACTIVITY_TABLE_SIZE - 1);
+} // ClientActivityHash
+
+// Returns the slot holding the specified IP address, or -1 if not present
+int FindClientActivity(uint32_t ip)
+{
+    int slot = ClientActivityHash(ip);
+    for (int i = 0; i < CLIENT_ACTIVITY_TABLE_SIZE; i++)
+    {
+        if (clientActivity[slot].ip == ip) return slot;
+        if (clientActivity[slot].ip == 0) return -1;  // End of probe sequence
+        slot = (slot + 1) & (CLIENT_ACTIVITY_TABLE_SIZE - 1);
+    } // for
+
+    return -1;
+} // FindClientActivity
+
+// Register webSocket communication with the specified IP address. Returns the slot in 'clientActivity'.
+int SetLastWebSocketCommunication(uint32_t ip)
+{
+    unsigned long now = millis();
+
+    int slot = ClientActivityHash(ip);
+    int oldest = slot;
+    for (int i = 0; i < CLIENT_ACTIVITY_TABLE_SIZE; i++)
+    {
+        if (clientActivity[slot].ip == ip || clientActivity[slot].ip == 0) break;
+
+        // Arithmetic has safe roll-over
+        if (now - clientActivity[slot].lastCommunication > now - clientActivity[oldest].lastCommunication)
+        {
+            oldest = slot;
+        } // if
+
+        slot = (slot + 1) & (CLIENT_ACTIVITY_TABLE_SIZE - 1);
+    } // for
+
+    // Table full and IP address not present? Then re-use the slot of the least recently active client.
+    if (clientActivity[slot].ip != ip && clientActivity[slot].ip != 0) slot = oldest;
+
+    if (clientActivity[slot].ip != ip) clientActivity[slot].websocketId = WEBSOCKET_INVALID_ID;
+    clientActivity[slot].ip = ip;
+    clientActivity[slot].lastCommunication = now;
+
+    return slot;
+} // SetLastWebSocketCommunication
+
+// Register webSocket communication with the specified client. For a client that is being served, the slot in
+// 'clientActivity' is remembered, so that the table is not searched for each frame that is sent.
+void SetLastWebSocketCommunicationById(uint32_t id)
+{
+    int* cachedSlot =
+        id == websocketId_1 ? &websocketActivitySlot_1 :
+        id == websocketId_2 ? &websocketActivitySlot_2 :
+        nullptr;
+
+    if (cachedSlot != nullptr && *cachedSlot >= 0 && clientActivity[*cachedSlot].websocketId == id)
+    {
+        clientActivity[*cachedSlot].lastCommunication = millis();
+        return;
+    } // if
+
+    int slot = SetLastWebSocketCommunication(webSocket.client(id)->remoteIP());
+    clientActivity[slot].websocketId = id;
+    if (cachedSlot != nullptr) *cachedSlot = slot;
+} // SetLastWebSocketCommunicationById
+
+// Get the last time of webSocket communication with the specified IP address. Returns false if unknown.
+bool GetLastWebSocketCommunication(uint32_t ip, unsigned long& lastCommunication)
+{
+    int slot = FindClientActivity(ip);
+    if (slot < 0) return false;
+
+    lastCommunication = clientActivity[slot].lastCommunication;
+    return true;
+} // GetLastWebSocketCommunication
 
 // Counts the number of new connection requests from the WebSocket client
 int nWebSocketConnections = 0;
@@ -57,9 +233,10 @@ bool IsIdConnected(uint32_t id)
 // (not available for writing).
 bool TryToSendJsonOnWebSocket(uint32_t id, const char* json)
 {
-  #if DEBUG_WEBSOCKET >= 3
-    Serial.printf_P(PSTR("%s[webSocket %lu] Trying to send %zu-byte packet\n"), TimeStamp(), id, strlen(json));
-  #endif // DEBUG_WEBSOCKET >= 3
+    if (IsDiagEnabled(DIAG_WEBSOCKET, 3))
+    {
+        AsyncLog.printf_P(PSTR("%s[webSocket %lu] Trying to send %zu-byte packet\n"), TimeStamp(), id, strlen(json));
+    } // if
 
     if (! IsIdConnected(id)) return false;
 
@@ -69,8 +246,8 @@ bool TryToSendJsonOnWebSocket(uint32_t id, const char* json)
 
     webSocket.text(id, json);
 
-    IPAddress clientIp = webSocket.client(id)->remoteIP();
-    lastWebSocketCommunication[clientIp] = millis();
+    SetLastWebSocketCommunicationById(id);
+    MarkWakePhase(WAKE_PHASE_FIRST_FRAME);
 
     return true;
 } // TryToSendJsonOnWebSocket
@@ -79,6 +256,8 @@ static const int N_QUEUED_JSON = 30;
 int nextJsonPacketIdx = 0;
 int nQueuedJsonSlotsOccupied = 0;
 int maxQueuedJsonSlots = 0;
+uint32_t nQueuedJsonEvictions = 0;  // Queued JSON packets that were overwritten by newer ones
+size_t queuedJsonBytes = 0;
 
 struct JsonPacket_t
 {
@@ -109,6 +288,7 @@ void FreeQueuedJson(JsonPacket_t* entry)
 {
     if (entry->packet == nullptr) return;
 
+    queuedJsonBytes -= strlen(entry->packet) + 1;
     free(entry->packet);
     entry->packet = nullptr;
     entry->lastSent = 0;
@@ -133,49 +313,55 @@ void DeleteAllQueuedJsons()
 // Optionally, pass one or two WebSocket IDs: the packet will not be re-sent to these IDs.
 void QueueJson(const char* json, uint32_t lastSentOnId_1 = 0, uint32_t lastSentOnId_2 = 0)
 {
-  #if DEBUG_WEBSOCKET >= 2
-    int currentJsonPacketIdx;
-  #endif // DEBUG_WEBSOCKET >= 2
+    int currentJsonPacketIdx = 0;
     JsonPacket_t* entry;
+    size_t size = strlen(json) + 1;
 
     do
     {
         entry = queuedJsonPackets + nextJsonPacketIdx;
 
         // Free a slot if necessary
+        if (entry->packet != nullptr) nQueuedJsonEvictions++;
         FreeQueuedJson(entry);
 
-      #if DEBUG_WEBSOCKET >= 2
-        currentJsonPacketIdx = nextJsonPacketIdx;
-      #endif // DEBUG_WEBSOCKET >= 2
+        if (IsDiagEnabled(DIAG_WEBSOCKET, 2)) currentJsonPacketIdx = nextJsonPacketIdx;
 
         if (++nextJsonPacketIdx == N_QUEUED_JSON) nextJsonPacketIdx = 0;
 
-    } while (system_get_free_heap_size() < 15 * 1024 && countQueuedJsons() > 0);
+    } while (
+        (! IsMemoryAvailable(MEMORY_FOR_JSON_QUEUE, size) || queuedJsonBytes + size > MEMORY_JSON_QUEUE_MAX_BYTES)
+        && countQueuedJsons() > 0);
+
+    // Not enough memory, even with an empty queue?
+    if (! AdmitMemory(MEMORY_FOR_JSON_QUEUE, size)) return;
 
     // Try to allocate memory
-    entry->packet = (char*) malloc(strlen(json) + 1);
+    entry->packet = (char*) malloc(size);
     if (entry->packet == nullptr) return;  // Return if failed to allocate
 
+    queuedJsonBytes += size;
+
     nQueuedJsonSlotsOccupied++;
     if (nQueuedJsonSlotsOccupied > maxQueuedJsonSlots) maxQueuedJsonSlots = nQueuedJsonSlotsOccupied;
 
     // Copy content and meta-data
-    memcpy(entry->packet, json, strlen(json) + 1);
+    memcpy(entry->packet, json, size);
     entry->lastSentOnId_1 = lastSentOnId_1;
     entry->lastSentOnId_2 = lastSentOnId_2;
     if (lastSentOnId_1 != 0 || lastSentOnId_2 != 0) entry->lastSent = millis();
 
-  #if DEBUG_WEBSOCKET >= 2
-    Serial.printf_P(
-        PSTR("%s[webSocket] %s %zu-byte packet for %ssending in slot '%d'\n"),
-        TimeStamp(),
-        lastSentOnId_1 == 0 && lastSentOnId_2 == 0 ? PSTR("Saving") : PSTR("Keeping"),
-        strlen(json),
-        lastSentOnId_1 == 0 && lastSentOnId_2 == 0 ? PSTR("later ") : PSTR("re-"),
-        currentJsonPacketIdx
-    );
-  #endif // DEBUG_WEBSOCKET >= 2
+    if (IsDiagEnabled(DIAG_WEBSOCKET, 2))
+    {
+        AsyncLog.printf_P(
+            PSTR("%s[webSocket] %s %zu-byte packet for %ssending in slot '%d'\n"),
+            TimeStamp(),
+            lastSentOnId_1 == 0 && lastSentOnId_2 == 0 ? PSTR("Saving") : PSTR("Keeping"),
+            strlen(json),
+            lastSentOnId_1 == 0 && lastSentOnId_2 == 0 ? PSTR("later ") : PSTR("re-"),
+            currentJsonPacketIdx
+        );
+    } // if
 
 } // QueueJson
 
@@ -200,15 +386,16 @@ void SendQueuedJson(uint32_t id)
 
         if (! TryToSendJsonOnWebSocket(id, entry->packet)) goto NEXT;
 
-      #ifdef DEBUG_WEBSOCKET
-        Serial.printf_P(
-            PSTR("%s[webSocket %" PRIu32 "] Sent stored %zu-byte packet no. '%d'\n"),
-            TimeStamp(),
-            id,
-            strlen(entry->packet),
-            i
-        );
-      #endif // DEBUG_WEBSOCKET
+        if (IsDiagEnabled(DIAG_WEBSOCKET))
+        {
+            AsyncLog.printf_P(
+                PSTR("%s[webSocket %" PRIu32 "] Sent stored %zu-byte packet no. '%d'\n"),
+                TimeStamp(),
+                id,
+                strlen(entry->packet),
+                i
+            );
+        } // if
 
         // Don't reset the age
         if (entry->lastSent == 0) entry->lastSent = millis();
@@ -246,17 +433,18 @@ void CleanupQueuedJsons(uint32_t id = 0)
             )
            )
         {
-          #if DEBUG_WEBSOCKET >= 3
-            Serial.printf_P(
-                PSTR("%s[webSocket] Cleaning up %zu-byte packet no. '%d', age=%lu, lastSentOn=%lu,%lu\n"),
-                TimeStamp(),
-                strlen(entry->packet),
-                i,
-                age,
-                entry->lastSentOnId_1,
-                entry->lastSentOnId_2
-            );
-          #endif // DEBUG_WEBSOCKET >= 3
+            if (IsDiagEnabled(DIAG_WEBSOCKET, 3))
+            {
+                AsyncLog.printf_P(
+                    PSTR("%s[webSocket] Cleaning up %zu-byte packet no. '%d', age=%lu, lastSentOn=%lu,%lu\n"),
+                    TimeStamp(),
+                    strlen(entry->packet),
+                    i,
+                    age,
+                    entry->lastSentOnId_1,
+                    entry->lastSentOnId_2
+                );
+            } // if
 
             FreeQueuedJson(entry);
         } // if
@@ -267,21 +455,149 @@ void CleanupQueuedJsons(uint32_t id = 0)
     while (i != nextJsonPacketIdx);
 } // CleanupQueuedJsons
 
+// Statistics on the WebSocket frames sent
+uint32_t nWebSocketFramesSent = 0;
+uint32_t nWebSocketBytesSent = 0;
+uint32_t nWebSocketEventsSent = 0;
+uint32_t nWebSocketSendFailures = 0;
+
+// Updates collected for sending in one WebSocket frame, to the client slots in 'batchSlots': the clients that can
+// handle WebSocket frames containing an array of JSON objects, instead of a single JSON object. Set per client with
+// the "batched_frames_on_client:YES" websocket message.
+char batchBuffer[WEBSOCKET_BATCH_MAX_BYTES];
+int batchLen = 0;
+int nBatchedEvents = 0;
+unsigned long batchStartedAt = 0;
+uint8_t batchSlots = 0;
+
+bool SendFrameOnWebSocket(
+    const char* json,
+    bool saveForLater,
+    bool isTestMessage,
+    int nEvents,
+    uint8_t slots = WEBSOCKET_SLOTS_ALL);
+
+// Returns the slots of the clients that can handle batched frames
+uint8_t BatchedFramesSlots()
+{
+    return
+        (websocketOptions_1 & CLIENT_OPTION_BATCHED_FRAMES ? WEBSOCKET_SLOT_1 : 0)
+        | (websocketOptions_2 & CLIENT_OPTION_BATCHED_FRAMES ? WEBSOCKET_SLOT_2 : 0);
+} // BatchedFramesSlots
+
+// Returns the slots of the clients that are connected
+uint8_t ConnectedSlots()
+{
+    return
+        (IsIdConnected(websocketId_1) ? WEBSOCKET_SLOT_1 : 0)
+        | (websocketId_2 != websocketId_1 && IsIdConnected(websocketId_2) ? WEBSOCKET_SLOT_2 : 0);
+} // ConnectedSlots
+
+// Send the collected updates as one WebSocket frame
+void FlushBatch()
+{
+    if (batchLen == 0) return;
+
+    // Close the JSON array
+    batchBuffer[batchLen++] = ']';
+    batchBuffer[batchLen] = 0;
+
+    SendFrameOnWebSocket(batchBuffer, false, false, nBatchedEvents, batchSlots);
+
+    batchLen = 0;
+    nBatchedEvents = 0;
+} // FlushBatch
+
+// A client slot was taken: the collected updates may be meant for another client. The data is re-sent
+// anyway to a client that has just connected (see ApplyWebSocketOptions).
+void DiscardBatchIfRequested()
+{
+    if (! webSocketBatchDiscardRequested) return;
+    webSocketBatchDiscardRequested = false;
+
+    batchLen = 0;
+    nBatchedEvents = 0;
+} // DiscardBatchIfRequested
+
+// A client disconnected, and the other client may have moved to slot 1. All clients that can handle batched frames
+// get the same updates, so send the collected updates to the remaining one(s), if any.
+void FlushBatchIfRequested()
+{
+    if (! webSocketBatchFlushRequested) return;
+    webSocketBatchFlushRequested = false;
+
+    batchSlots = BatchedFramesSlots();
+    if (batchSlots != 0) FlushBatch();
+
+    batchLen = 0;
+    nBatchedEvents = 0;
+} // FlushBatchIfRequested
+
 // Send a (JSON) message to the WebSocket client.
 // If isTestMessage is true, the message will be sent only on websocketId_1, not on websocketId_2.
+// Messages for a client that can handle it are collected and sent together in one frame; other clients get each
+// message right away. Messages that are to be saved for later are considered important: these are sent immediately,
+// after any collected messages.
 bool SendJsonOnWebSocket(const char* json, bool saveForLater, bool isTestMessage)
 {
     if (json == 0) return true;
-    if (strlen(json) <= 0) return true;
+    int len = strlen(json);
+    if (len <= 0) return true;
+
+    DiscardBatchIfRequested();
+    FlushBatchIfRequested();
+
+    // A client opted in to or out of batched frames? Then send what was collected for the clients that it was for.
+    uint8_t batchedSlots = BatchedFramesSlots();
+    if (batchedSlots != batchSlots) FlushBatch();
+
+    if (batchedSlots == 0 || saveForLater || isTestMessage)
+    {
+        FlushBatch();  // Keep the order of the messages
+        return SendFrameOnWebSocket(json, saveForLater, isTestMessage, 1);
+    } // if
+
+    // Clients that cannot handle batched frames get the message right away
+    uint8_t immediateSlots = ConnectedSlots() & ~batchedSlots;
+    if (immediateSlots != 0) SendFrameOnWebSocket(json, false, false, 1, immediateSlots);
+
+    // Does not fit in the current batch (including separator and closing bracket)?
+    if (batchLen > 0 && batchLen + len + 3 > WEBSOCKET_BATCH_MAX_BYTES) FlushBatch();
+
+    // Does not fit in any batch?
+    if (len + 3 > WEBSOCKET_BATCH_MAX_BYTES) return SendFrameOnWebSocket(json, false, false, 1, batchedSlots);
+
+    if (batchLen == 0)
+    {
+        batchStartedAt = millis();
+        batchSlots = batchedSlots;
+        batchBuffer[batchLen++] = '[';
+    }
+    else
+    {
+        batchBuffer[batchLen++] = ',';
+    } // if
+
+    memcpy(batchBuffer + batchLen, json, len);
+    batchLen += len;
+    nBatchedEvents++;
+
+    return true;
+} // SendJsonOnWebSocket
+
+// Send a WebSocket frame, containing one or more (JSON) messages, to the WebSocket clients in the specified slots.
+// If isTestMessage is true, the frame will be sent only on websocketId_1, not on websocketId_2.
+bool SendFrameOnWebSocket(const char* json, bool saveForLater, bool isTestMessage, int nEvents, uint8_t slots)
+{
 
     uint32_t ids[2];
     int n = 0;
-    if (IsIdConnected(websocketId_1))
+    if ((slots & WEBSOCKET_SLOT_1) && IsIdConnected(websocketId_1))
     {
         ids[n] = websocketId_1;
         n++;
     } // if
-    if (! isTestMessage && IsIdConnected(websocketId_2))
+    if (! isTestMessage && (slots & WEBSOCKET_SLOT_2) && IsIdConnected(websocketId_2))
     {
         ids[n] = websocketId_2;
         n++;
@@ -290,15 +606,16 @@ bool SendJsonOnWebSocket(const char* json, bool saveForLater, bool isTestMessage
 
     if (n == 0)
     {
-      #if DEBUG_WEBSOCKET >= 2
-        // Print reason
-        Serial.printf_P(
-            PSTR("%s[webSocket] Unable to send %zu-byte packet: no client connected, %s\n"),
-            TimeStamp(),
-            strlen(json),
-            saveForLater ? PSTR("stored for later") : PSTR("discarding")
-        );
-      #endif // DEBUG_WEBSOCKET >= 2
+        if (IsDiagEnabled(DIAG_WEBSOCKET, 2))
+        {
+            // Print reason
+            Log(LOG_LEVEL_WARNING).printf_P(
+                PSTR("%s[webSocket] Unable to send %zu-byte packet: no client connected, %s\n"),
+                TimeStamp(),
+                strlen(json),
+                saveForLater ? PSTR("stored for later") : PSTR("discarding")
+            );
+        } // if
 
         if (saveForLater) QueueJson(json);
 
@@ -323,20 +640,22 @@ bool SendJsonOnWebSocket(const char* json, bool saveForLater, bool isTestMessage
             unsigned long thisDuration = millis() - start;
             if (thisDuration < duration) duration = thisDuration;
 
-          #if DEBUG_WEBSOCKET >= 2
-           #if DEBUG_WEBSOCKET == 2
-            if (! isTestMessage)
-           #endif
-                Serial.printf_P(
+            if (IsDiagEnabled(DIAG_WEBSOCKET, 3) || (IsDiagEnabled(DIAG_WEBSOCKET, 2) && ! isTestMessage))
+            {
+                AsyncLog.printf_P(
                     PSTR("%s[webSocket %" PRIu32 "] Sent %zu-byte packet\n"),
                     TimeStamp(),
                     id,
                     strlen(json)
                 );
-          #endif // DEBUG_WEBSOCKET >= 2
+            } // if
 
             result = true;
             if (lastSentOnId_1 == 0) lastSentOnId_1 = id; else lastSentOnId_2 = id;
+
+            nWebSocketFramesSent++;
+            nWebSocketBytesSent += strlen(json);
+            nWebSocketEventsSent += nEvents;
         } // if
     } // for
 
@@ -344,20 +663,23 @@ bool SendJsonOnWebSocket(const char* json, bool saveForLater, bool isTestMessage
 
     if (! result)
     {
-      #ifdef DEBUG_WEBSOCKET
-        Serial.printf_P(
-            PSTR("%s[webSocket] Failed to send %zu-byte packet%s\n"),
-            TimeStamp(),
-            strlen(json),
-            saveForLater ? PSTR(", stored for later sending") : PSTR(", discarding")
-        );
+        nWebSocketSendFailures++;
 
-      #if DEBUG_WEBSOCKET >= 2
-        Serial.print(F("JSON object:\n"));
-        PrintJsonText(json);
-      #endif // DEBUG_WEBSOCKET >= 2
+        if (IsDiagEnabled(DIAG_WEBSOCKET))
+        {
+            Log(LOG_LEVEL_WARNING).printf_P(
+                PSTR("%s[webSocket] Failed to send %zu-byte packet%s\n"),
+                TimeStamp(),
+                strlen(json),
+                saveForLater ? PSTR(", stored for later sending") : PSTR(", discarding")
+            );
+        } // if
 
-      #endif // DEBUG_WEBSOCKET
+        if (IsDiagEnabled(DIAG_WEBSOCKET, 2))
+        {
+            AsyncLog.print(F("JSON object:\n"));
+            PrintJsonText(json);
+        } // if
     }
     else
     {
@@ -366,7 +688,7 @@ bool SendJsonOnWebSocket(const char* json, bool saveForLater, bool isTestMessage
         // a single-thread system).
         if (duration > 100)
         {
-            Serial.printf_P(
+            AsyncLog.printf_P(
                 PSTR("%s[webSocket] Sending %zu-byte packet took: %lu msec\n"),
                 TimeStamp(),
                 strlen(json),
@@ -376,7 +698,90 @@ bool SendJsonOnWebSocket(const char* json, bool saveForLater, bool isTestMessage
     } // if
 
     return result;
-} // SendJsonOnWebSocket
+} // SendFrameOnWebSocket
+
+// Send an infrared remote control button press to the WebSocket client(s), ahead of everything else: not collected
+// in a batch, and not behind the messages stored for later sending. Only if a client cannot take it right now, the
+// message is stored for later sending, so that the button press is not lost.
+bool SendIrJsonOnWebSocket(const char* json)
+{
+    if (json == 0 || json[0] == 0) return false;
+
+    uint32_t sentOnId_1 = 0;
+    uint32_t sentOnId_2 = 0;
+    bool failed = false;
+
+    const uint32_t ids[] = { websocketId_1, websocketId_2 };
+    for (int i = 0; i < 2; i++)
+    {
+        uint32_t id = ids[i];
+        if (! IsIdConnected(id) || (i == 1 && id == ids[0])) continue;
+
+        if (! TryToSendJsonOnWebSocket(id, json))
+        {
+            failed = true;
+            continue;
+        } // if
+
+        if (sentOnId_1 == 0) sentOnId_1 = id; else sentOnId_2 = id;
+
+        nWebSocketFramesSent++;
+        nWebSocketBytesSent += strlen(json);
+        nWebSocketEventsSent++;
+    } // for
+
+    if (sentOnId_1 != 0 && ! failed) return true;
+
+    if (failed) nWebSocketSendFailures++;
+    QueueJson(json, sentOnId_1, sentOnId_2);
+
+    return sentOnId_1 != 0;
+} // SendIrJsonOnWebSocket
+
+// Report the WebSocket frame statistics since the previous call
+const char* WebSocketStatsToJson(char* buf, const int n)
+{
+    static unsigned long lastReportedAt = 0;
+    static uint32_t lastFrames = 0;
+    static uint32_t lastBytes = 0;
+    static uint32_t lastEvents = 0;
+
+    unsigned long now = millis();
+    unsigned long elapsed = now - lastReportedAt;  // Arithmetic has safe roll-over
+    uint32_t frames = nWebSocketFramesSent - lastFrames;
+    uint32_t bytes = nWebSocketBytesSent - lastBytes;
+    uint32_t events = nWebSocketEventsSent - lastEvents;
+
+    lastReportedAt = now;
+    lastFrames = nWebSocketFramesSent;
+    lastBytes = nWebSocketBytesSent;
+    lastEvents = nWebSocketEventsSent;
+
+    if (elapsed == 0 || frames == 0) return "";
+
+    const static char jsonFormatter[] PROGMEM =
+    "{\n"
+        "\"event\": \"display\",\n"
+        "\"data\":\n"
+        "{\n"
+            "\"websocket_frame_stats\": \"%lu.%lu/s, %lu bytes, %lu.%lu pkts\"\n"
+        "}\n"
+    "}\n";
+
+    unsigned long framesPerSec_x10 = frames * 10000UL / elapsed;
+    unsigned long eventsPerFrame_x10 = events * 10UL / frames;
+
+    int at = snprintf_P(buf, n, jsonFormatter,
+        framesPerSec_x10 / 10, framesPerSec_x10 % 10,
+        (unsigned long)(bytes / frames),
+        eventsPerFrame_x10 / 10, eventsPerFrame_x10 % 10
+    );
+
+    // JSON buffer overflow?
+    if (at >= n) return "";
+
+    return buf;
+} // WebSocketStatsToJson
 
 // The WebSocket client (JavaScript) is sending data back to the ESP
 void ProcessWebSocketClientMessage(const char* payload, uint32_t id)
@@ -409,9 +814,10 @@ void ProcessWebSocketClientMessage(const char* payload, uint32_t id)
         // - Rate 2 (fastest): sat nav list of services, personal addresses and professional addresses
         irButtonFasterRepeat = clientMessage.substring(24).toInt();
 
-      #ifdef DEBUG_IR_RECV
-        Serial.printf_P(PSTR("==> irButtonFasterRepeat = %d\n"), irButtonFasterRepeat);
-      #endif // DEBUG_IR_RECV
+        if (IsDiagEnabled(DIAG_IR_RECV))
+        {
+            AsyncLog.printf_P(PSTR("==> irButtonFasterRepeat = %d\n"), irButtonFasterRepeat);
+        } // if
     }
     else if (clientMessage.startsWith("mfd_popup_showing:"))
     {
@@ -455,7 +861,7 @@ void ProcessWebSocketClientMessage(const char* payload, uint32_t id)
             value == "set_units_mph" ? MFD_DISTANCE_UNIT_IMPERIAL :
             MFD_DISTANCE_UNIT_METRIC;
 
-        if (mfdDistanceUnit != prevMfdDistanceUnit) ResetPacketPrevData();
+        if (mfdDistanceUnit != prevMfdDistanceUnit) ResetUnitDependentPacketPrevData();
     }
     else if (clientMessage.startsWith("mfd_temperature_unit:"))
     {
@@ -468,8 +874,78 @@ void ProcessWebSocketClientMessage(const char* payload, uint32_t id)
             value == "set_units_deg_fahrenheit" ? MFD_TEMPERATURE_UNIT_FAHRENHEIT :
             MFD_TEMPERATURE_UNIT_CELSIUS;
 
-        if (mfdTemperatureUnit != prevMfdTemperatureUnit) ResetPacketPrevData();
+        if (mfdTemperatureUnit != prevMfdTemperatureUnit) ResetUnitDependentPacketPrevData();
+    }
+    else if (clientMessage.startsWith("units_on_client:"))
+    {
+        // The WebSocket client indicates that it can handle unit-neutral values, and will do unit conversion
+        // and formatting itself
+
+        SetWebSocketOption(id, CLIENT_OPTION_UNITS, clientMessage.endsWith(":YES"));
     }
+    else if (clientMessage.startsWith("codes_on_client:"))
+    {
+        // The WebSocket client indicates that it has loaded the string tables ("/VanStrings.js"), and will look up
+        // the texts of notifications and RDS program types itself
+
+        SetWebSocketOption(id, CLIENT_OPTION_CODES, clientMessage.endsWith(":YES"));
+    }
+    else if (clientMessage.startsWith("guidance_icons_on_client:"))
+    {
+        // The WebSocket client indicates that it can expand the bit patterns of guidance instruction icons itself
+
+        SetWebSocketOption(id, CLIENT_OPTION_GUIDANCE_ICONS, clientMessage.endsWith(":YES"));
+    }
+    else if (clientMessage.startsWith("batched_frames_on_client:"))
+    {
+        // The WebSocket client indicates that it can handle frames containing an array of JSON objects. Takes
+        // effect with the next message that is sent (see SendJsonOnWebSocket).
+
+        SetWebSocketOption(id, CLIENT_OPTION_BATCHED_FRAMES, clientMessage.endsWith(":YES"));
+    }
+    else if (clientMessage.startsWith("satnav_list_pages_on_client:"))
+    {
+        // The WebSocket client indicates that it can assemble sat nav lists from pages
+
+        SetWebSocketOption(id, CLIENT_OPTION_SATNAV_LIST_PAGES, clientMessage.endsWith(":YES"));
+    }
+    else if (clientMessage.startsWith("latency_trace_on_client:"))
+    {
+        // The WebSocket client indicates that it will echo the "trace" stamps of the messages it has rendered
+
+        SetWebSocketOption(id, CLIENT_OPTION_LATENCY_TRACE, clientMessage.endsWith(":YES"));
+    }
+    else if (clientMessage.startsWith("latency_trace:"))
+    {
+        // The WebSocket client echoes a "trace" stamp, after having rendered the message
+
+        ProcessLatencyTraceEcho(clientMessage.c_str() + 14);
+    }
+    else if (clientMessage.startsWith("bus_stats_on_client:"))
+    {
+        // The WebSocket client wants to see the VAN bus load and the busiest IDEN values
+
+        SetWebSocketOption(id, CLIENT_OPTION_BUS_STATS, clientMessage.endsWith(":YES"));
+    }
+    else if (clientMessage.startsWith("diag:"))
+    {
+        // The WebSocket client switches diagnostic output on or off, e.g. "diag:websocket=2" (see Log.ino)
+
+        if (! SetDiagnostic(clientMessage.c_str() + 5))
+        {
+            Log(LOG_LEVEL_WARNING).printf_P(PSTR("%s[webSocket %" PRIu32 "] Invalid diagnostic setting: '%s'\n"),
+                TimeStamp(), id, clientMessage.c_str() + 5);
+        } // if
+    }
+  #ifdef VAN_TRACE_RECORDER
+    else if (clientMessage.startsWith("van_trace:"))
+    {
+        // The WebSocket client wants to start or stop recording a VAN bus trace (see VanTrace.ino)
+
+        if (clientMessage.endsWith(":START")) vanTraceRequest = 1;
+        else if (clientMessage.endsWith(":STOP")) vanTraceRequest = 0;
+    }
+  #endif // VAN_TRACE_RECORDER
     else if (clientMessage.startsWith("mfd_time_unit:"))
     {
         // The WebSocket client passes the current time unit (12 or 24 hour)
@@ -491,7 +967,7 @@ void ProcessWebSocketClientMessage(const char* payload, uint32_t id)
         int offsetMinutes = value.toInt();
         SetTimeZoneOffset(offsetMinutes);
 
-        Serial.printf_P(
+        AsyncLog.printf_P(
             PSTR("==> Time zone received from WebSocket client %" PRIu32 ": UTC %+2d:%02d\n"),
             id, offsetMinutes / MINS_PER_HOUR, abs(offsetMinutes % MINS_PER_HOUR)
         );
@@ -510,7 +986,7 @@ void ProcessWebSocketClientMessage(const char* payload, uint32_t id)
         // off a few (hundred) milliseconds...
         if (SetTime(epoch, msec))
         {
-            Serial.printf_P(
+            AsyncLog.printf_P(
                 PSTR("==> Current date-time received from WebSocket client %" PRIu32 ": %04d-%02d-%02d %02d:%02d:%02d.%03" PRIu32 " UTC\n"),
                 id, year(epoch), month(epoch), day(epoch), hour(epoch), minute(epoch), second(epoch), msec
             );
@@ -538,35 +1014,46 @@ void WebSocketEvent(
     {
         case WS_EVT_DISCONNECT:
         {
-            Serial.printf_P(PSTR("%s[webSocket %" PRIu32 "] Disconnected!\n"), TimeStamp(), id);
+            AsyncLog.printf_P(PSTR("%s[webSocket %" PRIu32 "] Disconnected!\n"), TimeStamp(), id);
 
             if (id == websocketId_1)
             {
                 websocketId_1 = websocketId_2;
+                websocketOptions_1 = websocketOptions_2;
+                websocketActivitySlot_1 = websocketActivitySlot_2;
                 websocketId_2 = WEBSOCKET_INVALID_ID;
+                websocketOptions_2 = 0;
+                websocketActivitySlot_2 = -1;
             }
             else if (id == websocketId_2)
             {
                 websocketId_2 = WEBSOCKET_INVALID_ID;
+                websocketOptions_2 = 0;
+                websocketActivitySlot_2 = -1;
             } // if
 
+            // The remaining client may be able to handle more
+            WebSocketOptionsChanged();
+            webSocketBatchFlushRequested = true;
+
             if (id == webSocketIdJustConnected)
             {
                 CleanupQueuedJsons(webSocketIdJustConnected);
                 webSocketIdJustConnected = 0;
             } // if
 
-          #ifdef DEBUG_WEBSOCKET
-            Serial.printf_P(PSTR("%s[webSocket] id_1=%" PRIu32 ", id_2=%" PRIu32 "\n"),
-                TimeStamp(), websocketId_1, websocketId_2);
-          #endif // DEBUG_WEBSOCKET
+            if (IsDiagEnabled(DIAG_WEBSOCKET))
+            {
+                AsyncLog.printf_P(PSTR("%s[webSocket] id_1=%" PRIu32 ", id_2=%" PRIu32 "\n"),
+                    TimeStamp(), websocketId_1, websocketId_2);
+            } // if
         }
         break;
 
         case WS_EVT_CONNECT:
         {
             IPAddress clientIp = client->remoteIP();
-            Serial.printf_P(PSTR("%s[webSocket %" PRIu32 "] Connection request from %s"),
+            AsyncLog.printf_P(PSTR("%s[webSocket %" PRIu32 "] Connection request from %s"),
                 TimeStamp(),
                 id,
                 clientIp.toString().c_str());
@@ -576,7 +1063,8 @@ void WebSocketEvent(
             client->client()->setAckTimeout(10000);
             //client->client()->setRxTimeout(120);
 
-            lastWebSocketCommunication[clientIp] = millis();
+            SetLastWebSocketCommunication(clientIp);
+            MarkWakePhase(WAKE_PHASE_WEBSOCKET_CLIENT);
 
             // A completely new value for id?
             if (id != websocketId_1 && id != websocketId_2)
@@ -584,7 +1072,7 @@ void WebSocketEvent(
                 nWebSocketConnections++;
 
                 webSocketIdJustConnected = id;
-                Serial.printf_P(PSTR(" --> will start serving %" PRIu32 "\n"), id);
+                AsyncLog.printf_P(PSTR(" --> will start serving %" PRIu32 "\n"), id);
 
                 // Use as much as possible an empty slot
                 if (websocketId_1 == WEBSOCKET_INVALID_ID || ! webSocket.hasClient(websocketId_1))
@@ -601,20 +1089,25 @@ void WebSocketEvent(
                     IPAddress clientIp_1 = webSocket.client(websocketId_1)->remoteIP();
                     if (clientIp == clientIp_1) websocketId_1 = id; else websocketId_2 = id;
                 } // if
+
+                // The client has not opted in to anything yet
+                *WebSocketOptions(id) = 0;
+                webSocketBatchDiscardRequested = true;
             }
             else
             {
-                Serial.printf_P(PSTR(" --> already serving %" PRIu32 "\n"), id);
+                AsyncLog.printf_P(PSTR(" --> already serving %" PRIu32 "\n"), id);
             } // if
 
-          #ifdef DEBUG_WEBSOCKET
-            Serial.printf_P(PSTR("%s[webSocket] id_1=%" PRIu32 ", id_2=%" PRIu32 "\n"),
-                TimeStamp(), websocketId_1, websocketId_2);
-            Serial.printf_P(PSTR("%s[webSocket %" PRIu32 "] Free RAM: %" PRIu32 "\n"),
-                TimeStamp(),
-                id,
-                system_get_free_heap_size());
-          #endif // DEBUG_WEBSOCKET
+            if (IsDiagEnabled(DIAG_WEBSOCKET))
+            {
+                AsyncLog.printf_P(PSTR("%s[webSocket] id_1=%" PRIu32 ", id_2=%" PRIu32 "\n"),
+                    TimeStamp(), websocketId_1, websocketId_2);
+                AsyncLog.printf_P(PSTR("%s[webSocket %" PRIu32 "] Free RAM: %" PRIu32 "\n"),
+                    TimeStamp(),
+                    id,
+                    system_get_free_heap_size());
+            } // if
 
             // Send ESP system data to client
             // Don't call 'SendJsonOnWebSocket' here, causes out-of-memory or stack overflow crash. Instead:
@@ -628,8 +1121,10 @@ void WebSocketEvent(
             // Don't call here, causes out-of-memory or stack overflow crash
             //SendQueuedJson(websocketId_1);
 
-            // Trigger re-sending of otherwise unchanged data
-            ResetPacketPrevData();
+            // Fall back to sending values in the selected units, until the client indicates it can handle
+            // unit-neutral values. Once the options have settled, trigger re-sending of otherwise unchanged data.
+            webSocketResendRequested = true;
+            WebSocketOptionsChanged();
         }
         break;
 
@@ -643,12 +1138,12 @@ void WebSocketEvent(
                 data[len] = '\0';
 
                 IPAddress clientIp = client->remoteIP();
-                lastWebSocketCommunication[clientIp] = millis();
+                SetLastWebSocketCommunication(clientIp);
 
                 // A completely new value for id?
                 if (id != websocketId_1 && id != websocketId_2)
                 {
-                    Serial.printf_P(
+                    AsyncLog.printf_P(
                         PSTR("%s[webSocket %" PRIu32 "] received text: '%s' --> switching to %" PRIu32 "\n"),
                         TimeStamp(), id, data, id
                     );
@@ -669,16 +1164,28 @@ void WebSocketEvent(
                         if (clientIp == clientIp_1) websocketId_1 = id; else websocketId_2 = id;
                     } // if
 
-                  #ifdef DEBUG_WEBSOCKET
-                    Serial.printf_P(PSTR("%s[webSocket] id_1=%" PRIu32 ", id_2=%" PRIu32 "\n"),
-                        TimeStamp(), websocketId_1, websocketId_2);
-                  #endif // DEBUG_WEBSOCKET
+                    // The client has not opted in to anything yet (the message below may be an opt-in)
+                    *WebSocketOptions(id) = 0;
+                    WebSocketOptionsChanged();
+                    webSocketBatchDiscardRequested = true;
+
+                    if (IsDiagEnabled(DIAG_WEBSOCKET))
+                    {
+                        AsyncLog.printf_P(PSTR("%s[webSocket] id_1=%" PRIu32 ", id_2=%" PRIu32 "\n"),
+                            TimeStamp(), websocketId_1, websocketId_2);
+                    } // if
                 }
                 else
                 {
-                  #if DEBUG_WEBSOCKET >= 2
-                    Serial.printf_P(PSTR("%s[webSocket %" PRIu32 "] received text: '%s'\n"), TimeStamp(), id, data);
-                  #endif // DEBUG_WEBSOCKET >= 2
+                    if (IsDiagEnabled(DIAG_WEBSOCKET, 2))
+                    {
+                        AsyncLog.printf_P(
+                            PSTR("%s[webSocket %" PRIu32 "] received text: '%s'\n"),
+                            TimeStamp(),
+                            id,
+                            data
+                        );
+                    } // if
                 } // if
 
                 ProcessWebSocketClientMessage((char*)data, id);  // Process the message
@@ -689,7 +1196,7 @@ void WebSocketEvent(
         case WS_EVT_ERROR:
         {
             uint16_t reasonCode = *(uint16_t*)arg;
-            Serial.printf_P(PSTR("%s[webSocket %" PRIu32 "]: error %d occurred: '%s'\n"), TimeStamp(), id, reasonCode, data);
+            Log(LOG_LEVEL_WARNING).printf_P(PSTR("%s[webSocket %" PRIu32 "]: error %d occurred: '%s'\n"), TimeStamp(), id, reasonCode, data);
         }
         break;
 
@@ -761,9 +1268,71 @@ void SetupWebSocket()
     webSocket.onEvent(WebSocketEvent);
     webServer.addHandler(&webSocket);
 
-    Serial.print(F("WebSocket server running\n"));
+    AsyncLog.print(F("WebSocket server running\n"));
 } // SetupWebSocket
 
+// Apply the options of the connected WebSocket clients, once these have not changed for a while: the options are
+// sent one by one after connecting, and each change of format requires all data to be re-sent.
+// The JSON data is formatted once for all clients, so a format option (e.g. units on client) is used only if all
+// connected clients have opted in to it. Bus statistics are sent if any client has asked for them.
+void ApplyWebSocketOptions()
+{
+    if (! webSocketOptionsChanged) return;
+
+    // Arithmetic has safe roll-over
+    if (millis() - webSocketOptionsChangedAt < WEBSOCKET_CLIENT_OPTIONS_SETTLE_MS) return;
+
+    // Clear the flags before reading the options: a change coming in from here on is applied in a next round
+    webSocketOptionsChanged = false;
+    bool resend = webSocketResendRequested;
+    webSocketResendRequested = false;
+
+    uint8_t allOptions = 0xFF;
+    uint8_t anyOptions = 0;
+    bool connected = false;
+    if (IsIdConnected(websocketId_1))
+    {
+        allOptions &= websocketOptions_1;
+        anyOptions |= websocketOptions_1;
+        connected = true;
+    } // if
+    if (websocketId_2 != websocketId_1 && IsIdConnected(websocketId_2))
+    {
+        allOptions &= websocketOptions_2;
+        anyOptions |= websocketOptions_2;
+        connected = true;
+    } // if
+    if (! connected) allOptions = 0;
+
+    bool newUnitsOnClient = allOptions & CLIENT_OPTION_UNITS;
+    bool newCodesOnClient = allOptions & CLIENT_OPTION_CODES;
+    bool newGuidanceIconsOnClient = allOptions & CLIENT_OPTION_GUIDANCE_ICONS;
+    bool formatChanged =
+        newUnitsOnClient != unitsOnClient
+        || newCodesOnClient != codesOnClient
+        || newGuidanceIconsOnClient != guidanceIconsOnClient;
+
+    // Send any updates collected in the previous format
+    if (formatChanged) FlushBatch();
+
+    unitsOnClient = newUnitsOnClient;
+    codesOnClient = newCodesOnClient;
+    guidanceIconsOnClient = newGuidanceIconsOnClient;
+    satnavListPagesOnClient = allOptions & CLIENT_OPTION_SATNAV_LIST_PAGES;
+    latencyTraceOnClient = allOptions & CLIENT_OPTION_LATENCY_TRACE;
+    busStatsOnClient = anyOptions & CLIENT_OPTION_BUS_STATS;
+
+    if (IsDiagEnabled(DIAG_WEBSOCKET))
+    {
+        AsyncLog.printf_P(PSTR("%s[webSocket] options: id_1=0x%02X, id_2=0x%02X --> all=0x%02X, any=0x%02X%s\n"),
+            TimeStamp(), websocketOptions_1, websocketOptions_2, allOptions, anyOptions,
+            formatChanged || resend ? PSTR(", re-sending all data") : PSTR(""));
+    } // if
+
+    // Re-send all values in the newly selected format, or to the newly connected client
+    if (formatChanged || resend) ResetPacketPrevData();
+} // ApplyWebSocketOptions
+
 void LoopWebSocket()
 {
     static unsigned long lastPoke = 0;
@@ -786,7 +1355,13 @@ void LoopWebSocket()
     } // if
 
     // Somehow, webSocket.cleanupClients() sometimes causes out of memory condition
-    if (system_get_free_heap_size() > 2 * 1024) webSocket.cleanupClients();
+    if (IsMemoryAvailable(MEMORY_FOR_WEBSOCKET_CLEANUP))
+    {
+        webSocket.cleanupClients();
+      #ifdef LOG_WEBSOCKET
+        logWebSocket.cleanupClients();
+      #endif // LOG_WEBSOCKET
+    } // if
 
     // New WebSocket just connected?
     if (webSocketIdJustConnected != 0)
@@ -814,6 +1389,14 @@ void LoopWebSocket()
     } // if
   #endif // WIFI_STRESS_TEST
 
+    ApplyWebSocketOptions();
+    RecordLatencyTraceEchoes();
+
+    // Send the collected updates when the batch window has passed
+    DiscardBatchIfRequested();
+    FlushBatchIfRequested();
+    if (batchLen > 0 && millis() - batchStartedAt >= WEBSOCKET_BATCH_WINDOW_MS) FlushBatch();
+
     if (millis() - lastSendQueued >= 200UL)  // Arithmetic has safe roll-over
     {
         SendQueuedJson(websocketId_1);
@@ -827,14 +1410,15 @@ void LoopWebSocket()
 
         CleanupQueuedJsons();
 
-      #ifdef DEBUG_WEBSOCKET
-        Serial.printf_P(
-            PSTR("%s[webSocket] %zu client%s currently connected, queued_jsons=%d, id_1=%" PRIu32 ", id_2=%" PRIu32 ", ram=%" PRIu32 "\n"),
-            TimeStamp(), webSocket.count(),
-            webSocket.count() == 1 ? PSTR(" is") : PSTR("s are"),
-            countQueuedJsons(), websocketId_1, websocketId_2,
-            system_get_free_heap_size()
-        );
-      #endif // DEBUG_WEBSOCKET
+        if (IsDiagEnabled(DIAG_WEBSOCKET))
+        {
+            AsyncLog.printf_P(
+                PSTR("%s[webSocket] %zu client%s currently connected, queued_jsons=%d, id_1=%" PRIu32 ", id_2=%" PRIu32 ", ram=%" PRIu32 "\n"),
+                TimeStamp(), webSocket.count(),
+                webSocket.count() == 1 ? PSTR(" is") : PSTR("s are"),
+                countQueuedJsons(), websocketId_1, websocketId_2,
+                system_get_free_heap_size()
+            );
+        } // if
     } // if
 } // LoopWebSocket
@@ -8,6 +8,12 @@
 
 #include "Config.h"
 
+// Defined in Sleep.ino
+extern bool wokeUpFromSleep;
+
+// Defined in WakeTrace.ino
+void MarkWakePhase(int phase);
+
 const char* GetHostname()
 {
     return HOST_NAME;
@@ -28,13 +34,14 @@ void onStationConnected(WiFiEvent_t event, WiFiEventInfo_t info)
     digitalWrite(LED_BUILTIN, LED_OFF);
   #endif
 
-    Serial.printf_P(PSTR("%sWi-Fi client connected: "), TimeStamp());
+    MarkWakePhase(WAKE_PHASE_WIFI_LINK);
+
   #if defined ESP_ARDUINO_VERSION && ESP_ARDUINO_VERSION >= ESP_ARDUINO_VERSION_VAL(2, 0, 0)
-    Serial.print(macToString(info.wifi_ap_staconnected.mac));
+    const unsigned char* mac = info.wifi_ap_staconnected.mac;
   #else
-    Serial.print(macToString(info.sta_connected.mac));
+    const unsigned char* mac = info.sta_connected.mac;
   #endif
-    Serial.print("\n");
+    AsyncLog.printf_P(PSTR("%sWi-Fi client connected: %s\n"), TimeStamp(), macToString(mac).c_str());
 }
 
 #else
@@ -44,9 +51,9 @@ void onStationConnected(const WiFiEventSoftAPModeStationConnected& evt)
     digitalWrite(LED_BUILTIN, LED_OFF);
   #endif
 
-    Serial.printf_P(PSTR("%sWi-Fi client connected: "), TimeStamp());
-    Serial.print(macToString(evt.mac));
-    Serial.print("\n");
+    MarkWakePhase(WAKE_PHASE_WIFI_LINK);
+
+    AsyncLog.printf_P(PSTR("%sWi-Fi client connected: %s\n"), TimeStamp(), macToString(evt.mac).c_str());
 } // onStationConnected
 
 #endif // ARDUINO_ARCH_ESP32
@@ -55,21 +62,18 @@ void onStationConnected(const WiFiEventSoftAPModeStationConnected& evt)
 // WARNING: This function is called from a separate FreeRTOS task (thread)!
 void onStationDisconnected(WiFiEvent_t event, WiFiEventInfo_t info)
 {
-    Serial.printf_P(PSTR("%sWi-Fi client disconnected: "), TimeStamp());
   #if defined ESP_ARDUINO_VERSION && ESP_ARDUINO_VERSION >= ESP_ARDUINO_VERSION_VAL(2, 0, 0)
-    Serial.print(macToString(info.wifi_ap_stadisconnected.mac));
+    const unsigned char* mac = info.wifi_ap_stadisconnected.mac;
   #else
-    Serial.print(macToString(info.sta_disconnected.mac));
+    const unsigned char* mac = info.sta_disconnected.mac;
   #endif
-    Serial.print("\n");
+    AsyncLog.printf_P(PSTR("%sWi-Fi client disconnected: %s\n"), TimeStamp(), macToString(mac).c_str());
 }
 
 #else
 void onStationDisconnected(const WiFiEventSoftAPModeStationDisconnected& evt)
 {
-    Serial.printf_P(PSTR("%sWi-Fi client disconnected: "), TimeStamp());
-    Serial.print(macToString(evt.mac));
-    Serial.print("\n");
+    AsyncLog.printf_P(PSTR("%sWi-Fi client disconnected: %s\n"), TimeStamp(), macToString(evt.mac).c_str());
 } // onStationDisconnected
 
 #endif // ARDUINO_ARCH_ESP32
@@ -214,15 +218,19 @@ const char* SetupWifi()
     esp_wifi_set_bandwidth(WIFI_IF_AP, WIFI_BW_HT20);
   #endif
 
-    softap_config config_ap;
-  #ifdef ARDUINO_ARCH_ESP32
-    wifi_config_t config;
-    esp_wifi_get_config(WIFI_IF_AP, &config);
-    config_ap = config.ap;
-  #else
-    wifi_softap_get_config(&config_ap);
-  #endif // ARDUINO_ARCH_ESP32
-    PrintSoftApConfig(config_ap);
+    // Skip the printout when waking up (see setup() in VanLiveConnect.ino)
+    if (! wokeUpFromSleep)
+    {
+        softap_config config_ap;
+      #ifdef ARDUINO_ARCH_ESP32
+        wifi_config_t config;
+        esp_wifi_get_config(WIFI_IF_AP, &config);
+        config_ap = config.ap;
+      #else
+        wifi_softap_get_config(&config_ap);
+      #endif // ARDUINO_ARCH_ESP32
+        PrintSoftApConfig(config_ap);
+    } // if
 
   #else  // ! WIFI_AP_MODE
 
@@ -285,6 +293,8 @@ void WifiCheckStatus()
 
     if (isConnected)
     {
+        MarkWakePhase(WAKE_PHASE_WIFI_LINK);
+
       #ifdef LED_BUILTIN
         digitalWrite(LED_BUILTIN, LED_OFF);
       #endif
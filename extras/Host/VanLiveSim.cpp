@@ -0,0 +1,158 @@
+// Host build: run the sketch in real time against a simulated VAN bus, and count the VanBusRx receive queue overruns
+//
+// A separate thread puts the packets of a synthetic trace (see VanTraceGen.h) in the VanBusRx receive queue at the
+// pace of the trace, as the VanBus interrupt service routine would. The main thread runs loop(), with one WebSocket
+// client connected. Sending a WebSocket frame takes '--ws-send-us' microseconds, and every '--stall-every-ms'
+// milliseconds the main loop is blocked for '--stall-ms' milliseconds, e.g. as by a slow page serve or a TCP
+// retransmission. Both are spent busy-waiting on the main thread.
+//
+// Built twice: with everything in the main loop, and with VAN_RX_PARSE_TASK (packets received and parsed in a
+// separate thread; see VanRxTask.ino), to compare the overrun rates.
+//
+// Usage: van_live_sim [--seconds <n>] [--load <x>] [--ws-send-us <n>] [--stall-ms <n>] [--stall-every-ms <n>]
+//                     [--serial]
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <VanBusRx.h>
+
+#include "Host.h"
+#include "VanTraceGen.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+// Defined in the sketch
+void setup();
+void loop();
+extern long sleepAfter;
+extern AsyncWebSocket webSocket;
+
+static const char* const mfdClientOptions[] =
+{
+    "units_on_client:YES",
+    "codes_on_client:YES",
+    "guidance_icons_on_client:YES",
+    "satnav_list_pages_on_client:YES",
+    "batched_frames_on_client:YES",
+    "latency_trace_on_client:YES",
+    "bus_stats_on_client:YES",
+};
+
+static void Usage()
+{
+    fprintf(stderr, "Usage: van_live_sim [--seconds <n>] [--load <x>] [--ws-send-us <n>] [--stall-ms <n>]"
+        " [--stall-every-ms <n>] [--serial]\n");
+    exit(EXIT_FAILURE);
+} // Usage
+
+int main(int argc, char* argv[])
+{
+    int seconds = 10;
+    double load = 1.0;
+    uint32_t stallMs = 0;
+    uint32_t stallEveryMs = 5000;
+    hostWebSocketSendMicros = 2000;  // Typically 1-2 ms on the ESP8266 (see SendFrameOnWebSocket in WebSocket.ino)
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--serial") { hostSerialEcho = true; continue; }
+        if (i + 1 >= argc) Usage();
+        const char* value = argv[++i];
+
+        if (arg == "--seconds") seconds = atoi(value);
+        else if (arg == "--load") load = atof(value);
+        else if (arg == "--ws-send-us") hostWebSocketSendMicros = atoi(value);
+        else if (arg == "--stall-ms") stallMs = atoi(value);
+        else if (arg == "--stall-every-ms") stallEveryMs = atoi(value);
+        else Usage();
+    } // for
+
+    hostRealTime = true;
+    HostSetFileSystemRoot("van_live_sim_fs");
+
+    setup();
+    sleepAfter = -1;  // The host program decides when to stop
+
+    AsyncWebSocketClient* client = webSocket.HostConnect(IPAddress(192, 168, 4, 2));
+    for (int j = 0; j < 10; j++) loop();
+    for (const char* option : mfdClientOptions) webSocket.HostReceiveText(client->id(), option);
+    for (int j = 0; j < 20; j++) loop();  // Let the options settle (see ApplyWebSocketOptions in WebSocket.ino)
+    client->nTextFrames = 0;
+    client->nBytes = 0;
+
+    std::atomic<uint32_t> nInjected(0);
+    std::atomic<bool> done(false);
+    unsigned long startedAt = millis();
+
+    std::thread bus([&]()
+    {
+        GenerateVanTraffic(seconds, load, 1,
+            [&](uint32_t at, uint16_t iden, uint8_t commandFlags, const uint8_t* data, int dataLen)
+            {
+                while (millis() - startedAt < at) usleep(200);
+                VanBusRx.HostInject(iden, commandFlags, data, dataLen);
+                nInjected++;
+            }
+        );
+        done = true;
+    });
+
+    unsigned long lastStallAt = startedAt;
+    unsigned long doneAt = 0;
+    for (;;)
+    {
+        loop();
+
+        if (stallMs > 0 && millis() - lastStallAt >= stallEveryMs)
+        {
+            HostSpend(stallMs * 1000);
+            lastStallAt = millis();
+        } // if
+
+        // Let the sketch drain the receive queue
+        if (done && doneAt == 0) doneAt = millis();
+        if (doneAt != 0 && millis() - doneAt >= 500) break;
+    } // for
+
+    bus.join();
+
+    uint32_t injected = nInjected;
+    uint32_t lost = VanBusRx.nHostOverruns;
+    printf("{\n"
+        "\"parse_task\": %s,\n"
+        "\"seconds\": %d,\n"
+        "\"packets_on_bus\": %" PRIu32 ",\n"
+        "\"packets_received\": %" PRIu32 ",\n"
+        "\"packets_dropped_by_policy\": %" PRIu32 ",\n"
+        "\"overruns\": %" PRIu32 ",\n"
+        "\"overrun_rate_percent\": %.2f,\n"
+        "\"lost_percent\": %.2f,\n"
+        "\"max_queued\": %d,\n"
+        "\"text_frames\": %" PRIu32 ",\n"
+        "\"bytes\": %" PRIu64 "\n"
+        "}\n",
+      #ifdef VAN_RX_PARSE_TASK
+        "true",
+      #else
+        "false",
+      #endif // VAN_RX_PARSE_TASK
+        seconds,
+        injected,
+        VanBusRx.GetCount(),
+        VanBusRx.nHostDropped,
+        lost,
+        injected == 0 ? 0.0 : lost * 100.0 / injected,
+        injected == 0 ? 0.0 : (lost + VanBusRx.nHostDropped) * 100.0 / injected,
+        VanBusRx.GetMaxQueued(),
+        client->nTextFrames,
+        client->nBytes);
+    fflush(stdout);
+
+    // The VAN bus receive task (if any) never returns: leave without running the destructors of the sketch
+    _exit(EXIT_SUCCESS);
+} // main
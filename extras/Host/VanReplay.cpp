@@ -0,0 +1,215 @@
+// Host build: replay a VAN bus trace through the sketch, and report what it costs
+//
+// Runs the sketch (setup() and loop()) on the host, with one or more WebSocket clients connected, and replays a trace
+// file through it (see VanTraceReplay.ino). The trace is either a file recorded by the trace recorder, or a synthetic
+// one (see VanTraceGen.h). Time is virtual (see Host.h), so a replay at speed 1 does not take as long as the trace.
+//
+// Prints a JSON object with the replay results of the sketch, the WebSocket traffic per client, the number of packets
+// skipped by VAN_RX_DECIMATION, and the host CPU time spent in loop(). Per client, the last value of each data item
+// it received (the state that it shows) is summarized in a digest, to compare runs (see
+// tests/CompareReplayState.cmake).
+//
+// Usage: van_replay [options]
+//   --trace <file>       Replay this trace file (default: a synthetic trace)
+//   --seconds <n>        Length of the synthetic trace (default: 60)
+//   --load <x>           Packet rate multiplier of the synthetic trace (default: 1)
+//   --speed <n>          Replay speed; 0 = as fast as possible (default: 1)
+//   --client <kind>      Connect a WebSocket client: "mfd" (opts in to everything, as MFD.js does) or "legacy"
+//                        (opts in to nothing). May be repeated. Default: one "mfd" client.
+//   --ws-send-us <n>     Time that sending a WebSocket frame takes (default: 0)
+//   --ignore-items <re>  Leave the data items matching this regular expression out of the state digest
+//   --fs <dir>           Directory for the flash file system (default: van_replay_fs)
+//   --serial             Echo the serial output of the sketch on stdout
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+#include "Host.h"
+#include "VanTraceGen.h"
+
+#include <filesystem>
+#include <map>
+#include <regex>
+#include <string>
+#include <vector>
+
+// Defined in the sketch
+void setup();
+void loop();
+extern long sleepAfter;
+extern AsyncWebSocket webSocket;
+extern AsyncWebServer webServer;
+void RequestVanTraceReplay(int idx, int speed);
+bool IsVanTraceReplaying();
+int VanTraceReplayToJson(char* buf, const int n);
+
+static const char* const mfdClientOptions[] =
+{
+    "units_on_client:YES",
+    "codes_on_client:YES",
+    "guidance_icons_on_client:YES",
+    "satnav_list_pages_on_client:YES",
+    "batched_frames_on_client:YES",
+    "latency_trace_on_client:YES",
+    "bus_stats_on_client:YES",
+};
+
+static void Usage()
+{
+    fprintf(stderr, "Usage: van_replay [--trace <file>] [--seconds <n>] [--load <x>] [--speed <n>]"
+        " [--client mfd|legacy]... [--ws-send-us <n>] [--ignore-items <re>] [--fs <dir>] [--serial]\n");
+    exit(EXIT_FAILURE);
+} // Usage
+
+// The last value of each data item that a client received: the state that the client shows
+typedef std::map<std::string, std::string> ClientState_t;
+
+static std::regex ignoredItemsRegex("$^");  // Matches nothing
+
+static void UpdateClientState(ClientState_t& state, const std::string& message)
+{
+    static const std::regex itemRegex("\"([a-z0-9_]+)\": \"((?:[^\"\\\\]|\\\\.)*)\"");
+    for (std::sregex_iterator it(message.begin(), message.end(), itemRegex), end; it != end; ++it)
+    {
+        if ((*it)[1] == "event" || std::regex_match((*it)[1].str(), ignoredItemsRegex)) continue;
+        state[(*it)[1]] = (*it)[2];
+    } // for
+} // UpdateClientState
+
+// FNV-1a hash of the client state, to compare runs
+static uint32_t ClientStateDigest(const ClientState_t& state)
+{
+    uint32_t hash = 2166136261u;
+    for (const auto& item : state)
+    {
+        for (char c : item.first + "=" + item.second + "\n") hash = (hash ^ (uint8_t)c) * 16777619u;
+    } // for
+    return hash;
+} // ClientStateDigest
+
+// Sum of the values of the specified metric (all label sets), as served on "/metrics"
+static uint64_t MetricTotal(const char* name)
+{
+    AsyncWebServerRequest request("/metrics");
+    webServer.HostRequest(&request);
+    String metrics = AsyncWebServer::HostReadResponse(&request);
+
+    uint64_t total = 0;
+    std::regex lineRegex(std::string("^") + name + "(\\{[^}]*\\})? ([0-9]+)$", std::regex::multiline);
+    for (std::sregex_iterator it(metrics.begin(), metrics.end(), lineRegex), end; it != end; ++it)
+    {
+        total += std::stoull((*it)[2]);
+    } // for
+    return total;
+} // MetricTotal
+
+int main(int argc, char* argv[])
+{
+    const char* traceFile = nullptr;
+    int seconds = 60;
+    double load = 1.0;
+    int speed = 1;
+    std::vector<std::string> clientKinds;
+    const char* fsDir = "van_replay_fs";
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--serial") { hostSerialEcho = true; continue; }
+        if (i + 1 >= argc) Usage();
+        const char* value = argv[++i];
+
+        if (arg == "--trace") traceFile = value;
+        else if (arg == "--seconds") seconds = atoi(value);
+        else if (arg == "--load") load = atof(value);
+        else if (arg == "--speed") speed = atoi(value);
+        else if (arg == "--client") clientKinds.push_back(value);
+        else if (arg == "--ws-send-us") hostWebSocketSendMicros = atoi(value);
+        else if (arg == "--ignore-items") ignoredItemsRegex = std::regex(value);
+        else if (arg == "--fs") fsDir = value;
+        else Usage();
+    } // for
+
+    if (clientKinds.empty()) clientKinds.push_back("mfd");
+
+    std::filesystem::remove_all(fsDir);
+    HostSetFileSystemRoot(fsDir);
+
+    // The replay engine reads "/trace0.bin" (see VanTraceFileName in VanTrace.ino)
+    std::string tracePath = std::string(fsDir) + "/trace0.bin";
+    if (traceFile != nullptr)
+    {
+        std::filesystem::copy_file(traceFile, tracePath);
+    }
+    else if (WriteSyntheticVanTrace(tracePath.c_str(), seconds, load) < 0)
+    {
+        fprintf(stderr, "Cannot write '%s'\n", tracePath.c_str());
+        return EXIT_FAILURE;
+    } // if
+
+    setup();
+    sleepAfter = -1;  // The host program decides when to stop
+
+    std::vector<AsyncWebSocketClient*> clients;
+    std::vector<ClientState_t> clientStates(clientKinds.size());
+    for (size_t i = 0; i < clientKinds.size(); i++)
+    {
+        if (clientKinds[i] != "mfd" && clientKinds[i] != "legacy") Usage();
+
+        AsyncWebSocketClient* client = webSocket.HostConnect(IPAddress(192, 168, 4, 2 + i));
+        clients.push_back(client);
+        ClientState_t* state = &clientStates[i];
+        client->onMessage = [state](const std::string& message, bool isBinary)
+        {
+            if (! isBinary) UpdateClientState(*state, message);
+        };
+        for (int j = 0; j < 10; j++) loop();  // Let the sketch handle the connection
+
+        if (clientKinds[i] == "mfd")
+        {
+            for (const char* option : mfdClientOptions) webSocket.HostReceiveText(client->id(), option);
+        } // if
+    } // for
+
+    // Settle, then count only the traffic of the replay
+    for (int i = 0; i < 100; i++) loop();
+    for (AsyncWebSocketClient* client : clients)
+    {
+        client->nTextFrames = client->nBinaryFrames = 0;
+        client->nBytes = 0;
+    } // for
+
+    RequestVanTraceReplay(0, speed);
+    loop();
+
+    uint64_t cpuAtStart = HostCpuMicros();
+    unsigned long millisAtStart = millis();
+    uint32_t nLoops = 0;
+    while (IsVanTraceReplaying())
+    {
+        loop();
+        nLoops++;
+    } // while
+    uint64_t cpuMicros = HostCpuMicros() - cpuAtStart;
+    unsigned long elapsed = millis() - millisAtStart;
+
+    char replayJson[1024];
+    VanTraceReplayToJson(replayJson, sizeof(replayJson));
+
+    printf("{\n\"replay\":\n%s,\n\"clients\":\n[\n", replayJson);
+    for (size_t i = 0; i < clients.size(); i++)
+    {
+        const AsyncWebSocketClient* c = clients[i];
+        printf("{ \"kind\": \"%s\", \"text_frames\": %" PRIu32 ", \"bytes\": %" PRIu64 ","
+            " \"frames_per_sec\": %.1f, \"items\": %zu, \"state_digest\": \"%08" PRIx32 "\" }%s\n",
+            clientKinds[i].c_str(), c->nTextFrames, c->nBytes,
+            elapsed == 0 ? 0.0 : c->nTextFrames * 1000.0 / elapsed,
+            clientStates[i].size(), ClientStateDigest(clientStates[i]),
+            i + 1 < clients.size() ? "," : "");
+    } // for
+    printf("],\n\"decimated_packets\": %" PRIu64 ",\n\"loops\": %" PRIu32 ",\n\"host_cpu_us\": %" PRIu64 ","
+        "\n\"host_cpu_us_per_loop\": %.2f\n}\n",
+        MetricTotal("vanlive_van_decimated_total"), nLoops, cpuMicros, nLoops == 0 ? 0.0 : (double)cpuMicros / nLoops);
+
+    return EXIT_SUCCESS;
+} // main
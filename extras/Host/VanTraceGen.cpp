@@ -0,0 +1,256 @@
+// Host build: synthetic VAN bus trace (see VanTraceGen.h)
+
+#include "VanTraceGen.h"
+
+#include <VanBusRx.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+namespace {
+
+// Same as in VanTrace.ino
+const uint8_t VAN_TRACE_VERSION = 1;
+const uint8_t VAN_TRACE_FLAG_CRC_OK = 1 << 7;
+
+// Simple, repeatable pseudo-random numbers
+struct Random_t
+{
+    uint32_t state;
+
+    uint32_t Next()
+    {
+        state = state * 1664525 + 1013904223;
+        return state >> 8;
+    } // Next
+
+    int Jitter(int maxMs) { return (int)(Next() % (2 * maxMs + 1)) - maxMs; }
+}; // struct Random_t
+
+// The car being driven
+struct Car_t
+{
+    double speed;  // km/h
+    double rpm;
+    double odometer;  // km
+    double coolantTemp;  // deg C
+    double tripDistance;  // km
+    double instConsumption;  // l/100 km
+
+    void At(uint32_t ms)
+    {
+        double t = ms / 1000.0;
+
+        // Speed up and slow down in a cycle of a minute, with some noise on top
+        speed = 55.0 + 45.0 * sin(2 * M_PI * t / 60.0) + 1.5 * sin(2 * M_PI * t / 1.7);
+        if (speed < 0) speed = 0;
+
+        // Shift up every 25 km/h
+        double inGear = fmod(speed, 25.0) / 25.0;
+        rpm = speed < 1 ? 800 : 1300 + 2000 * inGear;
+
+        coolantTemp = 20 + 70 * (1 - exp(-t / 120.0));
+        instConsumption = 4.0 + rpm / 1000.0 + 2.0 * cos(2 * M_PI * t / 60.0);
+    } // At
+}; // struct Car_t
+
+struct Stream_t
+{
+    uint16_t iden;
+    int dataLen;
+    int periodMs;  // At load 1
+    void (*fill)(const Car_t& car, uint32_t seq, uint8_t* data);
+    double nextAt;
+    uint32_t seq;
+}; // struct Stream_t
+
+void FillDashboard(const Car_t& car, uint32_t seq, uint8_t* data)
+{
+    uint16_t rpm_x8 = car.rpm * 8;
+    uint16_t speed_x100 = car.speed * 100;
+    uint8_t d[] = { (uint8_t)(rpm_x8 >> 8), (uint8_t)rpm_x8, (uint8_t)(speed_x100 >> 8), (uint8_t)speed_x100,
+        0x00, (uint8_t)(seq >> 8), (uint8_t)seq };
+    memcpy(data, d, sizeof(d));
+} // FillDashboard
+
+void FillWheelSpeed(const Car_t& car, uint32_t seq, uint8_t* data)
+{
+    uint16_t left_x100 = car.speed * 100;
+    uint16_t right_x100 = car.speed * 100 + (seq % 3);
+    uint8_t d[] = { (uint8_t)(left_x100 >> 8), (uint8_t)left_x100, (uint8_t)(right_x100 >> 8), (uint8_t)right_x100,
+        (uint8_t)seq };
+    memcpy(data, d, sizeof(d));
+} // FillWheelSpeed
+
+void FillEngine(const Car_t& car, uint32_t, uint8_t* data)
+{
+    uint32_t odometer_x10 = car.odometer * 10;
+    uint8_t d[] = { 0x8E, 0x05, (uint8_t)((car.coolantTemp + 39) * 0.6), (uint8_t)(odometer_x10 >> 16),
+        (uint8_t)(odometer_x10 >> 8), (uint8_t)odometer_x10, (uint8_t)((14.0 + 40) * 2) };
+    memcpy(data, d, sizeof(d));
+} // FillEngine
+
+void FillOdometer(const Car_t& car, uint32_t, uint8_t* data)
+{
+    uint32_t odometer_x10 = car.odometer * 10;
+    uint8_t d[] = { 0x00, (uint8_t)(odometer_x10 >> 16), (uint8_t)(odometer_x10 >> 8), (uint8_t)odometer_x10, 0x00 };
+    memcpy(data, d, sizeof(d));
+} // FillOdometer
+
+void FillCarStatus1(const Car_t& car, uint32_t seq, uint8_t* data)
+{
+    uint16_t trip = car.tripDistance;
+    uint16_t inst_x10 = car.instConsumption * 10;
+    uint16_t toEmpty = 650 - car.tripDistance;
+    memset(data, 0, 27);
+    data[0] = 0x80 | (seq & 0x07);
+    data[11] = 48;
+    data[12] = 52;
+    data[14] = trip >> 8;
+    data[15] = trip;
+    data[16] = 0;
+    data[17] = 68;
+    data[18] = trip >> 8;
+    data[19] = trip;
+    data[20] = 0;
+    data[21] = 71;
+    data[22] = inst_x10 >> 8;
+    data[23] = inst_x10;
+    data[24] = toEmpty >> 8;
+    data[25] = toEmpty;
+} // FillCarStatus1
+
+void FillAirCon1(const Car_t&, uint32_t, uint8_t* data)
+{
+    uint8_t d[] = { 0x00, 0x00, 0x80, 0x00, 0x06 };
+    memcpy(data, d, sizeof(d));
+} // FillAirCon1
+
+void FillAirCon2(const Car_t& car, uint32_t, uint8_t* data)
+{
+    uint8_t d[] = { 0x01, 0x00, (uint8_t)(car.coolantTemp > 60 ? 0x16 : 0x12), 0x7E, 0x5E, 0x00, 0x00 };
+    memcpy(data, d, sizeof(d));
+} // FillAirCon2
+
+void FillCom2000(const Car_t&, uint32_t, uint8_t* data)
+{
+    uint8_t d[] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+    memcpy(data, d, sizeof(d));
+} // FillCom2000
+
+void FillHeadUnitStalk(const Car_t&, uint32_t, uint8_t* data)
+{
+    data[0] = 0x00;
+    data[1] = 0xFF;
+} // FillHeadUnitStalk
+
+void FillMfdLanguageUnits(const Car_t&, uint32_t, uint8_t* data)
+{
+    uint8_t d[] = { 0x00, 0x00, 0x00, 0x00, 0x00 };
+    memcpy(data, d, sizeof(d));
+} // FillMfdLanguageUnits
+
+void FillAudioSettings(const Car_t&, uint32_t, uint8_t* data)
+{
+    uint8_t d[] = { 0x10, 0x00, 0x00, 0x94, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F };
+    memcpy(data, d, sizeof(d));
+} // FillAudioSettings
+
+} // namespace
+
+void GenerateVanTraffic(int seconds, double load, uint32_t seed, VanTraceGenCallback callback)
+{
+    std::vector<Stream_t> streams =
+    {
+        { 0x824, 7, 50, FillDashboard, 0, 0 },
+        { 0x744, 5, 50, FillWheelSpeed, 0, 0 },
+        { 0x8A4, 7, 200, FillEngine, 0, 0 },
+        { 0x564, 27, 200, FillCarStatus1, 0, 0 },
+        { 0x450, 10, 100, FillCom2000, 0, 0 },
+        { 0x9C4, 2, 200, FillHeadUnitStalk, 0, 0 },
+        { 0x464, 5, 500, FillAirCon1, 0, 0 },
+        { 0x4DC, 7, 500, FillAirCon2, 0, 0 },
+        { 0x8FC, 5, 500, FillOdometer, 0, 0 },
+        { 0x4D4, 11, 1000, FillAudioSettings, 0, 0 },
+        { 0x984, 5, 1000, FillMfdLanguageUnits, 0, 0 },
+    };
+
+    Random_t random { seed };
+    Car_t car {};
+    car.odometer = 123456.7;
+
+    // Streams start at random offsets within their period
+    for (Stream_t& stream : streams) stream.nextAt = random.Next() % stream.periodMs;
+
+    const uint32_t endAt = seconds * 1000;
+    for (uint32_t ms = 0; ms < endAt; ms++)
+    {
+        car.At(ms);
+        car.odometer += car.speed / 3600.0 / 1000.0;
+        car.tripDistance += car.speed / 3600.0 / 1000.0;
+
+        for (Stream_t& stream : streams)
+        {
+            if (ms < stream.nextAt) continue;
+
+            uint8_t data[28];
+            stream.fill(car, stream.seq++, data);
+            callback(ms, stream.iden, 0x0E, data, stream.dataLen);
+
+            // A few milliseconds of jitter, as the devices on the bus do not have precise timers
+            double period = stream.periodMs / load;
+            stream.nextAt += period + (period >= 10 ? random.Jitter(2) : 0);
+        } // for
+    } // for
+} // GenerateVanTraffic
+
+int WriteSyntheticVanTrace(const char* path, int seconds, double load, uint32_t seed)
+{
+    FILE* f = fopen(path, "wb");
+    if (f == nullptr) return -1;
+
+    const uint8_t header[] = { 'V', 'A', 'N', 'T', VAN_TRACE_VERSION, 0, 0, 0, 0, 0, 0, 0 };
+    fwrite(header, 1, sizeof(header), f);
+
+    int nPackets = 0;
+    uint32_t lastAt = 0;
+
+    GenerateVanTraffic(seconds, load, seed,
+        [&](uint32_t at, uint16_t iden, uint8_t commandFlags, const uint8_t* data, int dataLen)
+        {
+            uint8_t record[5 + 2 + 1 + 28 + 2];
+            uint8_t* p = record;
+
+            uint32_t delta = at - lastAt;
+            lastAt = at;
+            do
+            {
+                uint8_t b = delta & 0x7F;
+                delta >>= 7;
+                *p++ = delta != 0 ? b | 0x80 : b;
+            }
+            while (delta != 0);
+
+            uint16_t idenFlags = iden << 4 | (commandFlags & 0x0F);
+            *p++ = idenFlags & 0xFF;
+            *p++ = idenFlags >> 8;
+            *p++ = dataLen | VAN_TRACE_FLAG_CRC_OK;
+            memcpy(p, data, dataLen);
+            p += dataLen;
+
+            uint16_t crc = VanCrc(iden, commandFlags, data, dataLen);
+            *p++ = crc & 0xFF;
+            *p++ = crc >> 8;
+
+            fwrite(record, 1, p - record, f);
+            nPackets++;
+        }
+    );
+
+    bool ok = ferror(f) == 0;
+    fclose(f);
+    return ok ? nPackets : -1;
+} // WriteSyntheticVanTrace
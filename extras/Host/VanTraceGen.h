@@ -0,0 +1,23 @@
+#ifndef VanTraceGen_h
+#define VanTraceGen_h
+
+// Host build: writes a synthetic VAN bus trace file, in the format of the trace recorder (see VanTrace.ino)
+
+#include <stdint.h>
+
+#include <functional>
+
+// Called for each generated packet, in time order; 'at' is in milliseconds since the start of the trace
+typedef std::function<void(uint32_t at, uint16_t iden, uint8_t commandFlags, const uint8_t* data, int dataLen)>
+    VanTraceGenCallback;
+
+// Generate 'seconds' of bus traffic of a car being driven: the periodic packets of the engine, dashboard, wheel
+// speed, odometer, car status, climate control, head unit and stalk, with values that change as a car speeds up and
+// slows down. 'load' multiplies the packet rates (1 = about 70 packets per second). The traffic is the same for the
+// same 'seed'.
+void GenerateVanTraffic(int seconds, double load, uint32_t seed, VanTraceGenCallback callback);
+
+// Write the generated traffic into a trace file. Returns the number of packets written, or -1 on error.
+int WriteSyntheticVanTrace(const char* path, int seconds, double load = 1.0, uint32_t seed = 1);
+
+#endif // VanTraceGen_h
@@ -0,0 +1,295 @@
+#ifndef Arduino_h
+#define Arduino_h
+
+// Host build: the small part of the ESP8266 Arduino core that the sketch uses, enough to compile and run it on a
+// PC (see ../README.md). Time is virtual, unless real time is selected (see Host.h).
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <strings.h>
+#include <inttypes.h>
+#include <math.h>
+#include <time.h>
+
+#include <string>
+#include <algorithm>
+#include <functional>
+#include <memory>
+
+#include "pgmspace.h"
+
+#define ESP8266 1
+#define ARDUINO_ARCH_ESP8266 1
+#define ARDUINO 10819
+
+#define IRAM_ATTR
+#define ICACHE_RAM_ATTR
+#define ICACHE_FLASH_ATTR
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HEX 16
+#define DEC 10
+
+using std::abs;
+using std::min;
+using std::max;
+
+template <class T> T _min(T a, T b) { return a < b ? a : b; }
+template <class T> T _max(T a, T b) { return a > b ? a : b; }
+#define constrain(a, l, h) ((a) < (l) ? (l) : ((a) > (h) ? (h) : (a)))
+
+class __FlashStringHelper;
+#define FPSTR(p) (reinterpret_cast<const __FlashStringHelper*>(p))
+#define F(s) FPSTR(PSTR(s))
+
+class String : public std::string
+{
+  public:
+
+    String() { }
+    String(const char* s) : std::string(s != nullptr ? s : "") { }
+    String(const __FlashStringHelper* s) : String((const char*)s) { }
+    String(const std::string& s) : std::string(s) { }
+    explicit String(char c) : std::string(1, c) { }
+    explicit String(int v, int base = DEC) { Format(base == HEX ? "%x" : "%d", v); }
+    explicit String(unsigned int v, int base = DEC) { Format(base == HEX ? "%x" : "%u", v); }
+    explicit String(long v, int base = DEC) { Format(base == HEX ? "%lx" : "%ld", v); }
+    explicit String(unsigned long v, int base = DEC) { Format(base == HEX ? "%lx" : "%lu", v); }
+    explicit String(unsigned char v, int base = DEC) : String((unsigned int)v, base) { }
+    explicit String(short v, int base = DEC) : String((int)v, base) { }
+    explicit String(unsigned short v, int base = DEC) : String((unsigned int)v, base) { }
+    explicit String(float v, unsigned int decimals = 2) { Format("%.*f", decimals, (double)v); }
+    explicit String(double v, unsigned int decimals = 2) { Format("%.*f", decimals, v); }
+
+    unsigned int length() const { return size(); }
+    bool isEmpty() const { return empty(); }
+    bool reserve(unsigned int size) { std::string::reserve(size); return true; }
+
+    bool equals(const char* s) const { return compare(s) == 0; }
+    bool equals(const String& s) const { return compare(s) == 0; }
+    bool startsWith(const char* s) const { return rfind(s, 0) == 0; }
+    bool startsWith(const String& s) const { return rfind(s, 0) == 0; }
+    bool endsWith(const char* s) const
+    {
+        size_t n = strlen(s);
+        return size() >= n && compare(size() - n, n, s) == 0;
+    } // endsWith
+    bool endsWith(const String& s) const { return endsWith(s.c_str()); }
+
+    int indexOf(char c, unsigned int from = 0) const { return ToIndex(find(c, from)); }
+    int indexOf(const char* s, unsigned int from = 0) const { return ToIndex(find(s, from)); }
+    int indexOf(const String& s, unsigned int from = 0) const { return ToIndex(find(s, from)); }
+    int lastIndexOf(char c) const { return ToIndex(rfind(c)); }
+
+    String substring(unsigned int from) const { return from < size() ? String(substr(from)) : String(); }
+    String substring(unsigned int from, unsigned int to) const
+    {
+        if (to > size()) to = size();
+        return from < to ? String(substr(from, to - from)) : String();
+    } // substring
+
+    void replace(char from, char to) { std::replace(begin(), end(), from, to); }
+    void replace(const String& from, const String& to)
+    {
+        if (from.empty()) return;
+        for (size_t at = 0; (at = find(from, at)) != npos; at += to.size()) std::string::replace(at, from.size(), to);
+    } // replace
+    void remove(unsigned int index) { if (index < size()) erase(index); }
+    void remove(unsigned int index, unsigned int count) { if (index < size()) erase(index, count); }
+    void toUpperCase() { for (char& c : *this) c = toupper((unsigned char)c); }
+    void toLowerCase() { for (char& c : *this) c = tolower((unsigned char)c); }
+    void trim()
+    {
+        size_t first = find_first_not_of(" \t\r\n");
+        if (first == npos) { clear(); return; }
+        *this = substr(first, find_last_not_of(" \t\r\n") - first + 1);
+    } // trim
+
+    long toInt() const { return atol(c_str()); }
+    float toFloat() const { return atof(c_str()); }
+
+    String& operator+=(const String& s) { append(s); return *this; }
+    String& operator+=(const char* s) { append(s != nullptr ? s : ""); return *this; }
+    String& operator+=(char c) { push_back(c); return *this; }
+    String& operator+=(int v) { return *this += String(v); }
+    String& operator+=(unsigned int v) { return *this += String(v); }
+    String& operator+=(long v) { return *this += String(v); }
+    String& operator+=(unsigned long v) { return *this += String(v); }
+
+  private:
+
+    static int ToIndex(size_t at) { return at == npos ? -1 : (int)at; }
+
+    template <class... Args> void Format(const char* format, Args... args)
+    {
+        char buf[40];
+        snprintf(buf, sizeof(buf), format, args...);
+        assign(buf);
+    } // Format
+}; // class String
+
+inline String operator+(const String& a, const String& b) { String s(a); s += b; return s; }
+inline String operator+(const String& a, const char* b) { String s(a); s += b; return s; }
+inline String operator+(const char* a, const String& b) { String s(a); s += b; return s; }
+inline String operator+(const String& a, char b) { String s(a); s += b; return s; }
+
+class Print
+{
+  public:
+
+    virtual ~Print() { }
+
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buf, size_t size)
+    {
+        size_t n = 0;
+        while (size-- > 0 && write(*buf++) == 1) n++;
+        return n;
+    } // write
+    size_t write(const char* s) { return s == nullptr ? 0 : write((const uint8_t*)s, strlen(s)); }
+    size_t write(const char* buf, size_t size) { return write((const uint8_t*)buf, size); }
+
+    virtual int availableForWrite() { return 0; }
+    virtual void flush() { }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+    size_t printf_P(PGM_P format, ...) __attribute__((format(printf, 2, 3)));
+
+    size_t print(const __FlashStringHelper* s) { return write((const char*)s); }
+    size_t print(const String& s) { return write((const uint8_t*)s.c_str(), s.length()); }
+    size_t print(const char* s) { return write(s); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(unsigned char v, int base = DEC) { return print((unsigned long)v, base); }
+    size_t print(int v, int base = DEC) { return print((long)v, base); }
+    size_t print(unsigned int v, int base = DEC) { return print((unsigned long)v, base); }
+    size_t print(long v, int base = DEC) { return print(String(v, base)); }
+    size_t print(unsigned long v, int base = DEC) { return print(String(v, base)); }
+    size_t print(double v, int decimals = 2) { return print(String(v, (unsigned int)decimals)); }
+    size_t print(const class Printable& p);
+
+    size_t println() { return write("\r\n"); }
+    template <class T> size_t println(const T& v) { return print(v) + println(); }
+    template <class T> size_t println(const T& v, int base) { return print(v, base) + println(); }
+}; // class Print
+
+class Printable
+{
+  public:
+
+    virtual ~Printable() { }
+    virtual size_t printTo(Print& p) const = 0;
+}; // class Printable
+
+inline size_t Print::print(const Printable& p) { return p.printTo(*this); }
+
+class IPAddress : public Printable
+{
+  public:
+
+    IPAddress() { }
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : address((uint32_t)d << 24 | c << 16 | b << 8 | a) { }
+    IPAddress(uint32_t a) : address(a) { }
+
+    bool fromString(const char* s)
+    {
+        unsigned int a, b, c, d;
+        if (sscanf(s, "%u.%u.%u.%u", &a, &b, &c, &d) != 4) return false;
+        *this = IPAddress(a, b, c, d);
+        return true;
+    } // fromString
+
+    operator uint32_t() const { return address; }
+    bool operator==(const IPAddress& other) const { return address == other.address; }
+    bool operator!=(const IPAddress& other) const { return address != other.address; }
+    uint8_t operator[](int i) const { return address >> (8 * i) & 0xFF; }
+
+    String toString() const
+    {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+        return buf;
+    } // toString
+
+    size_t printTo(Print& p) const override { return p.print(toString()); }
+
+  private:
+
+    uint32_t address = 0;
+}; // class IPAddress
+
+// Serial port: written to stdout if selected (see Host.h), otherwise discarded
+class HardwareSerial : public Print
+{
+  public:
+
+    void begin(unsigned long) { }
+    void setDebugOutput(bool) { }
+    int available() { return 0; }
+    int read() { return -1; }
+    int availableForWrite() override { return 128; }
+    operator bool() const { return true; }
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buf, size_t size) override;
+    using Print::write;
+}; // class HardwareSerial
+
+extern HardwareSerial Serial;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+#define INPUT 0x00
+#define INPUT_PULLUP 0x02
+#define OUTPUT 0x01
+#define LOW 0x0
+#define HIGH 0x1
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+#define D0 (16)
+#define D1 (5)
+#define D2 (4)
+#define D3 (0)
+#define D4 (2)
+#define D5 (14)
+#define D6 (12)
+#define D7 (13)
+#define D8 (15)
+#define LED_BUILTIN (2)
+
+inline void pinMode(uint8_t, uint8_t) { }
+inline void digitalWrite(uint8_t, uint8_t) { }
+inline int digitalRead(uint8_t) { return HIGH; }
+inline int digitalPinToInterrupt(int pin) { return pin; }
+inline void attachInterrupt(uint8_t, std::function<void()>, int) { }
+inline void detachInterrupt(uint8_t) { }
+inline void noInterrupts() { }
+inline void interrupts() { }
+
+char* dtostrf(double number, signed char width, unsigned char prec, char* s);
+
+uint32_t system_get_free_heap_size();
+
+// The FreeRTOS task API, as far as the sketch uses it with VAN_RX_PARSE_TASK; a task is a thread, and the
+// scheduling options (stack depth, priority, core) are ignored
+#define ARDUINO_RUNNING_CORE (1)
+#define CONFIG_FREERTOS_UNICORE (0)
+typedef void (*TaskFunction_t)(void*);
+typedef void* TaskHandle_t;
+int xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stackDepth, void* param,
+    unsigned int priority, TaskHandle_t* handle, int core);
+void vTaskDelay(uint32_t ticks);  // One tick is one millisecond
+
+#include "Esp.h"
+
+#endif // Arduino_h
@@ -0,0 +1,40 @@
+#ifndef ArduinoOTA_h
+#define ArduinoOTA_h
+
+// Host build: no OTA updates arrive
+
+#include <Arduino.h>
+
+#define U_FLASH (0)
+#define U_FS (100)
+
+typedef enum
+{
+    OTA_AUTH_ERROR,
+    OTA_BEGIN_ERROR,
+    OTA_CONNECT_ERROR,
+    OTA_RECEIVE_ERROR,
+    OTA_END_ERROR
+} ota_error_t;
+
+class ArduinoOTAClass
+{
+  public:
+
+    void setPort(uint16_t) { }
+    void setHostname(const char*) { }
+    void setPassword(const char*) { }
+    void setPasswordHash(const char*) { }
+    void setRebootOnSuccess(bool) { }
+    int getCommand() { return U_FLASH; }
+    void onStart(std::function<void()>) { }
+    void onEnd(std::function<void()>) { }
+    void onProgress(std::function<void(unsigned int, unsigned int)>) { }
+    void onError(std::function<void(ota_error_t)>) { }
+    void begin(bool = true) { }
+    void handle() { }
+}; // class ArduinoOTAClass
+
+extern ArduinoOTAClass ArduinoOTA;
+
+#endif // ArduinoOTA_h
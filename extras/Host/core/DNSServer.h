@@ -0,0 +1,17 @@
+#ifndef DNSServer_h
+#define DNSServer_h
+
+// Host build: no DNS requests arrive
+
+#include <Arduino.h>
+
+class DNSServer
+{
+  public:
+
+    bool start(uint16_t, const char*, const IPAddress&) { return true; }
+    void processNextRequest() { }
+    void stop() { }
+}; // class DNSServer
+
+#endif // DNSServer_h
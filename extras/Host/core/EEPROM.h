@@ -0,0 +1,26 @@
+#ifndef EEPROM_h
+#define EEPROM_h
+
+// Host build: an erased EEPROM, kept in host memory
+
+#include <Arduino.h>
+
+class EEPROMClass
+{
+  public:
+
+    void begin(size_t size) { data.assign(size, 0xFF); }
+    uint8_t read(int address) { return address >= 0 && (size_t)address < data.size() ? data[address] : 0xFF; }
+    void write(int address, uint8_t value) { if (address >= 0 && (size_t)address < data.size()) data[address] = value; }
+    bool commit() { return true; }
+    bool end() { return true; }
+    size_t length() { return data.size(); }
+
+  private:
+
+    std::basic_string<uint8_t> data;
+}; // class EEPROMClass
+
+extern EEPROMClass EEPROM;
+
+#endif // EEPROM_h
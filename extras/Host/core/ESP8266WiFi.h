@@ -0,0 +1,77 @@
+#ifndef ESP8266WiFi_h
+#define ESP8266WiFi_h
+
+// Host build: Wi-Fi is not simulated; the access point is always up and has no stations
+
+#include <Arduino.h>
+
+enum WiFiMode_t { WIFI_OFF, WIFI_STA, WIFI_AP, WIFI_AP_STA };
+enum WiFiPhyMode_t { WIFI_PHY_MODE_11B = 1, WIFI_PHY_MODE_11G = 2, WIFI_PHY_MODE_11N = 3 };
+enum WiFiSleepType_t { WIFI_NONE_SLEEP, WIFI_LIGHT_SLEEP, WIFI_MODEM_SLEEP };
+enum wl_status_t { WL_IDLE_STATUS = 0, WL_CONNECTED = 3, WL_DISCONNECTED = 6 };
+
+enum { AUTH_OPEN, AUTH_WEP, AUTH_WPA_PSK, AUTH_WPA2_PSK, AUTH_WPA_WPA2_PSK, AUTH_MAX };
+
+struct WiFiEventSoftAPModeStationConnected { uint8_t mac[6]; uint8_t aid; };
+struct WiFiEventSoftAPModeStationDisconnected { uint8_t mac[6]; uint8_t aid; };
+struct WiFiEventSoftAPModeProbeRequestReceived { int rssi; uint8_t mac[6]; };
+
+typedef std::shared_ptr<void> WiFiEventHandler;
+
+struct softap_config
+{
+    uint8_t ssid[32];
+    uint8_t password[64];
+    uint8_t ssid_len;
+    uint8_t channel;
+    int authmode;
+    uint8_t ssid_hidden;
+    uint8_t max_connection;
+    uint16_t beacon_interval;
+}; // struct softap_config
+
+bool wifi_softap_get_config(softap_config* config);
+
+class ESP8266WiFiClass
+{
+  public:
+
+    bool mode(WiFiMode_t m) { wifiMode = m; return true; }
+    WiFiMode_t getMode() { return wifiMode; }
+    bool forceSleepBegin(uint32_t = 0) { return true; }
+    bool forceSleepWake() { return true; }
+    void persistent(bool) { }
+    bool hostname(const char*) { return true; }
+    bool setPhyMode(WiFiPhyMode_t) { return true; }
+    void setOutputPower(float) { }
+    bool setSleepMode(WiFiSleepType_t, uint8_t = 0) { return true; }
+    bool setAutoConnect(bool) { return true; }
+    bool setAutoReconnect(bool) { return true; }
+
+    bool softAPConfig(IPAddress, IPAddress, IPAddress) { return true; }
+    bool softAP(const char*, const char* = nullptr, int = 1, int = 0, int = 4) { wifiMode = WIFI_AP; return true; }
+    uint8_t softAPgetStationNum() { return 0; }
+    IPAddress softAPIP() { return IPAddress(192, 168, 4, 1); }
+
+    bool config(IPAddress, IPAddress, IPAddress) { return true; }
+    wl_status_t begin(const char*, const char* = nullptr) { return WL_CONNECTED; }
+    bool disconnect(bool = false) { return true; }
+    wl_status_t status() { return WL_CONNECTED; }
+    IPAddress localIP() { return IPAddress(192, 168, 4, 1); }
+    int8_t RSSI() { return -50; }
+    int32_t channel() { return 1; }
+    String macAddress() { return "02:00:00:00:00:01"; }
+    String SSID() { return "host"; }
+
+    template <class Handler> WiFiEventHandler onSoftAPModeStationConnected(Handler) { return nullptr; }
+    template <class Handler> WiFiEventHandler onSoftAPModeStationDisconnected(Handler) { return nullptr; }
+    template <class Handler> WiFiEventHandler onSoftAPModeProbeRequestReceived(Handler) { return nullptr; }
+
+  private:
+
+    WiFiMode_t wifiMode = WIFI_OFF;
+}; // class ESP8266WiFiClass
+
+extern ESP8266WiFiClass WiFi;
+
+#endif // ESP8266WiFi_h
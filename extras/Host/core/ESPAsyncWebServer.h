@@ -0,0 +1,314 @@
+#ifndef ESPAsyncWebServer_h
+#define ESPAsyncWebServer_h
+
+// Host build: the part of the ESP32Async "ESPAsyncWebServer" library that the sketch uses. There is no network: the
+// host program plays the part of the clients, e.g. connects a WebSocket client with AsyncWebSocket::HostConnect()
+// and requests a page with AsyncWebServer::HostRequest(). Events are delivered on the calling thread.
+
+#include <Arduino.h>
+#include <FS.h>
+
+#include <list>
+#include <map>
+#include <vector>
+
+#define ASYNCWEBSERVER_FORK_ESP32Async
+
+#define WS_MAX_QUEUED_MESSAGES (32)
+
+namespace asyncsrv {
+static const char T_text_html[] = "text/html";
+static const char T_text_css[] = "text/css";
+static const char T_text_javascript[] = "text/javascript";
+static const char T_text_plain[] = "text/plain";
+static const char T_application_json[] = "application/json";
+static const char T_application_octet_stream[] = "application/octet-stream";
+static const char T_font_woff[] = "font/woff";
+static const char T_image_x_icon[] = "image/x-icon";
+static const char T_image_jpeg[] = "image/jpeg";
+static const char T_image_png[] = "image/png";
+} // namespace asyncsrv
+
+enum WebRequestMethod { HTTP_GET = 0b00000001, HTTP_POST = 0b00000010, HTTP_ANY = 0b01111111 };
+
+class AsyncClient
+{
+  public:
+
+    AsyncClient(IPAddress ip = IPAddress()) : ip(ip) { }
+
+    IPAddress remoteIP() const { return ip; }
+    uint16_t remotePort() const { return 50000; }
+    void setNoDelay(bool) { }
+    void setAckTimeout(uint32_t) { }
+    void setRxTimeout(uint32_t) { }
+    void close(bool = false) { }
+
+  private:
+
+    IPAddress ip;
+}; // class AsyncClient
+
+// ---- HTTP
+
+typedef std::function<size_t(uint8_t* buffer, size_t maxLen, size_t index)> AwsResponseFiller;
+
+class AsyncWebServerResponse
+{
+  public:
+
+    AsyncWebServerResponse(int _code, const String& _contentType, const String& _content = String()) :
+        code(_code), contentType(_contentType), content(_content)
+    { }
+
+    void addHeader(const String& name, const String& value, bool replace = true)
+    {
+        if (replace) headers.erase(name);
+        headers.insert(std::make_pair(name, value));
+    } // addHeader
+    void setCode(int _code) { code = _code; }
+    void setContentType(const String& type) { contentType = type; }
+
+    // Host program: the response code, headers and body
+    int code;
+    String contentType;
+    String content;
+    std::multimap<String, String> headers;
+    AwsResponseFiller filler;  // Chunked response
+}; // class AsyncWebServerResponse
+
+class AsyncWebServerRequest
+{
+  public:
+
+    AsyncWebServerRequest(const String& _url, IPAddress ip = IPAddress(192, 168, 4, 2)) : url_(_url), tcp(ip) { }
+    ~AsyncWebServerRequest()
+    {
+        if (onDisconnectHandler) onDisconnectHandler();
+        delete response;
+    } // ~AsyncWebServerRequest
+
+    AsyncClient* client() { return &tcp; }
+    const String& url() const { return url_; }
+    String host() const { return "192.168.4.1"; }
+    WebRequestMethod method() const { return HTTP_GET; }
+    const char* methodToString() const { return "GET"; }
+
+    size_t args() const { return arguments.size(); }
+    const String& argName(size_t i) const { return arguments[i].first; }
+    const String& arg(size_t i) const { return arguments[i].second; }
+    bool hasArg(const char* name) const;
+    String arg(const char* name) const;
+
+    size_t headers() const { return headerList.size(); }
+    String headerName(size_t i) const { return i < headerList.size() ? headerList[i].first : String(); }
+    String header(size_t i) const { return i < headerList.size() ? headerList[i].second : String(); }
+    bool hasHeader(const char* name) const;
+    bool hasHeader(const __FlashStringHelper* name) const { return hasHeader((const char*)name); }
+    String header(const char* name) const;
+
+    void onDisconnect(std::function<void()> fn) { onDisconnectHandler = fn; }
+
+    AsyncWebServerResponse* beginResponse(int code, const String& contentType = String(),
+        const String& content = String())
+    {
+        return new AsyncWebServerResponse(code, contentType, content);
+    } // beginResponse
+    AsyncWebServerResponse* beginResponse(int code, const String& contentType, const uint8_t* content, size_t len)
+    {
+        return new AsyncWebServerResponse(code, contentType, std::string((const char*)content, len));
+    } // beginResponse
+    AsyncWebServerResponse* beginResponse(fs::FS& fs, const String& path, const String& contentType = String());
+    AsyncWebServerResponse* beginResponse_P(int code, const String& contentType, PGM_P content)
+    {
+        return beginResponse(code, contentType, String(content));
+    } // beginResponse_P
+    AsyncWebServerResponse* beginChunkedResponse(const String& contentType, AwsResponseFiller filler)
+    {
+        AsyncWebServerResponse* r = new AsyncWebServerResponse(200, contentType);
+        r->filler = filler;
+        return r;
+    } // beginChunkedResponse
+
+    void send(AsyncWebServerResponse* r) { delete response; response = r; }
+    void send(int code, const String& contentType = String(), const String& content = String())
+    {
+        send(beginResponse(code, contentType, content));
+    } // send
+    void send(int code, const String& contentType, const uint8_t* content, size_t len)
+    {
+        send(beginResponse(code, contentType, content, len));
+    } // send
+    void send(fs::FS& fs, const String& contentType, const String& path)
+    {
+        send(beginResponse(fs, path, contentType));
+    } // send
+    void send_P(int code, const String& contentType, const uint8_t* content, size_t len)
+    {
+        send(code, contentType, content, len);
+    } // send_P
+
+    // Host program: the request and its response
+    std::vector<std::pair<String, String>> arguments;
+    std::vector<std::pair<String, String>> headerList;
+    AsyncWebServerResponse* response = nullptr;
+
+  private:
+
+    String url_;
+    AsyncClient tcp;
+    std::function<void()> onDisconnectHandler;
+}; // class AsyncWebServerRequest
+
+typedef std::function<void(AsyncWebServerRequest* request)> ArRequestHandlerFunction;
+
+class AsyncWebHandler
+{
+  public:
+
+    virtual ~AsyncWebHandler() { }
+}; // class AsyncWebHandler
+
+class AsyncWebServer
+{
+  public:
+
+    AsyncWebServer(uint16_t) { }
+
+    AsyncWebHandler& on(const char* uri, ArRequestHandlerFunction fn)
+    {
+        handlers[uri] = fn;
+        return dummyHandler;
+    } // on
+    AsyncWebHandler& on(const char* uri, WebRequestMethod, ArRequestHandlerFunction fn) { return on(uri, fn); }
+    void onNotFound(ArRequestHandlerFunction fn) { notFoundHandler = fn; }
+    AsyncWebHandler& addHandler(AsyncWebHandler* handler) { return *handler; }
+    void begin() { }
+    void reset() { handlers.clear(); }
+
+    // Host program: handle a request. The request is complete when the response (if any) is read out; for a
+    // chunked response, the filler is called until it returns 0, 'chunkSize' bytes at a time.
+    void HostRequest(AsyncWebServerRequest* request);
+    static String HostReadResponse(AsyncWebServerRequest* request, size_t chunkSize = 1460);
+
+  private:
+
+    std::map<String, ArRequestHandlerFunction> handlers;
+    ArRequestHandlerFunction notFoundHandler;
+    AsyncWebHandler dummyHandler;
+}; // class AsyncWebServer
+
+// ---- WebSocket
+
+enum AwsEventType { WS_EVT_CONNECT, WS_EVT_DISCONNECT, WS_EVT_PING, WS_EVT_PONG, WS_EVT_ERROR, WS_EVT_DATA };
+enum AwsClientStatus { WS_DISCONNECTED, WS_CONNECTED, WS_DISCONNECTING };
+enum AwsFrameType { WS_CONTINUATION, WS_TEXT, WS_BINARY, WS_DISCONNECT = 0x08, WS_PING, WS_PONG };
+
+struct AwsFrameInfo
+{
+    uint8_t message_opcode;
+    uint32_t num;
+    uint8_t final;
+    uint8_t masked;
+    uint8_t opcode;
+    uint64_t len;
+    uint8_t mask[4];
+    uint64_t index;
+}; // struct AwsFrameInfo
+
+class AsyncWebSocket;
+
+class AsyncWebSocketClient
+{
+  public:
+
+    AsyncWebSocketClient(AsyncWebSocket* _server, uint32_t _id, IPAddress ip) : owner(_server), clientId(_id), tcp(ip)
+    { }
+
+    uint32_t id() const { return clientId; }
+    IPAddress remoteIP() const { return tcp.remoteIP(); }
+    AwsClientStatus status() const { return clientStatus; }
+    AsyncClient* client() { return &tcp; }
+    AsyncWebSocket* server() { return owner; }
+    bool queueIsFull() const { return _messageQueue.size() >= WS_MAX_QUEUED_MESSAGES; }
+    size_t queueLen() const { return _messageQueue.size(); }
+    bool canSend() const { return ! queueIsFull(); }
+
+    void text(const char* message, size_t len);
+    void text(const char* message) { text(message, strlen(message)); }
+    void binary(const uint8_t* message, size_t len);
+    void close(uint16_t = 0, const char* = nullptr);
+    void _runQueue() { }
+
+    // Messages not yet delivered; the host program delivers them with AsyncWebSocket::HostDeliver()
+    std::list<std::pair<std::string, bool>> _messageQueue;  // Message, is binary
+
+    // Host program: called for each delivered message
+    std::function<void(const std::string& message, bool isBinary)> onMessage;
+
+    // Host program: statistics
+    uint32_t nTextFrames = 0;
+    uint32_t nBinaryFrames = 0;
+    uint64_t nBytes = 0;
+
+  private:
+
+    friend class AsyncWebSocket;
+
+    AsyncWebSocket* owner;
+    uint32_t clientId;
+    AsyncClient tcp;
+    AwsClientStatus clientStatus = WS_CONNECTED;
+}; // class AsyncWebSocketClient
+
+typedef std::function<void(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg,
+    uint8_t* data, size_t len)> AwsEventHandler;
+
+class AsyncWebSocket : public AsyncWebHandler
+{
+  public:
+
+    AsyncWebSocket(const char* _url) : url(_url) { }
+
+    void onEvent(AwsEventHandler handler) { eventHandler = handler; }
+
+    size_t count() const;
+    bool hasClient(uint32_t id) { return client(id) != nullptr; }
+    AsyncWebSocketClient* client(uint32_t id);
+    std::list<AsyncWebSocketClient>& getClients() { return clients; }
+
+    bool availableForWrite(uint32_t id);
+    bool availableForWriteAll();
+    void text(uint32_t id, const char* message, size_t len);
+    void text(uint32_t id, const char* message) { text(id, message, strlen(message)); }
+    void textAll(const char* message, size_t len);
+    void textAll(const char* message) { textAll(message, strlen(message)); }
+    void binary(uint32_t id, const uint8_t* message, size_t len);
+    void binary(uint32_t id, const char* message, size_t len) { binary(id, (const uint8_t*)message, len); }
+    void close(uint32_t id, uint16_t = 0, const char* = nullptr);
+    void closeAll(uint16_t = 0, const char* = nullptr);
+    void cleanupClients(uint16_t = 0);
+
+    // Host program: play the part of the clients
+    AsyncWebSocketClient* HostConnect(IPAddress ip);
+    void HostReceiveText(uint32_t id, const char* message);
+    void HostDisconnect(uint32_t id);
+
+    // Host program: deliver the queued messages of all clients; returns the number delivered. If 'queueMessages'
+    // is false (the default), messages are delivered as soon as they are sent.
+    int HostDeliver();
+    bool queueMessages = false;
+
+  private:
+
+    friend class AsyncWebSocketClient;
+
+    void Deliver(AsyncWebSocketClient& c, const std::string& message, bool isBinary);
+
+    const char* url;
+    AwsEventHandler eventHandler;
+    std::list<AsyncWebSocketClient> clients;
+    uint32_t nextId = 1;
+}; // class AsyncWebSocket
+
+#endif // ESPAsyncWebServer_h
@@ -0,0 +1,82 @@
+#ifndef Esp_h
+#define Esp_h
+
+// Host build: the ESP8266 "ESP" object. Flash and RTC user memory are kept in host memory (see Host.cpp).
+
+#define SPI_FLASH_SEC_SIZE (4096)
+#define CPU_F_FACTOR (2)
+#define ARDUINO_ESP8266_RELEASE "host"
+#define LWIP_VERSION_STRING "host"
+
+enum FlashMode_t { FM_QIO, FM_QOUT, FM_DIO, FM_DOUT, FM_UNKNOWN };
+
+enum rst_reason
+{
+    REASON_DEFAULT_RST,
+    REASON_WDT_RST,
+    REASON_EXCEPTION_RST,
+    REASON_SOFT_WDT_RST,
+    REASON_SOFT_RESTART,
+    REASON_DEEP_SLEEP_AWAKE,
+    REASON_EXT_SYS_RST
+}; // enum rst_reason
+
+struct rst_info
+{
+    uint32_t reason;
+    uint32_t exccause;
+    uint32_t epc1;
+    uint32_t epc2;
+    uint32_t epc3;
+    uint32_t excvaddr;
+    uint32_t depc;
+}; // struct rst_info
+
+class EspClass
+{
+  public:
+
+    void restart();
+    void wdtFeed() { }
+
+    uint32_t getCpuFreqMHz() { return 160; }
+    uint32_t getCycleCount() { return micros() * getCpuFreqMHz(); }
+    uint32_t getChipId() { return 0x00C0FFEE; }
+    uint8_t getBootVersion() { return 0; }
+    const char* getSdkVersion() { return "host"; }
+    String getCoreVersion() { return "host"; }
+    String getFullVersion() { return "host"; }
+    String getSketchMD5() { return "00000000000000000000000000000000"; }
+    uint32_t getSketchSize() { return 0; }
+    uint32_t getFreeSketchSpace() { return 0; }
+
+    String getResetReason() { return "Power On"; }
+    rst_info* getResetInfoPtr() { return &resetInfo; }
+
+    uint32_t getFreeHeap() { return system_get_free_heap_size(); }
+    uint32_t getMaxFreeBlockSize() { return system_get_free_heap_size(); }
+    uint8_t getHeapFragmentation() { return 0; }
+
+    uint32_t getFlashChipId() { return 0x1640EF; }
+    uint32_t getFlashChipSize() { return 4 * 1024 * 1024; }
+    uint32_t getFlashChipRealSize() { return 4 * 1024 * 1024; }
+    uint32_t getFlashChipSpeed() { return 40000000; }
+    FlashMode_t getFlashChipMode() { return FM_DIO; }
+
+    bool flashEraseSector(uint32_t sector);
+    bool flashWrite(uint32_t address, const uint32_t* data, size_t size);
+    bool flashWrite(uint32_t address, const uint8_t* data, size_t size);
+    bool flashRead(uint32_t address, uint32_t* data, size_t size);
+    bool flashRead(uint32_t address, uint8_t* data, size_t size);
+
+    bool rtcUserMemoryRead(uint32_t offset, uint32_t* data, size_t size);
+    bool rtcUserMemoryWrite(uint32_t offset, uint32_t* data, size_t size);
+
+  private:
+
+    rst_info resetInfo = { REASON_DEFAULT_RST, 0, 0, 0, 0, 0, 0 };
+}; // class EspClass
+
+extern EspClass ESP;
+
+#endif // Esp_h
@@ -0,0 +1,125 @@
+#ifndef FS_h
+#define FS_h
+
+// Host build: the ESP8266 file system API, backed by a directory on the host (see HostSetFileSystemRoot in Host.h)
+
+#include <Arduino.h>
+
+#include <vector>
+
+namespace fs {
+
+class File : public Print
+{
+  public:
+
+    File() { }
+    File(const std::string& _path, const std::string& _name, FILE* _file) :
+        path(_path), fileName(_name), file(_file, fclose)
+    { }
+
+    operator bool() const { return file != nullptr; }
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buf, size_t size) override
+    {
+        return file != nullptr ? fwrite(buf, 1, size, file.get()) : 0;
+    } // write
+    using Print::write;
+
+    int available();
+    int read();
+    size_t read(uint8_t* buf, size_t size) { return file != nullptr ? fread(buf, 1, size, file.get()) : 0; }
+    int peek();
+    bool seek(uint32_t pos) { return file != nullptr && fseek(file.get(), pos, SEEK_SET) == 0; }
+    size_t position() const { return file != nullptr ? ftell(file.get()) : 0; }
+    size_t size() const;
+    String readStringUntil(char terminator);
+    void flush() override { if (file != nullptr) fflush(file.get()); }
+    void close() { file.reset(); }
+
+    const char* name() const { return fileName.c_str(); }
+    const char* fullName() const { return path.c_str(); }
+    time_t getLastWrite() const;
+
+  private:
+
+    std::string path;
+    std::string fileName;
+    std::shared_ptr<FILE> file;
+}; // class File
+
+class Dir
+{
+  public:
+
+    Dir() { }
+    Dir(const std::string& _path) : path(_path) { }
+
+    bool next();
+    String fileName() const { return entries.empty() ? String() : String(entries.back()); }
+    size_t fileSize() const;
+    File openFile(const char* mode) const;
+
+  private:
+
+    std::string path;
+    std::vector<std::string> entries;
+    bool isRead = false;
+}; // class Dir
+
+struct FSInfo
+{
+    size_t totalBytes;
+    size_t usedBytes;
+    size_t blockSize;
+    size_t pageSize;
+    size_t maxOpenFiles;
+    size_t maxPathLength;
+}; // struct FSInfo
+
+class FS
+{
+  public:
+
+    bool begin() { return true; }
+    void end() { }
+    bool format();
+    bool info(FSInfo& info);
+
+    File open(const char* path, const char* mode = "r");
+    File open(const String& path, const char* mode = "r") { return open(path.c_str(), mode); }
+    Dir openDir(const char* path);
+    bool exists(const char* path);
+    bool exists(const String& path) { return exists(path.c_str()); }
+    bool remove(const char* path);
+    bool remove(const String& path) { return remove(path.c_str()); }
+    bool rename(const char* from, const char* to);
+}; // class FS
+
+} // namespace fs
+
+using fs::File;
+using fs::Dir;
+using fs::FSInfo;
+
+extern fs::FS LittleFS;
+extern fs::FS SPIFFS;
+
+// Not a real MD5: a 128-bit content hash of the same format, which is all the sketch needs (an ETag)
+class MD5Builder
+{
+  public:
+
+    void begin() { hash[0] = 0xCBF29CE484222325ULL; hash[1] = 0x84222325CBF29CE4ULL; }
+    void add(const uint8_t* data, size_t len);
+    bool addStream(fs::File& stream, size_t maxLen);
+    void calculate() { }
+    String toString() const;
+
+  private:
+
+    uint64_t hash[2];
+}; // class MD5Builder
+
+#endif // FS_h
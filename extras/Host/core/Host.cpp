@@ -0,0 +1,772 @@
+// Host build: implementation of the host core (see Arduino.h)
+
+#include <Arduino.h>
+#include <ArduinoOTA.h>
+#include <EEPROM.h>
+#include <ESP8266WiFi.h>
+#include <ESPAsyncWebServer.h>
+#include <FS.h>
+#include <TimeLib.h>
+#include <VanBusRx.h>
+
+#include "Host.h"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <thread>
+
+#include <sys/stat.h>
+
+bool hostRealTime = false;
+bool hostSerialEcho = false;
+uint32_t hostWebSocketSendMicros = 0;
+
+HardwareSerial Serial;
+EspClass ESP;
+ESP8266WiFiClass WiFi;
+ArduinoOTAClass ArduinoOTA;
+EEPROMClass EEPROM;
+TVanBusRx VanBusRx;
+fs::FS LittleFS;
+fs::FS SPIFFS;
+
+// The sketch derives the flash address of its settings from the address of this symbol (see Settings.ino)
+extern "C" { uint32_t _EEPROM_start = 0; }
+
+// ---- Time
+
+static std::atomic<uint64_t> virtualMicros(0);
+
+static uint64_t RealMicros()
+{
+    static const auto start = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+} // RealMicros
+
+unsigned long micros()
+{
+    return hostRealTime ? RealMicros() : virtualMicros++;
+} // micros
+
+unsigned long millis()
+{
+    return (hostRealTime ? RealMicros() : virtualMicros.load()) / 1000;
+} // millis
+
+void delay(unsigned long ms)
+{
+    if (hostRealTime) std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    else virtualMicros += ms * 1000;
+} // delay
+
+void delayMicroseconds(unsigned int us)
+{
+    HostSpend(us);
+} // delayMicroseconds
+
+void yield()
+{
+    if (hostRealTime) std::this_thread::yield();
+} // yield
+
+int xTaskCreatePinnedToCore(TaskFunction_t fn, const char*, uint32_t, void* param, unsigned int, TaskHandle_t*, int)
+{
+    std::thread(fn, param).detach();
+    return 1;
+} // xTaskCreatePinnedToCore
+
+void vTaskDelay(uint32_t ticks)
+{
+    delay(ticks);
+} // vTaskDelay
+
+void HostSpend(uint32_t us)
+{
+    if (! hostRealTime)
+    {
+        virtualMicros += us;
+        return;
+    } // if
+
+    uint64_t until = RealMicros() + us;
+    while (RealMicros() < until) { }
+} // HostSpend
+
+uint64_t HostCpuMicros()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+} // HostCpuMicros
+
+static time_t timeBase = 0;
+static unsigned long millisAtTimeBase = 0;
+
+time_t now()
+{
+    return timeBase + (millis() - millisAtTimeBase) / 1000;
+} // now
+
+void setTime(time_t t)
+{
+    timeBase = t;
+    millisAtTimeBase = millis();
+} // setTime
+
+static struct tm ToTm(time_t t)
+{
+    struct tm result;
+    gmtime_r(&t, &result);
+    return result;
+} // ToTm
+
+int hour(time_t t) { return ToTm(t).tm_hour; }
+int minute(time_t t) { return ToTm(t).tm_min; }
+int second(time_t t) { return ToTm(t).tm_sec; }
+int day(time_t t) { return ToTm(t).tm_mday; }
+int weekday(time_t t) { return ToTm(t).tm_wday + 1; }
+int month(time_t t) { return ToTm(t).tm_mon + 1; }
+int year(time_t t) { return ToTm(t).tm_year + 1900; }
+
+// ---- Print, serial port
+
+size_t Print::printf(const char* format, ...)
+{
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    if (len < 0) return 0;
+    if ((size_t)len < sizeof(buf)) return write((const uint8_t*)buf, len);
+
+    std::string big(len + 1, '\0');
+    va_start(args, format);
+    vsnprintf(&big[0], big.size(), format, args);
+    va_end(args);
+    return write((const uint8_t*)big.data(), len);
+} // Print::printf
+
+size_t Print::printf_P(PGM_P format, ...)
+{
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    if (len < 0) return 0;
+    if ((size_t)len < sizeof(buf)) return write((const uint8_t*)buf, len);
+
+    std::string big(len + 1, '\0');
+    va_start(args, format);
+    vsnprintf(&big[0], big.size(), format, args);
+    va_end(args);
+    return write((const uint8_t*)big.data(), len);
+} // Print::printf_P
+
+size_t HardwareSerial::write(const uint8_t* buf, size_t size)
+{
+    if (hostSerialEcho) fwrite(buf, 1, size, stdout);
+    return size;
+} // HardwareSerial::write
+
+char* dtostrf(double number, signed char width, unsigned char prec, char* s)
+{
+    sprintf(s, "%*.*f", width, prec, number);
+    return s;
+} // dtostrf
+
+uint32_t system_get_free_heap_size()
+{
+    return 30 * 1024;
+} // system_get_free_heap_size
+
+// ---- ESP: flash and RTC user memory
+
+static std::map<uint32_t, std::basic_string<uint8_t>> flashSectors;
+
+static std::basic_string<uint8_t>& FlashSector(uint32_t sector)
+{
+    auto it = flashSectors.find(sector);
+    if (it == flashSectors.end())
+    {
+        it = flashSectors.insert(std::make_pair(sector, std::basic_string<uint8_t>(SPI_FLASH_SEC_SIZE, 0xFF))).first;
+    } // if
+    return it->second;
+} // FlashSector
+
+void EspClass::restart()
+{
+    fprintf(stderr, "ESP.restart() called\n");
+    exit(EXIT_FAILURE);
+} // EspClass::restart
+
+bool EspClass::flashEraseSector(uint32_t sector)
+{
+    FlashSector(sector).assign(SPI_FLASH_SEC_SIZE, 0xFF);
+    return true;
+} // EspClass::flashEraseSector
+
+bool EspClass::flashWrite(uint32_t address, const uint8_t* data, size_t size)
+{
+    if (address % 4 != 0 || size % 4 != 0) return false;
+
+    // NOR flash: writing can only clear bits
+    for (size_t i = 0; i < size; i++)
+    {
+        FlashSector((address + i) / SPI_FLASH_SEC_SIZE)[(address + i) % SPI_FLASH_SEC_SIZE] &= data[i];
+    } // for
+    return true;
+} // EspClass::flashWrite
+
+bool EspClass::flashWrite(uint32_t address, const uint32_t* data, size_t size)
+{
+    return flashWrite(address, (const uint8_t*)data, size);
+} // EspClass::flashWrite
+
+bool EspClass::flashRead(uint32_t address, uint8_t* data, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        data[i] = FlashSector((address + i) / SPI_FLASH_SEC_SIZE)[(address + i) % SPI_FLASH_SEC_SIZE];
+    } // for
+    return true;
+} // EspClass::flashRead
+
+bool EspClass::flashRead(uint32_t address, uint32_t* data, size_t size)
+{
+    return flashRead(address, (uint8_t*)data, size);
+} // EspClass::flashRead
+
+static uint8_t rtcUserMemory[512];
+
+bool EspClass::rtcUserMemoryRead(uint32_t offset, uint32_t* data, size_t size)
+{
+    if (offset * 4 + size > sizeof(rtcUserMemory)) return false;
+    memcpy(data, rtcUserMemory + offset * 4, size);
+    return true;
+} // EspClass::rtcUserMemoryRead
+
+bool EspClass::rtcUserMemoryWrite(uint32_t offset, uint32_t* data, size_t size)
+{
+    if (offset * 4 + size > sizeof(rtcUserMemory)) return false;
+    memcpy(rtcUserMemory + offset * 4, data, size);
+    return true;
+} // EspClass::rtcUserMemoryWrite
+
+bool wifi_softap_get_config(softap_config* config)
+{
+    memset(config, 0, sizeof(*config));
+    return true;
+} // wifi_softap_get_config
+
+// ---- VanBus library
+
+char* FloatToStr(char* buffer, float f, int prec)
+{
+    snprintf(buffer, MAX_FLOAT_SIZE, "%.*f", prec, (double)f);
+    return buffer;
+} // FloatToStr
+
+uint16_t VanCrc(uint16_t iden, uint8_t commandFlags, const uint8_t* data, int dataLen)
+{
+    uint8_t bytes[2 + VAN_MAX_DATA_BYTES];
+    bytes[0] = iden >> 4;
+    bytes[1] = (iden & 0x0F) << 4 | (commandFlags & 0x0F);
+    memcpy(bytes + 2, data, dataLen);
+
+    uint16_t crc = 0x7FFF;
+    for (int i = 0; i < 2 + dataLen; i++)
+    {
+        for (int bit = 7; bit >= 0; bit--)
+        {
+            bool feedback = (crc >> 14 & 1) ^ (bytes[i] >> bit & 1);
+            crc = crc << 1 & 0x7FFF;
+            if (feedback) crc ^= 0x0F9D;
+        } // for
+    } // for
+
+    return (crc ^ 0x7FFF) << 1;
+} // VanCrc
+
+const char* TVanPacketRxDesc::CommandFlagsStr() const
+{
+    static char buf[12];
+    snprintf(buf, sizeof(buf), "%c%c%c%c",
+        commandFlags & 0x08 ? 'E' : '-',
+        commandFlags & 0x04 ? 'A' : '-',
+        commandFlags & 0x02 ? 'R' : 'W',
+        commandFlags & 0x01 ? 'T' : '-');
+    return buf;
+} // TVanPacketRxDesc::CommandFlagsStr
+
+void TVanPacketRxDesc::DumpRaw(Print& s, char last) const
+{
+    s.printf("Raw: #%04" PRIu32 " (%*u/%u) %2d(%2d) 0E %03X %1X (%s)", seqNo % 10000, 2, 0, 0, dataLen + 5,
+        dataLen, iden, commandFlags, CommandFlagsStr());
+    for (int i = 0; i < dataLen; i++) s.printf("%c%02X", i == 0 ? '-' : ' ', data[i]);
+    s.printf(":%04X %s%c", crc, crcOk ? "CRC_OK" : "CRC_ERROR", last);
+} // TVanPacketRxDesc::DumpRaw
+
+bool TVanBusRx::Setup(uint8_t, int queueSize)
+{
+    size = std::min(std::max(queueSize, 1), VAN_MAX_RX_QUEUE_SIZE);
+    return true;
+} // TVanBusRx::Setup
+
+int TVanBusRx::GetNQueued()
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    return nQueued;
+} // TVanBusRx::GetNQueued
+
+void TVanBusRx::SetDropPolicy(int threshold, TIsPacketSelected _isPacketSelected)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    dropThreshold = threshold;
+    isPacketSelected = _isPacketSelected;
+} // TVanBusRx::SetDropPolicy
+
+bool TVanBusRx::HostInject(uint16_t iden, uint8_t commandFlags, const uint8_t* data, int dataLen, bool crcOk)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    if (! enabled)
+    {
+        nHostMissedDisabled++;
+        return false;
+    } // if
+
+    if (nQueued >= size)
+    {
+        overrun = true;
+        nHostOverruns++;
+        return false;
+    } // if
+
+    TVanPacketRxDesc& pkt = pool[head];
+    pkt.iden = iden;
+    pkt.commandFlags = commandFlags;
+    pkt.dataLen = std::min(std::max(dataLen, 0), VAN_MAX_DATA_BYTES);
+    memcpy(pkt.data, data, pkt.dataLen);
+    pkt.crc = VanCrc(iden, commandFlags, data, pkt.dataLen);
+    pkt.crcOk = crcOk;
+    pkt.millis_ = millis();
+    pkt.seqNo = count;
+
+    if (nQueued >= dropThreshold && isPacketSelected != nullptr && ! isPacketSelected(pkt))
+    {
+        nHostDropped++;
+        return false;
+    } // if
+
+    count++;
+    if (! crcOk) nCorrupt++;
+
+    head = (head + 1) % size;
+    nQueued++;
+    if (nQueued > maxQueued) maxQueued = nQueued;
+    return true;
+} // TVanBusRx::HostInject
+
+bool TVanBusRx::Receive(TVanPacketRxDesc& pkt, bool* isQueueOverrun)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    if (isQueueOverrun != nullptr)
+    {
+        *isQueueOverrun = overrun;
+        overrun = false;
+    } // if
+
+    if (nQueued == 0) return false;
+
+    pkt = pool[tail];
+    tail = (tail + 1) % size;
+    nQueued--;
+    return true;
+} // TVanBusRx::Receive
+
+void TVanBusRx::DumpStats(Print& s, bool longForm)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    s.printf("received pkts: %" PRIu32 ", corrupt: %" PRIu32 ", overruns: %" PRIu32 ", dropped: %" PRIu32
+        ", max queued: %d/%d%s", count, nCorrupt, nHostOverruns, nHostDropped, maxQueued, size,
+        longForm ? "\n" : "");
+} // TVanBusRx::DumpStats
+
+// ---- File system
+
+static std::string fileSystemRoot = "HostFlashFs";
+
+void HostSetFileSystemRoot(const char* dir)
+{
+    fileSystemRoot = dir;
+    std::filesystem::create_directories(fileSystemRoot);
+} // HostSetFileSystemRoot
+
+static std::string HostPath(const char* path)
+{
+    return fileSystemRoot + (path[0] == '/' ? "" : "/") + path;
+} // HostPath
+
+namespace fs {
+
+int File::available()
+{
+    if (file == nullptr) return 0;
+    return (int)(size() - position());
+} // File::available
+
+int File::read()
+{
+    if (file == nullptr) return -1;
+    int c = fgetc(file.get());
+    return c == EOF ? -1 : c;
+} // File::read
+
+int File::peek()
+{
+    if (file == nullptr) return -1;
+    int c = fgetc(file.get());
+    if (c == EOF) return -1;
+    ungetc(c, file.get());
+    return c;
+} // File::peek
+
+size_t File::size() const
+{
+    if (file == nullptr) return 0;
+    fflush(file.get());
+    struct stat st;
+    return fstat(fileno(file.get()), &st) == 0 ? st.st_size : 0;
+} // File::size
+
+String File::readStringUntil(char terminator)
+{
+    String result;
+    int c;
+    while ((c = read()) >= 0 && c != terminator) result += (char)c;
+    return result;
+} // File::readStringUntil
+
+time_t File::getLastWrite() const
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? st.st_mtime : 0;
+} // File::getLastWrite
+
+bool Dir::next()
+{
+    if (! isRead)
+    {
+        isRead = true;
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(path, ec))
+        {
+            if (entry.is_regular_file()) entries.push_back(entry.path().filename().string());
+        } // for
+
+        // Served from the back
+        std::sort(entries.begin(), entries.end(), std::greater<std::string>());
+        return ! entries.empty();
+    } // if
+
+    if (! entries.empty()) entries.pop_back();
+    return ! entries.empty();
+} // Dir::next
+
+size_t Dir::fileSize() const
+{
+    std::error_code ec;
+    return entries.empty() ? 0 : std::filesystem::file_size(path + "/" + entries.back(), ec);
+} // Dir::fileSize
+
+File Dir::openFile(const char* mode) const
+{
+    if (entries.empty()) return File();
+    std::string fullPath = path + "/" + entries.back();
+    FILE* f = fopen(fullPath.c_str(), mode);
+    return f == nullptr ? File() : File(fullPath, entries.back(), f);
+} // Dir::openFile
+
+bool FS::format()
+{
+    std::error_code ec;
+    std::filesystem::remove_all(fileSystemRoot, ec);
+    return std::filesystem::create_directories(fileSystemRoot, ec);
+} // FS::format
+
+bool FS::info(FSInfo& info)
+{
+    info = FSInfo { 1024 * 1024, 0, 8192, 256, 5, 32 };
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(fileSystemRoot, ec))
+    {
+        if (entry.is_regular_file()) info.usedBytes += entry.file_size();
+    } // for
+    return true;
+} // FS::info
+
+File FS::open(const char* path, const char* mode)
+{
+    std::string fullPath = HostPath(path);
+    std::string fopenMode = mode[0] == 'w' ? "wb+" : mode[0] == 'a' ? "ab+" : "rb";
+    FILE* f = fopen(fullPath.c_str(), fopenMode.c_str());
+    if (f == nullptr) return File();
+    const char* name = strrchr(path, '/');
+    return File(fullPath, name != nullptr ? name + 1 : path, f);
+} // FS::open
+
+Dir FS::openDir(const char* path)
+{
+    return Dir(HostPath(path));
+} // FS::openDir
+
+bool FS::exists(const char* path)
+{
+    std::error_code ec;
+    return std::filesystem::exists(HostPath(path), ec);
+} // FS::exists
+
+bool FS::remove(const char* path)
+{
+    std::error_code ec;
+    return std::filesystem::remove(HostPath(path), ec);
+} // FS::remove
+
+bool FS::rename(const char* from, const char* to)
+{
+    std::error_code ec;
+    std::filesystem::rename(HostPath(from), HostPath(to), ec);
+    return ! ec;
+} // FS::rename
+
+} // namespace fs
+
+void MD5Builder::add(const uint8_t* data, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        hash[0] = (hash[0] ^ data[i]) * 0x100000001B3ULL;
+        hash[1] = (hash[1] ^ data[i]) * 0x1000193ULL + (hash[0] >> 29);
+    } // for
+} // MD5Builder::add
+
+bool MD5Builder::addStream(fs::File& stream, size_t maxLen)
+{
+    uint8_t buf[512];
+    while (maxLen > 0)
+    {
+        size_t n = stream.read(buf, std::min(maxLen, sizeof(buf)));
+        if (n == 0) break;
+        add(buf, n);
+        maxLen -= n;
+    } // while
+    return maxLen == 0;
+} // MD5Builder::addStream
+
+String MD5Builder::toString() const
+{
+    char buf[33];
+    snprintf(buf, sizeof(buf), "%016" PRIx64 "%016" PRIx64, hash[0], hash[1]);
+    return buf;
+} // MD5Builder::toString
+
+// ---- Web server
+
+bool AsyncWebServerRequest::hasArg(const char* name) const
+{
+    for (const auto& a : arguments) if (a.first == name) return true;
+    return false;
+} // AsyncWebServerRequest::hasArg
+
+String AsyncWebServerRequest::arg(const char* name) const
+{
+    for (const auto& a : arguments) if (a.first == name) return a.second;
+    return String();
+} // AsyncWebServerRequest::arg
+
+bool AsyncWebServerRequest::hasHeader(const char* name) const
+{
+    for (const auto& h : headerList) if (strcasecmp(h.first.c_str(), name) == 0) return true;
+    return false;
+} // AsyncWebServerRequest::hasHeader
+
+String AsyncWebServerRequest::header(const char* name) const
+{
+    for (const auto& h : headerList) if (strcasecmp(h.first.c_str(), name) == 0) return h.second;
+    return String();
+} // AsyncWebServerRequest::header
+
+AsyncWebServerResponse* AsyncWebServerRequest::beginResponse(fs::FS& fs, const String& path,
+    const String& contentType)
+{
+    fs::File file = fs.open(path, "r");
+    if (! file) return new AsyncWebServerResponse(404, asyncsrv::T_text_plain);
+
+    std::string content(file.size(), '\0');
+    file.read((uint8_t*)&content[0], content.size());
+    return new AsyncWebServerResponse(200, contentType, content);
+} // AsyncWebServerRequest::beginResponse
+
+void AsyncWebServer::HostRequest(AsyncWebServerRequest* request)
+{
+    auto it = handlers.find(request->url());
+    if (it != handlers.end()) it->second(request);
+    else if (notFoundHandler) notFoundHandler(request);
+} // AsyncWebServer::HostRequest
+
+String AsyncWebServer::HostReadResponse(AsyncWebServerRequest* request, size_t chunkSize)
+{
+    AsyncWebServerResponse* response = request->response;
+    if (response == nullptr) return String();
+    if (! response->filler) return response->content;
+
+    String content;
+    std::string chunk(chunkSize, '\0');
+    for (;;)
+    {
+        size_t len = response->filler((uint8_t*)&chunk[0], chunkSize, content.size());
+        if (len == 0) break;
+        content.append(chunk, 0, len);
+    } // for
+    return content;
+} // AsyncWebServer::HostReadResponse
+
+// ---- WebSocket
+
+void AsyncWebSocketClient::text(const char* message, size_t len)
+{
+    if (clientStatus != WS_CONNECTED || queueIsFull()) return;  // Discarded, as in the library
+
+    HostSpend(hostWebSocketSendMicros);
+    nTextFrames++;
+    nBytes += len;
+    owner->Deliver(*this, std::string(message, len), false);
+} // AsyncWebSocketClient::text
+
+void AsyncWebSocketClient::binary(const uint8_t* message, size_t len)
+{
+    if (clientStatus != WS_CONNECTED || queueIsFull()) return;
+
+    HostSpend(hostWebSocketSendMicros);
+    nBinaryFrames++;
+    nBytes += len;
+    owner->Deliver(*this, std::string((const char*)message, len), true);
+} // AsyncWebSocketClient::binary
+
+void AsyncWebSocketClient::close(uint16_t, const char*)
+{
+    if (clientStatus == WS_DISCONNECTED) return;
+    clientStatus = WS_DISCONNECTED;
+    if (owner->eventHandler) owner->eventHandler(owner, this, WS_EVT_DISCONNECT, nullptr, nullptr, 0);
+} // AsyncWebSocketClient::close
+
+void AsyncWebSocket::Deliver(AsyncWebSocketClient& c, const std::string& message, bool isBinary)
+{
+    if (queueMessages) c._messageQueue.push_back(std::make_pair(message, isBinary));
+    else if (c.onMessage) c.onMessage(message, isBinary);
+} // AsyncWebSocket::Deliver
+
+size_t AsyncWebSocket::count() const
+{
+    return std::count_if(clients.begin(), clients.end(),
+        [](const AsyncWebSocketClient& c) { return c.status() == WS_CONNECTED; });
+} // AsyncWebSocket::count
+
+AsyncWebSocketClient* AsyncWebSocket::client(uint32_t id)
+{
+    for (auto& c : clients) if (c.id() == id && c.status() == WS_CONNECTED) return &c;
+    return nullptr;
+} // AsyncWebSocket::client
+
+bool AsyncWebSocket::availableForWrite(uint32_t id)
+{
+    AsyncWebSocketClient* c = client(id);
+    return c != nullptr && ! c->queueIsFull();
+} // AsyncWebSocket::availableForWrite
+
+bool AsyncWebSocket::availableForWriteAll()
+{
+    for (auto& c : clients) if (c.status() == WS_CONNECTED && c.queueIsFull()) return false;
+    return true;
+} // AsyncWebSocket::availableForWriteAll
+
+void AsyncWebSocket::text(uint32_t id, const char* message, size_t len)
+{
+    AsyncWebSocketClient* c = client(id);
+    if (c != nullptr) c->text(message, len);
+} // AsyncWebSocket::text
+
+void AsyncWebSocket::textAll(const char* message, size_t len)
+{
+    for (auto& c : clients) c.text(message, len);
+} // AsyncWebSocket::textAll
+
+void AsyncWebSocket::binary(uint32_t id, const uint8_t* message, size_t len)
+{
+    AsyncWebSocketClient* c = client(id);
+    if (c != nullptr) c->binary(message, len);
+} // AsyncWebSocket::binary
+
+void AsyncWebSocket::close(uint32_t id, uint16_t code, const char* message)
+{
+    AsyncWebSocketClient* c = client(id);
+    if (c != nullptr) c->close(code, message);
+} // AsyncWebSocket::close
+
+void AsyncWebSocket::closeAll(uint16_t code, const char* message)
+{
+    for (auto& c : clients) c.close(code, message);
+} // AsyncWebSocket::closeAll
+
+void AsyncWebSocket::cleanupClients(uint16_t)
+{
+    // Keep the disconnected clients, so that the host program can still read their statistics
+} // AsyncWebSocket::cleanupClients
+
+AsyncWebSocketClient* AsyncWebSocket::HostConnect(IPAddress ip)
+{
+    clients.emplace_back(this, nextId++, ip);
+    AsyncWebSocketClient* c = &clients.back();
+    if (eventHandler) eventHandler(this, c, WS_EVT_CONNECT, nullptr, nullptr, 0);
+    return c;
+} // AsyncWebSocket::HostConnect
+
+void AsyncWebSocket::HostReceiveText(uint32_t id, const char* message)
+{
+    AsyncWebSocketClient* c = client(id);
+    if (c == nullptr || ! eventHandler) return;
+
+    size_t len = strlen(message);
+    std::string data(message, len + 1);  // Room for the terminating '\0' that the handler may write
+    AwsFrameInfo info = { WS_TEXT, 0, 1, 1, WS_TEXT, len, { 0 }, 0 };
+    eventHandler(this, c, WS_EVT_DATA, &info, (uint8_t*)&data[0], len);
+} // AsyncWebSocket::HostReceiveText
+
+void AsyncWebSocket::HostDisconnect(uint32_t id)
+{
+    AsyncWebSocketClient* c = client(id);
+    if (c != nullptr) c->close();
+} // AsyncWebSocket::HostDisconnect
+
+int AsyncWebSocket::HostDeliver()
+{
+    int n = 0;
+    for (auto& c : clients)
+    {
+        while (! c._messageQueue.empty())
+        {
+            auto message = c._messageQueue.front();
+            c._messageQueue.pop_front();
+            if (c.onMessage) c.onMessage(message.first, message.second);
+            n++;
+        } // while
+    } // for
+    return n;
+} // AsyncWebSocket::HostDeliver
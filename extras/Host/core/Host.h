@@ -0,0 +1,29 @@
+#ifndef Host_h
+#define Host_h
+
+// Host build: controls for the host program (see ../README.md)
+
+#include <Arduino.h>
+
+// If true, millis(), micros() and delay() follow the wall clock. Otherwise, time is virtual: it advances only by
+// delay() and HostSpend(), plus one microsecond per call to micros(), so that a run is repeatable and not slowed
+// down by the delay(9) at the end of each loop() iteration.
+extern bool hostRealTime;
+
+// If true, what the sketch prints on the serial port is written to stdout
+extern bool hostSerialEcho;
+
+// Time that a WebSocket frame takes to send, e.g. to model the TCP/IP stack on the ESP8266; spent on the calling
+// thread with HostSpend()
+extern uint32_t hostWebSocketSendMicros;
+
+// Spend (real time: busy-wait) or advance (virtual time) the specified number of microseconds
+void HostSpend(uint32_t us);
+
+// The directory that holds the flash file system (LittleFS, SPIFFS); created if it does not exist
+void HostSetFileSystemRoot(const char* dir);
+
+// Process CPU time, in microseconds
+uint64_t HostCpuMicros();
+
+#endif // Host_h
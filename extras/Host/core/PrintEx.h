@@ -0,0 +1,43 @@
+#ifndef PrintEx_h
+#define PrintEx_h
+
+// Host build: the part of the "PrintEx" library that the sketch uses
+
+#include <Arduino.h>
+
+// Print into a character buffer; the caller makes sure that it is large enough
+class GString : public Print
+{
+  public:
+
+    GString(char* _buffer) : buffer(_buffer) { buffer[0] = '\0'; }
+
+    size_t write(uint8_t c) override
+    {
+        buffer[len++] = c;
+        buffer[len] = '\0';
+        return 1;
+    } // write
+    using Print::write;
+
+  private:
+
+    char* buffer;
+    size_t len = 0;
+}; // class GString
+
+class PrintAdapter : public Print
+{
+  public:
+
+    PrintAdapter(Print& _out) : out(_out) { }
+
+    size_t write(uint8_t c) override { return out.write(c); }
+    using Print::write;
+
+  private:
+
+    Print& out;
+}; // class PrintAdapter
+
+#endif // PrintEx_h
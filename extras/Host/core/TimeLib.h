@@ -0,0 +1,26 @@
+#ifndef TimeLib_h
+#define TimeLib_h
+
+// Host build: the part of the PaulStoffregen "Time" library that the sketch uses, on top of the C library
+
+#include <Arduino.h>
+
+
+time_t now();
+void setTime(time_t t);
+int hour(time_t t);
+int minute(time_t t);
+int second(time_t t);
+int day(time_t t);
+int weekday(time_t t);
+int month(time_t t);
+int year(time_t t);
+inline int hour() { return hour(now()); }
+inline int minute() { return minute(now()); }
+inline int second() { return second(now()); }
+inline int day() { return day(now()); }
+inline int weekday() { return weekday(now()); }
+inline int month() { return month(now()); }
+inline int year() { return year(now()); }
+
+#endif // TimeLib_h
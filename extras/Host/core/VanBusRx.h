@@ -0,0 +1,107 @@
+#ifndef VanBusRx_h
+#define VanBusRx_h
+
+// Host build: the part of the "VanBus" library that the sketch uses. Instead of an interrupt service routine
+// sampling a GPIO pin, the host program puts packets into the receive queue with TVanBusRx::HostInject(). The
+// queue, the drop policy and the overrun detection behave as in the library (version 0.3.4).
+
+#include <Arduino.h>
+
+#include <mutex>
+
+#define VAN_BUS_VERSION "0.3.4-host"
+#define VAN_BUS_VERSION_INT 000003004
+
+#define VAN_MAX_DATA_BYTES (28)
+#define VAN_BIT_RECESSIVE (1)
+#define VAN_DEFAULT_RX_QUEUE_SIZE (15)
+#define VAN_MAX_RX_QUEUE_SIZE (100)
+
+#define MAX_FLOAT_SIZE (12)
+
+// Print a float into a buffer
+char* FloatToStr(char* buffer, float f, int prec);
+
+// CRC-15 over the header (IDEN and command flags) and the data, as transmitted on the bus
+uint16_t VanCrc(uint16_t iden, uint8_t commandFlags, const uint8_t* data, int dataLen);
+
+class TVanPacketRxDesc
+{
+  public:
+
+    uint16_t Iden() const { return iden; }
+    uint8_t CommandFlags() const { return commandFlags; }
+    const char* CommandFlagsStr() const;
+    const uint8_t* Data() const { return data; }
+    int DataLen() const { return dataLen; }
+    uint16_t Crc() const { return crc; }
+    unsigned long Millis() const { return millis_; }
+    bool CheckCrc() const { return crcOk; }
+    bool CheckCrcAndRepair() { return crcOk; }
+    void DumpRaw(Print& s, char last = '\n') const;
+
+    uint32_t seqNo = 0;
+
+  private:
+
+    friend class TVanBusRx;
+
+    uint16_t iden = 0;
+    uint8_t commandFlags = 0;
+    uint8_t data[VAN_MAX_DATA_BYTES] = {};
+    int dataLen = 0;
+    uint16_t crc = 0;
+    bool crcOk = false;
+    unsigned long millis_ = 0;
+}; // class TVanPacketRxDesc
+
+typedef bool (*TIsPacketSelected)(const TVanPacketRxDesc&);
+
+class TVanBusRx
+{
+  public:
+
+    bool Setup(uint8_t rxPin, int queueSize = VAN_DEFAULT_RX_QUEUE_SIZE);
+    bool Receive(TVanPacketRxDesc& pkt, bool* isQueueOverrun = nullptr);
+
+    void Disable() { enabled = false; }
+    void Enable() { enabled = true; }
+    bool IsEnabled() const { return enabled; }
+
+    int QueueSize() const { return size; }
+    int GetNQueued();
+    int GetMaxQueued() const { return maxQueued; }
+    uint32_t GetCount() const { return count; }
+
+    void SetDropPolicy(int threshold, TIsPacketSelected isPacketSelected);
+    void DumpStats(Print& s, bool longForm = true);
+
+    // Host program: a packet comes in from the bus. Returns false if it was not queued: dropped by the drop
+    // policy, receiver disabled (e.g. while writing to flash), or queue full (overrun).
+    bool HostInject(uint16_t iden, uint8_t commandFlags, const uint8_t* data, int dataLen, bool crcOk = true);
+
+    // Host program: statistics
+    uint32_t nHostDropped = 0;
+    uint32_t nHostMissedDisabled = 0;
+    uint32_t nHostOverruns = 0;
+
+  private:
+
+    std::recursive_mutex mutex;  // The drop policy calls GetNQueued()
+    TVanPacketRxDesc pool[VAN_MAX_RX_QUEUE_SIZE];
+    int size = VAN_DEFAULT_RX_QUEUE_SIZE;
+    int head = 0;  // Next to be written
+    int tail = 0;  // Next to be read
+    int nQueued = 0;
+    int maxQueued = 0;
+    bool overrun = false;
+    bool enabled = true;
+    uint32_t count = 0;
+    uint32_t nCorrupt = 0;
+    int dropThreshold = VAN_MAX_RX_QUEUE_SIZE;
+    TIsPacketSelected isPacketSelected = nullptr;
+}; // class TVanBusRx
+
+extern TVanBusRx VanBusRx;
+
+#endif // VanBusRx_h
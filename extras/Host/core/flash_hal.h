@@ -0,0 +1,10 @@
+#ifndef flash_hal_h
+#define flash_hal_h
+
+// Host build: the ESP8266 flash layout. The flash file system is a host directory (see HostSetFileSystemRoot in
+// Host.h), so it takes no space in the emulated flash.
+
+#define FS_PHYS_ADDR (0)
+#define FS_PHYS_SIZE (0)
+
+#endif // flash_hal_h
@@ -0,0 +1,24 @@
+#ifndef user_interface_h
+#define user_interface_h
+
+// Host build: ESP8266 NONOS SDK functions used for light sleep; sleeping is not simulated
+
+#include <stdint.h>
+
+#define GPIO_ID_PIN(p) (p)
+
+enum { GPIO_PIN_INTR_LOLEVEL = 4 };
+enum { NULL_MODE = 0 };
+enum { NONE_SLEEP_T = 0, LIGHT_SLEEP_T = 1 };
+
+inline void gpio_pin_wakeup_enable(uint32_t, int) { }
+inline void gpio_pin_wakeup_disable() { }
+inline bool wifi_set_opmode(uint8_t) { return true; }
+inline bool wifi_set_sleep_type(int) { return true; }
+inline void wifi_fpm_set_sleep_type(int) { }
+inline void wifi_fpm_open() { }
+inline void wifi_fpm_close() { }
+inline void wifi_fpm_set_wakeup_cb(void (*)()) { }
+inline int8_t wifi_fpm_do_sleep(uint32_t) { return 0; }
+
+#endif // user_interface_h
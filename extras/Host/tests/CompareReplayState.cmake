@@ -0,0 +1,22 @@
+# Run two van_replay commands, and check that the clients end up showing the same state (see VanReplay.cpp)
+#
+# Usage: cmake -DREPLAY_A=<command;args...> -DREPLAY_B=<command;args...> -P CompareReplayState.cmake
+
+foreach(run A B)
+    execute_process(COMMAND ${REPLAY_${run}} OUTPUT_VARIABLE output RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "${REPLAY_${run}} failed (${result})")
+    endif()
+
+    string(REGEX MATCH "\"items\": ([0-9]+), \"state_digest\": \"([0-9a-f]+)\"" match "${output}")
+    if(NOT match)
+        message(FATAL_ERROR "No state digest in the output of ${REPLAY_${run}}:\n${output}")
+    endif()
+    set(items_${run} ${CMAKE_MATCH_1})
+    set(digest_${run} ${CMAKE_MATCH_2})
+    message(STATUS "${run}: ${items_${run}} items, state digest ${digest_${run}}")
+endforeach()
+
+if(NOT digest_A STREQUAL digest_B)
+    message(FATAL_ERROR "The clients show a different state")
+endif()
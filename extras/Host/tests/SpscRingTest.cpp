@@ -0,0 +1,131 @@
+// Host build: tests the lock-free ring buffer between the VAN bus receive task and the main loop (SpscRing.h), with
+// a producer and a consumer thread
+
+#include "SpscRing.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <thread>
+
+static int nFailures = 0;
+
+#define CHECK(cond) \
+    do { if (! (cond)) { printf("FAIL: %s (line %d)\n", #cond, __LINE__); nFailures++; } } while (0)
+
+// Message number 'seq': length and content follow from the sequence number, so that the consumer can check them
+static uint32_t MessageLen(uint32_t seq)
+{
+    return 1 + (seq * 7919) % 300;
+} // MessageLen
+
+static void FillMessage(uint32_t seq, uint8_t* buf)
+{
+    for (uint32_t i = 0; i < MessageLen(seq); i++) buf[i] = (uint8_t)(seq * 31 + i);
+} // FillMessage
+
+static void TestSingleThread()
+{
+    SpscRing_t<64> ring;
+    uint32_t len, tag;
+
+    CHECK(ring.IsEmpty());
+    CHECK(ring.Front(len, tag) == nullptr);
+
+    // Too large for the ring at all
+    uint8_t big[64] = {};
+    CHECK(! ring.Push(big, sizeof(big)));
+
+    // Records of 8 (header) + 8 bytes: 4 fit, a 5th does not
+    uint8_t msg[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    for (int i = 0; i < 4; i++) CHECK(ring.Push(msg, sizeof(msg), i));
+    CHECK(! ring.Push(msg, 1));
+    CHECK(ring.maxBytesUsed == 64);
+
+    const uint8_t* front = ring.Front(len, tag);
+    CHECK(front != nullptr && len == 8 && tag == 0 && memcmp(front, msg, 8) == 0);
+    ring.Pop();
+
+    // A record that does not fit at the end of the ring wraps around, skipping the space at the end
+    CHECK(ring.Push(msg, 1, 10));  // Takes the freed 16 bytes at the start
+    for (int i = 1; i < 4; i++)
+    {
+        front = ring.Front(len, tag);
+        CHECK(front != nullptr && tag == (uint32_t)i);
+        ring.Pop();
+    } // for
+    front = ring.Front(len, tag);
+    CHECK(front != nullptr && len == 1 && tag == 10 && front[0] == 1);
+    ring.Pop();
+    CHECK(ring.IsEmpty());
+
+    // A record that fits neither in the space left at the end, nor in the free space at the start, is refused
+    CHECK(ring.Push(msg, 8, 11));  // At offset 16
+    CHECK(ring.Push(msg, 8, 12));  // At offset 32
+    CHECK(! ring.Push(big, 24, 13));  // 32 bytes: 16 left at the end, 16 free at the start
+    front = ring.Front(len, tag);
+    CHECK(front != nullptr && tag == 11);
+    ring.Pop();
+    CHECK(ring.Push(big, 24, 13));  // Now 32 bytes free at the start
+    front = ring.Front(len, tag);
+    CHECK(front != nullptr && tag == 12);
+    ring.Pop();
+    front = ring.Front(len, tag);
+    CHECK(front != nullptr && len == 24 && tag == 13);
+    ring.Pop();
+    CHECK(ring.IsEmpty());
+} // TestSingleThread
+
+static void TestTwoThreads()
+{
+    static SpscRing_t<1024> ring;  // Small, so that it is often full and wraps around often
+    const uint32_t nMessages = 1000000;
+
+    uint32_t nPushFailures = 0;
+    std::thread producer([&]()
+    {
+        uint8_t buf[300];
+        for (uint32_t seq = 0; seq < nMessages; seq++)
+        {
+            FillMessage(seq, buf);
+            while (! ring.Push(buf, MessageLen(seq), seq))
+            {
+                nPushFailures++;
+                std::this_thread::yield();
+            } // while
+        } // for
+    });
+
+    uint32_t nBad = 0;
+    uint8_t expected[300];
+    for (uint32_t seq = 0; seq < nMessages; seq++)
+    {
+        uint32_t len, tag;
+        const uint8_t* msg;
+        while ((msg = ring.Front(len, tag)) == nullptr) std::this_thread::yield();
+
+        FillMessage(seq, expected);
+        if (tag != seq || len != MessageLen(seq) || memcmp(msg, expected, len) != 0)
+        {
+            if (nBad++ < 5) printf("FAIL: message %u: tag %u, len %u\n", seq, tag, len);
+        } // if
+
+        ring.Pop();
+    } // for
+
+    producer.join();
+
+    CHECK(nBad == 0);
+    CHECK(ring.IsEmpty());
+    printf("%u messages passed in order and intact; producer found the ring full %u times\n", nMessages,
+        nPushFailures);
+} // TestTwoThreads
+
+int main()
+{
+    TestSingleThread();
+    TestTwoThreads();
+
+    printf("%s\n", nFailures == 0 ? "PASS" : "FAIL");
+    return nFailures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+} // main
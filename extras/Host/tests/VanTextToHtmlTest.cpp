@@ -0,0 +1,135 @@
+// Host build: checks that the table-driven VanTextToHtml (PacketToJson.ino) gives the same result as the String
+// replace() chain it replaced, and compares their speed.
+//
+// The one intended difference: VanTextToHtml also escapes '"' and '\', which would otherwise break the JSON string.
+
+#include <Arduino.h>
+
+#include <chrono>
+
+// Defined in PacketToJson.ino
+int VanTextToHtml(const char* in, char* out, const int n, uint8_t options);
+enum
+{
+    VAN_TEXT_SOFT_HYPHENS = 0x01,
+    VAN_TEXT_NON_BREAKING_SPACES = 0x02,
+    VAN_TEXT_SATNAV_MARKERS = 0x04
+};
+
+// The conversion as done before, for the strings of a sat nav report (unchanged, apart from the name)
+void OldAsciiToHtml(String& in)
+{
+    for (unsigned int i = 0; i < in.length(); i++)
+    {
+        char c = in.c_str()[i];
+
+        // Vast majority of characters is printable, so this if-statement is entered seldomly
+        if (c > 127)
+        {
+            // Hope this is somewhat efficient...
+            String from(c);
+            String to((int)c, DEC);
+            to = "&#" + to + ";";
+            in.replace(from, to);  // in.length() will become larger; no problem
+            i += 5;  // We can skip the just added characters
+        } // if
+    } // for
+} // OldAsciiToHtml
+
+String OldSatNavStringToHtml(const char* buffer, bool nonBreakingSpaces)
+{
+    String record = buffer;
+    record.replace("#", "&shy;");
+    if (nonBreakingSpaces) record.replace(" ", "&nbsp;");
+    record.replace("\x80", "?");
+    record.replace("\x81", "&#x24E7;");
+    OldAsciiToHtml(record);
+    return record;
+} // OldSatNavStringToHtml
+
+String NewSatNavStringToHtml(const char* buffer, bool nonBreakingSpaces)
+{
+    char out[512];
+    uint8_t options = VAN_TEXT_SOFT_HYPHENS | VAN_TEXT_SATNAV_MARKERS
+        | (nonBreakingSpaces ? VAN_TEXT_NON_BREAKING_SPACES : 0);
+    return VanTextToHtml(buffer, out, sizeof(out), options) < 0 ? String("<overflow>") : String(out);
+} // NewSatNavStringToHtml
+
+static int nFailures = 0;
+
+static void Expect(const String& actual, const String& expected, const char* what, int c)
+{
+    if (actual == expected) return;
+    printf("FAIL: %s, byte 0x%02X: got '%s', expected '%s'\n", what, c, actual.c_str(), expected.c_str());
+    nFailures++;
+} // Expect
+
+int main()
+{
+    // Every byte value, alone and between other text, with and without non-breaking spaces
+    for (int c = 1; c <= 0xFF; c++)
+    {
+        for (int nbsp = 0; nbsp <= 1; nbsp++)
+        {
+            char alone[] = { (char)c, 0 };
+            char embedded[] = { 'R', 'U', 'E', ' ', (char)c, 'A', (char)c, ' ', 'B', 0 };
+
+            String expectedAlone = OldSatNavStringToHtml(alone, nbsp);
+            String expectedEmbedded = OldSatNavStringToHtml(embedded, nbsp);
+            if (c == '"' || c == '\\')
+            {
+                expectedAlone = c == '"' ? "&quot;" : "&#92;";
+                String sep = nbsp ? "&nbsp;" : " ";
+                expectedEmbedded = "RUE" + sep + expectedAlone + "A" + expectedAlone + sep + "B";
+            } // if
+
+            Expect(NewSatNavStringToHtml(alone, nbsp), expectedAlone, "alone", c);
+            Expect(NewSatNavStringToHtml(embedded, nbsp), expectedEmbedded, "embedded", c);
+        } // for
+    } // for
+
+    // Outside sat nav reports (e.g. RDS text), 0x80 and 0x81 are ordinary extended Ascii characters
+    char out[64];
+    VanTextToHtml("A\x80\x81#", out, sizeof(out), 0);
+    Expect(out, "A&#128;&#129;#", "RDS text", 0x80);
+
+    // Output that does not fit is reported
+    if (VanTextToHtml("\xEB\xEB", out, 12, 0) != -1) { printf("FAIL: overflow not reported\n"); nFailures++; }
+    if (VanTextToHtml("\xEB\xEB", out, 13, 0) != 12) { printf("FAIL: exact fit not accepted\n"); nFailures++; }
+
+    // Speed, on a mix of typical sat nav strings
+    const char* const strings[] =
+    {
+        "CHAMPS-ELYS\xC9" "ES", "AVENUE DES#TERNES", "GARE DE L'EST", "M\xDC" "NCHEN", "ALLEE DU PARC\x80",
+        "SCHLO\xDF" "STRASSE", "RUE DE LA PAIX", "PLACE DE LA CONCORDE\x81", "BOULEVARD HAUSSMANN", "S\xC3" "O PAULO",
+    };
+    const int nStrings = sizeof(strings) / sizeof(strings[0]);
+    const int nRounds = 20000;
+
+    size_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < nRounds; r++)
+    {
+        for (int i = 0; i < nStrings; i++) sink += OldSatNavStringToHtml(strings[i], i % 2).length();
+    } // for
+    auto oldNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < nRounds; r++)
+    {
+        for (int i = 0; i < nStrings; i++)
+        {
+            char buf[256];
+            uint8_t options = VAN_TEXT_SOFT_HYPHENS | VAN_TEXT_SATNAV_MARKERS
+                | (i % 2 ? VAN_TEXT_NON_BREAKING_SPACES : 0);
+            sink += VanTextToHtml(strings[i], buf, sizeof(buf), options);
+        } // for
+    } // for
+    auto newNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+
+    printf("replace() chain: %.0f ns/string, VanTextToHtml: %.0f ns/string (%zu)\n",
+        (double)oldNs.count() / (nRounds * nStrings), (double)newNs.count() / (nRounds * nStrings), sink % 10);
+
+    printf("%s\n", nFailures == 0 ? "PASS" : "FAIL");
+    return nFailures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+} // main